@@ -0,0 +1,167 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: archive_extract.c
+//
+//  Description: Writes the frames of a frame archive (see frame_archive.c) back out, one file per frame, named like
+//               the files main writes without an archive (frame_<no>.ppm/.png/.rtd). Delta frames (.rtd) are written
+//               as they are, frame_read rebuilds them
+//
+//               Usage: ./archive_extract <archive name> [first frame no] [last frame no]
+//
+
+#include "include.h"
+#include "frame_archive.h"
+#include <limits.h>
+
+//local functions
+static int read_frame(const char *archive_name, const frame_archive_index_entry_t *entry, int *segment_fd,
+                      unsigned int *segment_no, unsigned char **data, size_t *data_capacity);
+static void print_usage(void);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  main
+//
+//  Parameters:     argc, argv - archive name, optional frame number range
+//
+//  Return:         EXIT_SUCCESS, or EXIT_FAILURE on a bad or truncated archive
+//
+//  Description:    Walks the index in store order, and writes every frame in the range. Record headers are checked
+//                  against the index entries, so a segment not matching its index is reported instead of extracted
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    FILE *index_fp, *out;
+    char file_name[FRAME_ARCHIVE_NAME_SIZE + 16];
+    frame_archive_index_header_t header;
+    frame_archive_index_entry_t entry;
+    unsigned int first_frame_no = 0, last_frame_no = UINT_MAX;
+    unsigned int segment_no = 0;
+    unsigned long long no_of_frames = 0, no_of_bytes = 0;
+    unsigned char *data = NULL;
+    size_t data_capacity = 0;
+    int segment_fd = -1;
+
+    if((argc < 2) || (argc > 4) || (strlen(argv[1]) >= FRAME_ARCHIVE_NAME_SIZE))
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+    if(argc > 2) first_frame_no = strtoul(argv[2], NULL, 10);
+    if(argc > 3) last_frame_no = strtoul(argv[3], NULL, 10);
+
+    frame_archive_index_name(file_name, sizeof(file_name), argv[1]);
+    index_fp = fopen(file_name, "rb");
+    if(!index_fp) EXIT_FAIL("fopen");
+
+    if((fread(&header, sizeof(header), 1, index_fp) != 1) || memcmp(header.magic, FRAME_ARCHIVE_INDEX_MAGIC, sizeof(header.magic)) ||
+       (header.version != FRAME_ARCHIVE_VERSION) || (header.entry_size != sizeof(entry)))
+    {
+        fprintf(stderr, "\n%s is not a frame archive index\n", file_name);
+        return EXIT_FAILURE;
+    }
+
+    while(fread(&entry, sizeof(entry), 1, index_fp) == 1)
+    {
+        if((entry.frame_no < first_frame_no) || (entry.frame_no > last_frame_no)) continue;
+
+        if(read_frame(argv[1], &entry, &segment_fd, &segment_no, &data, &data_capacity)) return EXIT_FAILURE;
+
+        snprintf(file_name, sizeof(file_name), "frame_%u.%s", entry.frame_no, frame_archive_format_extension(entry.format));
+        out = fopen(file_name, "wb");
+        if(!out) EXIT_FAIL("fopen");
+        if(fwrite(data, 1, entry.data_size, out) != entry.data_size) EXIT_FAIL("fwrite");
+        if(fclose(out)) EXIT_FAIL("fclose");
+
+        ++no_of_frames;
+        no_of_bytes += entry.data_size;
+    }
+
+    //an interrupted capture may leave a partly written last entry, the frames before it are fine
+    if(ferror(index_fp)) EXIT_FAIL("fread");
+
+    fclose(index_fp);
+    if(segment_fd != -1) close(segment_fd);
+    free(data);
+
+    fprintf(stdout, "%llu frames (%llu bytes) extracted from %s\n", no_of_frames, no_of_bytes, argv[1]);
+
+    return EXIT_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  read_frame
+//
+//  Parameters:     archive_name - archive name
+//                  entry - index entry of the frame
+//                  segment_fd, segment_no - open segment, -1 if none, replaced if the frame is in another segment
+//                  data, data_capacity - frame data buffer, grown as needed
+//
+//  Return:         SUCCESS, or ERROR on a missing segment, or a record not matching the index entry
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int read_frame(const char *archive_name, const frame_archive_index_entry_t *entry, int *segment_fd,
+                      unsigned int *segment_no, unsigned char **data, size_t *data_capacity)
+{
+    char file_name[FRAME_ARCHIVE_NAME_SIZE + 16];
+    frame_archive_record_t record;
+
+    if((*segment_fd == -1) || (*segment_no != entry->segment_no))
+    {
+        if(*segment_fd != -1) close(*segment_fd);
+        *segment_no = entry->segment_no;
+        frame_archive_segment_name(file_name, sizeof(file_name), archive_name, *segment_no);
+        *segment_fd = open(file_name, O_RDONLY);
+        if(*segment_fd == -1)
+        {
+            fprintf(stderr, "\n%s: %s\n", file_name, strerror(errno));
+            return ERROR;
+        }
+    }
+
+    if(*data_capacity < entry->data_size)
+    {
+        free(*data);
+        *data = (unsigned char *)malloc(entry->data_size);
+        if(!*data) EXIT_FAIL("malloc");
+        *data_capacity = entry->data_size;
+    }
+
+    if((pread(*segment_fd, &record, sizeof(record), entry->offset) != sizeof(record)) ||
+       (record.magic != FRAME_ARCHIVE_RECORD_MAGIC) || (record.frame_no != entry->frame_no) || (record.data_size != entry->data_size))
+    {
+        fprintf(stderr, "\nframe %u: bad or truncated record in segment %u at offset %llu\n",
+                entry->frame_no, entry->segment_no, (unsigned long long)entry->offset);
+        return ERROR;
+    }
+
+    if(pread(*segment_fd, *data, entry->data_size, entry->offset + sizeof(record)) != (ssize_t)entry->data_size)
+    {
+        fprintf(stderr, "\nframe %u: truncated data in segment %u\n", entry->frame_no, entry->segment_no);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  print_usage
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void print_usage(void)
+{
+    fprintf(stdout, "\nUsage: ./archive_extract <archive name> [first frame no] [last frame no]"
+                    "\n\nWrites the frames stored by main with '-a <archive name>' to frame_<no>.ppm/.png/.rtd files"
+                    "\nin the current directory, every frame unless a range is given\n");
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
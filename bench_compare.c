@@ -0,0 +1,254 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: bench_compare.c
+//
+//  Description: Compares pipeline benchmark results (see pipeline_bench.sh) against a stored baseline, run by run.
+//               A metric regresses when it is worse than the baseline by more than the threshold (percent) and by
+//               more than its noise floor. Exits with EXIT_FAILURE on any regression, so it can gate a roll out
+//
+//               Usage: ./bench_compare bench_baseline.json bench_results.json [threshold percent, default 10]
+//
+
+#include "include.h"
+#include "bench_report.h"
+
+//max no.of runs per results file
+#define MAX_BENCH_RUNS                  (1024)
+#define MAX_BENCH_LINE_SIZE             (4096)
+
+#define DEFAULT_REGRESSION_THRESHOLD    (10.0) //percent
+
+//metric direction
+#define HIGHER_IS_BETTER                (0)
+#define LOWER_IS_BETTER                 (1)
+
+//compared metric
+typedef struct
+{
+    const char *key;
+    int direction;
+    double noise_floor;     //smaller absolute changes are never a regression
+}bench_metric_t;
+
+static const bench_metric_t bench_metrics[] =
+{
+    {"sustained_fps",               HIGHER_IS_BETTER,   0.05},
+    {"cpu_msec_per_frame",          LOWER_IS_BETTER,    0.5},
+    {"missed_deadlines",            LOWER_IS_BETTER,    0.5},
+    {"grab_p99_usec",               LOWER_IS_BETTER,    200.0},
+    {"encode_p99_usec",             LOWER_IS_BETTER,    200.0},
+    {"write_p99_usec",              LOWER_IS_BETTER,    200.0},
+    {"store_response_p99_usec",     LOWER_IS_BETTER,    200.0},
+    {"capture_to_disk_p99_usec",    LOWER_IS_BETTER,    200.0},
+};
+#define NO_OF_BENCH_METRICS     (sizeof(bench_metrics) / sizeof(bench_metrics[0]))
+
+//results of one run
+typedef struct
+{
+    char name[BENCH_RUN_NAME_SIZE];
+    double values[NO_OF_BENCH_METRICS];
+}bench_run_t;
+
+//local functions
+static int read_results(const char *file_name, bench_run_t *runs);
+static int parse_run(const char *line, bench_run_t *run);
+static const bench_run_t *find_run(const bench_run_t *runs, const int no_of_runs, const char *name);
+static void print_usage(void);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  main
+//
+//  Parameters:     argc, argv - baseline results, new results, optional threshold in percent
+//
+//  Return:         EXIT_SUCCESS, or EXIT_FAILURE on a regression or a bad results file
+//
+//  Description:    Prints every compared metric of every run found in both files, and flags the regressions.
+//                  Runs missing from either file are listed, but are not a failure
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    int i, no_of_baseline_runs, no_of_runs, no_of_regressions = 0, no_of_compared = 0;
+    unsigned int m;
+    double threshold = DEFAULT_REGRESSION_THRESHOLD;
+    double baseline_value, value, change_percent, worse_by;
+    const bench_run_t *baseline;
+    static bench_run_t baseline_runs[MAX_BENCH_RUNS];
+    static bench_run_t runs[MAX_BENCH_RUNS];
+
+    if((argc != 3) && (argc != 4))
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+    if(argc == 4) threshold = atof(argv[3]);
+
+    no_of_baseline_runs = read_results(argv[1], baseline_runs);
+    no_of_runs = read_results(argv[2], runs);
+    if((no_of_baseline_runs < 0) || (no_of_runs < 0)) return EXIT_FAILURE;
+
+    fprintf(stdout, "%-28s %-26s %14s %14s %9s\n", "run", "metric", "baseline", "current", "change");
+
+    for(i = 0; i < no_of_runs; ++i)
+    {
+        baseline = find_run(baseline_runs, no_of_baseline_runs, runs[i].name);
+        if(!baseline)
+        {
+            fprintf(stdout, "%-28s not in the baseline\n", runs[i].name);
+            continue;
+        }
+        ++no_of_compared;
+
+        for(m = 0; m < NO_OF_BENCH_METRICS; ++m)
+        {
+            baseline_value = baseline->values[m];
+            value = runs[i].values[m];
+            change_percent = baseline_value ? ((value - baseline_value) * 100.0) / baseline_value : 0;
+            worse_by = (bench_metrics[m].direction == HIGHER_IS_BETTER) ? (baseline_value - value) : (value - baseline_value);
+
+            fprintf(stdout, "%-28s %-26s %14.3lf %14.3lf %+8.1lf%%", runs[i].name, bench_metrics[m].key, baseline_value, value, change_percent);
+
+            if((worse_by > bench_metrics[m].noise_floor) &&
+               (!baseline_value || ((worse_by * 100.0) / baseline_value > threshold)))
+            {
+                fprintf(stdout, "  REGRESSION");
+                ++no_of_regressions;
+            }
+            fprintf(stdout, "\n");
+        }
+    }
+
+    for(i = 0; i < no_of_baseline_runs; ++i)
+    {
+        if(!find_run(runs, no_of_runs, baseline_runs[i].name))
+        {
+            fprintf(stdout, "%-28s missing from %s\n", baseline_runs[i].name, argv[2]);
+        }
+    }
+
+    fprintf(stdout, "\n%d runs compared, %d regressions (threshold %.1lf%%)\n", no_of_compared, no_of_regressions, threshold);
+
+    return no_of_regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  read_results
+//
+//  Parameters:     file_name - results file, one run object per line (as written by pipeline_bench.sh)
+//                  runs - MAX_BENCH_RUNS entries
+//
+//  Return:         No.of runs read, or ERROR
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int read_results(const char *file_name, bench_run_t *runs)
+{
+    FILE *fp;
+    int no_of_runs = 0;
+    char line[MAX_BENCH_LINE_SIZE];
+
+    fp = fopen(file_name, "r");
+    if(!fp)
+    {
+        fprintf(stderr, "\nCannot open %s: %s\n", file_name, strerror(errno));
+        return ERROR;
+    }
+
+    while(fgets(line, sizeof(line), fp))
+    {
+        if(!strstr(line, "\"name\":")) continue;
+
+        if(no_of_runs == MAX_BENCH_RUNS)
+        {
+            fprintf(stderr, "\n%s: more than %d runs, the rest are ignored\n", file_name, MAX_BENCH_RUNS);
+            break;
+        }
+
+        if(parse_run(line, &runs[no_of_runs]))
+        {
+            fprintf(stderr, "\n%s: bad run \"%.60s...\"\n", file_name, line);
+            fclose(fp);
+            return ERROR;
+        }
+        ++no_of_runs;
+    }
+
+    fclose(fp);
+    return no_of_runs;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  parse_run
+//
+//  Parameters:     line - run object, written by bench_report_write()
+//                  run - filled with the run name and the compared metrics
+//
+//  Return:         SUCCESS, or ERROR if the name or a metric is missing
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int parse_run(const char *line, bench_run_t *run)
+{
+    unsigned int m;
+    const char *value;
+    char key[64];
+    char *end;
+
+    value = strstr(line, "\"name\": \"");
+    if(!value || (sscanf(value + strlen("\"name\": \""), "%63[^\"]", run->name) != 1)) return ERROR;
+
+    for(m = 0; m < NO_OF_BENCH_METRICS; ++m)
+    {
+        snprintf(key, sizeof(key), "\"%s\": ", bench_metrics[m].key);
+        value = strstr(line, key);
+        if(!value) return ERROR;
+
+        run->values[m] = strtod(value + strlen(key), &end);
+        if(end == value + strlen(key)) return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  find_run
+//
+//  Parameters:     runs, no_of_runs - results
+//                  name - run name
+//
+//  Return:         Run with the name, NULL if not found
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static const bench_run_t *find_run(const bench_run_t *runs, const int no_of_runs, const char *name)
+{
+    int i;
+
+    for(i = 0; i < no_of_runs; ++i)
+    {
+        if(!strcmp(runs[i].name, name)) return &runs[i];
+    }
+
+    return NULL;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  print_usage
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void print_usage(void)
+{
+    fprintf(stderr, "\nUsage: ./bench_compare <baseline results> <results> [threshold percent, default %.0lf]\n\n",
+            DEFAULT_REGRESSION_THRESHOLD);
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,242 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: bench_report.c
+//
+//  Description: Machine readable results of a run (-j), one JSON object on one line. pipeline_bench.sh collects them
+//               over a sweep of configurations, and bench_compare checks them against a stored baseline
+//
+
+#include "include.h"
+#include "bench_report.h"
+#include "capture_stats.h"
+#include "frame_source.h"
+#include "sequencer.h"
+#include <sys/resource.h>
+
+extern unsigned int store_frames_frequency;
+extern unsigned int compress_ratio;
+extern unsigned int output_format;
+extern unsigned int frame_source_type;
+extern unsigned int encode_workers;
+
+//stored frame format names, indexed by OUTPUT_FORMAT_xxx
+static const char *output_format_names[OUTPUT_FORMATS] =
+{
+    "ppm",
+    "png",
+    "delta"
+};
+
+//frame source names, indexed by FRAME_SOURCE_xxx
+static const char *frame_source_names[FRAME_SOURCES] =
+{
+    "device",
+    "test pattern",
+    "replay"
+};
+
+//stage latencies and store services of every camera, merged
+typedef struct
+{
+    capture_stats_t stats;
+    histogram_t query_response;
+    histogram_t store_response;
+    histogram_t store_execution;
+    double service_cpu_nsec;
+    unsigned long long missed_deadlines;
+    unsigned long long skipped_releases;
+}bench_totals_t;
+
+//local functions
+static void merge_cameras(bench_totals_t *totals);
+static int time_before(const struct timespec *time, const struct timespec *other);
+static void write_percentiles(FILE *fp, const char *stage, const histogram_t *histogram);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  bench_report_write
+//
+//  Parameters:     file_name - results file, overwritten
+//
+//  Return:         None
+//
+//  Description:    Writes the configuration, sustained store rate, bytes written per second, CPU time per stored frame,
+//                  and the latency percentiles of every stage (micro seconds), over all the cameras.
+//                  Call once the services have exited
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void bench_report_write(const char *file_name)
+{
+    FILE *fp;
+    char run_name[BENCH_RUN_NAME_SIZE];
+    struct rusage usage;
+    double elapsed_sec, sustained_fps, bytes_per_sec, service_cpu_msec, process_cpu_msec;
+    //histograms are too large for the dispatcher stack
+    static bench_totals_t totals;
+    const capture_stats_t *stats = &totals.stats;
+    const unsigned int no_of_cameras = get_no_of_cameras();
+    unsigned long long frames;
+
+    merge_cameras(&totals);
+    frames = stats->frames_stored ? stats->frames_stored : 1;
+
+    //runs of more cameras are compared with their own baselines
+    snprintf(run_name, sizeof(run_name), (no_of_cameras > 1) ? "%ux%u_f%u_c%u_%s_n%u" : "%ux%u_f%u_c%u_%s", stats->width, stats->height,
+             store_frames_frequency, compress_ratio, output_format_names[output_format], no_of_cameras);
+
+    //first to last stored frame (of any camera), one frame period less than the run, for every camera
+    elapsed_sec = delta_time_in_msec(&stats->last_store_time, &stats->first_store_time) / MSEC_PER_SEC;
+    sustained_fps = ((elapsed_sec > 0) && (stats->frames_stored > no_of_cameras)) ? (stats->frames_stored - no_of_cameras) / elapsed_sec : 0;
+    //mean stored frame size at the sustained rate
+    bytes_per_sec = sustained_fps * (stats->bytes_written / (double)frames);
+
+    //CPU time of the query and store jobs, and of the whole process (including start-up and reporting)
+    service_cpu_msec = totals.service_cpu_nsec / NSEC_PER_MSEC;
+    if(getrusage(RUSAGE_SELF, &usage)) EXIT_FAIL("getrusage");
+    process_cpu_msec = ((usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * (double)MSEC_PER_SEC) +
+                       ((usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / (double)USEC_PER_MSEC);
+
+    fp = fopen(file_name, "w");
+    if(!fp) EXIT_FAIL("fopen");
+
+    fprintf(fp, "{\"name\": \"%s\", \"source\": \"%s\", \"cameras\": %u, \"width\": %u, \"height\": %u, \"store_hz\": %u, "
+                "\"compress_ratio\": %u, \"format\": \"%s\", \"frames_stored\": %llu, \"elapsed_sec\": %.3lf, "
+                "\"sustained_fps\": %.3lf, \"bytes_written\": %llu, \"bytes_per_sec\": %.0lf, "
+                "\"cpu_msec_per_frame\": %.3lf, \"process_cpu_msec_per_frame\": %.3lf, "
+                "\"missed_deadlines\": %llu, \"skipped_releases\": %llu, \"encode_workers\": %u, \"frames_dropped\": %llu, "
+                "\"frames_unchanged\": %llu, \"sequence_gaps\": %llu, \"frames_lost\": %llu, \"late_dequeues\": %llu, "
+                "\"dequeue_timeouts\": %llu, \"frames_skipped\": %llu",
+                run_name, frame_source_names[frame_source_type], no_of_cameras, stats->width, stats->height, store_frames_frequency,
+                compress_ratio, output_format_names[output_format], stats->frames_stored, elapsed_sec,
+                sustained_fps, stats->bytes_written, bytes_per_sec,
+                service_cpu_msec / frames, process_cpu_msec / frames,
+                totals.missed_deadlines, totals.skipped_releases,
+                (output_format == OUTPUT_FORMAT_PNG) ? encode_workers : 0, stats->frames_dropped,
+                stats->frames_unchanged, stats->sequence_gaps, stats->frames_lost, stats->late_dequeues,
+                stats->dequeue_timeouts, stats->frames_skipped);
+
+    write_percentiles(fp, "grab", &stats->grab_time);
+    write_percentiles(fp, "dequeue", &stats->dequeue_latency);
+    write_percentiles(fp, "encode", &stats->encode_time);
+    write_percentiles(fp, "write", &stats->write_time);
+    write_percentiles(fp, "capture_to_disk", &stats->capture_to_disk);
+    write_percentiles(fp, "release_skew", &stats->release_skew);
+    write_percentiles(fp, "query_response", &totals.query_response);
+    write_percentiles(fp, "store_response", &totals.store_response);
+    write_percentiles(fp, "store_execution", &totals.store_execution);
+
+    fprintf(fp, "}\n");
+    if(fclose(fp)) EXIT_FAIL("fclose");
+
+    syslog(LOG_WARNING, " bench report: %s, %.3lf fps sustained, written to %s", run_name, sustained_fps, file_name);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  merge_cameras
+//
+//  Parameters:     totals - set to the merged stages, counters and store services of every camera
+//
+//  Return:         None
+//
+//  Description:    Resolution is camera 0's, the store times span the first to the last stored frame of any camera
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void merge_cameras(bench_totals_t *totals)
+{
+    unsigned int camera;
+    const capture_stats_t *stats;
+    const sequencer_service_t *query_service, *store_service;
+
+    memset(totals, 0, sizeof(*totals));
+
+    for(camera = 0; camera < get_no_of_cameras(); ++camera)
+    {
+        stats = get_capture_stats(camera);
+        query_service = sequencer_get_service(QUERY_FRAMES_SERVICE_IDX(camera));
+        store_service = sequencer_get_service(STORE_FRAMES_SERVICE_IDX(camera));
+
+        histogram_merge(&totals->stats.grab_time, &stats->grab_time);
+        histogram_merge(&totals->stats.dequeue_latency, &stats->dequeue_latency);
+        histogram_merge(&totals->stats.release_skew, &stats->release_skew);
+        histogram_merge(&totals->stats.encode_time, &stats->encode_time);
+        histogram_merge(&totals->stats.write_time, &stats->write_time);
+        histogram_merge(&totals->stats.capture_to_disk, &stats->capture_to_disk);
+        histogram_merge(&totals->query_response, &query_service->response_time);
+        histogram_merge(&totals->store_response, &store_service->response_time);
+        histogram_merge(&totals->store_execution, &store_service->execution_time);
+
+        if(!camera)
+        {
+            totals->stats.width = stats->width;
+            totals->stats.height = stats->height;
+        }
+
+        if(stats->frames_stored)
+        {
+            if(!totals->stats.frames_stored || time_before(&stats->first_store_time, &totals->stats.first_store_time))
+            {
+                totals->stats.first_store_time = stats->first_store_time;
+            }
+            if(!totals->stats.frames_stored || time_before(&totals->stats.last_store_time, &stats->last_store_time))
+            {
+                totals->stats.last_store_time = stats->last_store_time;
+            }
+        }
+
+        totals->stats.frames_stored += stats->frames_stored;
+        totals->stats.frames_dropped += stats->frames_dropped;
+        totals->stats.frames_unchanged += stats->frames_unchanged;
+        totals->stats.sequence_gaps += stats->sequence_gaps;
+        totals->stats.frames_lost += stats->frames_lost;
+        totals->stats.late_dequeues += stats->late_dequeues;
+        totals->stats.dequeue_timeouts += stats->dequeue_timeouts;
+        totals->stats.frames_skipped += stats->frames_skipped;
+        totals->stats.bytes_written += stats->bytes_written;
+
+        totals->service_cpu_nsec += (histogram_mean(&query_service->execution_time) * histogram_count(&query_service->execution_time)) +
+                                    (histogram_mean(&store_service->execution_time) * histogram_count(&store_service->execution_time));
+        totals->missed_deadlines += store_service->missed_deadlines;
+        totals->skipped_releases += store_service->skipped_releases;
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  time_before
+//
+//  Parameters:     time, other - CLOCK_MONOTONIC
+//
+//  Return:         TRUE if time is earlier than other, else FALSE
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int time_before(const struct timespec *time, const struct timespec *other)
+{
+    return (time->tv_sec < other->tv_sec) || ((time->tv_sec == other->tv_sec) && (time->tv_nsec < other->tv_nsec));
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  write_percentiles
+//
+//  Parameters:     fp - results file
+//                  stage - key prefix
+//                  histogram - stage latencies, nano seconds
+//
+//  Return:         None
+//
+//  Description:    Appends "<stage>_p50_usec", "_p99_usec", "_p999_usec" and "_max_usec" (0 for an unused stage)
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void write_percentiles(FILE *fp, const char *stage, const histogram_t *histogram)
+{
+    fprintf(fp, ", \"%s_p50_usec\": %.1lf, \"%s_p99_usec\": %.1lf, \"%s_p999_usec\": %.1lf, \"%s_max_usec\": %.1lf",
+            stage, (double)histogram_percentile(histogram, 50.0) / NSEC_PER_USEC,
+            stage, (double)histogram_percentile(histogram, 99.0) / NSEC_PER_USEC,
+            stage, (double)histogram_percentile(histogram, 99.9) / NSEC_PER_USEC,
+            stage, (double)histogram_max(histogram) / NSEC_PER_USEC);
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,27 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: bench_report.h
+//
+//  Description: Header file for bench_report.c
+//
+
+#ifndef _BENCH_REPORT_H
+#define _BENCH_REPORT_H
+
+#include "include.h"
+
+//store frequency allowed with -j, 10 Hz otherwise
+#define MAX_BENCH_STORE_FRAMES_FREQUENCY    (50)
+
+//max length of a run name, "<width>x<height>_f<store Hz>_c<compression>_<format>"
+#define BENCH_RUN_NAME_SIZE     (64)
+
+//APIs
+void bench_report_write(const char *file_name);
+
+#endif //_BENCH_REPORT_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -4,241 +4,589 @@
 //
 //  File name: capture.cpp
 //
-//  Description: Used for querying and storing the frames from the USB camera
+//  Description: Used for querying and storing the frames from the USB cameras. Every camera (-N) has its own frame
+//               source, frame buffers, change detection, encoders and output, used by its own query and store
+//               services only, so the cameras do not share any state in the RT loops. Frames are shown by a
+//               best-effort preview thread, the RT loops only hand it their latest frame and never wait for it
 //
 
 #include "capture.hpp"
+#include "capture_stats.h"
+#include "change_detect.h"
+#include "encode_pool.h"
+#include "frame_archive.h"
+#include "frame_pool.h"
+#include "frame_publisher.h"
+#include "frame_ring.h"
+#include "frame_source.h"
 #include "include.h"
+#include "latest_frame.h"
+#include "pixel_convert.h"
+#include "placement.h"
 #include "posix_timer.h"
+#include "quality_control.h"
+#include "sequencer.h"
+#include "ppm_writer.h"
+#include "rt_memory.h"
+#include "tile_delta.h"
+#include "trace.h"
 #include "utilities.h"
+#include "v4l2_capture.h"
 
 //global variable //updated once, and used across the application for sync
-extern pthread_cond_t cond_query_frames_thread;
-extern pthread_cond_t cond_store_frames_thread;
-extern pthread_mutex_t app_timer_counter_mutex_lock;
 extern unsigned long long app_timer_counter;
-extern bool timer_started;
 extern unsigned int store_frames_frequency;
 extern bool live_camera_view;
+extern bool headless;
 extern unsigned int compress_ratio; //default:0 no compression
+extern unsigned int output_format;
 extern unsigned int max_no_of_frames_allowed;
+extern unsigned int frame_ring_slots;
+extern int frame_pool_backing;
+extern char *device_names[];
+extern unsigned int no_of_cameras;
+extern unsigned int frame_source_type;
+extern char *replay_paths[];
+extern unsigned int frame_source_width;
+extern unsigned int frame_source_height;
+extern unsigned int frame_source_fps;
+extern unsigned int encode_workers;
+extern placement_t placement;
+extern char *archive_name;
+extern unsigned int archive_segment_mb;
+extern unsigned int change_detect_threshold;
+extern unsigned int change_detect_cells_percent;
+extern unsigned int change_detect_max_skip_sec;
+extern unsigned int tile_delta_keyframe_interval;
+extern unsigned int preview_width;
+extern unsigned int preview_height;
+extern unsigned int preview_frequency;
+extern char *shm_name;
+extern unsigned int shm_publish_interval;
+extern unsigned int quality_miss_percent;
+extern unsigned int quality_max_downscale;
+extern int quality_min_compress_ratio;
+extern int quality_max_compress_ratio;
 
 //cpp namespaces
 using namespace cv;
 using namespace std;
 
-//capture window title
+//capture window title, followed by the camera number with more than one camera
 const char capture_window_title[] = "Project-Trails";
 
-//global capture variables
-static CvCapture* grab_frame;
-static IplImage* retrieve_frame;
-//protect globally shared frame data
-static pthread_mutex_t frame_mutex_lock;
-static pthread_mutexattr_t frame_mutex_lock_attr;
+//output of camera <n> goes to this directory, with more than one camera
+#define CAMERA_DIRECTORY            "camera_%u/"
+//and its frame archive and shared memory frame ring get this suffix
+#define CAMERA_ARCHIVE_SUFFIX       "_camera_%u"
+#define CAMERA_NAME_SIZE            (32)
+
+//reads of the first frame of a camera before giving up, one query period each
+#define FIRST_FRAME_RETRIES         (MSEC_PER_SEC / QUERY_FRAMES_INTERVAL_IN_MSEC)
+
+//one camera, its state is used by its own query_frames_thread, store_frames_thread and encode workers only
+typedef struct
+{
+    unsigned int idx;
+    //camera, test pattern or replayed frames
+    frame_source_t frame_source;
+    //frames handed from query_frames_thread to store_frames_thread, without locks
+    frame_ring_t frame_ring;
+    //every frame sized buffer is borrowed from this pool, nothing is allocated in the RT loops
+    frame_pool_t frame_pool;
+    //per stage latencies and store throughput, see bench_report.c
+    capture_stats_t capture_stats;
+    //driver sequence of the last captured frame, and the dequeue latency of a late frame (one query period)
+    unsigned long long last_source_sequence;
+    unsigned long long last_frames_skipped;
+    unsigned long long late_dequeue_nsec;
+    //.png frames encoded off store_frames_thread (-e), and the encoded data of every job, capacity reserved once
+    encode_pool_t encode_pool;
+    int encode_pool_running;
+    vector<uchar> encoded_frames[MAX_ENCODE_JOBS];
+    //frames appended to one archive instead of a file per frame (-a)
+    frame_archive_t frame_archive;
+    int frame_archive_open_flag;
+    //captured frames published to other processes (-M)
+    frame_publisher_t frame_publisher;
+    int frame_publisher_open_flag;
+    //unchanged frames are not stored (-D)
+    change_detect_t change_detect;
+    int change_detect_on;
+    //keyframes and changed tiles (-o 2)
+    tile_delta_t tile_delta;
+    int tile_delta_on;
+    //store mode stepped on missed store periods (-Q), its .png parameters, and the downscaled frame and column sums
+    quality_control_t quality_control;
+    int quality_control_on;
+    vector<int> png_params;
+    unsigned char *downscale_data;
+    unsigned short *downscale_column_sums;
+    //stored file name prefix, "" or CAMERA_DIRECTORY
+    char output_directory[CAMERA_NAME_SIZE];
+    char window_title[CAMERA_NAME_SIZE + sizeof(capture_window_title)];
+    //latest frame for the preview, offered by query_frames_thread (-l) or store_frames_thread, unless headless
+    latest_frame_t preview_frame;
+    int preview_on;
+    //downscaled frame and its column sums, used by the preview thread only
+    unsigned int preview_factor;
+    size_t preview_step;
+    unsigned char *preview_data;
+    unsigned short *preview_column_sums;
+}camera_t;
+
+static camera_t cameras[MAX_CAMERAS];
+static vector<int> png_params;
+
+//best-effort (SCHED_OTHER) thread showing the latest frame of every camera
+static pthread_t preview_thread;
+static int preview_thread_running = FALSE;
 
 //synchronization purposes
 static int exit_application = FALSE;
 
+//local functions
+static void initialize_camera(camera_t *camera);
+static void initialize_frame_buffers(camera_t *camera, const unsigned int width, const unsigned int height);
+static int handle_user_key(const char key);
+static void start_preview(void);
+static void *preview_frames(void *args);
+static int encode_png_frame(encode_job_t *job);
+static void write_png_frame(encode_job_t *job);
+static void check_frame_source(camera_t *camera, const frame_t *frame, const unsigned int frame_counter);
+static void record_frame_stored(camera_t *camera, const struct timespec *store_time, const frame_t *frame,
+                                const size_t frame_bytes);
+static void report_camera(camera_t *camera);
+static void fill_archive_record(frame_archive_record_t *record, const unsigned int format, const frame_t *frame,
+                                const unsigned int frame_no, const size_t data_size);
+static unsigned long long delta_time_in_nsec(const struct timespec *end_time, const struct timespec *start_time);
+
 //------------------------------------------------------------------------------------------------------------------------------
-//  Function Name:  initialize_device_use_openCV
+//  Function Name:  initialize_capture
 //
 //  Parameters:     None
 //
 //  Return:         None
 //
-//  Description:    Initializes the ca,era device using openCV
+//  Description:    Initializes every camera (see initialize_camera()), and waits for a key once their first frames are
+//                  shown, then starts the preview thread. With more than one camera, the output of every camera goes
+//                  to its own directory
 //
 //------------------------------------------------------------------------------------------------------------------------------
-void initialize_device_use_openCV(void)
+void initialize_capture(void)
 {
-    //start capturing frames from /dev/video0
-    grab_frame = cvCreateCameraCapture(0);
-    //set capture properties
-    cvSetCaptureProperty(grab_frame, CV_CAP_PROP_FRAME_WIDTH, FRAME_HRES);
-    cvSetCaptureProperty(grab_frame, CV_CAP_PROP_FRAME_HEIGHT, FRAME_VRES);
-    cvNamedWindow(capture_window_title, CV_WINDOW_AUTOSIZE);
+    unsigned int i;
+    char c;
 
-    //grab and retrieve a frame
-    retrieve_frame = cvQueryFrame(grab_frame);
-    if(!retrieve_frame) EXIT_FAIL("Problem initializing the device");
+    //SIMD conversion and box downscale kernels, for the V4L2 sources, the quality control and the preview
+    pixel_convert_init();
+
+    //parameters to save the frames as compressed .png files
+    png_params.push_back(CV_IMWRITE_PNG_COMPRESSION);
+    png_params.push_back(compress_ratio); //user selectable compression ration
+
+    for(i = 0; i < no_of_cameras; ++i)
+    {
+        cameras[i].idx = i;
+        initialize_camera(&cameras[i]);
+    }
+
+    //no display, no keys
+    if(headless) return;
 
-    //show the recently grabbed frame
-    cvShowImage(capture_window_title, retrieve_frame);
     //wait for user key input
-    char c = cvWaitKey(33);
+    c = cvWaitKey(33);
     if(c == 'q' || c == 27)
     {
         exit(SUCCESS);
     }
 
-    //convert IplImage type to Mat type
-    Mat openCV_store_frames_mat = cvarrToMat(retrieve_frame);
+    start_preview();
+}
 
-    //paramaters to save .ppm file
-    vector<int> ppm_params;
-    ppm_params.push_back(CV_IMWRITE_PXM_BINARY);
-    ppm_params.push_back(1);
 
-    //try writing a dummy file, and see if the write was successful or not
-    try
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  initialize_camera
+//
+//  Parameters:     camera - camera to initialize, idx is set
+//
+//  Return:         None
+//
+//  Description:    Opens the frame source selected with -i, preallocates the frame buffers with the resolution it
+//                  delivers, and reads a first frame (into a slot which is not published) to make sure the source is
+//                  working. The frame is shown unless running headless, and the preview frame slot is set up.
+//                  Starts the encode workers if .png frames are encoded off store_frames_thread, and opens the frame
+//                  archive and the shared memory frame ring, and sets up the change detection, the delta frame
+//                  encoder and the quality control if selected
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void initialize_camera(camera_t *camera)
+{
+    frame_t *frame;
+    int rc;
+    unsigned int retry;
+    char name[FRAME_ARCHIVE_NAME_SIZE];
+
+    frame_source_open(&camera->frame_source, frame_source_type,
+                      (frame_source_type == FRAME_SOURCE_DEVICE) ? device_names[camera->idx] : replay_paths[camera->idx],
+                      frame_source_width, frame_source_height, frame_source_fps);
+
+    //preallocate the frame buffers, query_frames_thread reads straight into the ring slots
+    initialize_frame_buffers(camera, camera->frame_source.width, camera->frame_source.height);
+    camera->capture_stats.width = camera->frame_source.width;
+    camera->capture_stats.height = camera->frame_source.height;
+    camera->late_dequeue_nsec = (unsigned long long)frame_source_period_msec(frame_source_type, frame_source_fps) * NSEC_PER_MSEC;
+
+    //one camera keeps the single camera file names and window title
+    camera->output_directory[0] = '\0';
+    strcpy(camera->window_title, capture_window_title);
+    if(no_of_cameras > 1)
+    {
+        snprintf(camera->output_directory, sizeof(camera->output_directory), CAMERA_DIRECTORY, camera->idx);
+        //archived frames go to <name>_camera_<n> instead
+        if(!archive_name && mkdir(camera->output_directory, 00777) && (errno != EEXIST)) EXIT_FAIL("mkdir");
+        snprintf(camera->window_title, sizeof(camera->window_title), "%s camera %u", capture_window_title, camera->idx);
+    }
+
+    if(change_detect_threshold)
+    {
+        change_detect_init(&camera->change_detect, camera->frame_source.width, camera->frame_source.height, change_detect_threshold,
+                           change_detect_cells_percent, change_detect_max_skip_sec);
+        camera->change_detect_on = TRUE;
+    }
+
+    //deflated with the -c level, the fastest one if not compressed
+    if(output_format == OUTPUT_FORMAT_DELTA)
+    {
+        tile_delta_init(&camera->tile_delta, camera->frame_source.width, camera->frame_source.height, tile_delta_keyframe_interval,
+                        compress_ratio ? compress_ratio : Z_BEST_SPEED);
+        camera->tile_delta_on = TRUE;
+    }
+
+    if(archive_name)
+    {
+        snprintf(name, sizeof(name), "%s", archive_name);
+        if(no_of_cameras > 1) snprintf(name, sizeof(name), "%s" CAMERA_ARCHIVE_SUFFIX, archive_name, camera->idx);
+        frame_archive_open(&camera->frame_archive, name, (size_t)archive_segment_mb * 1024 * 1024);
+        camera->frame_archive_open_flag = TRUE;
+    }
+
+    if(shm_name)
+    {
+        snprintf(name, sizeof(name), "%s", shm_name);
+        if(no_of_cameras > 1) snprintf(name, sizeof(name), "%s" CAMERA_ARCHIVE_SUFFIX, shm_name, camera->idx);
+        frame_publisher_open(&camera->frame_publisher, name, DEFAULT_FRAME_SHM_SLOTS, camera->frame_source.width,
+                             camera->frame_source.height, 3, shm_publish_interval, camera->idx);
+        camera->frame_publisher_open_flag = TRUE;
+    }
+
+    if((output_format == OUTPUT_FORMAT_PNG) && encode_workers)
+    {
+        for(unsigned int i = 0; i < encode_workers * ENCODE_JOBS_PER_WORKER; ++i)
+        {
+            camera->encoded_frames[i].reserve(camera->frame_pool.buffer_size);
+        }
+        encode_pool_init(&camera->encode_pool, encode_workers, placement.encode_cores, placement.no_of_encode_cores, &camera->frame_pool,
+                         camera->frame_source.width, camera->frame_source.height, 3, encode_png_frame, write_png_frame, (void *)camera);
+        camera->encode_pool_running = TRUE;
+    }
+
+    //.ppm and .png frames stored by store_frames_thread itself, delta frames and encode workers are rejected by main()
+    camera->png_params = png_params;
+    if(quality_miss_percent)
     {
-        imwrite("dump.ppm", openCV_store_frames_mat, ppm_params);
+        assert((output_format != OUTPUT_FORMAT_DELTA) && !camera->encode_pool_running);
+
+        quality_control_init(&camera->quality_control, camera->idx, output_format, compress_ratio, quality_min_compress_ratio,
+                             quality_max_compress_ratio, quality_miss_percent, quality_max_downscale);
+        camera->quality_control_on = TRUE;
+
+        //largest downscaled frame, factor 2
+        camera->downscale_data = (unsigned char *)malloc((size_t)(camera->frame_source.width / 2) * 3 * (camera->frame_source.height / 2));
+        camera->downscale_column_sums = (unsigned short *)malloc((size_t)camera->frame_source.width * 3 * sizeof(unsigned short));
+        if(!camera->downscale_data || !camera->downscale_column_sums) EXIT_FAIL("malloc");
     }
-    catch (runtime_error& ex)
+
+    //a device may take a few query periods for its first frame
+    frame = frame_ring_begin_write(&camera->frame_ring);
+    for(retry = 0; (rc = frame_source_read(&camera->frame_source, frame)) == FRAME_SOURCE_NO_FRAME; ++retry)
     {
-        //exit applicaiton if having troubles to save the file
-        printf("Exception converting image to PPM format!\n");
-        exit(ERROR);
+        if(retry >= FIRST_FRAME_RETRIES) break;
     }
+    if(rc) EXIT_FAIL("Problem initializing the frame source");
+
+    syslog(LOG_WARNING, " camera %u: %s %s, %ux%u", camera->idx, frame_source_name(&camera->frame_source),
+           camera->frame_source.path ? camera->frame_source.path : "", camera->frame_source.width, camera->frame_source.height);
+
+    if(headless) return;
+
+    //preview buffers, downscaled to fit the -V size
+    latest_frame_init(&camera->preview_frame, camera->frame_source.width, camera->frame_source.height, 3, &camera->frame_pool);
+    camera->preview_on = TRUE;
+    camera->preview_factor = pixel_box_factor(camera->frame_source.width, camera->frame_source.height, preview_width, preview_height);
+    camera->preview_step = (size_t)(camera->frame_source.width / camera->preview_factor) * 3;
+    camera->preview_data = (unsigned char *)malloc(camera->preview_step * (camera->frame_source.height / camera->preview_factor));
+    camera->preview_column_sums = (unsigned short *)malloc((size_t)camera->frame_source.width * 3 * sizeof(unsigned short));
+    if(!camera->preview_data || !camera->preview_column_sums) EXIT_FAIL("malloc");
 
+    //show the recently grabbed frame
+    cvNamedWindow(camera->window_title, CV_WINDOW_AUTOSIZE);
+    IplImage frame_iplimage = Mat(frame->height, frame->width, CV_8UC3, frame->data, frame->step);
+    cvShowImage(camera->window_title, &frame_iplimage);
 }
 
 
 //------------------------------------------------------------------------------------------------------------------------------
-//  Function Name:  query_frames
+//  Function Name:  initialize_frame_buffers
 //
-//  Parameters:     cameraIdx: Not used at the moment
+//  Parameters:     camera - camera
+//                  width, height - resolution delivered by the frame source
 //
 //  Return:         None
 //
-//  Description:    query_frames_thread handler function. Which executes at 30Hz to query frames from the device
+//  Description:    Sizes the frame pool of the camera (width x height x 3 x no.of buffers), and sets up the frame ring
+//                  on it. Pool holds the ring slots, the buffers borrowed by store_frames_thread, the encode job
+//                  snapshots, and the preview frame slot
 //
 //------------------------------------------------------------------------------------------------------------------------------
-void *query_frames(void *cameraIdx)
+static void initialize_frame_buffers(camera_t *camera, const unsigned int width, const unsigned int height)
 {
-    int rc;
-    int *dev = (int *)cameraIdx;
-    static unsigned int frame_counter = 0;
+    const unsigned int encode_buffers = ((output_format == OUTPUT_FORMAT_PNG) && encode_workers) ? (encode_workers * ENCODE_JOBS_PER_WORKER) : 0;
+    const unsigned int preview_buffers = headless ? 0 : LATEST_FRAME_BUFFERS;
 
-    #ifdef TIME_ANALYSIS
-    //RT time analysis
-    static struct timespec query_frames_start_time, query_frames_end_time;
-    static double query_frames_elapsed_time, query_frames_average_load_time, query_frames_wcet=0;
-    static unsigned int missed_deadlines = 0;
-    #endif //TIME_ANALYSIS
+    frame_pool_init(&camera->frame_pool, frame_ring_slots + STORE_FRAMES_POOL_BUFFERS + encode_buffers + preview_buffers,
+                    (size_t)width * height * 3, frame_pool_backing);
+    frame_ring_init(&camera->frame_ring, frame_ring_slots, width, height, 3, &camera->frame_pool);
+}
 
-    //initilize mutex to protect timer count variable
-    if(pthread_mutexattr_init(&frame_mutex_lock_attr)) EXIT_FAIL("pthread_mutexattr_init");
-    if(pthread_mutexattr_settype(&frame_mutex_lock_attr, PTHREAD_MUTEX_ERRORCHECK)) EXIT_FAIL("pthread_mutexattr_settype");
-    if(pthread_mutex_init(&frame_mutex_lock, &frame_mutex_lock_attr)) EXIT_FAIL("pthread_mutex_init");
 
-    while(1)
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  handle_user_key
+//
+//  Parameters:     key - key returned by cvWaitKey()
+//
+//  Return:         TRUE if the user asked to exit ('q' or 'Esc'), else FALSE
+//
+//  Description:    '+'/'-' raise/lower the frequency to store frames by 1 Hz, for every camera, so their store
+//                  releases stay aligned. A higher frequency is applied only if the sequencer finds the service set
+//                  still schedulable with the measured WCETs
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int handle_user_key(const char key)
+{
+    unsigned int new_frequency, i;
+
+    if((key == 'q') || (key == 27)) return TRUE;
+    if((key != '+') && (key != '-')) return FALSE;
+
+    new_frequency = (key == '+') ? (store_frames_frequency + 1) : (store_frames_frequency - 1);
+    if((new_frequency < 1) || (new_frequency > 10)) return FALSE;
+
+    for(i = 0; i < no_of_cameras; ++i)
     {
-        //wait for signal from timer
-        if(timer_started)
+        if(sequencer_set_service_period(STORE_FRAMES_SERVICE_IDX(i), DEFAULT_STORE_FRAMES_INTERVAL_IN_MSEC/new_frequency) != SUCCESS) break;
+    }
+
+    //cameras already changed go back, the lower frequency was schedulable
+    if(i < no_of_cameras)
+    {
+        while(i--)
         {
-            if(pthread_mutex_lock(&app_timer_counter_mutex_lock)) EXIT_FAIL("pthread_mutex_lock");
-            if(pthread_cond_wait(&cond_query_frames_thread, &app_timer_counter_mutex_lock)) EXIT_FAIL("pthread_cond_wait");
-            if(pthread_mutex_unlock(&app_timer_counter_mutex_lock)) EXIT_FAIL("pthread_mutex_unlock");
+            sequencer_set_service_period(STORE_FRAMES_SERVICE_IDX(i), DEFAULT_STORE_FRAMES_INTERVAL_IN_MSEC/store_frames_frequency);
         }
-        else
+        fprintf(stdout, "\nStoring frames at %u Hz is not schedulable, staying at %u Hz\n", new_frequency, store_frames_frequency);
+    }
+    else
+    {
+        store_frames_frequency = new_frequency;
+        fprintf(stdout, "\nStoring frames at %u Hz\n", store_frames_frequency);
+    }
+
+    return FALSE;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  start_preview
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//  Description:    Creates the preview thread with SCHED_OTHER explicitly, on any core the services leave idle. It would
+//                  inherit the SCHED_FIFO priority of the dispatcher otherwise, so every RT service preempts it
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void start_preview(void)
+{
+    pthread_attr_t preview_thread_attr;
+
+    assign_normal_schedular_attr(&preview_thread_attr, ALL_CORES);
+    if(pthread_create(&preview_thread, &preview_thread_attr, preview_frames, NULL)) EXIT_FAIL("pthread_create");
+    pthread_attr_destroy(&preview_thread_attr);
+    preview_thread_running = TRUE;
+
+    syslog(LOG_WARNING, " preview: %ux%u at %u Hz, %s box downscale", preview_width, preview_height, preview_frequency,
+           pixel_convert_isa_name(pixel_convert_selected_isa()));
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  preview_frames
+//
+//  Parameters:     args - not used
+//
+//  Return:         None
+//
+//  Description:    Preview thread handler function. At the -U rate, takes the latest frame of every camera (if there is
+//                  a new one), box downscales it to fit the -V size and shows it, then handles the user keys. Frames
+//                  are dropped freely, the query and store services never wait for it. 'q'/'Esc' exits the application
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void *preview_frames(void *args)
+{
+    unsigned int i;
+    camera_t *camera;
+    const frame_t *frame;
+    struct timespec next_time;
+    char c;
+
+    (void)args;
+
+    trace_thread_register("preview_frames");
+
+    clock_gettime(CLOCK_MONOTONIC, &next_time);
+
+    while(!exit_application)
+    {
+        for(i = 0; i < no_of_cameras; ++i)
         {
-            EXIT_FAIL("Timer not available");
+            camera = &cameras[i];
+            frame = latest_frame_take(&camera->preview_frame);
+            if(!frame) continue;
+
+            TRACE_EVENT(TRACE_EVENT_DISPLAY, TRACE_BEGIN, frame->sequence);
+            pixel_box_downscale(frame->data, frame->step, frame->width, frame->height, frame->channels, camera->preview_factor,
+                                camera->preview_data, camera->preview_step, camera->preview_column_sums);
+            IplImage frame_iplimage = Mat(frame->height / camera->preview_factor, frame->width / camera->preview_factor, CV_8UC3,
+                                          camera->preview_data, camera->preview_step);
+            cvShowImage(camera->window_title, &frame_iplimage);
+            TRACE_EVENT(TRACE_EVENT_DISPLAY, TRACE_END, frame->sequence);
         }
 
-        if(exit_application) break;
+        //window events and user keys, once for every window
+        c = cvWaitKey(1);
+        if(handle_user_key(c)) exit_application = TRUE;
 
-        //RT time analysis purposes
-        #ifdef TIME_ANALYSIS
-        if(clock_gettime(CLOCK_REALTIME, &query_frames_start_time)) EXIT_FAIL("clock_gettime");
-        #endif //TIME_ANALYSIS
-
-        //debug purposes
-        #ifdef DEBUG_MODE_ON
-        syslog(LOG_WARNING," cvQueryframe start at :%lld", app_timer_counter);
-        #endif //DEBUG_MODE_ON
-
-        //thread safe //lock frame before updating
-        if(pthread_mutex_lock(&frame_mutex_lock)) EXIT_FAIL("pthread_mutex_lock");
-        //grab a new frame. Returns a valid int on Success
-        if(!(cvGrabFrame(grab_frame))) EXIT_FAIL("cvGrabFrame"); //grab new frame
-        //retrieve frame data only if live view is selected. Saving some Milli sec time!!
-        if(live_camera_view)
+        //absolute release times, the preview rate does not drift with the time taken above
+        next_time.tv_nsec += NSEC_PER_SEC / preview_frequency;
+        if(next_time.tv_nsec >= NSEC_PER_SEC)
         {
-            retrieve_frame = cvRetrieveFrame(grab_frame);
-            //if there is not valid data, exit application
-            if(!retrieve_frame) break;
+            next_time.tv_nsec -= NSEC_PER_SEC;
+            ++next_time.tv_sec;
         }
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_time, NULL) == EINTR);
+    }
 
-        if(pthread_mutex_unlock(&frame_mutex_lock)) EXIT_FAIL("pthread_mutex_unlock");
+    for(i = 0; i < no_of_cameras; ++i)
+    {
+        cvDestroyWindow(cameras[i].window_title);
+    }
 
-        #ifdef DEBUG_MODE_ON
-        syslog(LOG_WARNING," cvQueryframe done at :%lld", app_timer_counter);
-        #endif //DEBUG_MODE_ON
+    #ifdef DEBUG_MODE_ON
+    syslog(LOG_WARNING," preview_frames_thread exiting...");
+    #endif //DEBUG_MODE_ON
 
-        //show frames in real time
-        if(live_camera_view)
-        {
-            //show recently retrieved frame and wait for user key input
-            cvShowImage(capture_window_title, retrieve_frame);
-            char c = cvWaitKey(1);
-            if( c == 'q' || c == 27) break;
-        }
+    return NULL;
+}
 
-        #ifdef DEBUG_MODE_ON
-        syslog(LOG_WARNING," cvShowImage done at :%lld", app_timer_counter);
-        #endif //DEBUG_MODE_ON
 
-        ++frame_counter;
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  query_frames
+//
+//  Parameters:     cameraIdx: threadParams_t, threadIdx is the camera index
+//
+//  Return:         None
+//
+//  Description:    query_frames_thread handler function of a camera. Reads a frame from the frame source on every release
+//                  (20 Hz for the device, the -F frame rate for the test pattern and replay sources). Every camera is
+//                  released at the same time, so their frames are captured together
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void *query_frames(void *cameraIdx)
+{
+    camera_t *camera = &cameras[((threadParams_t *)cameraIdx)->threadIdx];
+    unsigned int frame_counter = 0;
+    int rc;
+    frame_t *frame;
+    struct rusage page_faults_baseline;
+    struct timespec release_time, grab_start_time;
+
+    prefault_thread_stack(&page_faults_baseline);
 
-        #ifdef TIME_ANALYSIS
-        //measure end-time
-        clock_gettime(CLOCK_REALTIME, &query_frames_end_time);
-        //measure elapsed time
-        query_frames_elapsed_time = delta_time_in_msec(&query_frames_end_time, &query_frames_start_time);
+    while(1)
+    {
+        //wait for the next release from the sequencer
+        sequencer_wait_for_release(&release_time);
+
+        if(exit_application) break;
+
+        clock_gettime(CLOCK_MONOTONIC, &grab_start_time);
+        TRACE_EVENT(TRACE_EVENT_GRAB, TRACE_BEGIN, frame_counter);
+
+        //oldest slot not held by store_frames_thread, never waits for it
+        frame = frame_ring_begin_write(&camera->frame_ring);
 
-        //measure WCET
-        if(query_frames_elapsed_time > query_frames_wcet)
+        //read straight into the slot, end of the frames exits the application
+        rc = frame_source_read(&camera->frame_source, frame);
+        if(rc == FRAME_SOURCE_NO_FRAME)
         {
-            query_frames_wcet = query_frames_elapsed_time;
+            //late frame, nothing to publish this release. The slot is given back as it was, a frame published in it
+            //stays claimable by store_frames_thread
+            frame_ring_abort_write(&camera->frame_ring);
+            ++camera->capture_stats.dequeue_timeouts;
+            TRACE_EVENT(TRACE_EVENT_GRAB, TRACE_END, frame_counter);
+            continue;
         }
+        if(rc) break;
 
-        //measure avrage load time
-        query_frames_average_load_time += query_frames_elapsed_time;
+        //time-stamp, and hand the frame over to store_frames_thread
+        clock_gettime(CLOCK_MONOTONIC, &frame->capture_time);
+        gettimeofday(&frame->wall_time, NULL);
+        if(!frame->exposure_time.tv_sec && !frame->exposure_time.tv_nsec) frame->exposure_time = frame->capture_time;
+        frame_ring_publish(&camera->frame_ring);
+        histogram_record(&camera->capture_stats.grab_time, delta_time_in_nsec(&frame->capture_time, &grab_start_time));
 
-        //keep track of missed deadlines
-        if(query_frames_elapsed_time > QUERY_FRAMES_INTERVAL_IN_MSEC)
+        //frames the driver dropped, and frames left waiting in its queue
+        check_frame_source(camera, frame, frame_counter);
+
+        TRACE_EVENT(TRACE_EVENT_GRAB, TRACE_END, frame_counter);
+        TRACE_EVENT(TRACE_EVENT_PUBLISH, TRACE_INSTANT, frame->sequence);
+
+        //every n-th frame to the other processes, they never hold the publisher up
+        if(camera->frame_publisher_open_flag)
         {
-            ++missed_deadlines; //tbd: add syslog with time when missed deadline
+            TRACE_EVENT(TRACE_EVENT_SHM_PUBLISH, TRACE_BEGIN, frame->sequence);
+            frame_publisher_offer(&camera->frame_publisher, frame);
+            TRACE_EVENT(TRACE_EVENT_SHM_PUBLISH, TRACE_END, frame->sequence);
         }
-        #endif //TIME_ANALYSIS
+
+        //preview the latest captured frame, copied in for every capture
+        //published slot is not overwritten before the next frame_ring_begin_write()
+        if(live_camera_view) latest_frame_offer(&camera->preview_frame, frame);
+
+        ++frame_counter;
 
     }
 
-    //stop capturing and destroy the frame view window
-    cvReleaseCapture(&grab_frame);
-    cvDestroyWindow(capture_window_title);
+    //stop capturing
+    frame_source_close(&camera->frame_source);
 
-    //destroy mutex lock!
-    pthread_mutex_destroy(&frame_mutex_lock);
+    //latency distributions are reported by the sequencer
+    fprintf(stdout, "\n\ncamera %u query_frames_thread processed %u frames", camera->idx, frame_counter);
+    syslog(LOG_WARNING, " camera %u query_frames_thread processed %u frames", camera->idx, frame_counter);
 
-    #ifdef TIME_ANALYSIS
-    //validate for division by Zero
-    if(frame_counter)
-    {
-        query_frames_average_load_time /= frame_counter;
-    }
-    fprintf(stdout, "\n\n**************************************"
-                     "\nquery_frames_thread execuiton results:"
-                     "\nno. of frames processed: %d,"
-                     "\nWCET: %lf,"
-                     "\nAverage Execution Time: %lf,"
-                     "\nMissed Deadlines: %d"
-                     "\n**************************************",
-                     frame_counter, query_frames_wcet, query_frames_average_load_time, missed_deadlines);
-    
-    syslog(LOG_WARNING," ");
-    syslog(LOG_WARNING,"**************************************");
-    syslog(LOG_WARNING," query_frames_thread execuiton results:");
-    syslog(LOG_WARNING," no. of frames processed: %d", frame_counter);
-    syslog(LOG_WARNING," WCET: %lf", query_frames_wcet);
-    syslog(LOG_WARNING," Average Execution Time: %lf", query_frames_average_load_time);
-    syslog(LOG_WARNING," Missed Deadlines: %d", missed_deadlines);
-    syslog(LOG_WARNING,"**************************************");
-    syslog(LOG_WARNING," ");
-
-    #endif //TIME_ANALYSIS
+    report_thread_page_faults("query_frames_thread", &page_faults_baseline);
 
     #ifdef DEBUG_MODE_ON
     syslog(LOG_WARNING," query_frames_thread exiting...");
@@ -246,123 +594,153 @@ void *query_frames(void *cameraIdx)
 
     //set this bit to let other threads know!
     exit_application = TRUE;
+    return NULL;
 }
 
 //------------------------------------------------------------------------------------------------------------------------------
 //  Function Name:  store_frames
 //
-//  Parameters:     params: Not used at the moment
+//  Parameters:     params: threadParams_t, threadIdx is the camera index
 //
 //  Return:         None
 //
-//  Description:    store_frames_thread handler function. Which stores frames at user defined frequency rate (1 Hz to 10 Hz)
+//  Description:    store_frames_thread handler function of a camera. Which stores frames at user defined frequency rate (1 Hz to 10 Hz).
+//                  With encode workers (-e), a .png frame is only snapshot and queued, so the job time does not depend
+//                  on the compression level. Frames are dropped while every encode job is busy. Every camera is
+//                  released at the same time, and stores its frame captured closest to the release. With the
+//                  quality control (-Q), .ppm and .png frames are stored in its current mode
 //
 //------------------------------------------------------------------------------------------------------------------------------
 void *store_frames(void *params)
 {
+    camera_t *camera = &cameras[((threadParams_t *)params)->threadIdx];
 
-    int rc;
-
-    #ifdef TIME_ANALYSIS
-    //time analysis
-    static struct timespec store_frames_start_time, store_frames_end_time;
-    static double store_frames_elapsed_time, store_frames_average_load_time, store_frames_wcet=0;
-    static unsigned int missed_deadlines = 0;
-    #endif //TIME_ANALYSIS
-
-    static unsigned int frame_counter=0;
+    unsigned int frame_counter=0;
 
     //.ppm file name variable
-    static struct timeval frame_timestamp;
-    static char file_name[20] = {};
-    static char ppm_header1[64] = "";
-    static char ppm_header2[] = "\n# TARGET: Linux tegra-ubuntu 4.4.38-tegra #1 SMP PREEMPT Thu May 17 00:15:19 PDT 2018 aarch64 aarch64 aarch64 GNU/Linux";
-    static int ppm_fd, ppm_file_size, dump_fd;
-    static const unsigned int frame_data_size = 0xff;
-    static char buffer[frame_data_size] = {};
+    struct timeval frame_timestamp;
+    char file_name[CAMERA_NAME_SIZE + 20] = {};
+    char ppm_header[PPM_MAX_HEADER_SIZE] = "";
+    static const char ppm_target_comment[] = "# TARGET: Linux tegra-ubuntu 4.4.38-tegra #1 SMP PREEMPT Thu May 17 00:15:19 PDT 2018 aarch64 aarch64 aarch64 GNU/Linux";
+    //BGR to RGB swap buffer, borrowed from the frame pool
+    unsigned char *ppm_scratch_buffer;
+    //encoded .png data, capacity reserved once
+    vector<uchar> png_buffer;
+    //frame archive record header, and the segment the .ppm data goes to
+    frame_archive_record_t archive_record;
+    int archive_fd;
+
+    //frame closest to the release time, and the frame stored from it (downscaled by the quality control)
+    const frame_t *frame, *store_frame;
+    frame_t downscaled_frame;
+    unsigned int store_format;
+    struct timespec release_time, stage_start_time, stage_end_time;
+    unsigned long long encode_nsec, write_nsec;
+    size_t frame_bytes;
+    struct rusage page_faults_baseline;
+    int frame_stored;
+    //store period, followed by the quality control
+    const sequencer_service_t *store_service = sequencer_get_service(STORE_FRAMES_SERVICE_IDX(camera->idx));
 
     //openCV supported Mat class data structure
     Mat openCV_store_frames_mat;
 
-    //parameters to save the frame as compressed .png file
-    vector<int> compress_params;
-    compress_params.push_back(CV_IMWRITE_PXM_BINARY);
-    compress_params.push_back(compress_ratio); //user selectable compression ration
+    prefault_thread_stack(&page_faults_baseline);
 
-    //parameters to save the frame as .ppm file
-    vector<int> ppm_params;
-    ppm_params.push_back(CV_IMWRITE_PXM_BINARY);
-    ppm_params.push_back(1);
+    //borrow the store buffers up front
+    ppm_scratch_buffer = frame_pool_get(&camera->frame_pool);
+    if(!ppm_scratch_buffer) EXIT_FAIL("frame_pool_get");
+    png_buffer.reserve(camera->frame_pool.buffer_size);
 
     //loop forever, until user enters 'q' or 'Esc'
     while(1)
     {
-        if(timer_started)
+        //wait for the next release from the sequencer
+        //release time is used to pick the frame captured closest to it
+        sequencer_wait_for_release(&release_time);
+
+        if(exit_application) break;
+
+        //claim a frame from query_frames_thread, never waits for it
+        frame = frame_ring_claim(&camera->frame_ring, &release_time);
+        if(!frame)
         {
-            //wait for signal from timer...
-            if(pthread_mutex_lock(&app_timer_counter_mutex_lock)) EXIT_FAIL("pthread_mutex_lock");
-            if(pthread_cond_wait(&cond_store_frames_thread, &app_timer_counter_mutex_lock)) EXIT_FAIL("pthread_cond_wait");
-            if(pthread_mutex_unlock(&app_timer_counter_mutex_lock)) EXIT_FAIL("pthread_mutex_unlock");
+            TRACE_EVENT(TRACE_EVENT_NO_FRAME, TRACE_INSTANT, frame_counter);
+            continue;
         }
-        else
+        TRACE_EVENT(TRACE_EVENT_CLAIM, TRACE_INSTANT, frame->sequence);
+
+        //capture time-stamp, and how far it is from the release, the same release for every camera
+        frame_timestamp = frame->wall_time;
+        histogram_record(&camera->capture_stats.release_skew, delta_time_in_nsec(&frame->capture_time, &release_time) +
+                                                              delta_time_in_nsec(&release_time, &frame->capture_time));
+        //wrap the slot pixels, no copy
+        openCV_store_frames_mat = Mat(frame->height, frame->width, CV_8UC3, frame->data, frame->step);
+        frame_stored = TRUE;
+
+        //compared with the last stored frame, stored anyway once the max skip interval is over
+        if(camera->change_detect_on)
         {
-            EXIT_FAIL("Timer not available!");
+            TRACE_EVENT(TRACE_EVENT_DETECT, TRACE_BEGIN, frame->sequence);
+            frame_stored = (change_detect_frame_changed(&camera->change_detect, frame) != CHANGE_DETECT_UNCHANGED);
+            TRACE_EVENT(TRACE_EVENT_DETECT, TRACE_END, frame->sequence);
         }
 
-        if(exit_application) break;
-
-        //log for RT time analysis
-        #ifdef TIME_ANALYSIS
-        if(clock_gettime(CLOCK_REALTIME, &store_frames_start_time)) EXIT_FAIL("clock_gettime");
-        #endif //TIME_ANALYSIS
-
-        //log for debugging purposes
-        #ifdef DEBUG_MODE_ON
-        syslog(LOG_WARNING, " store_frames start write at:%lld", app_timer_counter);
-        #endif //DEBUG_MODE_ON
-
-        //make sure other threads are not updating frames at this moment
-        if(pthread_mutex_lock(&frame_mutex_lock)) EXIT_FAIL("pthread_mutex_lock");
-        //get timestamp
-        gettimeofday(&frame_timestamp, NULL);
-        //if this bit is set, most recent frame is already retrieved by the query_frames_thread
-        if(!live_camera_view)
+        //store mode of the quality control, a downscaled frame is counted in the encode time
+        store_frame = frame;
+        store_format = camera->quality_control_on ? camera->quality_control.mode.format : output_format;
+        encode_nsec = 0;
+        write_nsec = 0;
+        if(frame_stored && camera->quality_control_on && (camera->quality_control.mode.downscale > 1))
         {
-            if(!(cvGrabFrame(grab_frame))) EXIT_FAIL("cvGrabFrame"); //grab new frame
-            retrieve_frame = cvRetrieveFrame(grab_frame);
+            clock_gettime(CLOCK_MONOTONIC, &stage_start_time);
+            downscaled_frame = *frame;
+            downscaled_frame.width = frame->width / camera->quality_control.mode.downscale;
+            downscaled_frame.height = frame->height / camera->quality_control.mode.downscale;
+            downscaled_frame.step = (size_t)downscaled_frame.width * 3;
+            downscaled_frame.data = camera->downscale_data;
+            pixel_box_downscale(frame->data, frame->step, frame->width, frame->height, 3, camera->quality_control.mode.downscale,
+                                downscaled_frame.data, downscaled_frame.step, camera->downscale_column_sums);
+            store_frame = &downscaled_frame;
+            openCV_store_frames_mat = Mat(store_frame->height, store_frame->width, CV_8UC3, store_frame->data, store_frame->step);
+            clock_gettime(CLOCK_MONOTONIC, &stage_end_time);
+            encode_nsec = delta_time_in_nsec(&stage_end_time, &stage_start_time);
         }
-        //convert IplImage type to Mat type
-        openCV_store_frames_mat = cvarrToMat(retrieve_frame);
-        if(pthread_mutex_unlock(&frame_mutex_lock)) EXIT_FAIL("pthread_mutex_unlock");
-
-        #ifdef DEBUG_MODE_ON
-        syslog(LOG_WARNING, " store_frames unlocked frame_mutex at %lld", app_timer_counter);
-        #endif
 
-        if(compress_ratio)
+        if(!frame_stored)
         {
-            //compressed .png file name
-            sprintf(file_name, "frame_%d.png", frame_counter);
+            //unchanged scene, counted and traced only, its time-stamp is logged in debug mode
+            TRACE_EVENT(TRACE_EVENT_UNCHANGED, TRACE_INSTANT, frame->sequence);
+            ++camera->capture_stats.frames_unchanged;
+            #ifdef DEBUG_MODE_ON
+            syslog(LOG_INFO, " camera %u frame %llu unchanged, captured at %ld:%ld, %u cells changed, sad %llu",
+                   camera->idx, frame->sequence, frame_timestamp.tv_sec, frame_timestamp.tv_usec, camera->change_detect.changed_cells, camera->change_detect.sad);
+            #endif //DEBUG_MODE_ON
+        }
 
-            //dump frames as png
-            try
-            {
-                imwrite(file_name, openCV_store_frames_mat, compress_params);
-            }
-            //catch any exceptions, and exit the application if there are any issue while storing the .ppm file
-            catch(runtime_error& ex)
+        else if(camera->encode_pool_running)
+        {
+            //snapshot only, encoded and written in frame order by the encode workers
+            TRACE_EVENT(TRACE_EVENT_SNAPSHOT, TRACE_BEGIN, frame_counter);
+            if(encode_pool_submit(&camera->encode_pool, frame, frame_counter))
             {
-                printf("Exception converting image to PPM format!\n");
-                exit(ERROR);
+                ++camera->capture_stats.frames_dropped;
+                frame_stored = FALSE;
             }
+            TRACE_EVENT(TRACE_EVENT_SNAPSHOT, TRACE_END, frame_counter);
         }
 
-        else
+        else if(store_format == OUTPUT_FORMAT_PNG)
         {
-            //dump frames as ppm
+            //compressed .png file name
+            sprintf(file_name, "%sframe_%d.png", camera->output_directory, frame_counter);
+
+            //dump frames as png, encoded into the reserved buffer
+            TRACE_EVENT(TRACE_EVENT_ENCODE, TRACE_BEGIN, frame_counter);
+            clock_gettime(CLOCK_MONOTONIC, &stage_start_time);
             try
             {
-                imwrite("dump.ppm", openCV_store_frames_mat, ppm_params);
+                imencode(".png", openCV_store_frames_mat, png_buffer, camera->png_params);
             }
             //catch any exceptions, and exit the application if there are any issue while storing the .ppm file
             catch(runtime_error& ex)
@@ -371,118 +749,510 @@ void *store_frames(void *params)
                 exit(ERROR);
             }
 
-            //.ppm file name
-            sprintf(file_name, "frame_%d.ppm", frame_counter);
-            //apend ppm header
-            ppm_fd = open(file_name, O_RDWR | O_NONBLOCK | O_CREAT, 00666);
-            dump_fd = open("dump.ppm", O_RDONLY | O_NONBLOCK | O_CREAT, 00666);
+            clock_gettime(CLOCK_MONOTONIC, &stage_end_time);
+            encode_nsec += delta_time_in_nsec(&stage_end_time, &stage_start_time);
+            histogram_record(&camera->capture_stats.encode_time, encode_nsec);
+            TRACE_EVENT(TRACE_EVENT_ENCODE, TRACE_END, frame_counter);
 
-            //read first line of the file which specifies the format P6
-            if(read(dump_fd, buffer, 2))
-            {
-                write(ppm_fd, buffer, 2);
-            }
-            else
+            TRACE_EVENT(TRACE_EVENT_WRITE, TRACE_BEGIN, frame_counter);
+            stage_start_time = stage_end_time;
+            if(camera->frame_archive_open_flag)
             {
-                EXIT_FAIL("Error opening dump.ppm file!");
+                fill_archive_record(&archive_record, FRAME_ARCHIVE_FORMAT_PNG, store_frame, frame_counter, png_buffer.size());
+                if(frame_archive_write_frame(&camera->frame_archive, &archive_record, png_buffer.data())) EXIT_FAIL("frame_archive_write_frame");
             }
+            else if(write_buffer_to_file(file_name, png_buffer.data(), png_buffer.size())) EXIT_FAIL("write_buffer_to_file");
+            frame_bytes = png_buffer.size();
+            TRACE_EVENT(TRACE_EVENT_WRITE, TRACE_END, frame_counter);
+
+            //write time, capture to disk latency and throughput
+            clock_gettime(CLOCK_MONOTONIC, &stage_end_time);
+            write_nsec = delta_time_in_nsec(&stage_end_time, &stage_start_time);
+            histogram_record(&camera->capture_stats.write_time, write_nsec);
+            record_frame_stored(camera, &stage_end_time, frame, frame_bytes);
+        }
 
-            //append headers to the .ppm file
-            CLEAR_MEMORY(ppm_header1); //remove previous header data
-            //write time-stamp to header string
-            sprintf(ppm_header1, "\n# Frame %d captured at %ld:%ld", frame_counter, frame_timestamp.tv_sec, frame_timestamp.tv_usec);
-            write(ppm_fd, ppm_header1, strlen(ppm_header1));
-            write(ppm_fd, ppm_header2, strlen(ppm_header2));
-
-            //read dump.ppm file contents
-            while(read(dump_fd, buffer, frame_data_size))
+        else if(store_format == OUTPUT_FORMAT_DELTA)
+        {
+            //delta frame file name
+            sprintf(file_name, "%sframe_%d.rtd", camera->output_directory, frame_counter);
+
+            //keyframe, or the tiles changed since the last stored frame, straight from the slot pixels
+            TRACE_EVENT(TRACE_EVENT_ENCODE, TRACE_BEGIN, frame_counter);
+            clock_gettime(CLOCK_MONOTONIC, &stage_start_time);
+            frame_bytes = tile_delta_encode(&camera->tile_delta, frame, frame_counter);
+            if(!frame_bytes) EXIT_FAIL("tile_delta_encode");
+            clock_gettime(CLOCK_MONOTONIC, &stage_end_time);
+            histogram_record(&camera->capture_stats.encode_time, delta_time_in_nsec(&stage_end_time, &stage_start_time));
+            TRACE_EVENT(TRACE_EVENT_ENCODE, TRACE_END, frame_counter);
+
+            //every encoded frame must be stored, the next one is a delta of it
+            TRACE_EVENT(TRACE_EVENT_WRITE, TRACE_BEGIN, frame_counter);
+            stage_start_time = stage_end_time;
+            if(camera->frame_archive_open_flag)
             {
-                //write data
-                write(ppm_fd, buffer, frame_data_size);
-                //CLEAR_MEMORY(buffer);
+                fill_archive_record(&archive_record, FRAME_ARCHIVE_FORMAT_DELTA, frame, frame_counter, frame_bytes);
+                if(frame_archive_write_frame(&camera->frame_archive, &archive_record, camera->tile_delta.output)) EXIT_FAIL("frame_archive_write_frame");
             }
-            //write last few bytes before the EOF
-            write(ppm_fd, buffer, frame_data_size);
-            //close files
-            close(ppm_fd);
-            close(dump_fd);
+            else if(write_buffer_to_file(file_name, camera->tile_delta.output, frame_bytes)) EXIT_FAIL("write_buffer_to_file");
+            TRACE_EVENT(TRACE_EVENT_WRITE, TRACE_END, frame_counter);
+
+            //write time, capture to disk latency and throughput
+            clock_gettime(CLOCK_MONOTONIC, &stage_end_time);
+            write_nsec = delta_time_in_nsec(&stage_end_time, &stage_start_time);
+            histogram_record(&camera->capture_stats.write_time, write_nsec);
+            record_frame_stored(camera, &stage_end_time, frame, frame_bytes);
         }
 
-        //if this bit is set, most recent frames are already being displayed by query_frames_thread
-        if(!live_camera_view)
+        else
         {
-            //show image and wait for 1ms to receive user input
-            cvShowImage(capture_window_title, retrieve_frame);
-            char c = cvWaitKey(1);
-            if( c == 'q' || c == 27) break;
-        }
+            //.ppm file name
+            sprintf(file_name, "%sframe_%d.ppm", camera->output_directory, frame_counter);
+
+            //write time-stamps to header string, wall clock at capture and the driver sequence and time-stamp
+            snprintf(ppm_header, sizeof(ppm_header), "# Frame %d captured at %ld:%ld\n# Source sequence %llu exposed at %ld.%09ld\n%s",
+                     frame_counter, frame_timestamp.tv_sec, frame_timestamp.tv_usec, frame->source_sequence,
+                     (long)frame->exposure_time.tv_sec, frame->exposure_time.tv_nsec, ppm_target_comment);
+
+            //header plus pixel rows, straight from the frame data in one pass
+            TRACE_EVENT(TRACE_EVENT_WRITE, TRACE_BEGIN, frame_counter);
+            clock_gettime(CLOCK_MONOTONIC, &stage_start_time);
+            frame_bytes = ppm_frame_size(openCV_store_frames_mat.cols, openCV_store_frames_mat.rows, openCV_store_frames_mat.channels(), ppm_header);
+            if(camera->frame_archive_open_flag)
+            {
+                //the .ppm file is written straight into the archive record
+                fill_archive_record(&archive_record, FRAME_ARCHIVE_FORMAT_PPM, store_frame, frame_counter, frame_bytes);
+                archive_fd = frame_archive_begin_frame(&camera->frame_archive, &archive_record);
+                if((archive_fd == ERROR) ||
+                   ppm_write_frame_fd(archive_fd, openCV_store_frames_mat.data, openCV_store_frames_mat.cols, openCV_store_frames_mat.rows,
+                                      openCV_store_frames_mat.channels(), openCV_store_frames_mat.step[0], PPM_PIXEL_ORDER_BGR, ppm_header,
+                                      ppm_scratch_buffer) ||
+                   frame_archive_end_frame(&camera->frame_archive))
+                {
+                    EXIT_FAIL("frame archive");
+                }
+            }
+            else if(ppm_write_frame(file_name, openCV_store_frames_mat.data, openCV_store_frames_mat.cols, openCV_store_frames_mat.rows,
+                                    openCV_store_frames_mat.channels(), openCV_store_frames_mat.step[0], PPM_PIXEL_ORDER_BGR, ppm_header,
+                                    ppm_scratch_buffer))
+            {
+                EXIT_FAIL("ppm_write_frame");
+            }
+            TRACE_EVENT(TRACE_EVENT_WRITE, TRACE_END, frame_counter);
 
-        ++frame_counter;
+            //write time, capture to disk latency and throughput
+            clock_gettime(CLOCK_MONOTONIC, &stage_end_time);
+            write_nsec = delta_time_in_nsec(&stage_end_time, &stage_start_time);
+            histogram_record(&camera->capture_stats.write_time, write_nsec);
+            record_frame_stored(camera, &stage_end_time, frame, frame_bytes);
+        }
 
-        #ifdef DEBUG_MODE_ON
-        syslog(LOG_WARNING, " store_frames end of write at:%lld", app_timer_counter);
-        #endif //DEBUG_MODE_ON
+        //preview the stored frames, unless query_frames_thread offers every captured one
+        if(camera->preview_on && !live_camera_view) latest_frame_offer(&camera->preview_frame, frame);
 
-        #ifdef TIME_ANALYSIS
-        //measure end time
-        clock_gettime(CLOCK_REALTIME, &store_frames_end_time);
-        //measure elapsed time
-        store_frames_elapsed_time = delta_time_in_msec(&store_frames_end_time, &store_frames_start_time);
+        //next frames are compared with this one
+        if(frame_stored && camera->change_detect_on) change_detect_frame_stored(&camera->change_detect, frame);
 
-        //measure WCET
-        if(store_frames_elapsed_time > store_frames_wcet)
+        //store response of the job, the store mode is stepped if too many jobs miss their period
+        if(camera->quality_control_on)
         {
-            store_frames_wcet = store_frames_elapsed_time;
+            clock_gettime(CLOCK_MONOTONIC, &stage_end_time);
+            if(quality_control_job(&camera->quality_control, delta_time_in_nsec(&stage_end_time, &release_time),
+                                   (unsigned long long)__atomic_load_n(&store_service->period_msec, __ATOMIC_RELAXED) * NSEC_PER_MSEC,
+                                   encode_nsec, write_nsec))
+            {
+                camera->png_params[1] = camera->quality_control.mode.compress_ratio;
+            }
         }
 
-        //measure average run time
-        store_frames_average_load_time += store_frames_elapsed_time;
+        //hand the slot back to query_frames_thread
+        frame_ring_release(&camera->frame_ring);
 
-        //keep track of number of missed deadlines
-        if(store_frames_elapsed_time > (DEFAULT_STORE_FRAMES_INTERVAL_IN_MSEC/store_frames_frequency))
-        {
-            ++missed_deadlines;
-        }
-        #endif //TIME_ANALYSIS
+        //dropped and unchanged frames are not numbered
+        if(!frame_stored) continue;
+
+        ++frame_counter;
 
         //exit if no.of frames reached the user selected limit
         if(frame_counter >= max_no_of_frames_allowed) break;
     }
 
-    #ifdef TIME_ANALYSIS
-    //do not divide by Zero
-    if(frame_counter)
+    //queued frames are still encoded and written
+    if(camera->encode_pool_running) encode_pool_stop(&camera->encode_pool);
+
+    //every frame is in, trim and flush the last segment
+    if(camera->frame_archive_open_flag)
     {
-        store_frames_average_load_time /= frame_counter;
+        frame_archive_close(&camera->frame_archive);
+        camera->frame_archive_open_flag = FALSE;
     }
 
-    fprintf(stdout, "\n\n^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"
-                     "\nstore_frames_thread execuiton results:"
-                     "\nno. of frames processed: %d,"
-                     "\nWCET: %lf,"
-                     "\nAverage Execution Time: %lf,"
-                     "\nMissed Deadlines: %d"
-                     "\n^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^",
-                     frame_counter, store_frames_wcet, store_frames_average_load_time, missed_deadlines);
-
-    syslog(LOG_WARNING," ");
-    syslog(LOG_WARNING,"**************************************");
-    syslog(LOG_WARNING," query_frames_thread execuiton results:");
-    syslog(LOG_WARNING," no. of frames processed: %d", frame_counter);
-    syslog(LOG_WARNING," WCET: %lf", store_frames_wcet);
-    syslog(LOG_WARNING," Average Execution Time: %lf", store_frames_average_load_time);
-    syslog(LOG_WARNING," Missed Deadlines: %d", missed_deadlines);
-    syslog(LOG_WARNING,"**************************************");
-    syslog(LOG_WARNING," ");
-
-    #endif //TIME_ANALYSIS
+    //latency distributions are reported by the sequencer
+    fprintf(stdout, "\n\ncamera %u store_frames_thread processed %u frames", camera->idx, frame_counter);
+    syslog(LOG_WARNING, " camera %u store_frames_thread processed %u frames", camera->idx, frame_counter);
+
+    report_thread_page_faults("store_frames_thread", &page_faults_baseline);
 
     #ifdef DEBUG_MODE_ON
     syslog(LOG_WARNING," store_frames_thread exiting...");
     #endif //DEBUG_MODE_ON
 
+    //hand the store buffers back
+    frame_pool_put(&camera->frame_pool, ppm_scratch_buffer);
+
     exit_application = TRUE;
+    return NULL;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  encode_png_frame
+//
+//  Parameters:     job - frame snapshot
+//
+//  Return:         SUCCESS, or ERROR if openCV failed to encode the frame
+//
+//  Description:    Encode worker function, encodes the snapshot into the job's reserved buffer
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int encode_png_frame(encode_job_t *job)
+{
+    camera_t *camera = (camera_t *)job->arg;
+
+    try
+    {
+        imencode(".png", Mat(job->frame.height, job->frame.width, CV_8UC3, job->frame.data, job->frame.step),
+                 camera->encoded_frames[job->idx], png_params);
+    }
+    catch(runtime_error& ex)
+    {
+        syslog(LOG_ERR, " frame %u: .png encode failed, %s", job->frame_no, ex.what());
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  write_png_frame
+//
+//  Parameters:     job - encoded frame
+//
+//  Return:         None
+//
+//  Description:    Encode pool completion function, called in frame order. Writes the .png file (or archive record), and records the
+//                  encode, write and capture to disk times
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void write_png_frame(encode_job_t *job)
+{
+    camera_t *camera = (camera_t *)job->arg;
+    char file_name[CAMERA_NAME_SIZE + 20];
+    struct timespec write_end_time;
+    frame_archive_record_t archive_record;
+    const vector<uchar> &png_data = camera->encoded_frames[job->idx];
+
+    TRACE_EVENT(TRACE_EVENT_WRITE, TRACE_BEGIN, job->frame_no);
+    if(camera->frame_archive_open_flag)
+    {
+        fill_archive_record(&archive_record, FRAME_ARCHIVE_FORMAT_PNG, &job->frame, job->frame_no, png_data.size());
+        if(frame_archive_write_frame(&camera->frame_archive, &archive_record, png_data.data())) EXIT_FAIL("frame_archive_write_frame");
+    }
+    else
+    {
+        snprintf(file_name, sizeof(file_name), "%sframe_%u.png", camera->output_directory, job->frame_no);
+        if(write_buffer_to_file(file_name, png_data.data(), png_data.size())) EXIT_FAIL("write_buffer_to_file");
+    }
+    TRACE_EVENT(TRACE_EVENT_WRITE, TRACE_END, job->frame_no);
+
+    clock_gettime(CLOCK_MONOTONIC, &write_end_time);
+    histogram_record(&camera->capture_stats.encode_time, delta_time_in_nsec(&job->encode_end_time, &job->encode_start_time));
+    histogram_record(&camera->capture_stats.write_time, delta_time_in_nsec(&write_end_time, &job->encode_end_time));
+    record_frame_stored(camera, &write_end_time, &job->frame, png_data.size());
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  check_frame_source
+//
+//  Parameters:     camera - camera of the frame
+//                  frame - frame just published, with its source sequence and exposure time-stamp
+//                  frame_counter - frames captured before it by query_frames_thread
+//
+//  Return:         None
+//
+//  Description:    Counts the driver sequence numbers skipped since the last captured frame (the driver dropped them,
+//                  or they were overwritten in its queue), apart from the older frames v4l2_dequeue_frame() handed back
+//                  for a newer one, and the frames dequeued more than one query period after
+//                  their driver time-stamp (query_frames_thread is behind, older frames are waiting in the queue).
+//                  Called by query_frames_thread only, nothing is logged here
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void check_frame_source(camera_t *camera, const frame_t *frame, const unsigned int frame_counter)
+{
+    const unsigned long long dequeue_latency = delta_time_in_nsec(&frame->capture_time, &frame->exposure_time);
+    //V4L2 sequence numbers are 32 bit and wrap, a repeated or older sequence (driver restart) is not a gap
+    const int sequence_step = (int)(unsigned int)(frame->source_sequence - camera->last_source_sequence);
+    //older frames handed back for this one are not lost
+    const int frames_skipped = (int)(camera->frame_source.frames_skipped - camera->last_frames_skipped);
+
+    histogram_record(&camera->capture_stats.dequeue_latency, dequeue_latency);
+    if(dequeue_latency > camera->late_dequeue_nsec) ++camera->capture_stats.late_dequeues;
+
+    //sequence of the first frame is the reference
+    if(frame_counter && (sequence_step > (frames_skipped + 1)))
+    {
+        ++camera->capture_stats.sequence_gaps;
+        camera->capture_stats.frames_lost += sequence_step - frames_skipped - 1;
+        TRACE_EVENT(TRACE_EVENT_FRAME_GAP, TRACE_INSTANT, sequence_step - frames_skipped - 1);
+    }
+    camera->capture_stats.frames_skipped += frames_skipped;
+    camera->last_source_sequence = frame->source_sequence;
+    camera->last_frames_skipped = camera->frame_source.frames_skipped;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  record_frame_stored
+//
+//  Parameters:     camera - camera of the frame
+//                  store_time - CLOCK_MONOTONIC, file written
+//                  frame - stored frame, with its exposure time-stamp
+//                  frame_bytes - file size
+//
+//  Return:         None
+//
+//  Description:    Capture to disk latency, from the driver time-stamp, and throughput. The latency of every frame is
+//                  traced (no syslog, this runs in the RT store_frames_thread without encode workers). Called by one
+//                  thread of the camera at a time, its store_frames_thread or (in frame order) an encode worker
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void record_frame_stored(camera_t *camera, const struct timespec *store_time, const frame_t *frame,
+                                const size_t frame_bytes)
+{
+    const unsigned long long capture_to_disk = delta_time_in_nsec(store_time, &frame->exposure_time);
+
+    histogram_record(&camera->capture_stats.capture_to_disk, capture_to_disk);
+    TRACE_EVENT(TRACE_EVENT_STORED, TRACE_INSTANT, capture_to_disk / NSEC_PER_USEC);
+    if(!camera->capture_stats.frames_stored) camera->capture_stats.first_store_time = *store_time;
+    camera->capture_stats.last_store_time = *store_time;
+    camera->capture_stats.bytes_written += frame_bytes;
+    ++camera->capture_stats.frames_stored;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  fill_archive_record
+//
+//  Parameters:     record - archive record header to fill
+//                  format - FRAME_ARCHIVE_FORMAT_xxx
+//                  frame - stored frame, resolution, sequences and time-stamps
+//                  frame_no - store frame counter
+//                  data_size - encoded frame size
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void fill_archive_record(frame_archive_record_t *record, const unsigned int format, const frame_t *frame,
+                                const unsigned int frame_no, const size_t data_size)
+{
+    memset(record, 0, sizeof(*record));
+    record->format = format;
+    record->channels = frame->channels;
+    record->width = frame->width;
+    record->height = frame->height;
+    record->frame_no = frame_no;
+    record->data_size = data_size;
+    record->sequence = frame->sequence;
+    record->capture_nsec = ((uint64_t)frame->capture_time.tv_sec * NSEC_PER_SEC) + frame->capture_time.tv_nsec;
+    record->wall_usec = ((uint64_t)frame->wall_time.tv_sec * USEC_PER_SEC) + frame->wall_time.tv_usec;
+    record->source_sequence = frame->source_sequence;
+    record->exposure_nsec = ((uint64_t)frame->exposure_time.tv_sec * NSEC_PER_SEC) + frame->exposure_time.tv_nsec;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  get_capture_stats
+//
+//  Parameters:     camera - camera index, less than get_no_of_cameras()
+//
+//  Return:         Per stage latencies and store throughput of the camera, final once its query_frames_thread and
+//                  store_frames_thread have exited
+//
+//------------------------------------------------------------------------------------------------------------------------------
+const capture_stats_t *get_capture_stats(const unsigned int camera)
+{
+    return &cameras[camera].capture_stats;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  get_no_of_cameras
+//
+//  Parameters:     None
+//
+//  Return:         No.of cameras capturing (-N)
+//
+//------------------------------------------------------------------------------------------------------------------------------
+unsigned int get_no_of_cameras(void)
+{
+    return no_of_cameras;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  release_frame_buffers
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//  Description:    Waits for the preview thread, reports the counters of every camera (see report_camera()), and frees
+//                  the frame buffers. Call once every query_frames_thread and store_frames_thread has exited
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void release_frame_buffers(void)
+{
+    unsigned int i;
+
+    //exits within a preview period once the services are done
+    if(preview_thread_running)
+    {
+        exit_application = TRUE;
+        pthread_join(preview_thread, NULL);
+        preview_thread_running = FALSE;
+    }
+
+    for(i = 0; i < no_of_cameras; ++i)
+    {
+        report_camera(&cameras[i]);
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  report_camera
+//
+//  Parameters:     camera - camera, its services have exited
+//
+//  Return:         None
+//
+//  Description:    Prints and logs the stored frame counts, the frames lost by the source, the dequeue and capture to
+//                  disk latencies and the capture time alignment (distance of the stored frames from their store
+//                  release), then reports the change detection, quality control, delta frame, encode pool,
+//                  preview, shared memory, frame ring and frame pool counters, and frees the camera buffers
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void report_camera(camera_t *camera)
+{
+    const capture_stats_t *stats = &camera->capture_stats;
+    char name[CAMERA_NAME_SIZE + 48];
+
+    fprintf(stdout, "\n\n--------------------------------------"
+                     "\ncamera %u results (%s, %ux%u):"
+                     "\nframes stored: %llu, unchanged: %llu, dropped: %llu,"
+                     "\nsource sequence gaps: %llu, frames lost: %llu, late dequeues: %llu,"
+                     "\ndequeue timeouts: %llu, older frames skipped: %llu,"
+                     "\ndriver time-stamp to dequeue: p50 %.1lf us, p99 %.1lf us, max %.1lf us"
+                     "\ncapture to store release: p50 %.1lf us, p99 %.1lf us, max %.1lf us"
+                     "\ncapture to disk: p50 %.1lf us, p99 %.1lf us, max %.1lf us"
+                     "\n--------------------------------------",
+                     camera->idx, frame_source_name(&camera->frame_source), stats->width, stats->height,
+                     stats->frames_stored, stats->frames_unchanged, stats->frames_dropped,
+                     stats->sequence_gaps, stats->frames_lost, stats->late_dequeues,
+                     stats->dequeue_timeouts, stats->frames_skipped,
+                     (double)histogram_percentile(&stats->dequeue_latency, 50.0) / NSEC_PER_USEC,
+                     (double)histogram_percentile(&stats->dequeue_latency, 99.0) / NSEC_PER_USEC,
+                     (double)histogram_max(&stats->dequeue_latency) / NSEC_PER_USEC,
+                     (double)histogram_percentile(&stats->release_skew, 50.0) / NSEC_PER_USEC,
+                     (double)histogram_percentile(&stats->release_skew, 99.0) / NSEC_PER_USEC,
+                     (double)histogram_max(&stats->release_skew) / NSEC_PER_USEC,
+                     (double)histogram_percentile(&stats->capture_to_disk, 50.0) / NSEC_PER_USEC,
+                     (double)histogram_percentile(&stats->capture_to_disk, 99.0) / NSEC_PER_USEC,
+                     (double)histogram_max(&stats->capture_to_disk) / NSEC_PER_USEC);
+
+    syslog(LOG_WARNING, " camera %u: stored %llu, unchanged %llu, dropped %llu, capture to store release p99 %llu ns",
+           camera->idx, stats->frames_stored, stats->frames_unchanged, stats->frames_dropped,
+           histogram_percentile(&stats->release_skew, 99.0));
+    syslog(LOG_WARNING, " camera %u: source sequence gaps %llu, frames lost %llu, late dequeues %llu, dequeue timeouts %llu, "
+                        "older frames skipped %llu, dequeue p99 %llu ns, capture to disk p99 %llu ns",
+           camera->idx, stats->sequence_gaps, stats->frames_lost, stats->late_dequeues, stats->dequeue_timeouts, stats->frames_skipped,
+           histogram_percentile(&stats->dequeue_latency, 99.0), histogram_percentile(&stats->capture_to_disk, 99.0));
+
+    if(camera->change_detect_on)
+    {
+        change_detect_report(&camera->change_detect);
+        change_detect_destroy(&camera->change_detect);
+        camera->change_detect_on = FALSE;
+    }
+
+    if(camera->quality_control_on)
+    {
+        quality_control_report(&camera->quality_control);
+        free(camera->downscale_data);
+        free(camera->downscale_column_sums);
+        camera->quality_control_on = FALSE;
+    }
+
+    if(camera->tile_delta_on)
+    {
+        tile_delta_report(&camera->tile_delta);
+        tile_delta_destroy(&camera->tile_delta);
+        camera->tile_delta_on = FALSE;
+    }
+
+    if(camera->encode_pool_running)
+    {
+        snprintf(name, sizeof(name), "camera %u store_frames", camera->idx);
+        encode_pool_report(&camera->encode_pool, name);
+        encode_pool_destroy(&camera->encode_pool);
+        camera->encode_pool_running = FALSE;
+    }
+
+    if(camera->preview_on)
+    {
+        snprintf(name, sizeof(name), "camera %u preview", camera->idx);
+        latest_frame_report(&camera->preview_frame, name);
+        latest_frame_destroy(&camera->preview_frame);
+        free(camera->preview_data);
+        free(camera->preview_column_sums);
+        camera->preview_on = FALSE;
+    }
+
+    if(camera->frame_publisher_open_flag)
+    {
+        snprintf(name, sizeof(name), "camera %u query_frames", camera->idx);
+        frame_publisher_report(&camera->frame_publisher, name);
+        frame_publisher_close(&camera->frame_publisher);
+        camera->frame_publisher_open_flag = FALSE;
+    }
+
+    snprintf(name, sizeof(name), "camera %u query_frames -> store_frames", camera->idx);
+    frame_ring_report(&camera->frame_ring, name);
+    frame_ring_destroy(&camera->frame_ring);
+
+    snprintf(name, sizeof(name), "camera %u capture", camera->idx);
+    frame_pool_report(&camera->frame_pool, name);
+    frame_pool_destroy(&camera->frame_pool);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  delta_time_in_nsec
+//
+//  Parameters:     end_time - end time
+//                  start_time - start time
+//
+//  Return:         time difference between "end_time" and "start_time" in nano seconds, 0 if end_time is earlier
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static unsigned long long delta_time_in_nsec(const struct timespec *end_time, const struct timespec *start_time)
+{
+    const long long delta = ((long long)(end_time->tv_sec - start_time->tv_sec) * NSEC_PER_SEC) +
+                            (end_time->tv_nsec - start_time->tv_nsec);
 
+    return (delta > 0) ? (unsigned long long)delta : 0;
 }
 
 //==============================================================================
@@ -13,16 +13,34 @@
 #include <iostream>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <vector>
 
+//frame pool buffers held by store_frames_thread (ppm BGR to RGB swap buffer)
+#define STORE_FRAMES_POOL_BUFFERS   (1)
+
+//stored frame formats, selected with -o
+#define OUTPUT_FORMAT_PPM           (0) //binary .ppm, uncompressed
+#define OUTPUT_FORMAT_PNG           (1) //.png, compressed with the -c level
+#define OUTPUT_FORMAT_DELTA         (2) //.rtd, keyframes and changed tiles, see tile_delta.c
+#define OUTPUT_FORMATS              (3)
+
+//preview, the latest frame of every camera box downscaled to fit WIDTHxHEIGHT (-V), shown at its own rate (-U)
+#define DEFAULT_PREVIEW_WIDTH       (320)
+#define DEFAULT_PREVIEW_HEIGHT      (240)
+#define MIN_PREVIEW_SIZE            (16)
+#define DEFAULT_PREVIEW_FREQUENCY   (10)
+#define MAX_PREVIEW_FREQUENCY       (30)
+
 //APIs
-void initialize_device_use_openCV(void);
+void initialize_capture(void);
 void *query_frames(void *cameraIdx);
 void *store_frames(void *params);
+void release_frame_buffers(void);
 
 #endif //_CAPTURE_HPP_
 
@@ -0,0 +1,51 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: capture_stats.h
+//
+//  Description: Per stage statistics of the capture pipeline, recorded in capture.cpp
+//
+
+#ifndef _CAPTURE_STATS_H
+#define _CAPTURE_STATS_H
+
+#include "include.h"
+#include "histogram.h"
+#include <time.h>
+
+//per stage latencies and store throughput of a camera, recorded by its query_frames_thread, store_frames_thread and
+//encode workers
+typedef struct
+{
+    histogram_t grab_time;              //frame source read, query_frames_thread
+    histogram_t dequeue_latency;        //driver buffer time-stamp to frame ready in the ring, query_frames_thread
+    histogram_t release_skew;           //capture time-stamp to the store release the frame was claimed for, the same
+                                        //release for every camera, so also the capture time alignment of the cameras
+    histogram_t encode_time;            //.png encode, store_frames_thread or an encode worker
+    histogram_t write_time;             //file write (encode end to file written with encode workers)
+    histogram_t capture_to_disk;        //driver buffer (or capture) time-stamp to file written
+    unsigned int width;                 //frame source resolution
+    unsigned int height;
+    unsigned long long frames_stored;
+    unsigned long long frames_dropped;  //every encode job busy
+    unsigned long long frames_unchanged;//not stored, see change_detect.c
+    unsigned long long sequence_gaps;   //driver sequence jumps between two captured frames
+    unsigned long long frames_lost;     //driver sequence numbers never captured (dropped by the driver, or overwritten
+                                        //in its queue)
+    unsigned long long late_dequeues;   //frames dequeued more than one query period after their driver time-stamp
+    unsigned long long dequeue_timeouts;//releases the device filled no buffer within the query period, nothing published
+    unsigned long long frames_skipped;  //older filled buffers handed back unread for the newest one
+    unsigned long long bytes_written;
+    struct timespec first_store_time;   //CLOCK_MONOTONIC, first frame written
+    struct timespec last_store_time;    //CLOCK_MONOTONIC, last frame written
+}capture_stats_t;
+
+//APIs
+const capture_stats_t *get_capture_stats(const unsigned int camera);
+unsigned int get_no_of_cameras(void);
+
+#endif //_CAPTURE_STATS_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,329 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: change_detect.c
+//
+//  Description: Change detection before storage. Every frame is reduced to a thumbnail (one byte per 16x16 cell), and
+//               compared cell by cell with the thumbnail of the last stored frame. Only frames with enough changed
+//               cells are stored, plus one every max skip interval. Cell sums and the thumbnail differences use the
+//               SIMD sum of absolute differences, SSE2 on x86-64 and NEON on aarch64 (baseline on both, no run time
+//               selection needed), with a scalar fallback
+//
+
+#include "include.h"
+#include "change_detect.h"
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#define CHANGE_DETECT_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define CHANGE_DETECT_NEON
+#include <arm_neon.h>
+#endif
+
+//bytes of one cell row, BGR
+#define CELL_ROW_BYTES  (CHANGE_DETECT_CELL_SIZE * 3)
+
+//local functions
+static void build_thumbnail(const change_detect_t *detect, const frame_t *frame, unsigned char *thumbnail);
+static inline unsigned int cell_row_sum(const unsigned char *pixels);
+static void compare_thumbnails(const unsigned char *a, const unsigned char *b, const unsigned int size,
+                               const unsigned int threshold, unsigned int *changed_cells, unsigned long long *sad);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  change_detect_init
+//
+//  Parameters:     detect - change detection to initialize
+//                  width, height - frame resolution
+//                  threshold - cell change threshold, 1 to MAX_CHANGE_DETECT_THRESHOLD
+//                  cells_percent - changed cells needed to store a frame, percent of the cells
+//                  max_skip_sec - a frame is stored at least this often
+//
+//  Return:         None
+//
+//  Description:    Allocates the thumbnails (outside the RT loops, locked by mlockall). Exits the application on failure
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void change_detect_init(change_detect_t *detect, const unsigned int width, const unsigned int height, const unsigned int threshold,
+                        const unsigned int cells_percent, const unsigned int max_skip_sec)
+{
+    unsigned int no_of_cells;
+
+    memset(detect, 0, sizeof(*detect));
+    detect->cols = width / CHANGE_DETECT_CELL_SIZE;
+    detect->rows = height / CHANGE_DETECT_CELL_SIZE;
+    no_of_cells = detect->cols * detect->rows;
+    if(!no_of_cells)
+    {
+        errno = EINVAL;
+        EXIT_FAIL("change_detect_init");
+    }
+
+    detect->threshold = threshold;
+    detect->cells_needed = ((no_of_cells * cells_percent) + 99) / 100;
+    if(!detect->cells_needed) detect->cells_needed = 1;
+    detect->max_skip_nsec = (unsigned long long)max_skip_sec * NSEC_PER_SEC;
+
+    detect->reference = (unsigned char *)calloc(no_of_cells, 1);
+    detect->current = (unsigned char *)calloc(no_of_cells, 1);
+    detect->cell_sums = (unsigned int *)calloc(detect->cols, sizeof(*detect->cell_sums));
+    if(!detect->reference || !detect->current || !detect->cell_sums) EXIT_FAIL("calloc");
+
+    syslog(LOG_WARNING, " change detection: %ux%u cells, threshold %u, %u cells needed, max skip %u sec",
+           detect->cols, detect->rows, threshold, detect->cells_needed, max_skip_sec);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  change_detect_frame_changed
+//
+//  Parameters:     detect - initialized change detection
+//                  frame - claimed frame
+//
+//  Return:         CHANGE_DETECT_CHANGED or CHANGE_DETECT_MAX_SKIP to store the frame, CHANGE_DETECT_UNCHANGED to skip it
+//
+//  Description:    Builds the frame thumbnail, and compares it with the last stored one. changed_cells and sad are
+//                  left for the log. The first frame is always stored. Call change_detect_frame_stored() once the
+//                  frame is stored
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int change_detect_frame_changed(change_detect_t *detect, const frame_t *frame)
+{
+    unsigned long long skipped_nsec;
+
+    ++detect->frames_checked;
+    build_thumbnail(detect, frame, detect->current);
+
+    if(!detect->have_reference)
+    {
+        detect->changed_cells = detect->cols * detect->rows;
+        detect->sad = 0;
+        ++detect->frames_changed;
+        return CHANGE_DETECT_CHANGED;
+    }
+
+    compare_thumbnails(detect->reference, detect->current, detect->cols * detect->rows, detect->threshold,
+                       &detect->changed_cells, &detect->sad);
+    if(detect->changed_cells >= detect->cells_needed)
+    {
+        ++detect->frames_changed;
+        return CHANGE_DETECT_CHANGED;
+    }
+
+    skipped_nsec = ((frame->capture_time.tv_sec - detect->reference_time.tv_sec) * (unsigned long long)NSEC_PER_SEC) +
+                   frame->capture_time.tv_nsec - detect->reference_time.tv_nsec;
+    if(skipped_nsec >= detect->max_skip_nsec)
+    {
+        ++detect->frames_max_skip;
+        return CHANGE_DETECT_MAX_SKIP;
+    }
+
+    ++detect->frames_unchanged;
+    return CHANGE_DETECT_UNCHANGED;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  change_detect_frame_stored
+//
+//  Parameters:     detect - initialized change detection
+//                  frame - frame last passed to change_detect_frame_changed(), now stored
+//
+//  Return:         None
+//
+//  Description:    Makes the frame the reference for the next ones. A frame dropped on the way to storage is not
+//                  passed here, so the next frame is compared with the last one actually stored
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void change_detect_frame_stored(change_detect_t *detect, const frame_t *frame)
+{
+    unsigned char *thumbnail = detect->reference;
+
+    detect->reference = detect->current;
+    detect->current = thumbnail;
+    detect->reference_time = frame->capture_time;
+    detect->have_reference = TRUE;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  change_detect_report
+//
+//  Parameters:     detect - change detection
+//
+//  Return:         None
+//
+//  Description:    Prints and logs the frame counters
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void change_detect_report(const change_detect_t *detect)
+{
+    fprintf(stdout, "\n\n--------------------------------------"
+                     "\nchange detection results:"
+                     "\nframes checked: %llu,"
+                     "\nchanged: %llu,"
+                     "\nunchanged, stored after the max skip interval: %llu,"
+                     "\nunchanged, not stored: %llu (%.1f%%)"
+                     "\n--------------------------------------",
+                     detect->frames_checked, detect->frames_changed, detect->frames_max_skip, detect->frames_unchanged,
+                     detect->frames_checked ? ((100.0 * detect->frames_unchanged) / detect->frames_checked) : 0.0);
+
+    syslog(LOG_WARNING, " change detection: checked %llu, changed %llu, max skip %llu, unchanged %llu",
+           detect->frames_checked, detect->frames_changed, detect->frames_max_skip, detect->frames_unchanged);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  change_detect_destroy
+//
+//  Parameters:     detect - change detection
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void change_detect_destroy(change_detect_t *detect)
+{
+    free(detect->reference);
+    free(detect->current);
+    free(detect->cell_sums);
+    detect->reference = NULL;
+    detect->current = NULL;
+    detect->cell_sums = NULL;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  build_thumbnail
+//
+//  Parameters:     detect - thumbnail resolution
+//                  frame - BGR frame
+//                  thumbnail - cols x rows bytes, mean of the B, G and R bytes of every cell
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void build_thumbnail(const change_detect_t *detect, const frame_t *frame, unsigned char *thumbnail)
+{
+    unsigned int *sums = detect->cell_sums;
+    unsigned int cell_row, row, col;
+    const unsigned char *pixels;
+
+    for(cell_row = 0; cell_row < detect->rows; ++cell_row)
+    {
+        memset(sums, 0, detect->cols * sizeof(*sums));
+        for(row = 0; row < CHANGE_DETECT_CELL_SIZE; ++row)
+        {
+            pixels = frame->data + (((size_t)cell_row * CHANGE_DETECT_CELL_SIZE) + row) * frame->step;
+            for(col = 0; col < detect->cols; ++col, pixels += CELL_ROW_BYTES)
+            {
+                sums[col] += cell_row_sum(pixels);
+            }
+        }
+
+        for(col = 0; col < detect->cols; ++col)
+        {
+            *thumbnail++ = sums[col] / (CHANGE_DETECT_CELL_SIZE * CELL_ROW_BYTES);
+        }
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  cell_row_sum
+//
+//  Parameters:     pixels - CELL_ROW_BYTES bytes, one row of a cell
+//
+//  Return:         Sum of the bytes
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static inline unsigned int cell_row_sum(const unsigned char *pixels)
+{
+#if defined(CHANGE_DETECT_SSE2)
+    //sum of absolute differences against zero, two 64 bit partial sums per register
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_sad_epu8(_mm_loadu_si128((const __m128i *)pixels), zero);
+
+    sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(pixels + 16)), zero));
+    sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(pixels + 32)), zero));
+
+    return (unsigned int)(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+#elif defined(CHANGE_DETECT_NEON)
+    uint16x8_t sum = vpaddlq_u8(vld1q_u8(pixels));
+
+    sum = vpadalq_u8(sum, vld1q_u8(pixels + 16));
+    sum = vpadalq_u8(sum, vld1q_u8(pixels + 32));
+
+    return vaddvq_u16(sum);
+#else
+    unsigned int i, sum = 0;
+
+    for(i = 0; i < CELL_ROW_BYTES; ++i)
+    {
+        sum += pixels[i];
+    }
+
+    return sum;
+#endif
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  compare_thumbnails
+//
+//  Parameters:     a, b - thumbnails
+//                  size - cells per thumbnail
+//                  threshold - a cell changed if the values differ by more than this
+//                  changed_cells - set to the no.of changed cells
+//                  sad - set to the sum of absolute differences
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void compare_thumbnails(const unsigned char *a, const unsigned char *b, const unsigned int size,
+                               const unsigned int threshold, unsigned int *changed_cells, unsigned long long *sad)
+{
+    unsigned int i = 0, changed = 0, difference;
+    unsigned long long total = 0;
+
+#if defined(CHANGE_DETECT_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i limit = _mm_set1_epi8((char)threshold);
+    __m128i va, vb, vdiff, vsad = zero;
+
+    for(; i + 16 <= size; i += 16)
+    {
+        va = _mm_loadu_si128((const __m128i *)(a + i));
+        vb = _mm_loadu_si128((const __m128i *)(b + i));
+        vsad = _mm_add_epi64(vsad, _mm_sad_epu8(va, vb));
+        //|a - b| > threshold, where the saturated difference to the threshold is not zero
+        vdiff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        changed += 16 - __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(vdiff, limit), zero)));
+    }
+    total = (unsigned long long)_mm_cvtsi128_si32(vsad) + (unsigned long long)_mm_cvtsi128_si32(_mm_srli_si128(vsad, 8));
+#elif defined(CHANGE_DETECT_NEON)
+    const uint8x16_t limit = vdupq_n_u8(threshold);
+    uint8x16_t vdiff;
+
+    for(; i + 16 <= size; i += 16)
+    {
+        vdiff = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        total += vaddlvq_u8(vdiff);
+        changed += vaddvq_u8(vshrq_n_u8(vcgtq_u8(vdiff, limit), 7));
+    }
+#endif
+
+    for(; i < size; ++i)
+    {
+        difference = (a[i] > b[i]) ? (a[i] - b[i]) : (b[i] - a[i]);
+        total += difference;
+        if(difference > threshold) ++changed;
+    }
+
+    *changed_cells = changed;
+    *sad = total;
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,70 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: change_detect.h
+//
+//  Description: Header file for change_detect.c
+//
+
+#ifndef _CHANGE_DETECT_H
+#define _CHANGE_DETECT_H
+
+#include "include.h"
+#include "frame_ring.h"
+#include <time.h>
+
+//frames are compared as thumbnails, one byte (mean of B, G and R) per cell of CELL_SIZE x CELL_SIZE pixels
+#define CHANGE_DETECT_CELL_SIZE                 (16)
+
+//a cell changed if its thumbnail value moved by more than this, 0 disables change detection (-D)
+#define DEFAULT_CHANGE_DETECT_THRESHOLD         (0)
+#define MAX_CHANGE_DETECT_THRESHOLD             (254)
+
+//changed cells needed to store a frame, percent of the cells (-P), at least one cell
+#define DEFAULT_CHANGE_DETECT_CELLS_PERCENT     (1)
+#define MAX_CHANGE_DETECT_CELLS_PERCENT         (100)
+
+//a frame is stored at least this often, changed or not (-k)
+#define DEFAULT_CHANGE_DETECT_MAX_SKIP_IN_SEC   (60)
+#define MIN_CHANGE_DETECT_MAX_SKIP_IN_SEC       (1)
+#define MAX_CHANGE_DETECT_MAX_SKIP_IN_SEC       (3600)
+
+//change_detect_frame_changed() results
+#define CHANGE_DETECT_UNCHANGED                 (0) //skip the frame
+#define CHANGE_DETECT_CHANGED                   (1)
+#define CHANGE_DETECT_MAX_SKIP                  (2) //unchanged, but the max skip interval is over
+
+//thumbnails of the last stored and the current frame
+typedef struct
+{
+    unsigned int threshold;
+    unsigned int cells_needed;              //changed cells to store a frame
+    unsigned long long max_skip_nsec;
+    unsigned int cols;                      //thumbnail resolution, partial cells at the right and bottom are left out
+    unsigned int rows;
+    unsigned char *reference;               //last stored frame
+    unsigned char *current;                 //last checked frame
+    unsigned int *cell_sums;                //one row of cells, while building a thumbnail
+    int have_reference;
+    struct timespec reference_time;         //CLOCK_MONOTONIC capture time of the last stored frame
+    unsigned int changed_cells;             //last check
+    unsigned long long sad;                 //last check, sum of absolute cell differences
+    unsigned long long frames_checked;
+    unsigned long long frames_changed;
+    unsigned long long frames_max_skip;
+    unsigned long long frames_unchanged;
+}change_detect_t;
+
+//APIs
+void change_detect_init(change_detect_t *detect, const unsigned int width, const unsigned int height, const unsigned int threshold,
+                        const unsigned int cells_percent, const unsigned int max_skip_sec);
+int change_detect_frame_changed(change_detect_t *detect, const frame_t *frame);
+void change_detect_frame_stored(change_detect_t *detect, const frame_t *frame);
+void change_detect_report(const change_detect_t *detect);
+void change_detect_destroy(change_detect_t *detect);
+
+#endif //_CHANGE_DETECT_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
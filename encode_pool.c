@@ -0,0 +1,319 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: encode_pool.c
+//
+//  Description: Frame encoding off the RT threads. store_frames_thread only snapshots a frame into a free job, and
+//               never waits. Worker threads, pinned to their own cores, encode the queued frames in parallel, and the
+//               encoded frames are completed (written out) strictly in frame order, by whichever worker finishes the
+//               oldest one
+//
+
+#include "include.h"
+#include "encode_pool.h"
+#include "trace.h"
+
+//local functions
+static void *encode_worker_handler(void *args);
+static void complete_in_order(encode_pool_t *pool);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  encode_pool_init
+//
+//  Parameters:     pool - pool to initialize
+//                  no_of_workers - worker threads, 1 to MAX_ENCODE_WORKERS
+//                  cores, no_of_cores - worker i is pinned to cores[i % no_of_cores], not pinned if no_of_cores is 0
+//                  frame_pool - ENCODE_JOBS_PER_WORKER buffers per worker are borrowed from it, for the snapshots
+//                  width, height, channels - snapshot frame size
+//                  encode, complete - see encode_pool.h
+//                  arg - passed to encode and complete in every job
+//
+//  Return:         None
+//
+//  Description:    Borrows the job buffers and starts the workers. Workers are normal (SCHED_OTHER) threads, they only use
+//                  the slack of their cores (every core the process may run on without cores). Exits the application on
+//                  failure
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void encode_pool_init(encode_pool_t *pool, const unsigned int no_of_workers, const int *cores, const unsigned int no_of_cores,
+                      frame_pool_t *frame_pool, const unsigned int width, const unsigned int height, const unsigned int channels,
+                      encode_fn_t encode, complete_fn_t complete, void *arg)
+{
+    unsigned int i;
+    encode_job_t *job;
+    encode_worker_t *worker;
+    pthread_attr_t worker_thread_attr;
+
+    assert((no_of_workers > 0) && (no_of_workers <= MAX_ENCODE_WORKERS));
+
+    memset(pool, 0, sizeof(*pool));
+    pool->no_of_workers = no_of_workers;
+    pool->no_of_jobs = no_of_workers * ENCODE_JOBS_PER_WORKER;
+    pool->encode = encode;
+    pool->complete = complete;
+    pool->frame_pool = frame_pool;
+
+    if(sem_init(&pool->queued, 0, 0)) EXIT_FAIL("sem_init");
+    if(pthread_mutex_init(&pool->complete_lock, NULL)) EXIT_FAIL("pthread_mutex_init");
+
+    for(i = 0; i < pool->no_of_jobs; ++i)
+    {
+        job = &pool->jobs[i];
+        job->idx = i;
+        job->arg = arg;
+        job->state = ENCODE_JOB_FREE;
+        job->frame.width = width;
+        job->frame.height = height;
+        job->frame.channels = channels;
+        job->frame.step = (size_t)width * channels;
+        job->frame.data = frame_pool_get(frame_pool);
+        if(!job->frame.data) EXIT_FAIL("frame_pool_get");
+    }
+
+    for(i = 0; i < no_of_workers; ++i)
+    {
+        worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->idx = i;
+        worker->core = no_of_cores ? cores[i % no_of_cores] : ALL_CORES;
+        //the pool is started from the dispatcher, its RT policy and core are not inherited
+        assign_normal_schedular_attr(&worker_thread_attr, worker->core);
+        if(pthread_create(&worker->thread, &worker_thread_attr, encode_worker_handler, (void *)worker)) EXIT_FAIL("pthread_create");
+        pthread_attr_destroy(&worker_thread_attr);
+    }
+
+    syslog(LOG_WARNING, " encode pool: %u workers, %u jobs", pool->no_of_workers, pool->no_of_jobs);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  encode_pool_submit
+//
+//  Parameters:     pool - running pool
+//                  frame - frame to snapshot, can be reused once this returns
+//                  frame_no - passed on to the job
+//
+//  Return:         SUCCESS, or ERROR if every job is busy (the frame is dropped)
+//
+//  Description:    Copies the frame into the next job in frame order, and wakes a worker. Never blocks, only called
+//                  from one thread (store_frames_thread)
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int encode_pool_submit(encode_pool_t *pool, const frame_t *frame, const unsigned int frame_no)
+{
+    unsigned int row;
+    const unsigned long long submitted = __atomic_load_n(&pool->submitted, __ATOMIC_RELAXED);
+    encode_job_t *job = &pool->jobs[submitted % pool->no_of_jobs];
+    const size_t row_size = (size_t)frame->width * frame->channels;
+
+    //jobs are completed in submit order, the next one is free once the one no_of_jobs older is complete
+    if(__atomic_load_n(&job->state, __ATOMIC_ACQUIRE) != ENCODE_JOB_FREE)
+    {
+        ++pool->dropped;
+        return ERROR;
+    }
+
+    assert((frame->width == job->frame.width) && (frame->height == job->frame.height) && (frame->channels == job->frame.channels));
+
+    for(row = 0; row < frame->height; ++row)
+    {
+        memcpy(job->frame.data + (row * job->frame.step), frame->data + (row * frame->step), row_size);
+    }
+    job->frame.sequence = frame->sequence;
+    job->frame.capture_time = frame->capture_time;
+    job->frame.wall_time = frame->wall_time;
+    job->frame.source_sequence = frame->source_sequence;
+    job->frame.exposure_time = frame->exposure_time;
+    job->frame_no = frame_no;
+
+    __atomic_store_n(&job->state, ENCODE_JOB_QUEUED, __ATOMIC_RELAXED);
+    __atomic_store_n(&pool->submitted, submitted + 1, __ATOMIC_RELEASE);
+    if(sem_post(&pool->queued)) EXIT_FAIL("sem_post");
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  encode_pool_stop
+//
+//  Parameters:     pool - running pool
+//
+//  Return:         None
+//
+//  Description:    Lets the workers encode and complete every submitted job, then joins them. Call from the
+//                  submitting thread, once it stopped submitting
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void encode_pool_stop(encode_pool_t *pool)
+{
+    unsigned int i;
+
+    //a worker exits when it is woken with nothing left to take
+    for(i = 0; i < pool->no_of_workers; ++i)
+    {
+        if(sem_post(&pool->queued)) EXIT_FAIL("sem_post");
+    }
+
+    for(i = 0; i < pool->no_of_workers; ++i)
+    {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    pool->no_of_workers = 0;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  encode_pool_destroy
+//
+//  Parameters:     pool - stopped pool
+//
+//  Return:         None
+//
+//  Description:    Hands the job buffers back to the frame pool
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void encode_pool_destroy(encode_pool_t *pool)
+{
+    unsigned int i;
+
+    for(i = 0; i < pool->no_of_jobs; ++i)
+    {
+        frame_pool_put(pool->frame_pool, pool->jobs[i].frame.data);
+        pool->jobs[i].frame.data = NULL;
+    }
+    pool->no_of_jobs = 0;
+
+    sem_destroy(&pool->queued);
+    pthread_mutex_destroy(&pool->complete_lock);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  encode_pool_report
+//
+//  Parameters:     pool - stopped pool
+//                  pool_name - printed along with the results
+//
+//  Return:         None
+//
+//  Description:    Prints and logs the job counters, used for sizing the no.of workers
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void encode_pool_report(const encode_pool_t *pool, const char *pool_name)
+{
+    fprintf(stdout, "\n\n--------------------------------------"
+                     "\n%s encode pool results:"
+                     "\njobs: %u,"
+                     "\nframes submitted: %llu,"
+                     "\nframes completed: %llu,"
+                     "\nframes dropped (every job busy): %llu,"
+                     "\nencode errors: %llu"
+                     "\n--------------------------------------",
+                     pool_name, pool->no_of_jobs, pool->submitted, pool->completed, pool->dropped, pool->encode_errors);
+
+    syslog(LOG_WARNING," %s encode pool: submitted %llu, completed %llu, dropped %llu, errors %llu",
+           pool_name, pool->submitted, pool->completed, pool->dropped, pool->encode_errors);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  encode_worker_handler
+//
+//  Parameters:     args - encode_worker_t of this thread
+//
+//  Return:         None
+//
+//  Description:    Takes the oldest queued job on every wake up, encodes it, and completes every encoded job that is
+//                  next in frame order. Exits when woken with no job left to take (encode_pool_stop())
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void *encode_worker_handler(void *args)
+{
+    encode_worker_t *worker = (encode_worker_t *)args;
+    encode_pool_t *pool = worker->pool;
+    encode_job_t *job;
+    unsigned long long taken;
+    int have_job;
+    char name[TRACE_NAME_SIZE];
+
+    snprintf(name, sizeof(name), "encode_worker_%u", worker->idx);
+    trace_thread_register(name);
+
+    while(1)
+    {
+        while(sem_wait(&pool->queued))
+        {
+            if(errno != EINTR) EXIT_FAIL("sem_wait");
+        }
+
+        //every submit posts once, so a job is left unless the pool is stopping
+        have_job = FALSE;
+        taken = __atomic_load_n(&pool->taken, __ATOMIC_RELAXED);
+        while(taken != __atomic_load_n(&pool->submitted, __ATOMIC_ACQUIRE))
+        {
+            if(__atomic_compare_exchange_n(&pool->taken, &taken, taken + 1, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            {
+                have_job = TRUE;
+                break;
+            }
+        }
+        if(!have_job) break;
+
+        job = &pool->jobs[taken % pool->no_of_jobs];
+
+        TRACE_EVENT(TRACE_EVENT_ENCODE, TRACE_BEGIN, job->frame_no);
+        clock_gettime(CLOCK_MONOTONIC, &job->encode_start_time);
+        //a failed job is still completed in order, so the jobs after it are not held up
+        job->encode_status = pool->encode(job);
+        clock_gettime(CLOCK_MONOTONIC, &job->encode_end_time);
+        TRACE_EVENT(TRACE_EVENT_ENCODE, TRACE_END, job->frame_no);
+
+        __atomic_store_n(&job->state, ENCODE_JOB_ENCODED, __ATOMIC_RELEASE);
+        complete_in_order(pool);
+    }
+
+    #ifdef DEBUG_MODE_ON
+    syslog(LOG_WARNING," encode_worker_%u exiting...", worker->idx);
+    #endif //DEBUG_MODE_ON
+
+    return NULL;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  complete_in_order
+//
+//  Parameters:     pool - running pool
+//
+//  Return:         None
+//
+//  Description:    Completes the encoded jobs from the oldest submitted one, up to the first one still queued or being
+//                  encoded, and frees them for store_frames_thread. A worker always calls this after marking its job
+//                  encoded, so every job is completed by the last worker to finish the jobs before it
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void complete_in_order(encode_pool_t *pool)
+{
+    encode_job_t *job;
+
+    if(pthread_mutex_lock(&pool->complete_lock)) EXIT_FAIL("pthread_mutex_lock");
+
+    while(pool->completed < __atomic_load_n(&pool->submitted, __ATOMIC_ACQUIRE))
+    {
+        job = &pool->jobs[pool->completed % pool->no_of_jobs];
+        if(__atomic_load_n(&job->state, __ATOMIC_ACQUIRE) != ENCODE_JOB_ENCODED) break;
+
+        if(job->encode_status == SUCCESS) pool->complete(job);
+        else ++pool->encode_errors;
+
+        ++pool->completed;
+        __atomic_store_n(&job->state, ENCODE_JOB_FREE, __ATOMIC_RELEASE);
+    }
+
+    if(pthread_mutex_unlock(&pool->complete_lock)) EXIT_FAIL("pthread_mutex_unlock");
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,93 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: encode_pool.h
+//
+//  Description: Header file for encode_pool.c
+//
+
+#ifndef _ENCODE_POOL_H
+#define _ENCODE_POOL_H
+
+#include "frame_pool.h"
+#include "frame_ring.h"
+#include "include.h"
+#include <semaphore.h>
+#include <time.h>
+
+//encode worker threads, 0 encodes in store_frames_thread
+#define MIN_ENCODE_WORKERS          (0)
+#define DEFAULT_ENCODE_WORKERS      (2)
+#define MAX_ENCODE_WORKERS          (8)
+
+//frames queued or being encoded, each job holds a frame pool buffer
+#define ENCODE_JOBS_PER_WORKER      (2)
+#define MAX_ENCODE_JOBS             (MAX_ENCODE_WORKERS * ENCODE_JOBS_PER_WORKER)
+
+//encode job states
+#define ENCODE_JOB_FREE             (0)
+#define ENCODE_JOB_QUEUED           (1) //snapshot taken, waiting for a worker
+#define ENCODE_JOB_ENCODED          (2) //waiting for the older frames to complete
+
+//frame snapshot, and its encode times
+typedef struct
+{
+    frame_t frame;                      //pixels in a frame pool buffer owned by the job
+    unsigned int frame_no;              //store_frames_thread frame counter
+    unsigned int idx;                   //job index, for per job encoder state
+    void *arg;                          //given to encode_pool_init(), e.g. the camera of the pool
+    int state;                          //ENCODE_JOB_xxx, atomic
+    int encode_status;                  //encode_fn_t result
+    struct timespec encode_start_time;  //CLOCK_MONOTONIC
+    struct timespec encode_end_time;
+} __attribute__((aligned(CACHE_LINE_SIZE))) encode_job_t;
+
+//encode, run by the workers in parallel. Returns SUCCESS or ERROR
+typedef int (*encode_fn_t)(encode_job_t *job);
+//complete (write out), run in frame order, one job at a time
+typedef void (*complete_fn_t)(encode_job_t *job);
+
+struct encode_pool;
+
+//worker thread
+typedef struct
+{
+    struct encode_pool *pool;
+    pthread_t thread;
+    unsigned int idx;
+    int core;                           //pinned core, ALL_CORES if not pinned
+}encode_worker_t;
+
+//single producer (store_frames_thread), multiple consumer (encode workers) job queue
+typedef struct encode_pool
+{
+    encode_job_t jobs[MAX_ENCODE_JOBS];
+    unsigned int no_of_jobs;
+    encode_worker_t workers[MAX_ENCODE_WORKERS];
+    unsigned int no_of_workers;
+    encode_fn_t encode;
+    complete_fn_t complete;
+    frame_pool_t *frame_pool;
+    sem_t queued;                                                           //one post per submitted job, one per worker on stop
+    unsigned long long submitted __attribute__((aligned(CACHE_LINE_SIZE))); //jobs submitted, atomic
+    unsigned long long dropped;                                             //frames not submitted, every job busy
+    unsigned long long taken __attribute__((aligned(CACHE_LINE_SIZE)));     //jobs taken by the workers, atomic
+    unsigned long long completed;                                           //jobs completed, under complete_lock
+    unsigned long long encode_errors;                                       //under complete_lock
+    pthread_mutex_t complete_lock;
+}encode_pool_t;
+
+//APIs
+void encode_pool_init(encode_pool_t *pool, const unsigned int no_of_workers, const int *cores, const unsigned int no_of_cores,
+                      frame_pool_t *frame_pool, const unsigned int width, const unsigned int height, const unsigned int channels,
+                      encode_fn_t encode, complete_fn_t complete, void *arg);
+int encode_pool_submit(encode_pool_t *pool, const frame_t *frame, const unsigned int frame_no);
+void encode_pool_stop(encode_pool_t *pool);
+void encode_pool_destroy(encode_pool_t *pool);
+void encode_pool_report(const encode_pool_t *pool, const char *pool_name);
+
+#endif //_ENCODE_POOL_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,491 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_archive.c
+//
+//  Description: Append-only frame archive. Frames are written back to back into a few large segment files, each
+//               frame behind a small record header, and a compact index (offset, size, time-stamps, sequence) is
+//               appended per frame. Segments are preallocated with fallocate() and written sequentially, so storing
+//               a frame creates no file and barely touches the file system metadata. The next segment is created and
+//               preallocated, and a full one trimmed and closed, by a normal (non RT) helper thread; a rollover in the
+//               store job is a file descriptor swap.
+//               archive_extract writes frames back out as .ppm/.png files
+//
+
+#include "include.h"
+#include "frame_archive.h"
+
+//local functions
+static void *helper_thread_handler(void *args);
+static void start_helper(frame_archive_t *archive);
+static void request_helper(frame_archive_t *archive);
+static int create_segment(frame_archive_t *archive, const unsigned int segment_no);
+static void close_segment(const int fd, const uint64_t size);
+static int write_all(const int fd, const void *data, const size_t size);
+static uint64_t record_size(const uint32_t data_size);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_archive_open
+//
+//  Parameters:     archive - archive to open
+//                  name - archive name, segment and index file names are made from it (existing files are truncated)
+//                  segment_size - preallocated size of a segment, in bytes
+//
+//  Return:         None
+//
+//  Description:    Creates the index and the first segment, and starts the helper thread. Exits the application on
+//                  failure
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_archive_open(frame_archive_t *archive, const char *name, const size_t segment_size)
+{
+    char file_name[FRAME_ARCHIVE_NAME_SIZE + 16];
+    frame_archive_index_header_t header;
+
+    assert(sizeof(frame_archive_segment_header_t) == FRAME_ARCHIVE_RECORD_ALIGN);
+    assert(sizeof(frame_archive_record_t) == FRAME_ARCHIVE_RECORD_ALIGN);
+    assert(sizeof(frame_archive_index_header_t) == 64);
+    assert(sizeof(frame_archive_index_entry_t) == 64);
+
+    memset(archive, 0, sizeof(*archive));
+    strncpy(archive->name, name, sizeof(archive->name) - 1);
+    archive->segment_size = segment_size;
+    archive->segment_fd = -1;
+    archive->next_fd = -1;
+    archive->retired_fd = -1;
+
+    frame_archive_index_name(file_name, sizeof(file_name), archive->name);
+    archive->index_fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 00666);
+    if(archive->index_fd == -1) EXIT_FAIL("open");
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FRAME_ARCHIVE_INDEX_MAGIC, sizeof(header.magic));
+    header.version = FRAME_ARCHIVE_VERSION;
+    header.entry_size = sizeof(frame_archive_index_entry_t);
+    header.segment_size = segment_size;
+    if(write_all(archive->index_fd, &header, sizeof(header))) EXIT_FAIL("write");
+
+    archive->segment_fd = create_segment(archive, 0);
+    archive->offset = sizeof(frame_archive_segment_header_t);
+    archive->bytes = sizeof(frame_archive_segment_header_t);
+
+    start_helper(archive);
+
+    syslog(LOG_WARNING, " frame archive: %s, %zu MB segments", archive->name, segment_size / (1024 * 1024));
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_archive_begin_frame
+//
+//  Parameters:     archive - open archive
+//                  record - frame details, data_size must be exact (magic is filled in)
+//
+//  Return:         Segment file descriptor to write the data_size bytes of frame data to (sequentially, write()/writev()),
+//                  or ERROR (errno is set)
+//
+//  Description:    Moves on to the segment prepared by the helper thread if the frame does not fit in the current one,
+//                  and writes the record header. If the helper has not prepared it yet, the frame is written past the
+//                  segment size instead, nothing is created here. Finish the frame with frame_archive_end_frame()
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int frame_archive_begin_frame(frame_archive_t *archive, const frame_archive_record_t *record)
+{
+    int next_fd;
+
+    if((archive->offset + record_size(record->data_size) > archive->segment_size) &&
+       (archive->offset > sizeof(frame_archive_segment_header_t)))
+    {
+        //a frame larger than the prepare mark asks for the next segment here
+        if(!archive->next_requested) request_helper(archive);
+
+        next_fd = __atomic_load_n(&archive->next_fd, __ATOMIC_ACQUIRE);
+        if((next_fd != -1) && (__atomic_load_n(&archive->retired_fd, __ATOMIC_ACQUIRE) == -1))
+        {
+            //full segment is trimmed and closed by the helper
+            archive->retired_size = archive->offset;
+            __atomic_store_n(&archive->retired_fd, archive->segment_fd, __ATOMIC_RELEASE);
+            __atomic_store_n(&archive->next_fd, -1, __ATOMIC_RELAXED);
+            if(sem_post(&archive->helper_wake)) EXIT_FAIL("sem_post");
+
+            archive->segment_fd = next_fd;
+            ++archive->segment_no;
+            archive->offset = sizeof(frame_archive_segment_header_t);
+            archive->bytes += sizeof(frame_archive_segment_header_t);
+            archive->next_requested = FALSE;
+        }
+        else
+        {
+            ++archive->late_rollovers;
+        }
+    }
+
+    archive->record = *record;
+    archive->record.magic = FRAME_ARCHIVE_RECORD_MAGIC;
+    archive->record_offset = archive->offset;
+
+    if(write_all(archive->segment_fd, &archive->record, sizeof(archive->record))) return ERROR;
+
+    return archive->segment_fd;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_archive_end_frame
+//
+//  Parameters:     archive - archive with a frame begun
+//
+//  Return:         SUCCESS, or ERROR (errno is set, EIO if the data written does not match the record data_size)
+//
+//  Description:    Pads the record to FRAME_ARCHIVE_RECORD_ALIGN, and appends the frame to the index
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int frame_archive_end_frame(frame_archive_t *archive)
+{
+    static const unsigned char padding[FRAME_ARCHIVE_RECORD_ALIGN] = {0};
+    const uint64_t data_end = archive->record_offset + sizeof(frame_archive_record_t) + archive->record.data_size;
+    const uint64_t record_end = archive->record_offset + record_size(archive->record.data_size);
+    frame_archive_index_entry_t entry;
+
+    if(lseek(archive->segment_fd, 0, SEEK_CUR) != (off_t)data_end)
+    {
+        errno = EIO;
+        return ERROR;
+    }
+    if(write_all(archive->segment_fd, padding, record_end - data_end)) return ERROR;
+    archive->offset = record_end;
+
+    //next segment is prepared ahead, off the store thread
+    if(!archive->next_requested && ((archive->offset * 100) >= ((uint64_t)archive->segment_size * FRAME_ARCHIVE_PREPARE_PERCENT)))
+    {
+        request_helper(archive);
+    }
+
+    memset(&entry, 0, sizeof(entry));
+    entry.sequence = archive->record.sequence;
+    entry.capture_nsec = archive->record.capture_nsec;
+    entry.wall_usec = archive->record.wall_usec;
+    entry.source_sequence = archive->record.source_sequence;
+    entry.exposure_nsec = archive->record.exposure_nsec;
+    entry.offset = archive->record_offset;
+    entry.segment_no = archive->segment_no;
+    entry.data_size = archive->record.data_size;
+    entry.frame_no = archive->record.frame_no;
+    entry.format = archive->record.format;
+    if(write_all(archive->index_fd, &entry, sizeof(entry))) return ERROR;
+
+    ++archive->frames;
+    archive->bytes += record_end - archive->record_offset;
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_archive_write_frame
+//
+//  Parameters:     archive - open archive
+//                  record - frame details, see frame_archive_begin_frame()
+//                  data - record->data_size bytes of frame data (encoded file contents)
+//
+//  Return:         SUCCESS/ERROR (errno is set)
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int frame_archive_write_frame(frame_archive_t *archive, const frame_archive_record_t *record, const void *data)
+{
+    const int fd = frame_archive_begin_frame(archive, record);
+
+    if(fd == ERROR) return ERROR;
+    if(write_all(fd, data, record->data_size)) return ERROR;
+
+    return frame_archive_end_frame(archive);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_archive_close
+//
+//  Parameters:     archive - open archive
+//
+//  Return:         None
+//
+//  Description:    Stops the helper thread (a prepared, unused segment is removed), flushes and trims the last segment
+//                  to the data written, flushes the index, and closes the files
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_archive_close(frame_archive_t *archive)
+{
+    __atomic_store_n(&archive->stop_helper, TRUE, __ATOMIC_RELEASE);
+    if(sem_post(&archive->helper_wake)) EXIT_FAIL("sem_post");
+    pthread_join(archive->helper_thread, NULL);
+    sem_destroy(&archive->helper_wake);
+
+    //rolled over segments are left to the normal write back, not flushed in the store job
+    if(fdatasync(archive->segment_fd) || fdatasync(archive->index_fd)) EXIT_FAIL("fdatasync");
+    close_segment(archive->segment_fd, archive->offset);
+    archive->segment_fd = -1;
+
+    if(close(archive->index_fd)) EXIT_FAIL("close");
+    archive->index_fd = -1;
+
+    fprintf(stdout, "\n\n--------------------------------------"
+                     "\n%s frame archive results:"
+                     "\nframes: %llu,"
+                     "\nsegments: %u,"
+                     "\nbytes: %llu,"
+                     "\nsegments not preallocated: %u,"
+                     "\nframes written past the segment size (next segment not ready): %llu"
+                     "\n--------------------------------------",
+                     archive->name, archive->frames, archive->segment_no + 1, archive->bytes, archive->preallocation_failures,
+                     archive->late_rollovers);
+
+    syslog(LOG_WARNING, " frame archive: %s closed, %llu frames in %u segments, %llu bytes",
+           archive->name, archive->frames, archive->segment_no + 1, archive->bytes);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_archive_segment_name, frame_archive_index_name
+//
+//  Parameters:     file_name, size - file name buffer
+//                  name - archive name
+//                  segment_no - segment number
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_archive_segment_name(char *file_name, const size_t size, const char *name, const unsigned int segment_no)
+{
+    snprintf(file_name, size, "%s" FRAME_ARCHIVE_SEGMENT_SUFFIX, name, segment_no);
+}
+
+void frame_archive_index_name(char *file_name, const size_t size, const char *name)
+{
+    snprintf(file_name, size, "%s" FRAME_ARCHIVE_INDEX_SUFFIX, name);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_archive_format_extension
+//
+//  Parameters:     format - FRAME_ARCHIVE_FORMAT_xxx
+//
+//  Return:         File name extension of the format, as in frame_<no>.<extension>
+//
+//------------------------------------------------------------------------------------------------------------------------------
+const char *frame_archive_format_extension(const unsigned int format)
+{
+    if(format == FRAME_ARCHIVE_FORMAT_PNG) return "png";
+    if(format == FRAME_ARCHIVE_FORMAT_DELTA) return "rtd";
+
+    return "ppm";
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  helper_thread_handler
+//
+//  Parameters:     args - archive
+//
+//  Return:         None
+//
+//  Description:    Archive helper thread handler function. On every wake up, trims and closes the segment retired by
+//                  the writer, then creates and preallocates the segment asked for. On close, a prepared segment which
+//                  was never used is removed
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void *helper_thread_handler(void *args)
+{
+    frame_archive_t *archive = (frame_archive_t *)args;
+    char file_name[FRAME_ARCHIVE_NAME_SIZE + 16];
+    unsigned int segment_no;
+    int fd;
+
+    while(1)
+    {
+        while(sem_wait(&archive->helper_wake))
+        {
+            if(errno != EINTR) EXIT_FAIL("sem_wait");
+        }
+
+        fd = __atomic_load_n(&archive->retired_fd, __ATOMIC_ACQUIRE);
+        if(fd != -1)
+        {
+            close_segment(fd, archive->retired_size);
+            __atomic_store_n(&archive->retired_fd, -1, __ATOMIC_RELEASE);
+        }
+
+        if(__atomic_load_n(&archive->stop_helper, __ATOMIC_ACQUIRE)) break;
+
+        segment_no = __atomic_load_n(&archive->prepare_segment_no, __ATOMIC_ACQUIRE);
+        if(segment_no && (__atomic_load_n(&archive->next_fd, __ATOMIC_ACQUIRE) == -1))
+        {
+            fd = create_segment(archive, segment_no);
+            __atomic_store_n(&archive->prepare_segment_no, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&archive->next_fd, fd, __ATOMIC_RELEASE);
+        }
+    }
+
+    fd = __atomic_load_n(&archive->next_fd, __ATOMIC_ACQUIRE);
+    if(fd != -1)
+    {
+        if(close(fd)) EXIT_FAIL("close");
+        frame_archive_segment_name(file_name, sizeof(file_name), archive->name, archive->segment_no + 1);
+        if(unlink(file_name)) EXIT_FAIL("unlink");
+        archive->next_fd = -1;
+    }
+
+    return NULL;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  start_helper
+//
+//  Parameters:     archive - archive, its first segment is open
+//
+//  Return:         None
+//
+//  Description:    Starts the helper thread as a normal (SCHED_OTHER) thread on every core the process may run on.
+//                  The archive is opened from the dispatcher, its RT policy and core are not inherited
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void start_helper(frame_archive_t *archive)
+{
+    pthread_attr_t helper_thread_attr;
+
+    if(sem_init(&archive->helper_wake, 0, 0)) EXIT_FAIL("sem_init");
+
+    assign_normal_schedular_attr(&helper_thread_attr, ALL_CORES);
+    if(pthread_create(&archive->helper_thread, &helper_thread_attr, helper_thread_handler, (void *)archive)) EXIT_FAIL("pthread_create");
+    pthread_attr_destroy(&helper_thread_attr);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  request_helper
+//
+//  Parameters:     archive - open archive (writer only)
+//
+//  Return:         None
+//
+//  Description:    Asks the helper thread for the segment after the current one
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void request_helper(frame_archive_t *archive)
+{
+    __atomic_store_n(&archive->prepare_segment_no, archive->segment_no + 1, __ATOMIC_RELEASE);
+    archive->next_requested = TRUE;
+    if(sem_post(&archive->helper_wake)) EXIT_FAIL("sem_post");
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  create_segment
+//
+//  Parameters:     archive - archive
+//                  segment_no - segment to create
+//
+//  Return:         Segment file descriptor, at the end of the segment header
+//
+//  Description:    Creates the segment, preallocates segment_size bytes, and writes the segment header.
+//                  File systems without fallocate() support get a sparse, growing segment instead
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int create_segment(frame_archive_t *archive, const unsigned int segment_no)
+{
+    char file_name[FRAME_ARCHIVE_NAME_SIZE + 16];
+    frame_archive_segment_header_t header;
+    int fd;
+
+    frame_archive_segment_name(file_name, sizeof(file_name), archive->name, segment_no);
+    fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 00666);
+    if(fd == -1) EXIT_FAIL("open");
+
+    //blocks allocated up front, frame writes do not extend the file
+    if(fallocate(fd, 0, 0, archive->segment_size))
+    {
+        if(!archive->preallocation_failures++)
+        {
+            syslog(LOG_WARNING, " frame archive: %s not preallocated, %s", file_name, strerror(errno));
+        }
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FRAME_ARCHIVE_SEGMENT_MAGIC, sizeof(header.magic));
+    header.version = FRAME_ARCHIVE_VERSION;
+    header.segment_no = segment_no;
+    header.record_header_size = sizeof(frame_archive_record_t);
+    if(write_all(fd, &header, sizeof(header))) EXIT_FAIL("write");
+
+    return fd;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  close_segment
+//
+//  Parameters:     fd - segment file descriptor
+//                  size - data written to the segment
+//
+//  Return:         None
+//
+//  Description:    Gives the preallocated space after the last record back, and closes the segment
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void close_segment(const int fd, const uint64_t size)
+{
+    if(ftruncate(fd, size)) EXIT_FAIL("ftruncate");
+    if(close(fd)) EXIT_FAIL("close");
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  write_all
+//
+//  Parameters:     fd - file descriptor
+//                  data, size - data to write at the current file offset
+//
+//  Return:         SUCCESS/ERROR (errno is set)
+//
+//  Description:    write() until every byte is written
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int write_all(const int fd, const void *data, const size_t size)
+{
+    ssize_t written;
+    size_t offset = 0;
+
+    while(offset < size)
+    {
+        written = write(fd, (const char *)data + offset, size - offset);
+        if(written == -1)
+        {
+            if(errno == EINTR) continue;
+            return ERROR;
+        }
+        offset += written;
+    }
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  record_size
+//
+//  Parameters:     data_size - frame data size
+//
+//  Return:         Record size in the segment, header and padding included
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static uint64_t record_size(const uint32_t data_size)
+{
+    const uint64_t size = sizeof(frame_archive_record_t) + (uint64_t)data_size;
+
+    return (size + FRAME_ARCHIVE_RECORD_ALIGN - 1) & ~((uint64_t)FRAME_ARCHIVE_RECORD_ALIGN - 1);
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,139 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_archive.h
+//
+//  Description: Header file for frame_archive.c, and the archive file formats
+//
+
+#ifndef _FRAME_ARCHIVE_H
+#define _FRAME_ARCHIVE_H
+
+#include "include.h"
+#include <semaphore.h>
+#include <stdint.h>
+
+//archive "<name>": segments "<name>_000.seg", "<name>_001.seg", ..., and index "<name>.idx"
+#define FRAME_ARCHIVE_SEGMENT_SUFFIX    "_%03u.seg"
+#define FRAME_ARCHIVE_INDEX_SUFFIX      ".idx"
+#define FRAME_ARCHIVE_NAME_SIZE         (256)
+
+#define FRAME_ARCHIVE_SEGMENT_MAGIC     "RTFSEG01"
+#define FRAME_ARCHIVE_INDEX_MAGIC       "RTFIDX01"
+#define FRAME_ARCHIVE_RECORD_MAGIC      (0x314D5246) //"FRM1"
+#define FRAME_ARCHIVE_VERSION           (2)
+
+//segments are preallocated with this size, and trimmed to the data written when closed
+//a frame larger than a segment gets a segment of its own
+#define DEFAULT_FRAME_ARCHIVE_SEGMENT_MB    (256)
+#define MIN_FRAME_ARCHIVE_SEGMENT_MB        (16)
+#define MAX_FRAME_ARCHIVE_SEGMENT_MB        (4096)
+
+//next segment is created and preallocated by the archive helper thread once the current one is this full
+#define FRAME_ARCHIVE_PREPARE_PERCENT   (50)
+
+//records start on this boundary in the segments
+#define FRAME_ARCHIVE_RECORD_ALIGN      (64)
+
+//frame data formats, same values as OUTPUT_FORMAT_xxx
+#define FRAME_ARCHIVE_FORMAT_PPM        (0) //complete .ppm file (P6 header and RGB pixels)
+#define FRAME_ARCHIVE_FORMAT_PNG        (1) //complete .png file
+#define FRAME_ARCHIVE_FORMAT_DELTA      (2) //complete .rtd file (see tile_delta.h), needs the frames before it
+
+//first bytes of a segment, 64 bytes
+typedef struct
+{
+    char magic[8];                  //FRAME_ARCHIVE_SEGMENT_MAGIC
+    uint32_t version;
+    uint32_t segment_no;
+    uint32_t record_header_size;
+    uint8_t reserved[44];
+}frame_archive_segment_header_t;
+
+//in front of every frame in a segment, 64 bytes, so a segment can be read (or the index rebuilt) without the index
+typedef struct
+{
+    uint32_t magic;                 //FRAME_ARCHIVE_RECORD_MAGIC
+    uint16_t format;                //FRAME_ARCHIVE_FORMAT_xxx
+    uint16_t channels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frame_no;
+    uint32_t data_size;             //frame data after this header, record is padded to FRAME_ARCHIVE_RECORD_ALIGN
+    uint64_t sequence;              //frame ring sequence
+    uint64_t capture_nsec;          //CLOCK_MONOTONIC
+    uint64_t wall_usec;             //wall clock, micro seconds since the epoch
+    uint64_t source_sequence;       //driver buffer sequence (V4L2), frames read by the source otherwise
+    uint64_t exposure_nsec;         //CLOCK_MONOTONIC, driver buffer time-stamp (V4L2), capture_nsec otherwise
+}frame_archive_record_t;
+
+//first bytes of the index, 64 bytes
+typedef struct
+{
+    char magic[8];                  //FRAME_ARCHIVE_INDEX_MAGIC
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t segment_size;          //preallocated size of a segment
+    uint8_t reserved[40];
+}frame_archive_index_header_t;
+
+//one per frame, in store order, 64 bytes
+typedef struct
+{
+    uint64_t sequence;
+    uint64_t capture_nsec;
+    uint64_t wall_usec;
+    uint64_t source_sequence;
+    uint64_t exposure_nsec;
+    uint64_t offset;                //record header offset in the segment
+    uint32_t segment_no;
+    uint32_t data_size;
+    uint32_t frame_no;
+    uint16_t format;
+    uint16_t reserved;
+}frame_archive_index_entry_t;
+
+//archive being written
+//segment files are created, preallocated, trimmed and closed by a normal (non RT) helper thread, the writer (store
+//thread) only swaps file descriptors. Fields marked helper are handed over with helper_wake and atomics
+typedef struct
+{
+    char name[FRAME_ARCHIVE_NAME_SIZE];
+    size_t segment_size;
+    int segment_fd;
+    int index_fd;
+    unsigned int segment_no;
+    uint64_t offset;                //next record offset in the segment
+    frame_archive_record_t record;  //record being written, see frame_archive_begin_frame()
+    uint64_t record_offset;
+    unsigned long long frames;
+    unsigned long long bytes;       //segment bytes, headers and padding included
+    unsigned int preallocation_failures;    //helper
+    unsigned long long late_rollovers;      //frames written past the segment size, the next segment was not ready
+
+    //helper thread
+    pthread_t helper_thread;
+    sem_t helper_wake;              //posted by the writer for every request, and on close
+    int next_requested;             //writer only, the next segment is asked for
+    unsigned int prepare_segment_no;//helper, segment to create and preallocate, 0 if none
+    int next_fd;                    //helper, prepared segment with its header written, -1 if none
+    int retired_fd;                 //helper, full segment to trim to retired_size and close, -1 if none
+    uint64_t retired_size;
+    int stop_helper;
+}frame_archive_t;
+
+//APIs
+void frame_archive_open(frame_archive_t *archive, const char *name, const size_t segment_size);
+int frame_archive_begin_frame(frame_archive_t *archive, const frame_archive_record_t *record);
+int frame_archive_end_frame(frame_archive_t *archive);
+int frame_archive_write_frame(frame_archive_t *archive, const frame_archive_record_t *record, const void *data);
+void frame_archive_close(frame_archive_t *archive);
+void frame_archive_segment_name(char *file_name, const size_t size, const char *name, const unsigned int segment_no);
+void frame_archive_index_name(char *file_name, const size_t size, const char *name);
+const char *frame_archive_format_extension(const unsigned int format);
+
+#endif //_FRAME_ARCHIVE_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,208 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_pool.c
+//
+//  Description: Pool of frame buffers, allocated once at startup. Buffers are page aligned, prefaulted and locked in
+//               memory, so borrowing them in the RT threads never faults or calls malloc. The free list is a lock-free
+//               stack with an ABA tag, so frame_pool_get()/frame_pool_put() never block.
+//
+
+#include "include.h"
+#include <sys/mman.h>
+#include "frame_pool.h"
+
+//2 MB huge pages
+#define HUGE_PAGE_SIZE  (2 * 1024 * 1024)
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_pool_init
+//
+//  Parameters:     pool - pool to initialize
+//                  no_of_buffers - no.of frame buffers
+//                  buffer_size - size of each buffer, in bytes
+//                  backing - FRAME_POOL_NORMAL_PAGES or FRAME_POOL_HUGE_PAGES
+//
+//  Return:         None
+//
+//  Description:    Maps, prefaults, and locks memory for all the buffers
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_pool_init(frame_pool_t *pool, const unsigned int no_of_buffers, const size_t buffer_size, const int backing)
+{
+    unsigned int i;
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+
+    assert(no_of_buffers > 0);
+
+    memset(pool, 0, sizeof(*pool));
+    pool->no_of_buffers = no_of_buffers;
+    pool->buffer_size = (buffer_size + page_size - 1) & ~(page_size - 1);
+    pool->memory_size = pool->buffer_size * no_of_buffers;
+    pool->memory = (unsigned char *)MAP_FAILED;
+
+    if(backing == FRAME_POOL_HUGE_PAGES)
+    {
+        pool->memory_size = (pool->memory_size + HUGE_PAGE_SIZE - 1) & ~((size_t)HUGE_PAGE_SIZE - 1);
+        pool->memory = (unsigned char *)mmap(NULL, pool->memory_size, PROT_READ | PROT_WRITE,
+                                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+        if(pool->memory == MAP_FAILED)
+        {
+            syslog(LOG_WARNING, " frame pool: no huge pages available (%s), using normal pages", strerror(errno));
+            pool->memory_size = pool->buffer_size * no_of_buffers;
+        }
+        else
+        {
+            pool->huge_pages = TRUE;
+        }
+    }
+
+    if(pool->memory == MAP_FAILED)
+    {
+        pool->memory = (unsigned char *)mmap(NULL, pool->memory_size, PROT_READ | PROT_WRITE,
+                                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if(pool->memory == MAP_FAILED) EXIT_FAIL("mmap");
+    }
+
+    //touch every page, then keep them resident
+    memset(pool->memory, 0, pool->memory_size);
+    if(mlock(pool->memory, pool->memory_size)) EXIT_FAIL("mlock");
+
+    //all the buffers are free
+    pool->next_free = (unsigned int *)malloc(no_of_buffers * sizeof(*pool->next_free));
+    if(!pool->next_free) EXIT_FAIL("malloc");
+    for(i = 0; i < no_of_buffers; ++i)
+    {
+        pool->next_free[i] = i + 2; //index + 1 of the next buffer
+    }
+    pool->next_free[no_of_buffers - 1] = 0;
+    pool->free_head = 1;
+
+    syslog(LOG_WARNING, " frame pool: %u buffers of %zu bytes, %zu bytes locked%s",
+           no_of_buffers, pool->buffer_size, pool->memory_size, pool->huge_pages ? " (huge pages)" : "");
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_pool_destroy
+//
+//  Parameters:     pool - initialized pool, all the buffers must have been returned
+//
+//  Return:         None
+//
+//  Description:    Unlocks and unmaps the pool memory
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_pool_destroy(frame_pool_t *pool)
+{
+    if(pool->in_use)
+    {
+        syslog(LOG_WARNING, " frame pool: destroyed with %u buffers in use", pool->in_use);
+    }
+
+    munlock(pool->memory, pool->memory_size);
+    if(munmap(pool->memory, pool->memory_size)) EXIT_FAIL("munmap");
+    free(pool->next_free);
+
+    pool->memory = NULL;
+    pool->next_free = NULL;
+    pool->no_of_buffers = 0;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_pool_get
+//
+//  Parameters:     pool - frame pool
+//
+//  Return:         Free buffer of pool->buffer_size bytes, NULL if all the buffers are in use
+//
+//  Description:    Borrows a buffer, lock-free
+//
+//------------------------------------------------------------------------------------------------------------------------------
+unsigned char *frame_pool_get(frame_pool_t *pool)
+{
+    unsigned long long head, new_head;
+    unsigned int idx, in_use, max_in_use;
+
+    head = __atomic_load_n(&pool->free_head, __ATOMIC_ACQUIRE);
+    do
+    {
+        idx = (unsigned int)head;
+        if(!idx)
+        {
+            __atomic_add_fetch(&pool->exhausted, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+
+        //new tag, so a concurrent get/put of the same buffer fails the compare
+        new_head = (((head >> 32) + 1) << 32) | __atomic_load_n(&pool->next_free[idx - 1], __ATOMIC_RELAXED);
+    } while(!__atomic_compare_exchange_n(&pool->free_head, &head, new_head, TRUE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    in_use = __atomic_add_fetch(&pool->in_use, 1, __ATOMIC_RELAXED);
+    max_in_use = __atomic_load_n(&pool->max_in_use, __ATOMIC_RELAXED);
+    while((in_use > max_in_use) &&
+          !__atomic_compare_exchange_n(&pool->max_in_use, &max_in_use, in_use, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    return pool->memory + ((size_t)(idx - 1) * pool->buffer_size);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_pool_put
+//
+//  Parameters:     pool - frame pool
+//                  buffer - buffer returned by frame_pool_get() on the same pool
+//
+//  Return:         None
+//
+//  Description:    Returns a buffer, lock-free
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_pool_put(frame_pool_t *pool, unsigned char *buffer)
+{
+    unsigned long long head, new_head;
+    const unsigned int idx = ((buffer - pool->memory) / pool->buffer_size) + 1;
+
+    assert((buffer >= pool->memory) && (idx <= pool->no_of_buffers));
+
+    head = __atomic_load_n(&pool->free_head, __ATOMIC_RELAXED);
+    do
+    {
+        __atomic_store_n(&pool->next_free[idx - 1], (unsigned int)head, __ATOMIC_RELAXED);
+        new_head = (((head >> 32) + 1) << 32) | idx;
+    } while(!__atomic_compare_exchange_n(&pool->free_head, &head, new_head, TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    __atomic_sub_fetch(&pool->in_use, 1, __ATOMIC_RELAXED);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_pool_report
+//
+//  Parameters:     pool - frame pool
+//                  pool_name - printed along with the results
+//
+//  Return:         None
+//
+//  Description:    Prints and logs the pool usage, used for sizing the pool
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_pool_report(const frame_pool_t *pool, const char *pool_name)
+{
+    fprintf(stdout, "\n\n--------------------------------------"
+                     "\n%s frame pool results:"
+                     "\nbuffers: %u x %zu bytes%s,"
+                     "\nmax buffers in use: %u,"
+                     "\nrequests with no free buffer: %llu"
+                     "\n--------------------------------------",
+                     pool_name, pool->no_of_buffers, pool->buffer_size, pool->huge_pages ? " (huge pages)" : "",
+                     pool->max_in_use, pool->exhausted);
+
+    syslog(LOG_WARNING," %s frame pool: %u x %zu bytes, max in use %u, exhausted %llu",
+           pool_name, pool->no_of_buffers, pool->buffer_size, pool->max_in_use, pool->exhausted);
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
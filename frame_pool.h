@@ -0,0 +1,45 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_pool.h
+//
+//  Description: Header file for frame_pool.c
+//
+
+#ifndef _FRAME_POOL_H
+#define _FRAME_POOL_H
+
+#include "include.h"
+#include <stddef.h>
+
+//frame pool backing
+#define FRAME_POOL_NORMAL_PAGES     (0)
+#define FRAME_POOL_HUGE_PAGES       (1) //falls back to normal pages if no huge pages are reserved
+
+//fixed size, page aligned, prefaulted and locked frame buffers
+typedef struct
+{
+    unsigned char *memory;          //one mapping for all the buffers
+    size_t memory_size;
+    size_t buffer_size;             //rounded up to the page size
+    unsigned int no_of_buffers;
+    unsigned int *next_free;        //free list links, atomic
+    unsigned long long free_head;   //ABA tag (upper 32 bits), free buffer index + 1 (lower 32 bits), atomic
+    int huge_pages;                 //TRUE if backed by huge pages
+    unsigned int in_use;            //atomic
+    unsigned int max_in_use;        //atomic
+    unsigned long long exhausted;   //frame_pool_get() calls with no free buffer, atomic
+}frame_pool_t;
+
+//APIs
+void frame_pool_init(frame_pool_t *pool, const unsigned int no_of_buffers, const size_t buffer_size, const int backing);
+void frame_pool_destroy(frame_pool_t *pool);
+unsigned char *frame_pool_get(frame_pool_t *pool);
+void frame_pool_put(frame_pool_t *pool, unsigned char *buffer);
+void frame_pool_report(const frame_pool_t *pool, const char *pool_name);
+
+#endif //_FRAME_POOL_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
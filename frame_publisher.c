@@ -0,0 +1,224 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_publisher.c
+//
+//  Description: Publishes captured frames into a POSIX shared memory frame ring (see frame_shm.h), for analytics
+//               processes mapping them read-only with frame_subscriber.c. The publisher never waits for a consumer:
+//               every slot has a seqlock generation, consumers find out themselves if a frame was overwritten while
+//               they used it, and a futex wake is only made while a consumer is waiting
+//
+
+#include "include.h"
+#include "frame_publisher.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_publisher_open
+//
+//  Parameters:     publisher - publisher to initialize
+//                  name - shared memory object name, a '/' is prepended if missing
+//                  no_of_slots - MIN_FRAME_SHM_SLOTS to MAX_FRAME_SHM_SLOTS
+//                  width, height, channels - frame resolution
+//                  interval - every interval-th offered frame is published
+//                  camera - camera number, for the consumers
+//
+//  Return:         None
+//
+//  Description:    Creates (or replaces) the shared memory object, sized for the slots, and maps it. Every page is
+//                  touched here, so publishing does not fault (the mapping is locked by lock_process_memory())
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_publisher_open(frame_publisher_t *publisher, const char *name, const unsigned int no_of_slots, const unsigned int width,
+                          const unsigned int height, const unsigned int channels, const unsigned int interval, const unsigned int camera)
+{
+    int fd;
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    const size_t step = (size_t)width * channels;
+    const size_t slot_size = (((step * height) + page_size - 1) / page_size) * page_size;
+    const size_t frames_offset = (((sizeof(frame_shm_header_t) + (no_of_slots * sizeof(frame_shm_slot_t))) + page_size - 1) / page_size) * page_size;
+
+    assert((no_of_slots >= MIN_FRAME_SHM_SLOTS) && (no_of_slots <= MAX_FRAME_SHM_SLOTS));
+    assert((interval >= MIN_FRAME_PUBLISH_INTERVAL) && (interval <= MAX_FRAME_PUBLISH_INTERVAL));
+
+    memset(publisher, 0, sizeof(*publisher));
+    snprintf(publisher->name, sizeof(publisher->name), "%s%s", (name[0] == '/') ? "" : "/", name);
+    publisher->size = frames_offset + (no_of_slots * slot_size);
+    publisher->interval = interval;
+    histogram_reset(&publisher->publish_time);
+
+    //a new object, consumers still mapping the one of an earlier run keep it
+    //consumers open it read-write for the waiters count only, see frame_subscriber_open()
+    shm_unlink(publisher->name);
+    fd = shm_open(publisher->name, O_RDWR | O_CREAT | O_EXCL, 00666);
+    if(fd == -1) EXIT_FAIL("shm_open");
+    if(ftruncate(fd, publisher->size)) EXIT_FAIL("ftruncate");
+    publisher->memory = (unsigned char *)mmap(NULL, publisher->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(publisher->memory == MAP_FAILED) EXIT_FAIL("mmap");
+    close(fd);
+
+    //fault every page in now
+    memset(publisher->memory, 0, publisher->size);
+
+    publisher->header = (frame_shm_header_t *)publisher->memory;
+    publisher->slots = (frame_shm_slot_t *)(publisher->header + 1);
+    publisher->frames = publisher->memory + frames_offset;
+
+    publisher->header->width = width;
+    publisher->header->height = height;
+    publisher->header->channels = channels;
+    publisher->header->no_of_slots = no_of_slots;
+    publisher->header->step = step;
+    publisher->header->slot_size = slot_size;
+    publisher->header->frames_offset = frames_offset;
+    publisher->header->camera = camera;
+    publisher->header->publish_interval = interval;
+    publisher->header->state = FRAME_SHM_STATE_OPEN;
+
+    //consumers check the magic last
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(publisher->header->magic, FRAME_SHM_MAGIC, sizeof(publisher->header->magic));
+
+    syslog(LOG_WARNING, " frame publisher: %s, %u slots of %ux%u, every %u frames, %zu bytes", publisher->name, no_of_slots,
+           width, height, interval, publisher->size);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_publisher_close
+//
+//  Parameters:     publisher - opened publisher, the publishing thread must have exited
+//
+//  Return:         None
+//
+//  Description:    Marks the ring closed and wakes the waiting consumers, then unmaps and unlinks the object. Consumers
+//                  which mapped it keep their mapping until they close it
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_publisher_close(frame_publisher_t *publisher)
+{
+    if(!publisher->memory) return;
+
+    __atomic_store_n(&publisher->header->state, FRAME_SHM_STATE_CLOSED, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&publisher->header->notify, 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, &publisher->header->notify, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+
+    munmap(publisher->memory, publisher->size);
+    shm_unlink(publisher->name);
+    publisher->memory = NULL;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_publisher_offer
+//
+//  Parameters:     publisher - opened publisher (publishing thread only)
+//                  frame - captured frame, with the ring resolution
+//
+//  Return:         TRUE if the frame was published, FALSE if it is skipped (publish interval)
+//
+//  Description:    Copies the frame into the next slot inside its seqlock, moves the head, and bumps the futex word.
+//                  The futex wake (a system call) is made only if a consumer is waiting
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int frame_publisher_offer(frame_publisher_t *publisher, const frame_t *frame)
+{
+    frame_shm_header_t *header = publisher->header;
+    frame_shm_slot_t *slot;
+    unsigned char *data;
+    unsigned long long sequence, generation;
+    unsigned int row;
+    struct timespec start_time, end_time;
+
+    if((publisher->offered++ % publisher->interval) != 0) return FALSE;
+
+    assert((frame->width == header->width) && (frame->height == header->height) && (frame->channels == header->channels));
+
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    //head and generations are written by the publisher only
+    sequence = header->head + 1;
+    slot = &publisher->slots[(sequence - 1) % header->no_of_slots];
+    data = publisher->frames + (((sequence - 1) % header->no_of_slots) * header->slot_size);
+    generation = slot->generation;
+
+    //odd generation before any byte of the slot changes
+    __atomic_store_n(&slot->generation, generation + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if(frame->step == header->step)
+    {
+        memcpy(data, frame->data, header->step * header->height);
+    }
+    else
+    {
+        for(row = 0; row < header->height; ++row)
+        {
+            memcpy(data + (row * header->step), frame->data + (row * frame->step), header->step);
+        }
+    }
+    slot->sequence = sequence;
+    slot->frame_sequence = frame->sequence;
+    slot->capture_nsec = ((unsigned long long)frame->capture_time.tv_sec * NSEC_PER_SEC) + frame->capture_time.tv_nsec;
+    slot->wall_sec = frame->wall_time.tv_sec;
+    slot->wall_usec = frame->wall_time.tv_usec;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    slot->publish_nsec = ((unsigned long long)end_time.tv_sec * NSEC_PER_SEC) + end_time.tv_nsec;
+
+    //even again, then visible through the head
+    __atomic_store_n(&slot->generation, generation + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->head, sequence, __ATOMIC_RELEASE);
+
+    //consumers count themselves in before reading notify (see frame_subscriber_wait()), so either they see the new
+    //notify value, or the publisher sees them waiting
+    __atomic_add_fetch(&header->notify, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&header->waiters, __ATOMIC_SEQ_CST))
+    {
+        syscall(SYS_futex, &header->notify, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+        ++publisher->wakes;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    histogram_record(&publisher->publish_time, ((unsigned long long)(end_time.tv_sec - start_time.tv_sec) * NSEC_PER_SEC) +
+                                               end_time.tv_nsec - start_time.tv_nsec);
+
+    return TRUE;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_publisher_report
+//
+//  Parameters:     publisher - publisher, the publishing thread must have exited
+//                  publisher_name - printed along with the results
+//
+//  Return:         None
+//
+//  Description:    Prints and logs the published frames and the publish time distribution
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_publisher_report(const frame_publisher_t *publisher, const char *publisher_name)
+{
+    fprintf(stdout, "\n\n--------------------------------------"
+                     "\n%s shared memory results (%s):"
+                     "\noffered frames: %llu, published frames: %llu,"
+                     "\npublishes waking consumers: %llu,"
+                     "\npublish time: p50 %.1lf us, p99 %.1lf us, max %.1lf us"
+                     "\n--------------------------------------",
+                     publisher_name, publisher->name, publisher->offered, histogram_count(&publisher->publish_time), publisher->wakes,
+                     (double)histogram_percentile(&publisher->publish_time, 50.0) / NSEC_PER_USEC,
+                     (double)histogram_percentile(&publisher->publish_time, 99.0) / NSEC_PER_USEC,
+                     (double)histogram_max(&publisher->publish_time) / NSEC_PER_USEC);
+
+    syslog(LOG_WARNING, " %s shared memory %s: offered %llu, published %llu, wakes %llu, publish time p99 %llu ns",
+           publisher_name, publisher->name, publisher->offered, histogram_count(&publisher->publish_time), publisher->wakes,
+           histogram_percentile(&publisher->publish_time, 99.0));
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
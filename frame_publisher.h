@@ -0,0 +1,51 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_publisher.h
+//
+//  Description: Header file for frame_publisher.c
+//
+
+#ifndef _FRAME_PUBLISHER_H
+#define _FRAME_PUBLISHER_H
+
+#include "frame_ring.h"
+#include "frame_shm.h"
+#include "histogram.h"
+#include "include.h"
+#include <stddef.h>
+
+//POSIX shared memory object name, '/' and the -M name, followed by the camera number with more than one camera
+#define FRAME_PUBLISHER_NAME_SIZE   (64)
+
+//publish every n-th captured frame (-I)
+#define MIN_FRAME_PUBLISH_INTERVAL  (1)
+#define MAX_FRAME_PUBLISH_INTERVAL  (1000)
+
+//shared memory frame ring of one camera, single publisher (query_frames_thread)
+typedef struct
+{
+    char name[FRAME_PUBLISHER_NAME_SIZE];
+    size_t size;                        //object size
+    unsigned char *memory;              //mapping of the whole object
+    frame_shm_header_t *header;
+    frame_shm_slot_t *slots;
+    unsigned char *frames;
+    unsigned int interval;
+    unsigned long long offered;         //frames offered, every interval-th one is published
+    unsigned long long wakes;           //publishes with waiting consumers (futex wake)
+    histogram_t publish_time;           //frame copy into the slot, and the notification
+}frame_publisher_t;
+
+//APIs
+void frame_publisher_open(frame_publisher_t *publisher, const char *name, const unsigned int no_of_slots, const unsigned int width,
+                          const unsigned int height, const unsigned int channels, const unsigned int interval, const unsigned int camera);
+void frame_publisher_close(frame_publisher_t *publisher);
+int frame_publisher_offer(frame_publisher_t *publisher, const frame_t *frame);
+void frame_publisher_report(const frame_publisher_t *publisher, const char *publisher_name);
+
+#endif //_FRAME_PUBLISHER_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
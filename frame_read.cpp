@@ -0,0 +1,558 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_read.cpp
+//
+//  Description: Command line front end of frame_reader.c. Lists, exports or streams the frames stored by main, from a
+//               frame archive (-a) or a frame directory. Frames are selected by capture time (binary search of the
+//               index) and decoded by a thread per core. Streams are raw RGB24 frames in frame order, .ppm frames are
+//               written straight from the mapped archive/file, only .png frames are decoded, and delta frames (.rtd)
+//               rebuilt from their keyframe
+//
+//               Usage: ./frame_read [options] <archive name | frame directory> <list | export <dir> | stream>
+//
+
+#include "include.h"
+#include "frame_reader.h"
+#include "ppm_writer.h"
+#include "utilities.h"
+#include <sys/mman.h>
+
+//cpp namespaces
+using namespace cv;
+using namespace std;
+
+//frames decoded per thread, before a stream batch is written out in order
+#define STREAM_BATCH_FRAMES_PER_THREAD  (4)
+
+//frame_read command
+#define FRAME_READ_LIST     (0)
+#define FRAME_READ_EXPORT   (1)
+#define FRAME_READ_STREAM   (2)
+
+//selected frames, and the export/stream state shared by the frame_reader_for_each() threads
+typedef struct
+{
+    size_t first;                       //first selected frame index
+    size_t end;
+    size_t step;
+    size_t no_of_frames;                //selected
+    unsigned int width;                 //stream resolution, every frame must have it
+    unsigned int height;
+    size_t frame_size;                  //RGB24 bytes per frame
+    const char *export_dir;
+    //stream batch, frames batch_first .. batch_first + batch_size - 1 of the selection
+    size_t batch_first;
+    size_t batch_size;
+    frame_reader_frame_t *batch_maps;   //.ppm frames kept mapped until written (zero copy)
+    const unsigned char **batch_pixels; //RGB24 frame to write, mapped or decoded
+    unsigned char *batch_buffers;       //decoded .png frames
+    frame_reader_shm_header_t *shm;     //-m, frames are written into the shared memory object instead
+    unsigned char *shm_frames;
+    unsigned char *scratch[MAX_FRAME_READER_THREADS];   //export: BGR to RGB swap buffer per thread
+    frame_reader_delta_t deltas[MAX_FRAME_READER_THREADS];  //delta frames rebuilt per thread
+}frame_read_t;
+
+//local functions
+static int list_frames(frame_reader_t *reader, frame_read_t *job);
+static int export_frame(frame_reader_t *reader, const size_t idx, const unsigned int thread_idx, void *arg);
+static int stream_frames(frame_reader_t *reader, frame_read_t *job, const unsigned int no_of_threads, const char *shm_name);
+static int stream_frame(frame_reader_t *reader, const size_t idx, const unsigned int thread_idx, void *arg);
+static int decode_frame(const frame_reader_t *reader, const size_t idx, const unsigned int thread_idx, frame_read_t *job,
+                        const frame_reader_frame_t *frame, Mat &decoded);
+static int decode_png_frame(const frame_reader_t *reader, const size_t idx, const frame_reader_frame_t *frame, Mat &decoded);
+static int write_all(const int fd, const void *data, const size_t size);
+static void print_usage(FILE *fp);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  main
+//
+//  Parameters:     Command-line args, see print_usage()
+//
+//  Return:         EXIT_SUCCESS, or EXIT_FAILURE on bad arguments, or a bad or damaged archive/frame
+//
+//  Description:    Opens the stored frames, selects them by capture time and step, and runs the command.
+//                  Reports go to stderr, stdout may carry the stream
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    frame_reader_t reader;
+    frame_read_t job;
+    int option, command, rc = SUCCESS;
+    unsigned int no_of_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    double begin_sec = -1, end_sec = -1;
+    const char *shm_name = NULL;
+    struct timespec start_time, end_time;
+    double elapsed_sec;
+    unsigned int i;
+
+    memset(&job, 0, sizeof(job));
+    job.step = 1;
+
+    while((option = getopt(argc, argv, "b:e:hj:m:s:")) != -1)
+    {
+        switch(option)
+        {
+            case 'b':
+            begin_sec = atof(optarg);
+            break;
+
+            case 'e':
+            end_sec = atof(optarg);
+            break;
+
+            case 'j':
+            no_of_threads = atoi(optarg);
+            break;
+
+            case 'm':
+            shm_name = optarg;
+            break;
+
+            case 's':
+            job.step = atoi(optarg);
+            //boundary checks
+            if(job.step < 1)
+            {
+                job.step = 1;
+                fprintf(stderr, "Resetting step to 1 (Min allowed)!\n");
+            }
+            break;
+
+            case 'h':
+            print_usage(stdout);
+            return EXIT_SUCCESS;
+
+            default:
+            print_usage(stderr);
+            return EXIT_FAILURE;
+        }
+    }
+
+    //boundary checks
+    if(no_of_threads < 1)
+    {
+        no_of_threads = 1;
+        fprintf(stderr, "Resetting no.of threads to 1 (Min allowed)!\n");
+    }
+    else if(no_of_threads > MAX_FRAME_READER_THREADS)
+    {
+        no_of_threads = MAX_FRAME_READER_THREADS;
+        fprintf(stderr, "Resetting no.of threads to %d (Max allowed)!\n", MAX_FRAME_READER_THREADS);
+    }
+
+    if((argc - optind) < 2) command = ERROR;
+    else if(!strcmp(argv[optind + 1], "list")) command = FRAME_READ_LIST;
+    else if(!strcmp(argv[optind + 1], "export") && ((argc - optind) == 3)) command = FRAME_READ_EXPORT;
+    else if(!strcmp(argv[optind + 1], "stream")) command = FRAME_READ_STREAM;
+    else command = ERROR;
+    if(command == ERROR)
+    {
+        print_usage(stderr);
+        return EXIT_FAILURE;
+    }
+
+    if(frame_reader_open(&reader, argv[optind])) return EXIT_FAILURE;
+
+    //capture time range, binary search of the index
+    job.first = (begin_sec < 0) ? 0 : frame_reader_find(&reader, (uint64_t)(begin_sec * USEC_PER_SEC));
+    job.end = (end_sec < 0) ? reader.no_of_entries : frame_reader_find(&reader, (uint64_t)(end_sec * USEC_PER_SEC));
+    job.no_of_frames = (job.end > job.first) ? ((job.end - job.first + job.step - 1) / job.step) : 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    if(command == FRAME_READ_LIST)
+    {
+        rc = list_frames(&reader, &job);
+    }
+    else if(command == FRAME_READ_EXPORT)
+    {
+        job.export_dir = argv[optind + 2];
+        if(mkdir(job.export_dir, 00777) && (errno != EEXIST)) EXIT_FAIL("mkdir");
+        rc = frame_reader_for_each(&reader, job.first, job.end, job.step, no_of_threads, export_frame, &job);
+        for(i = 0; i < MAX_FRAME_READER_THREADS; ++i)
+        {
+            free(job.scratch[i]);
+        }
+    }
+    else
+    {
+        rc = stream_frames(&reader, &job, no_of_threads, shm_name);
+    }
+
+    for(i = 0; i < MAX_FRAME_READER_THREADS; ++i)
+    {
+        frame_reader_delta_free(&job.deltas[i]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    elapsed_sec = (end_time.tv_sec - start_time.tv_sec) + ((double)(end_time.tv_nsec - start_time.tv_nsec) / NSEC_PER_SEC);
+
+    if(command != FRAME_READ_LIST)
+    {
+        fprintf(stderr, "%s %zu of %zu frames with %u threads: %.3lf sec, %.1lf frames/sec\n",
+                (command == FRAME_READ_EXPORT) ? "exported" : "streamed", job.no_of_frames, reader.no_of_entries, no_of_threads,
+                elapsed_sec, elapsed_sec ? (job.no_of_frames / elapsed_sec) : 0.0);
+    }
+
+    frame_reader_close(&reader);
+
+    return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  list_frames
+//
+//  Parameters:     reader - open reader
+//                  job - selected frames
+//
+//  Return:         SUCCESS
+//
+//  Description:    One line per selected frame, from the index only (no frame data is read)
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int list_frames(frame_reader_t *reader, frame_read_t *job)
+{
+    size_t idx;
+    const frame_archive_index_entry_t *entry;
+
+    fprintf(stdout, "%-10s %-10s %-10s %-20s %-6s %-10s %s\n", "frame", "sequence", "source seq", "captured (wall sec)", "format",
+            "bytes", (reader->type == FRAME_READER_ARCHIVE) ? "segment:offset" : "");
+
+    for(idx = job->first; idx < job->end; idx += job->step)
+    {
+        entry = &reader->entries[idx];
+        fprintf(stdout, "%-10u %-10llu %-10llu %-20.6lf %-6s %-10u", entry->frame_no, (unsigned long long)entry->sequence,
+                (unsigned long long)entry->source_sequence, (double)entry->wall_usec / USEC_PER_SEC,
+                frame_archive_format_extension(entry->format), entry->data_size);
+        if(reader->type == FRAME_READER_ARCHIVE) fprintf(stdout, " %u:%llu", entry->segment_no, (unsigned long long)entry->offset);
+        fprintf(stdout, "\n");
+    }
+
+    fprintf(stdout, "%zu of %zu frames\n", job->no_of_frames, reader->no_of_entries);
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  export_frame
+//
+//  Parameters:     reader, idx, thread_idx, arg - see frame_reader_fn_t, arg is the frame_read_t
+//
+//  Return:         SUCCESS/ERROR
+//
+//  Description:    Writes the frame as <export dir>/frame_<no>.ppm. .ppm frames are written as they are from the
+//                  mapping, .png frames are decoded, and delta frames rebuilt
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int export_frame(frame_reader_t *reader, const size_t idx, const unsigned int thread_idx, void *arg)
+{
+    frame_read_t *job = (frame_read_t *)arg;
+    const frame_archive_index_entry_t *entry = &reader->entries[idx];
+    char file_name[FRAME_ARCHIVE_NAME_SIZE + 32];
+    frame_reader_frame_t frame;
+    Mat decoded;
+    int rc;
+
+    if(frame_reader_map(reader, idx, &frame)) return ERROR;
+    snprintf(file_name, sizeof(file_name), "%s/frame_%u.ppm", job->export_dir, entry->frame_no);
+
+    if(frame.pixels)
+    {
+        rc = write_buffer_to_file(file_name, frame.data, frame.size);
+    }
+    else
+    {
+        rc = decode_frame(reader, idx, thread_idx, job, &frame, decoded);
+        if(!rc)
+        {
+            if(!job->scratch[thread_idx])
+            {
+                job->scratch[thread_idx] = (unsigned char *)malloc((size_t)decoded.cols * decoded.rows * 3);
+                if(!job->scratch[thread_idx]) EXIT_FAIL("malloc");
+            }
+            rc = ppm_write_frame(file_name, decoded.data, decoded.cols, decoded.rows, 3, decoded.step[0], PPM_PIXEL_ORDER_BGR,
+                                 NULL, job->scratch[thread_idx]);
+        }
+    }
+
+    if(rc) fprintf(stderr, "\n%s: %s\n", file_name, strerror(errno));
+    frame_reader_unmap(&frame);
+
+    return rc;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  stream_frames
+//
+//  Parameters:     reader - open reader
+//                  job - selected frames
+//                  no_of_threads - decode threads
+//                  shm_name - POSIX shared memory object to stream to, NULL for stdout
+//
+//  Return:         SUCCESS/ERROR
+//
+//  Description:    The first frame sets the resolution. Frames are decoded in batches by every thread, and each batch
+//                  is written out in frame order. stdout gets the .ppm pixels straight from the mapping. The shared
+//                  memory object is sized for every selected frame (see frame_reader_shm_header_t), frames are decoded
+//                  or copied straight into it, and frames_ready is advanced after every batch
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int stream_frames(frame_reader_t *reader, frame_read_t *job, const unsigned int no_of_threads, const char *shm_name)
+{
+    frame_reader_frame_t frame;
+    Mat decoded;
+    size_t slot, shm_size = 0;
+    int fd, rc = SUCCESS;
+
+    if(!job->no_of_frames) return SUCCESS;
+
+    //resolution of the stream
+    if(frame_reader_map(reader, job->first, &frame)) return ERROR;
+    if(!frame.width)
+    {
+        if(decode_png_frame(reader, job->first, &frame, decoded)) return ERROR;
+        frame.width = decoded.cols;
+        frame.height = decoded.rows;
+    }
+    job->width = frame.width;
+    job->height = frame.height;
+    job->frame_size = (size_t)job->width * job->height * 3;
+    frame_reader_unmap(&frame);
+
+    job->batch_size = no_of_threads * STREAM_BATCH_FRAMES_PER_THREAD;
+    job->batch_maps = (frame_reader_frame_t *)calloc(job->batch_size, sizeof(*job->batch_maps));
+    job->batch_pixels = (const unsigned char **)calloc(job->batch_size, sizeof(*job->batch_pixels));
+    if(!job->batch_maps || !job->batch_pixels) EXIT_FAIL("calloc");
+
+    if(shm_name)
+    {
+        shm_size = sizeof(*job->shm) + (job->frame_size * job->no_of_frames);
+        fd = shm_open(shm_name, O_RDWR | O_CREAT | O_TRUNC, 00666);
+        if(fd == -1) EXIT_FAIL("shm_open");
+        if(ftruncate(fd, shm_size)) EXIT_FAIL("ftruncate");
+        job->shm = (frame_reader_shm_header_t *)mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(job->shm == MAP_FAILED) EXIT_FAIL("mmap");
+        close(fd);
+
+        job->shm_frames = (unsigned char *)(job->shm + 1);
+        job->shm->width = job->width;
+        job->shm->height = job->height;
+        job->shm->channels = 3;
+        job->shm->frame_size = job->frame_size;
+        job->shm->no_of_frames = job->no_of_frames;
+        memcpy(job->shm->magic, FRAME_READER_SHM_MAGIC, sizeof(job->shm->magic));
+    }
+    else
+    {
+        job->batch_buffers = (unsigned char *)malloc(job->batch_size * job->frame_size);
+        if(!job->batch_buffers) EXIT_FAIL("malloc");
+    }
+
+    for(job->batch_first = 0; !rc && (job->batch_first < job->no_of_frames); job->batch_first += job->batch_size)
+    {
+        rc = frame_reader_for_each(reader, job->first + (job->batch_first * job->step),
+                                   job->first + ((job->batch_first + job->batch_size) * job->step), job->step,
+                                   no_of_threads, stream_frame, job);
+
+        for(slot = 0; (slot < job->batch_size) && ((job->batch_first + slot) < job->no_of_frames); ++slot)
+        {
+            if(!rc && !job->shm && write_all(STDOUT_FILENO, job->batch_pixels[slot], job->frame_size))
+            {
+                fprintf(stderr, "\nstdout: %s\n", strerror(errno));
+                rc = ERROR;
+            }
+            frame_reader_unmap(&job->batch_maps[slot]);
+            job->batch_pixels[slot] = NULL;
+        }
+
+        //consumers may use every frame before frames_ready
+        if(!rc && job->shm)
+        {
+            __atomic_store_n(&job->shm->frames_ready, (uint64_t)(job->batch_first + slot), __ATOMIC_RELEASE);
+        }
+    }
+
+    if(job->shm)
+    {
+        munmap(job->shm, shm_size);
+        fprintf(stderr, "%ux%u RGB24 frames in shared memory object %s\n", job->width, job->height, shm_name);
+    }
+    free(job->batch_buffers);
+    free(job->batch_pixels);
+    free(job->batch_maps);
+
+    return rc;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  stream_frame
+//
+//  Parameters:     reader, idx, thread_idx, arg - see frame_reader_fn_t, arg is the frame_read_t
+//
+//  Return:         SUCCESS, or ERROR on a damaged frame, or a frame not matching the stream resolution
+//
+//  Description:    Gets the frame ready for its batch slot: .ppm pixels stay mapped (stdout) or are copied into the
+//                  shared memory object, .png and delta frames are decoded and converted to RGB in their slot
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int stream_frame(frame_reader_t *reader, const size_t idx, const unsigned int thread_idx, void *arg)
+{
+    frame_read_t *job = (frame_read_t *)arg;
+    const size_t position = (idx - job->first) / job->step;
+    const size_t slot = position - job->batch_first;
+    frame_reader_frame_t *frame = &job->batch_maps[slot];
+    unsigned char *destination;
+    Mat decoded;
+
+    destination = job->shm ? (job->shm_frames + (position * job->frame_size)) : (job->batch_buffers + (slot * job->frame_size));
+
+    if(frame_reader_map(reader, idx, frame)) return ERROR;
+
+    if(frame->pixels)
+    {
+        if((frame->width != job->width) || (frame->height != job->height)) goto bad_resolution;
+
+        if(job->shm) memcpy(destination, frame->pixels, job->frame_size);
+        else job->batch_pixels[slot] = frame->pixels;
+        return SUCCESS;
+    }
+
+    if(decode_frame(reader, idx, thread_idx, job, frame, decoded)) return ERROR;
+    if(((unsigned int)decoded.cols != job->width) || ((unsigned int)decoded.rows != job->height)) goto bad_resolution;
+
+    //decoded BGR to RGB, converted in place in the slot
+    {
+        Mat rgb(job->height, job->width, CV_8UC3, destination);
+        cvtColor(decoded, rgb, CV_BGR2RGB);
+    }
+    job->batch_pixels[slot] = destination;
+    frame_reader_unmap(frame);
+
+    return SUCCESS;
+
+bad_resolution:
+    fprintf(stderr, "\nframe %u: resolution differs from the stream, %ux%u\n", reader->entries[idx].frame_no, job->width, job->height);
+    return ERROR;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  decode_frame
+//
+//  Parameters:     reader, idx - frame
+//                  thread_idx - calling frame_reader_for_each() thread, delta frames are rebuilt in its buffers
+//                  job - export/stream state
+//                  frame - mapped .png or delta frame
+//                  decoded - set to the decoded BGR frame, delta frames stay in the thread buffers
+//
+//  Return:         SUCCESS/ERROR
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int decode_frame(const frame_reader_t *reader, const size_t idx, const unsigned int thread_idx, frame_read_t *job,
+                        const frame_reader_frame_t *frame, Mat &decoded)
+{
+    frame_reader_delta_t *delta = &job->deltas[thread_idx];
+
+    if(reader->entries[idx].format != FRAME_ARCHIVE_FORMAT_DELTA) return decode_png_frame(reader, idx, frame, decoded);
+
+    if(frame_reader_rebuild(reader, idx, delta)) return ERROR;
+    decoded = Mat(delta->height, delta->width, CV_8UC3, delta->pixels);
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  decode_png_frame
+//
+//  Parameters:     reader, idx - frame
+//                  frame - mapped .png frame
+//                  decoded - set to the decoded BGR frame
+//
+//  Return:         SUCCESS/ERROR
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int decode_png_frame(const frame_reader_t *reader, const size_t idx, const frame_reader_frame_t *frame, Mat &decoded)
+{
+    try
+    {
+        decoded = imdecode(Mat(1, frame->size, CV_8UC1, (void *)frame->data), CV_LOAD_IMAGE_COLOR);
+    }
+    catch(runtime_error& ex)
+    {
+        decoded = Mat();
+    }
+
+    if(decoded.empty())
+    {
+        fprintf(stderr, "\nframe %u: .png decode failed\n", reader->entries[idx].frame_no);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  write_all
+//
+//  Parameters:     fd - file descriptor
+//                  data, size - data to write
+//
+//  Return:         SUCCESS/ERROR (errno is set)
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int write_all(const int fd, const void *data, const size_t size)
+{
+    ssize_t written;
+    size_t offset = 0;
+
+    while(offset < size)
+    {
+        written = write(fd, (const char *)data + offset, size - offset);
+        if(written == -1)
+        {
+            if(errno == EINTR) continue;
+            return ERROR;
+        }
+        offset += written;
+    }
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  print_usage
+//
+//  Parameters:     fp - stdout or stderr
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void print_usage(FILE *fp)
+{
+    fprintf(fp, "\nUsage: ./frame_read [options] <archive name | frame directory> <command>\n\n"
+                "Commands:\n"
+                "\tlist          Frame no, sequence, capture time, format and size of the frames (index only)\n\n"
+                "\texport <dir>  Frames as <dir>/frame_<no>.ppm, decoded in parallel (delta frames from their keyframe)\n\n"
+                "\tstream        Raw RGB24 frames in frame order to stdout, e.g.\n"
+                "\t\t| ffmpeg -f rawvideo -pix_fmt rgb24 -s 640x480 -i - timelapse.mp4\n\n"
+                "Options:\n"
+                "\t-b    First frame, captured at or after this wall clock time \n\t\t[seconds since the epoch, see 'list']\n\n"
+                "\t-e    Frames captured before this wall clock time \n\t\t[seconds since the epoch]\n\n"
+                "\t-s    Every n-th frame of the range, for time-lapse \n\t\t[Min: 1, Default: 1]\n\n"
+                "\t-j    Decode threads \n\t\t[Max: %d, Default: online cores]\n\n"
+                "\t-m    Stream to this POSIX shared memory object instead of stdout \n\t\t[e.g. /rt_frames]\n\n",
+                MAX_FRAME_READER_THREADS);
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,702 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_reader.c
+//
+//  Description: Reads stored frames back, from a frame archive (see frame_archive.c) or a directory of
+//               frame_<no>.ppm/.png/.rtd files. Archive index and segments are memory mapped once, so a frame is a
+//               pointer and a size, and .ppm pixels are used where they are, without a copy. Delta frames (.rtd) are
+//               rebuilt from the keyframe before them (see tile_delta.c). Frames are looked up by wall clock time
+//               with a binary search of the index, and frame ranges are processed by a group of threads.
+//               frame_read is the command line front end
+//
+
+#include "include.h"
+#include "frame_reader.h"
+#include "ppm_writer.h"
+#include "tile_delta.h"
+#include <dirent.h>
+#include <sys/mman.h>
+
+//frame_reader_for_each() state, shared by its threads
+typedef struct
+{
+    frame_reader_t *reader;
+    frame_reader_fn_t fn;
+    void *arg;
+    size_t first;
+    size_t end;
+    size_t step;
+    size_t next;        //next frame to take, counted in steps, atomic
+    int failed;         //atomic
+}for_each_t;
+
+typedef struct
+{
+    for_each_t *for_each;
+    unsigned int thread_idx;
+    pthread_t thread;
+}for_each_thread_t;
+
+//local functions
+static int open_archive(frame_reader_t *reader);
+static int open_directory(frame_reader_t *reader);
+static int frame_file_filter(const struct dirent *entry);
+static int read_file_entry(const char *directory, const char *file_name, frame_archive_index_entry_t *entry);
+static int read_delta_header(const frame_reader_t *reader, const size_t idx, tile_delta_header_t *header);
+static int compare_frame_no(const void *a, const void *b);
+static void *for_each_handler(void *args);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_reader_open
+//
+//  Parameters:     reader - reader to open
+//                  path - archive name (as given to main -a), or a directory of frame_<no>.ppm/.png files
+//
+//  Return:         SUCCESS, or ERROR (reported on stderr) if there are no readable frames
+//
+//  Description:    Archive: maps the index and every segment. Directory: lists the frame files, and reads the capture
+//                  time-stamp from the .ppm/.rtd headers (file modification time for .png files)
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int frame_reader_open(frame_reader_t *reader, const char *path)
+{
+    struct stat path_stat;
+
+    memset(reader, 0, sizeof(*reader));
+    if(strlen(path) >= sizeof(reader->path))
+    {
+        fprintf(stderr, "\n'%s': name too long\n", path);
+        return ERROR;
+    }
+    strcpy(reader->path, path);
+
+    reader->type = (!stat(path, &path_stat) && S_ISDIR(path_stat.st_mode)) ? FRAME_READER_DIRECTORY : FRAME_READER_ARCHIVE;
+    if(((reader->type == FRAME_READER_DIRECTORY) ? open_directory(reader) : open_archive(reader)) == SUCCESS) return SUCCESS;
+
+    frame_reader_close(reader);
+    return ERROR;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_reader_close
+//
+//  Parameters:     reader - open reader
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_reader_close(frame_reader_t *reader)
+{
+    unsigned int i;
+
+    for(i = 0; i < reader->no_of_segments; ++i)
+    {
+        if(reader->segments[i]) munmap(reader->segments[i], reader->segment_sizes[i]);
+    }
+    free(reader->segments);
+    free(reader->segment_sizes);
+
+    if(reader->index_map) munmap(reader->index_map, reader->index_map_size);
+    free(reader->file_entries);
+
+    memset(reader, 0, sizeof(*reader));
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_reader_find
+//
+//  Parameters:     reader - open reader
+//                  wall_usec - wall clock time, micro seconds since the epoch
+//
+//  Return:         Index of the first frame captured at or after wall_usec, no_of_entries if there is none
+//
+//  Description:    Binary search, frames are stored in capture order
+//
+//------------------------------------------------------------------------------------------------------------------------------
+size_t frame_reader_find(const frame_reader_t *reader, const uint64_t wall_usec)
+{
+    size_t low = 0, high = reader->no_of_entries, mid;
+
+    while(low < high)
+    {
+        mid = low + ((high - low) / 2);
+        if(reader->entries[mid].wall_usec < wall_usec) low = mid + 1;
+        else high = mid;
+    }
+
+    return low;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_reader_map
+//
+//  Parameters:     reader - open reader
+//                  idx - frame index
+//                  frame - set to the frame data, see frame_reader_frame_t
+//
+//  Return:         SUCCESS, or ERROR (reported on stderr) on a damaged record or file
+//
+//  Description:    Archive: points into the mapped segment, after checking the record header against the index.
+//                  Directory: maps the frame file. Safe to call from several threads
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int frame_reader_map(const frame_reader_t *reader, const size_t idx, frame_reader_frame_t *frame)
+{
+    const frame_archive_index_entry_t *entry = &reader->entries[idx];
+    const frame_archive_record_t *record;
+    char file_name[FRAME_ARCHIVE_NAME_SIZE + 32];
+    struct stat file_stat;
+    tile_delta_header_t delta_header;
+    size_t header_size;
+    int fd;
+
+    memset(frame, 0, sizeof(*frame));
+
+    if(reader->type == FRAME_READER_ARCHIVE)
+    {
+        if((entry->segment_no >= reader->no_of_segments) ||
+           (entry->offset + sizeof(*record) + entry->data_size > reader->segment_sizes[entry->segment_no]))
+        {
+            fprintf(stderr, "\nframe %u: outside of segment %u\n", entry->frame_no, entry->segment_no);
+            return ERROR;
+        }
+
+        record = (const frame_archive_record_t *)(reader->segments[entry->segment_no] + entry->offset);
+        if((record->magic != FRAME_ARCHIVE_RECORD_MAGIC) || (record->frame_no != entry->frame_no) || (record->data_size != entry->data_size))
+        {
+            fprintf(stderr, "\nframe %u: bad record in segment %u at offset %llu\n",
+                    entry->frame_no, entry->segment_no, (unsigned long long)entry->offset);
+            return ERROR;
+        }
+
+        frame->data = (const unsigned char *)(record + 1);
+        frame->size = record->data_size;
+        frame->width = record->width;
+        frame->height = record->height;
+    }
+    else
+    {
+        snprintf(file_name, sizeof(file_name), "%s/frame_%u.%s", reader->path, entry->frame_no,
+                 frame_archive_format_extension(entry->format));
+
+        fd = open(file_name, O_RDONLY);
+        if((fd == -1) || fstat(fd, &file_stat) || !file_stat.st_size)
+        {
+            fprintf(stderr, "\n%s: %s\n", file_name, (fd == -1) ? strerror(errno) : "empty");
+            if(fd != -1) close(fd);
+            return ERROR;
+        }
+
+        frame->file_map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(frame->file_map == MAP_FAILED)
+        {
+            frame->file_map = NULL;
+            fprintf(stderr, "\n%s: mmap, %s\n", file_name, strerror(errno));
+            return ERROR;
+        }
+
+        frame->file_map_size = file_stat.st_size;
+        frame->data = (const unsigned char *)frame->file_map;
+        frame->size = file_stat.st_size;
+    }
+
+    if(entry->format == FRAME_ARCHIVE_FORMAT_PPM)
+    {
+        header_size = ppm_parse_header(frame->data, frame->size, &frame->width, &frame->height);
+        if(!header_size || (header_size + ((size_t)frame->width * frame->height * 3) > frame->size))
+        {
+            fprintf(stderr, "\nframe %u: bad .ppm data\n", entry->frame_no);
+            frame_reader_unmap(frame);
+            return ERROR;
+        }
+        frame->pixels = frame->data + header_size;
+    }
+    else if(entry->format == FRAME_ARCHIVE_FORMAT_DELTA)
+    {
+        if(tile_delta_read_header(frame->data, frame->size, &delta_header))
+        {
+            fprintf(stderr, "\nframe %u: bad .rtd data\n", entry->frame_no);
+            frame_reader_unmap(frame);
+            return ERROR;
+        }
+        frame->width = delta_header.width;
+        frame->height = delta_header.height;
+    }
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_reader_unmap
+//
+//  Parameters:     frame - mapped frame
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_reader_unmap(frame_reader_frame_t *frame)
+{
+    if(frame->file_map) munmap(frame->file_map, frame->file_map_size);
+    memset(frame, 0, sizeof(*frame));
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_reader_rebuild
+//
+//  Parameters:     reader - open reader
+//                  idx - delta frame (FRAME_ARCHIVE_FORMAT_DELTA) index
+//                  delta - set to the rebuilt frame, pixels are allocated with the keyframe resolution
+//
+//  Return:         SUCCESS, or ERROR (reported on stderr) on a damaged frame, or a missing keyframe or delta frame
+//
+//  Description:    Walks back to the keyframe of the frame, or to the frame delta holds if that comes first, and
+//                  applies the delta frames up to idx in order. Every delta frame must follow the frame it was
+//                  encoded against. Frames rebuilt in ascending order with the same delta only apply the frames in
+//                  between. Safe to call from several threads, each with its own delta
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int frame_reader_rebuild(const frame_reader_t *reader, const size_t idx, frame_reader_delta_t *delta)
+{
+    frame_reader_frame_t frame;
+    tile_delta_header_t header;
+    size_t start, frame_size;
+    int rc;
+
+    //back to the keyframe, or to the frame already rebuilt
+    for(start = idx; ; --start)
+    {
+        if(delta->have_frame && (delta->idx == start))
+        {
+            ++start;
+            break;
+        }
+
+        if(read_delta_header(reader, start, &header)) return ERROR;
+        if(header.type == TILE_DELTA_KEYFRAME) break;
+
+        if(!start)
+        {
+            fprintf(stderr, "\nframe %u: no keyframe before it\n", reader->entries[idx].frame_no);
+            return ERROR;
+        }
+    }
+
+    for(; start <= idx; ++start)
+    {
+        if(read_delta_header(reader, start, &header)) return ERROR;
+
+        if(header.type == TILE_DELTA_KEYFRAME)
+        {
+            //pixels sized for the keyframe
+            if((header.width != delta->width) || (header.height != delta->height))
+            {
+                frame_size = (size_t)header.width * header.height * 3;
+                frame_reader_delta_free(delta);
+                delta->pixels = (unsigned char *)malloc(frame_size);
+                delta->payload = (unsigned char *)malloc(frame_size);
+                if(!delta->pixels || !delta->payload) EXIT_FAIL("malloc");
+                delta->width = header.width;
+                delta->height = header.height;
+            }
+        }
+        else if(!delta->have_frame || (header.reference_no != delta->frame_no) ||
+                (header.width != delta->width) || (header.height != delta->height))
+        {
+            fprintf(stderr, "\nframe %u: delta of frame %u, which is missing\n", header.frame_no, header.reference_no);
+            delta->have_frame = FALSE;
+            return ERROR;
+        }
+
+        //pixels are only valid again once the frame is applied
+        delta->have_frame = FALSE;
+        if(frame_reader_map(reader, start, &frame)) return ERROR;
+        rc = tile_delta_decode(frame.data, frame.size, delta->pixels, delta->payload);
+        frame_reader_unmap(&frame);
+        if(rc)
+        {
+            fprintf(stderr, "\nframe %u: bad .rtd data\n", header.frame_no);
+            return ERROR;
+        }
+
+        delta->idx = start;
+        delta->frame_no = header.frame_no;
+        delta->have_frame = TRUE;
+    }
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_reader_delta_free
+//
+//  Parameters:     delta - delta frame buffers
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_reader_delta_free(frame_reader_delta_t *delta)
+{
+    free(delta->pixels);
+    free(delta->payload);
+    memset(delta, 0, sizeof(*delta));
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_reader_for_each
+//
+//  Parameters:     reader - open reader
+//                  first, end, step - frames first, first + step, ... before end
+//                  no_of_threads - threads to run fn in, 1 to MAX_FRAME_READER_THREADS
+//                  fn, arg - called once per frame, see frame_reader_fn_t
+//
+//  Return:         SUCCESS, or ERROR if fn failed for a frame
+//
+//  Description:    Threads take the next frame until none is left, so slow (large .png) frames do not hold the
+//                  others up. Frames are processed in no particular order, fn gets its thread index for per thread
+//                  buffers. The calling thread runs as thread 0
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int frame_reader_for_each(frame_reader_t *reader, const size_t first, const size_t end, const size_t step,
+                          const unsigned int no_of_threads, frame_reader_fn_t fn, void *arg)
+{
+    for_each_t for_each;
+    for_each_thread_t threads[MAX_FRAME_READER_THREADS];
+    unsigned int i;
+
+    assert((no_of_threads > 0) && (no_of_threads <= MAX_FRAME_READER_THREADS) && step);
+
+    for_each.reader = reader;
+    for_each.fn = fn;
+    for_each.arg = arg;
+    for_each.first = first;
+    for_each.end = (end < reader->no_of_entries) ? end : reader->no_of_entries;
+    for_each.step = step;
+    for_each.next = 0;
+    for_each.failed = FALSE;
+
+    for(i = 0; i < no_of_threads; ++i)
+    {
+        threads[i].for_each = &for_each;
+        threads[i].thread_idx = i;
+        if(i && pthread_create(&threads[i].thread, NULL, for_each_handler, (void *)&threads[i])) EXIT_FAIL("pthread_create");
+    }
+
+    for_each_handler((void *)&threads[0]);
+
+    for(i = 1; i < no_of_threads; ++i)
+    {
+        pthread_join(threads[i].thread, NULL);
+    }
+
+    return for_each.failed ? ERROR : SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  for_each_handler
+//
+//  Parameters:     args - for_each_thread_t of this thread
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void *for_each_handler(void *args)
+{
+    for_each_thread_t *thread = (for_each_thread_t *)args;
+    for_each_t *for_each = thread->for_each;
+    size_t idx;
+
+    while(!__atomic_load_n(&for_each->failed, __ATOMIC_RELAXED))
+    {
+        idx = for_each->first + (__atomic_fetch_add(&for_each->next, 1, __ATOMIC_RELAXED) * for_each->step);
+        if((idx < for_each->first) || (idx >= for_each->end)) break;
+
+        if(for_each->fn(for_each->reader, idx, thread->thread_idx, for_each->arg))
+        {
+            __atomic_store_n(&for_each->failed, TRUE, __ATOMIC_RELAXED);
+        }
+    }
+
+    return NULL;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  open_archive
+//
+//  Parameters:     reader - reader, path is the archive name
+//
+//  Return:         SUCCESS/ERROR
+//
+//  Description:    Maps the index (the entries are used in place) and every segment it refers to. A partly written
+//                  last index entry (interrupted capture) is ignored
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int open_archive(frame_reader_t *reader)
+{
+    char file_name[FRAME_ARCHIVE_NAME_SIZE + 16];
+    const frame_archive_index_header_t *header;
+    struct stat file_stat;
+    unsigned int i;
+    int fd;
+
+    frame_archive_index_name(file_name, sizeof(file_name), reader->path);
+    fd = open(file_name, O_RDONLY);
+    if((fd == -1) || fstat(fd, &file_stat) || (file_stat.st_size < (off_t)sizeof(*header)))
+    {
+        fprintf(stderr, "\n'%s' is no frame directory, and %s is no frame archive index\n", reader->path, file_name);
+        if(fd != -1) close(fd);
+        return ERROR;
+    }
+
+    reader->index_map_size = file_stat.st_size;
+    reader->index_map = mmap(NULL, reader->index_map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(reader->index_map == MAP_FAILED)
+    {
+        reader->index_map = NULL;
+        fprintf(stderr, "\n%s: mmap, %s\n", file_name, strerror(errno));
+        return ERROR;
+    }
+
+    header = (const frame_archive_index_header_t *)reader->index_map;
+    if(memcmp(header->magic, FRAME_ARCHIVE_INDEX_MAGIC, sizeof(header->magic)) || (header->version != FRAME_ARCHIVE_VERSION) ||
+       (header->entry_size != sizeof(frame_archive_index_entry_t)))
+    {
+        fprintf(stderr, "\n%s is not a frame archive index\n", file_name);
+        return ERROR;
+    }
+
+    reader->entries = (const frame_archive_index_entry_t *)(header + 1);
+    reader->no_of_entries = (reader->index_map_size - sizeof(*header)) / sizeof(frame_archive_index_entry_t);
+    madvise(reader->index_map, reader->index_map_size, MADV_WILLNEED);
+
+    //segments are numbered from 0, and filled in order
+    if(reader->no_of_entries) reader->no_of_segments = reader->entries[reader->no_of_entries - 1].segment_no + 1;
+    reader->segments = (unsigned char **)calloc(reader->no_of_segments + 1, sizeof(*reader->segments));
+    reader->segment_sizes = (size_t *)calloc(reader->no_of_segments + 1, sizeof(*reader->segment_sizes));
+    if(!reader->segments || !reader->segment_sizes) EXIT_FAIL("calloc");
+
+    for(i = 0; i < reader->no_of_segments; ++i)
+    {
+        frame_archive_segment_name(file_name, sizeof(file_name), reader->path, i);
+        fd = open(file_name, O_RDONLY);
+        if((fd == -1) || fstat(fd, &file_stat) || !file_stat.st_size)
+        {
+            fprintf(stderr, "\n%s: %s\n", file_name, (fd == -1) ? strerror(errno) : "empty");
+            if(fd != -1) close(fd);
+            return ERROR;
+        }
+
+        reader->segments[i] = (unsigned char *)mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(reader->segments[i] == MAP_FAILED)
+        {
+            reader->segments[i] = NULL;
+            fprintf(stderr, "\n%s: mmap, %s\n", file_name, strerror(errno));
+            return ERROR;
+        }
+        reader->segment_sizes[i] = file_stat.st_size;
+    }
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  open_directory
+//
+//  Parameters:     reader - reader, path is the frame directory
+//
+//  Return:         SUCCESS/ERROR
+//
+//  Description:    Builds index entries for the frame_<no>.ppm/.png/.rtd files, ordered by frame number
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int open_directory(frame_reader_t *reader)
+{
+    struct dirent **files;
+    int no_of_files, i;
+    size_t no_of_entries = 0;
+
+    no_of_files = scandir(reader->path, &files, frame_file_filter, NULL);
+    if(no_of_files < 0)
+    {
+        fprintf(stderr, "\n%s: %s\n", reader->path, strerror(errno));
+        return ERROR;
+    }
+
+    reader->file_entries = (frame_archive_index_entry_t *)calloc(no_of_files + 1, sizeof(*reader->file_entries));
+    if(!reader->file_entries) EXIT_FAIL("calloc");
+
+    for(i = 0; i < no_of_files; ++i)
+    {
+        if(!read_file_entry(reader->path, files[i]->d_name, &reader->file_entries[no_of_entries])) ++no_of_entries;
+        free(files[i]);
+    }
+    free(files);
+
+    if(!no_of_entries)
+    {
+        fprintf(stderr, "\nNo frame_<no>.ppm/.png/.rtd frames in '%s'\n", reader->path);
+        return ERROR;
+    }
+
+    qsort(reader->file_entries, no_of_entries, sizeof(*reader->file_entries), compare_frame_no);
+    reader->entries = reader->file_entries;
+    reader->no_of_entries = no_of_entries;
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_file_filter
+//
+//  Parameters:     entry - directory entry
+//
+//  Return:         Non-zero for frame_<no>.ppm/.png/.rtd files, as written by main
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int frame_file_filter(const struct dirent *entry)
+{
+    unsigned int frame_no;
+    char extension[5];
+
+    if(sscanf(entry->d_name, "frame_%u.%4s", &frame_no, extension) != 2) return FALSE;
+
+    return !strcmp(extension, "ppm") || !strcmp(extension, "png") || !strcmp(extension, "rtd");
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  read_file_entry
+//
+//  Parameters:     directory, file_name - frame file
+//                  entry - filled with the frame number, format, size and capture time
+//
+//  Return:         SUCCESS, or ERROR if the file can not be read (skipped)
+//
+//  Description:    .ppm files carry the capture time in their "# Frame <no> captured at <sec>:<usec>" header comment,
+//                  and the driver sequence and time-stamp in "# Source sequence <no> exposed at <sec>.<nsec>", .rtd
+//                  files the capture time in their header, .png files only have the file modification time
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int read_file_entry(const char *directory, const char *file_name, frame_archive_index_entry_t *entry)
+{
+    char path[FRAME_ARCHIVE_NAME_SIZE + 32];
+    char header[PPM_MAX_HEADER_SIZE + 1];
+    tile_delta_header_t delta_header;
+    char extension[5];
+    const char *captured_at, *exposed_at;
+    struct stat file_stat;
+    long sec, usec, nsec;
+    unsigned long long source_sequence;
+    ssize_t header_size;
+    int fd;
+
+    memset(entry, 0, sizeof(*entry));
+    sscanf(file_name, "frame_%u.%4s", &entry->frame_no, extension);
+    if(!strcmp(extension, "png")) entry->format = FRAME_ARCHIVE_FORMAT_PNG;
+    else if(!strcmp(extension, "rtd")) entry->format = FRAME_ARCHIVE_FORMAT_DELTA;
+    else entry->format = FRAME_ARCHIVE_FORMAT_PPM;
+
+    snprintf(path, sizeof(path), "%s/%s", directory, file_name);
+    fd = open(path, O_RDONLY);
+    if(fd == -1) return ERROR;
+    if(fstat(fd, &file_stat))
+    {
+        close(fd);
+        return ERROR;
+    }
+
+    entry->data_size = file_stat.st_size;
+    entry->wall_usec = ((uint64_t)file_stat.st_mtim.tv_sec * USEC_PER_SEC) + (file_stat.st_mtim.tv_nsec / NSEC_PER_USEC);
+
+    if(entry->format == FRAME_ARCHIVE_FORMAT_PPM)
+    {
+        header_size = pread(fd, header, PPM_MAX_HEADER_SIZE, 0);
+        if(header_size > 0)
+        {
+            header[header_size] = '\0';
+            captured_at = strstr(header, " captured at ");
+            if(captured_at && (sscanf(captured_at, " captured at %ld:%ld", &sec, &usec) == 2))
+            {
+                entry->wall_usec = ((uint64_t)sec * USEC_PER_SEC) + usec;
+            }
+            exposed_at = strstr(header, "# Source sequence ");
+            if(exposed_at && (sscanf(exposed_at, "# Source sequence %llu exposed at %ld.%ld", &source_sequence, &sec, &nsec) == 3))
+            {
+                entry->source_sequence = source_sequence;
+                entry->exposure_nsec = ((uint64_t)sec * NSEC_PER_SEC) + nsec;
+            }
+        }
+    }
+    else if(entry->format == FRAME_ARCHIVE_FORMAT_DELTA)
+    {
+        if(pread(fd, &delta_header, sizeof(delta_header), 0) == (ssize_t)sizeof(delta_header)) entry->wall_usec = delta_header.wall_usec;
+    }
+
+    close(fd);
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  read_delta_header
+//
+//  Parameters:     reader - open reader
+//                  idx - frame index
+//                  header - set to the delta frame header
+//
+//  Return:         SUCCESS, or ERROR (reported on stderr) if the frame is no delta frame, or damaged
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int read_delta_header(const frame_reader_t *reader, const size_t idx, tile_delta_header_t *header)
+{
+    frame_reader_frame_t frame;
+
+    if(reader->entries[idx].format != FRAME_ARCHIVE_FORMAT_DELTA)
+    {
+        fprintf(stderr, "\nframe %u: not a delta frame\n", reader->entries[idx].frame_no);
+        return ERROR;
+    }
+
+    //checked by frame_reader_map()
+    if(frame_reader_map(reader, idx, &frame)) return ERROR;
+    memcpy(header, frame.data, sizeof(*header));
+    frame_reader_unmap(&frame);
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  compare_frame_no
+//
+//  Parameters:     a, b - index entries
+//
+//  Return:         qsort() order, ascending frame_no
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int compare_frame_no(const void *a, const void *b)
+{
+    const unsigned int frame_no_a = ((const frame_archive_index_entry_t *)a)->frame_no;
+    const unsigned int frame_no_b = ((const frame_archive_index_entry_t *)b)->frame_no;
+
+    return (frame_no_a > frame_no_b) - (frame_no_a < frame_no_b);
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,95 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_reader.h
+//
+//  Description: Header file for frame_reader.c
+//
+
+#ifndef _FRAME_READER_H
+#define _FRAME_READER_H
+
+#include "include.h"
+#include "frame_archive.h"
+#include <stdint.h>
+
+//stored frames read from
+#define FRAME_READER_ARCHIVE            (0) //frame archive (-a), index and segments are mapped once
+#define FRAME_READER_DIRECTORY          (1) //frame_<no>.ppm/.png/.rtd files, mapped one at a time
+
+//frame_reader_for_each() threads
+#define MAX_FRAME_READER_THREADS        (64)
+
+//frames streamed to shared memory (frame_read -m): this header, then the raw frames back to back, 64 bytes
+#define FRAME_READER_SHM_MAGIC          "RTFSHM01"
+typedef struct
+{
+    char magic[8];                  //FRAME_READER_SHM_MAGIC
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;              //RGB, 3
+    uint32_t reserved0;
+    uint64_t frame_size;            //bytes per frame
+    uint64_t no_of_frames;          //frames the object is sized for
+    uint64_t frames_ready;          //frames written so far, in order, atomic (release)
+    uint8_t reserved1[16];
+}frame_reader_shm_header_t;
+
+//mapped frame, see frame_reader_map()
+typedef struct
+{
+    const unsigned char *data;      //encoded frame, complete .ppm/.png/.rtd file contents
+    size_t size;
+    const unsigned char *pixels;    //.ppm: RGB rows inside data (step width * 3), NULL for .png/.rtd
+    unsigned int width;             //.ppm, .rtd and archived frames, 0 if not known before decoding
+    unsigned int height;
+    void *file_map;                 //directory: mapped file, unmapped by frame_reader_unmap()
+    size_t file_map_size;
+}frame_reader_frame_t;
+
+//delta frame (.rtd) rebuilt from its keyframe, see frame_reader_rebuild(), one per thread
+typedef struct
+{
+    unsigned char *pixels;          //BGR, width * 3 step
+    unsigned char *payload;         //inflated delta frame payload
+    unsigned int width;
+    unsigned int height;
+    size_t idx;                     //frame in pixels, valid if have_frame
+    unsigned int frame_no;
+    int have_frame;
+}frame_reader_delta_t;
+
+//stored frames, indexed in store order
+typedef struct
+{
+    int type;                                       //FRAME_READER_xxx
+    char path[FRAME_ARCHIVE_NAME_SIZE];             //archive name, or directory
+    const frame_archive_index_entry_t *entries;     //one per frame, ascending frame_no
+    size_t no_of_entries;
+    void *index_map;                                //archive: mapped index file
+    size_t index_map_size;
+    unsigned char **segments;                       //archive: mapped segments
+    size_t *segment_sizes;
+    unsigned int no_of_segments;
+    frame_archive_index_entry_t *file_entries;      //directory: built from the file names and headers
+}frame_reader_t;
+
+//called by frame_reader_for_each() threads, returns SUCCESS or ERROR (stops the other threads)
+typedef int (*frame_reader_fn_t)(frame_reader_t *reader, const size_t idx, const unsigned int thread_idx, void *arg);
+
+//APIs
+int frame_reader_open(frame_reader_t *reader, const char *path);
+void frame_reader_close(frame_reader_t *reader);
+size_t frame_reader_find(const frame_reader_t *reader, const uint64_t wall_usec);
+int frame_reader_map(const frame_reader_t *reader, const size_t idx, frame_reader_frame_t *frame);
+void frame_reader_unmap(frame_reader_frame_t *frame);
+int frame_reader_rebuild(const frame_reader_t *reader, const size_t idx, frame_reader_delta_t *delta);
+void frame_reader_delta_free(frame_reader_delta_t *delta);
+int frame_reader_for_each(frame_reader_t *reader, const size_t first, const size_t end, const size_t step,
+                          const unsigned int no_of_threads, frame_reader_fn_t fn, void *arg);
+
+#endif //_FRAME_READER_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,292 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_ring.c
+//
+//  Description: Lock-free single producer / single consumer ring of preallocated frame slots.
+//               query_frames_thread publishes every frame, store_frames_thread claims the frame closest to its
+//               release time. The producer skips the (only) slot held by the consumer, so neither side ever waits.
+//
+
+#include "include.h"
+#include "frame_ring.h"
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_ring_init
+//
+//  Parameters:     ring - ring to initialize
+//                  no_of_slots - MIN_FRAME_RING_SLOTS to MAX_FRAME_RING_SLOTS
+//                  width, height, channels - frame resolution
+//                  pool - frame pool, pixel memory of every slot is borrowed from it
+//
+//  Return:         None
+//
+//  Description:    Sets up the slots and their pixel memory up front, nothing is allocated afterwards
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_ring_init(frame_ring_t *ring, const unsigned int no_of_slots, const unsigned int width,
+                     const unsigned int height, const unsigned int channels, frame_pool_t *pool)
+{
+    unsigned int i;
+    const size_t step = (size_t)width * channels;
+
+    assert((no_of_slots >= MIN_FRAME_RING_SLOTS) && (no_of_slots <= MAX_FRAME_RING_SLOTS));
+    assert(pool->buffer_size >= (step * height));
+
+    memset(ring, 0, sizeof(*ring));
+    ring->no_of_slots = no_of_slots;
+    ring->claimed_idx = -1;
+    ring->pool = pool;
+
+    if(posix_memalign((void **)&ring->slots, CACHE_LINE_SIZE, no_of_slots * sizeof(frame_slot_t))) EXIT_FAIL("posix_memalign");
+    memset(ring->slots, 0, no_of_slots * sizeof(frame_slot_t));
+
+    for(i = 0; i < no_of_slots; ++i)
+    {
+        ring->slots[i].state = FRAME_SLOT_EMPTY;
+        ring->slots[i].frame.data = frame_pool_get(pool);
+        if(!ring->slots[i].frame.data) EXIT_FAIL("frame_pool_get");
+        ring->slots[i].frame.width = width;
+        ring->slots[i].frame.height = height;
+        ring->slots[i].frame.channels = channels;
+        ring->slots[i].frame.step = step;
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_ring_destroy
+//
+//  Parameters:     ring - initialized ring, no producer/consumer must be using it
+//
+//  Return:         None
+//
+//  Description:    Frees the slots, and returns their pixel memory to the frame pool
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_ring_destroy(frame_ring_t *ring)
+{
+    unsigned int i;
+
+    for(i = 0; i < ring->no_of_slots; ++i)
+    {
+        frame_pool_put(ring->pool, ring->slots[i].frame.data);
+    }
+
+    free(ring->slots);
+    ring->slots = NULL;
+    ring->no_of_slots = 0;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_ring_begin_write
+//
+//  Parameters:     ring - frame ring (producer only)
+//
+//  Return:         Frame to fill, its pixel memory and resolution are preassigned
+//
+//  Description:    Takes the oldest slot which is not held by the consumer. A frame in it which was never consumed
+//                  is counted as overwritten. Call frame_ring_publish() once the frame is filled, or
+//                  frame_ring_abort_write() if there is no frame for it
+//
+//------------------------------------------------------------------------------------------------------------------------------
+frame_t *frame_ring_begin_write(frame_ring_t *ring)
+{
+    int previous_state;
+    frame_slot_t *slot;
+
+    while(1)
+    {
+        slot = &ring->slots[ring->write_idx];
+        previous_state = __atomic_load_n(&slot->state, __ATOMIC_RELAXED);
+
+        //mark the slot, then check the consumer claim. Consumer claims, then checks the mark (see frame_ring_claim)
+        __atomic_store_n(&slot->state, FRAME_SLOT_WRITING, __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&ring->claimed_idx, __ATOMIC_SEQ_CST) != (int)ring->write_idx) break;
+
+        //held by the consumer, leave it as is and take the next one
+        __atomic_store_n(&slot->state, previous_state, __ATOMIC_RELEASE);
+        ring->write_idx = (ring->write_idx + 1) % ring->no_of_slots;
+    }
+
+    ring->write_previous_state = previous_state;
+    ring->write_overwrites = (previous_state == FRAME_SLOT_PUBLISHED) &&
+        (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) > __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+    if(ring->write_overwrites) ++ring->overwritten;
+
+    return &slot->frame;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_ring_publish
+//
+//  Parameters:     ring - frame ring (producer only)
+//
+//  Return:         None
+//
+//  Description:    Assigns the next sequence number to the frame returned by frame_ring_begin_write(),
+//                  and makes it visible to the consumer
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_ring_publish(frame_ring_t *ring)
+{
+    frame_slot_t *slot = &ring->slots[ring->write_idx];
+    const unsigned long long sequence = ring->head + 1; //head is written only by the producer
+
+    slot->frame.sequence = sequence;
+    __atomic_store_n(&slot->sequence, sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->capture_nsec, ((unsigned long long)slot->frame.capture_time.tv_sec * NSEC_PER_SEC) + slot->frame.capture_time.tv_nsec, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->state, FRAME_SLOT_PUBLISHED, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->head, sequence, __ATOMIC_RELEASE);
+
+    ++ring->published;
+    ring->write_idx = (ring->write_idx + 1) % ring->no_of_slots;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_ring_abort_write
+//
+//  Parameters:     ring - frame ring (producer only)
+//
+//  Return:         None
+//
+//  Description:    Gives the slot returned by frame_ring_begin_write() back unchanged, when no frame was read into it
+//                  (late frame). A frame published in it is visible to the consumer again, and not counted as overwritten
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_ring_abort_write(frame_ring_t *ring)
+{
+    frame_slot_t *slot = &ring->slots[ring->write_idx];
+
+    if(ring->write_overwrites) --ring->overwritten;
+    __atomic_store_n(&slot->state, ring->write_previous_state, __ATOMIC_RELEASE);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_ring_claim
+//
+//  Parameters:     ring - frame ring (consumer only)
+//                  release_time - CLOCK_MONOTONIC release time of the consumer job (NULL for the newest frame)
+//
+//  Return:         Frame captured closest to release_time, which is newer than the last claimed frame.
+//                  NULL if there is no new frame
+//
+//  Description:    The frame stays valid until frame_ring_release(). Older unconsumed frames are passed over
+//
+//------------------------------------------------------------------------------------------------------------------------------
+const frame_t *frame_ring_claim(frame_ring_t *ring, const struct timespec *release_time)
+{
+    unsigned int i;
+    int best_idx;
+    unsigned long long best_sequence, best_distance, sequence, capture_nsec, distance;
+    const unsigned long long tail = ring->tail; //tail is written only by the consumer
+    const unsigned long long release_nsec = release_time ?
+        ((unsigned long long)release_time->tv_sec * NSEC_PER_SEC) + release_time->tv_nsec : ~0ULL;
+    frame_slot_t *slot;
+
+    assert(ring->claimed_idx == -1);
+
+    while(1)
+    {
+        if(__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) <= tail)
+        {
+            ++ring->empty_claims;
+            return NULL;
+        }
+
+        //pick the unconsumed frame closest to the release time, newer one on a tie
+        best_idx = -1;
+        best_sequence = 0;
+        best_distance = ~0ULL;
+        for(i = 0; i < ring->no_of_slots; ++i)
+        {
+            slot = &ring->slots[i];
+            if(__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != FRAME_SLOT_PUBLISHED) continue;
+
+            sequence = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+            if(sequence <= tail) continue;
+
+            capture_nsec = __atomic_load_n(&slot->capture_nsec, __ATOMIC_RELAXED);
+            distance = (capture_nsec > release_nsec) ? (capture_nsec - release_nsec) : (release_nsec - capture_nsec);
+
+            if((distance < best_distance) || ((distance == best_distance) && (sequence > best_sequence)))
+            {
+                best_idx = i;
+                best_sequence = sequence;
+                best_distance = distance;
+            }
+        }
+
+        //every unconsumed frame is being overwritten right now, look again
+        if(best_idx < 0) continue;
+
+        //claim, then make sure the producer did not start overwriting it meanwhile
+        slot = &ring->slots[best_idx];
+        __atomic_store_n(&ring->claimed_idx, best_idx, __ATOMIC_SEQ_CST);
+        if((__atomic_load_n(&slot->state, __ATOMIC_SEQ_CST) == FRAME_SLOT_PUBLISHED) &&
+           (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) == best_sequence))
+        {
+            break;
+        }
+
+        __atomic_store_n(&ring->claimed_idx, -1, __ATOMIC_RELEASE);
+    }
+
+    ring->unconsumed += best_sequence - tail - 1;
+    ++ring->consumed;
+    __atomic_store_n(&ring->tail, best_sequence, __ATOMIC_RELEASE);
+
+    return &slot->frame;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_ring_release
+//
+//  Parameters:     ring - frame ring (consumer only)
+//
+//  Return:         None
+//
+//  Description:    Hands the claimed slot back to the producer
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_ring_release(frame_ring_t *ring)
+{
+    __atomic_store_n(&ring->claimed_idx, -1, __ATOMIC_RELEASE);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_ring_report
+//
+//  Parameters:     ring - frame ring, producer and consumer must have exited
+//                  ring_name - printed along with the results
+//
+//  Return:         None
+//
+//  Description:    Prints and logs the ring counters, used for sizing the ring
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_ring_report(const frame_ring_t *ring, const char *ring_name)
+{
+    fprintf(stdout, "\n\n--------------------------------------"
+                     "\n%s frame ring results (%u slots):"
+                     "\npublished frames: %llu,"
+                     "\nconsumed frames: %llu,"
+                     "\nunconsumed frames: %llu,"
+                     "\noverwritten frames: %llu,"
+                     "\nreleases without a new frame: %llu"
+                     "\n--------------------------------------",
+                     ring_name, ring->no_of_slots, ring->published, ring->consumed, ring->unconsumed, ring->overwritten, ring->empty_claims);
+
+    syslog(LOG_WARNING," %s frame ring: %u slots, published %llu, consumed %llu, unconsumed %llu, overwritten %llu, empty %llu",
+           ring_name, ring->no_of_slots, ring->published, ring->consumed, ring->unconsumed, ring->overwritten, ring->empty_claims);
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,94 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_ring.h
+//
+//  Description: Header file for frame_ring.c
+//
+
+#ifndef _FRAME_RING_H
+#define _FRAME_RING_H
+
+#include "frame_pool.h"
+#include "include.h"
+#include <stddef.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define CACHE_LINE_SIZE             (64)
+
+//no.of frame slots in the ring
+//one slot can be held by the consumer, the producer always needs two more to never block
+#define MIN_FRAME_RING_SLOTS        (3)
+#define DEFAULT_FRAME_RING_SLOTS    (4)
+#define MAX_FRAME_RING_SLOTS        (16)
+
+//frame slot states
+#define FRAME_SLOT_EMPTY            (0)
+#define FRAME_SLOT_WRITING          (1)
+#define FRAME_SLOT_PUBLISHED        (2)
+
+//frame data along with its capture details
+typedef struct
+{
+    unsigned char *data;            //BGR pixels
+    unsigned int width;
+    unsigned int height;
+    unsigned int channels;
+    size_t step;                    //distance in bytes between two adjacent rows
+    unsigned long long sequence;    //assigned on publish, starts at 1
+    struct timespec capture_time;   //CLOCK_MONOTONIC, used to pick a frame for a release
+    struct timeval wall_time;       //wall clock, used in the stored file headers
+    unsigned long long source_sequence; //driver buffer sequence (V4L2), frames read by the source otherwise
+    struct timespec exposure_time;  //CLOCK_MONOTONIC, driver buffer time-stamp (V4L2), capture_time otherwise
+}frame_t;
+
+//preallocated frame slot
+typedef struct
+{
+    frame_t frame;
+    int state;                          //FRAME_SLOT_xxx, atomic
+    unsigned long long sequence;        //published frame sequence, atomic
+    unsigned long long capture_nsec;    //published capture time, atomic
+} __attribute__((aligned(CACHE_LINE_SIZE))) frame_slot_t;
+
+//single producer (query_frames_thread), single consumer (store_frames_thread) frame ring
+typedef struct
+{
+    //producer side
+    unsigned long long head __attribute__((aligned(CACHE_LINE_SIZE)));    //last published sequence, atomic
+    unsigned int write_idx;             //slot being written
+    int write_previous_state;           //its state before frame_ring_begin_write(), see frame_ring_abort_write()
+    int write_overwrites;               //a frame in it was counted as overwritten
+    unsigned long long published;       //no.of published frames
+    unsigned long long overwritten;     //published frames overwritten before being consumed
+
+    //consumer side
+    unsigned long long tail __attribute__((aligned(CACHE_LINE_SIZE)));    //last consumed sequence, atomic
+    int claimed_idx;                    //slot held by the consumer, -1 if none, atomic
+    unsigned long long consumed;        //no.of consumed frames
+    unsigned long long unconsumed;      //published frames passed over by the consumer
+    unsigned long long empty_claims;    //releases with no new frame
+
+    //read only after initialization
+    frame_slot_t *slots __attribute__((aligned(CACHE_LINE_SIZE)));
+    unsigned int no_of_slots;
+    frame_pool_t *pool;                 //slot pixel memory is borrowed from it
+}frame_ring_t;
+
+//APIs
+void frame_ring_init(frame_ring_t *ring, const unsigned int no_of_slots, const unsigned int width,
+                     const unsigned int height, const unsigned int channels, frame_pool_t *pool);
+void frame_ring_destroy(frame_ring_t *ring);
+frame_t *frame_ring_begin_write(frame_ring_t *ring);
+void frame_ring_publish(frame_ring_t *ring);
+void frame_ring_abort_write(frame_ring_t *ring);
+const frame_t *frame_ring_claim(frame_ring_t *ring, const struct timespec *release_time);
+void frame_ring_release(frame_ring_t *ring);
+void frame_ring_report(const frame_ring_t *ring, const char *ring_name);
+
+#endif //_FRAME_RING_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,70 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_shm.h
+//
+//  Description: Layout of the POSIX shared memory frame ring (-M), shared by the publisher (frame_publisher.c) and
+//               the consumer library (frame_subscriber.c). Standalone, consumers build it without the rest of the tree
+//
+
+#ifndef _FRAME_SHM_H
+#define _FRAME_SHM_H
+
+#include <stdint.h>
+
+//object layout: header, slot descriptors, then the slot frames, the first one page aligned
+//  frame_shm_header_t | frame_shm_slot_t x no_of_slots | pad | frame 0 | frame 1 | ...
+#define FRAME_SHM_MAGIC             "RTFRING1"
+#define FRAME_SHM_CACHE_LINE_SIZE   (64)
+
+//no.of frame slots, a consumer has (no_of_slots - 1) publish intervals to use a frame before it is overwritten
+#define MIN_FRAME_SHM_SLOTS         (2)
+#define DEFAULT_FRAME_SHM_SLOTS     (8)
+#define MAX_FRAME_SHM_SLOTS         (64)
+
+//publisher states
+#define FRAME_SHM_STATE_OPEN        (1)
+#define FRAME_SHM_STATE_CLOSED      (2) //no more frames, the frames published last are still valid
+
+//object header, 3 cache lines: constant description, publisher side, consumer side
+typedef struct
+{
+    char magic[8];                  //FRAME_SHM_MAGIC
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;              //BGR, 3
+    uint32_t no_of_slots;
+    uint64_t step;                  //bytes per frame row
+    uint64_t slot_size;             //distance in bytes between two slot frames, page multiple
+    uint64_t frames_offset;         //first slot frame, from the start of the object, page aligned
+    uint32_t camera;
+    uint32_t publish_interval;      //every n-th captured frame is published
+    uint8_t reserved0[8];
+    //publisher side, written by the publisher only
+    uint64_t head __attribute__((aligned(FRAME_SHM_CACHE_LINE_SIZE)));     //last published sequence, 0 for none, atomic
+    uint32_t state;                 //FRAME_SHM_STATE_xxx, atomic
+    uint32_t notify;                //futex word, incremented on every publish and on close, atomic
+    //consumer side, the only field consumers write
+    uint32_t waiters __attribute__((aligned(FRAME_SHM_CACHE_LINE_SIZE)));  //consumers waiting on notify, atomic
+}frame_shm_header_t;
+
+//slot descriptor, one cache line
+//seqlock: the publisher makes generation odd, writes the frame and the descriptor, then makes it even again. A frame
+//used while generation stays the same (and even) was not touched by the publisher
+typedef struct
+{
+    uint64_t generation;            //atomic
+    uint64_t sequence;              //publish sequence, starts at 1, slot is (sequence - 1) % no_of_slots
+    uint64_t frame_sequence;        //capture sequence (every captured frame)
+    uint64_t capture_nsec;          //CLOCK_MONOTONIC, frame captured
+    uint64_t publish_nsec;          //CLOCK_MONOTONIC, frame complete in the slot
+    int64_t wall_sec;               //wall clock, frame captured
+    int64_t wall_usec;
+    uint8_t reserved[8];
+} __attribute__((aligned(FRAME_SHM_CACHE_LINE_SIZE))) frame_shm_slot_t;
+
+#endif //_FRAME_SHM_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
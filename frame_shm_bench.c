@@ -0,0 +1,213 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_shm_bench.c
+//
+//  Description: Publish to consume latency of the shared memory frame ring (see frame_publisher.c, frame_subscriber.c).
+//               A consumer process is forked, it waits on the ring and acquires every frame, the parent publishes
+//               frames at a fixed rate. Reports the publish time (the RT side cost), the latency from a complete
+//               frame in the slot to the consumer holding it, and the frames missed, overwritten while in use, or
+//               with wrong pixels. Exits with EXIT_FAILURE if a frame had wrong pixels
+//
+//               Usage: ./frame_shm_bench [frames, default 1000] [rate Hz, default 100] [WIDTHxHEIGHT, default 640x480]
+//
+
+#include "include.h"
+#include "frame_publisher.h"
+#include "frame_subscriber.h"
+#include "histogram.h"
+#include <sys/wait.h>
+
+#define DEFAULT_BENCH_FRAMES        (1000)
+#define DEFAULT_BENCH_RATE_HZ       (100)
+#define MAX_BENCH_RATE_HZ           (1000)
+#define BENCH_SHM_NAME              "/frame_shm_bench"
+
+//the consumer is waiting on the ring before the first frame
+#define BENCH_CONSUMER_START_MSEC   (200)
+#define BENCH_CONSUMER_WAIT_MSEC    (1000)
+
+//local functions
+static int consume_frames(void);
+static unsigned long long now_nsec(void);
+static void print_usage(void);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  main
+//
+//  Parameters:     argc, argv - optional frames, rate and resolution
+//
+//  Return:         EXIT_SUCCESS, or EXIT_FAILURE if the consumer saw wrong pixels
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    unsigned int frames = DEFAULT_BENCH_FRAMES, rate = DEFAULT_BENCH_RATE_HZ, width = FRAME_HRES, height = FRAME_VRES, i;
+    int status;
+    pid_t consumer;
+    frame_t frame;
+    frame_publisher_t publisher;
+    struct timespec release_time;
+
+    if(argc > 4)
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+    if(argc > 1) frames = atoi(argv[1]);
+    if(argc > 2) rate = atoi(argv[2]);
+    if((argc > 3) && (sscanf(argv[3], "%ux%u", &width, &height) != 2)) width = 0;
+    if(!frames || !rate || (rate > MAX_BENCH_RATE_HZ) || !width || !height)
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    memset(&frame, 0, sizeof(frame));
+    frame.width = width;
+    frame.height = height;
+    frame.channels = 3;
+    frame.step = (size_t)width * 3;
+    frame.data = (unsigned char *)malloc(frame.step * height);
+    if(!frame.data) EXIT_FAIL("malloc");
+
+    frame_publisher_open(&publisher, BENCH_SHM_NAME, DEFAULT_FRAME_SHM_SLOTS, width, height, 3, 1, 0);
+
+    fflush(stdout);
+    consumer = fork();
+    if(consumer == -1) EXIT_FAIL("fork");
+    if(!consumer)
+    {
+        exit(consume_frames());
+    }
+
+    usleep(BENCH_CONSUMER_START_MSEC * USEC_PER_MSEC);
+
+    clock_gettime(CLOCK_MONOTONIC, &release_time);
+    for(i = 0; i < frames; ++i)
+    {
+        //every byte of a frame is its sequence, checked by the consumer
+        frame.sequence = i + 1;
+        memset(frame.data, frame.sequence & 0xFF, frame.step * height);
+        clock_gettime(CLOCK_MONOTONIC, &frame.capture_time);
+        gettimeofday(&frame.wall_time, NULL);
+
+        frame_publisher_offer(&publisher, &frame);
+
+        release_time.tv_nsec += NSEC_PER_SEC / rate;
+        if(release_time.tv_nsec >= NSEC_PER_SEC)
+        {
+            release_time.tv_nsec -= NSEC_PER_SEC;
+            ++release_time.tv_sec;
+        }
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &release_time, NULL) == EINTR);
+    }
+
+    frame_publisher_close(&publisher);
+    if(waitpid(consumer, &status, 0) == -1) EXIT_FAIL("waitpid");
+
+    fprintf(stdout, "\n%u frames %ux%u at %u Hz, %u slots\n", frames, width, height, rate, DEFAULT_FRAME_SHM_SLOTS);
+    fprintf(stdout, "publish:            p50 %8.1lf us, p99 %8.1lf us, max %8.1lf us, %llu consumer wakes\n",
+            (double)histogram_percentile(&publisher.publish_time, 50.0) / NSEC_PER_USEC,
+            (double)histogram_percentile(&publisher.publish_time, 99.0) / NSEC_PER_USEC,
+            (double)histogram_max(&publisher.publish_time) / NSEC_PER_USEC, publisher.wakes);
+
+    free(frame.data);
+
+    return (WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  consume_frames
+//
+//  Parameters:     None
+//
+//  Return:         EXIT_SUCCESS, or EXIT_FAILURE if a frame released intact had wrong pixels
+//
+//  Description:    Consumer process: waits for every frame, records the publish to consume latency, checks the first
+//                  and last byte of the frame, and releases it. Prints its results once the ring is closed
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int consume_frames(void)
+{
+    frame_subscriber_t subscriber;
+    frame_subscriber_frame_t frame;
+    histogram_t latency;
+    unsigned long long consumed_nsec, wrong_pixels = 0;
+    unsigned char first, last;
+
+    histogram_reset(&latency);
+
+    if(frame_subscriber_open(&subscriber, BENCH_SHM_NAME))
+    {
+        fprintf(stderr, "frame_subscriber_open: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    while(!frame_subscriber_wait(&subscriber, BENCH_CONSUMER_WAIT_MSEC) || (errno == ETIMEDOUT))
+    {
+        while(!frame_subscriber_acquire(&subscriber, &frame, FRAME_SUBSCRIBER_NEXT))
+        {
+            consumed_nsec = now_nsec();
+            histogram_record(&latency, (consumed_nsec > frame.publish_nsec) ? (consumed_nsec - frame.publish_nsec) : 0);
+
+            first = frame.data[0];
+            last = frame.data[(frame.step * frame.height) - 1];
+
+            //overwritten frames are counted by the subscriber, their pixels are not checked
+            if(!frame_subscriber_release(&subscriber, &frame) &&
+               ((first != (frame.frame_sequence & 0xFF)) || (last != (frame.frame_sequence & 0xFF))))
+            {
+                ++wrong_pixels;
+            }
+        }
+    }
+
+    fprintf(stdout, "\npublish to consume: p50 %8.1lf us, p99 %8.1lf us, max %8.1lf us\n",
+            (double)histogram_percentile(&latency, 50.0) / NSEC_PER_USEC, (double)histogram_percentile(&latency, 99.0) / NSEC_PER_USEC,
+            (double)histogram_max(&latency) / NSEC_PER_USEC);
+    fprintf(stdout, "consumer: acquired %llu, missed %llu, overwritten while in use %llu, wrong pixels %llu\n",
+            (unsigned long long)subscriber.acquired, (unsigned long long)subscriber.missed, (unsigned long long)subscriber.torn, wrong_pixels);
+    fflush(stdout);
+
+    frame_subscriber_close(&subscriber);
+
+    return wrong_pixels ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  now_nsec
+//
+//  Parameters:     None
+//
+//  Return:         CLOCK_MONOTONIC in nano seconds, the clock of the slot time-stamps
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static unsigned long long now_nsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((unsigned long long)now.tv_sec * NSEC_PER_SEC) + now.tv_nsec;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  print_usage
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void print_usage(void)
+{
+    fprintf(stderr, "\nUsage: ./frame_shm_bench [frames, default %d] [rate Hz, Max %d, default %d] [WIDTHxHEIGHT, default %dx%d]\n\n",
+            DEFAULT_BENCH_FRAMES, MAX_BENCH_RATE_HZ, DEFAULT_BENCH_RATE_HZ, FRAME_HRES, FRAME_VRES);
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,385 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_source.cpp
+//
+//  Description: Frame sources behind query_frames(). A source fills the preallocated frame ring slots with BGR frames,
+//               from the camera (openCV or V4L2 streaming i/o), a generated test pattern, or replayed frames.
+//               The device backend is in this file, see frame_source_pattern.c and frame_source_replay.cpp for the others
+//
+
+#include "capture.hpp"
+#include "frame_source.h"
+#include "include.h"
+#include "pixel_convert.h"
+#include "v4l2_capture.h"
+
+extern unsigned int capture_io_method;
+extern unsigned int v4l2_buffer_count;
+
+//cpp namespaces
+using namespace cv;
+
+//device backend state
+typedef struct
+{
+    CvCapture *capture;     //IO_METHOD_OPENCV
+    v4l2_device_t v4l2;     //IO_METHOD_MMAP
+}device_source_t;
+
+//local functions
+static void device_open(frame_source_t *source);
+static int device_read(frame_source_t *source, frame_t *frame);
+static void device_close(frame_source_t *source);
+static int device_index(const char *device_path);
+static void convert_v4l2_frame(const v4l2_device_t *v4l2, const v4l2_frame_t *v4l2_frame, Mat &frame_mat);
+
+const frame_source_ops_t frame_source_device_ops =
+{
+    "device",
+    device_open,
+    device_read,
+    device_close
+};
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_source_open
+//
+//  Parameters:     source - source to open
+//                  type - FRAME_SOURCE_xxx
+//                  path - device name (FRAME_SOURCE_DEVICE), replay directory or raw file (FRAME_SOURCE_REPLAY)
+//                  width, height - requested resolution, test pattern and raw replay sources use it as is
+//                  fps - frame rate of the test pattern and replay sources
+//
+//  Return:         None
+//
+//  Description:    Opens the backend, source->width/height are set to the resolution it delivers.
+//                  Exits the application if the source cannot be opened
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_source_open(frame_source_t *source, const int type, const char *path, const unsigned int width,
+                       const unsigned int height, const unsigned int fps)
+{
+    memset(source, 0, sizeof(*source));
+    source->type = type;
+    source->path = path;
+    source->width = width;
+    source->height = height;
+    source->fps = fps;
+
+    switch(type)
+    {
+        case FRAME_SOURCE_DEVICE:
+            source->ops = &frame_source_device_ops;
+            break;
+
+        case FRAME_SOURCE_TEST_PATTERN:
+            source->ops = &frame_source_pattern_ops;
+            break;
+
+        case FRAME_SOURCE_REPLAY:
+            source->ops = &frame_source_replay_ops;
+            break;
+
+        default:
+            errno = EINVAL;
+            EXIT_FAIL("frame_source_open");
+    }
+
+    source->ops->open(source);
+
+    syslog(LOG_WARNING, " frame source: %s %s, %ux%u", source->ops->name, path ? path : "", source->width, source->height);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_source_read
+//
+//  Parameters:     source - opened source
+//                  frame - frame to fill, preallocated with the source resolution (see frame_ring_begin_write())
+//
+//  Return:         SUCCESS, FRAME_SOURCE_NO_FRAME if the device delivered no frame within this release (the frame
+//                  is left as is), or ERROR if the source has no more frames
+//
+//  Description:    Fills the frame pixels and its source sequence. V4L2 devices give the driver buffer sequence and
+//                  time-stamp, other sources count the frames read and leave exposure_time zero. Capture time-stamps
+//                  are left to the caller
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int frame_source_read(frame_source_t *source, frame_t *frame)
+{
+    int rc;
+    const unsigned long long source_sequence = frame->source_sequence;
+    const struct timespec exposure_time = frame->exposure_time;
+
+    assert((frame->width == source->width) && (frame->height == source->height) && (frame->channels == 3));
+
+    //backends with driver time-stamps overwrite them
+    frame->source_sequence = source->frames_read;
+    frame->exposure_time.tv_sec = 0;
+    frame->exposure_time.tv_nsec = 0;
+
+    rc = source->ops->read(source, frame);
+    if(rc == FRAME_SOURCE_NO_FRAME)
+    {
+        //late frame, the frame (a published one, see frame_ring_abort_write()) is left as is
+        frame->source_sequence = source_sequence;
+        frame->exposure_time = exposure_time;
+        ++source->frames_missed;
+    }
+    if(rc) return rc;
+
+    ++source->frames_read;
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_source_close
+//
+//  Parameters:     source - opened source
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_source_close(frame_source_t *source)
+{
+    source->ops->close(source);
+
+    syslog(LOG_WARNING, " frame source: %s closed, %llu frames read, %llu reads with no frame, %llu older frames skipped",
+           source->ops->name, source->frames_read, source->frames_missed, source->frames_skipped);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_source_period_msec
+//
+//  Parameters:     type - FRAME_SOURCE_xxx
+//                  fps - frame rate of the test pattern and replay sources
+//
+//  Return:         Release period of query_frames_thread for the source
+//
+//  Description:    The device is queried every QUERY_FRAMES_INTERVAL_IN_MSEC. Test pattern and replay sources deliver
+//                  one frame per release, so their rate is set by the query period
+//
+//------------------------------------------------------------------------------------------------------------------------------
+unsigned int frame_source_period_msec(const int type, const unsigned int fps)
+{
+    if(type == FRAME_SOURCE_DEVICE) return QUERY_FRAMES_INTERVAL_IN_MSEC;
+
+    return MSEC_PER_SEC / fps;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_source_name
+//
+//  Parameters:     source - opened source
+//
+//  Return:         Backend name
+//
+//------------------------------------------------------------------------------------------------------------------------------
+const char *frame_source_name(const frame_source_t *source)
+{
+    return source->ops->name;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  device_open
+//
+//  Parameters:     source - source being opened
+//
+//  Return:         None
+//
+//  Description:    Opens the camera with openCV or V4L2 streaming i/o (-m), and starts capturing
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void device_open(frame_source_t *source)
+{
+    device_source_t *device;
+    const struct v4l2_format *fmt;
+    IplImage *first_frame;
+
+    device = (device_source_t *)calloc(1, sizeof(*device));
+    if(!device) EXIT_FAIL("calloc");
+    source->state = device;
+
+    if(capture_io_method == IO_METHOD_MMAP)
+    {
+        v4l2_initialize_device(&device->v4l2, source->path, v4l2_buffer_count);
+        fmt = v4l2_get_format(&device->v4l2);
+        source->width = fmt->fmt.pix.width;
+        source->height = fmt->fmt.pix.height;
+
+        v4l2_start_capturing(&device->v4l2);
+        return;
+    }
+
+    //openCV opens the camera by index, /dev/videoX is index X
+    device->capture = cvCreateCameraCapture(device_index(source->path));
+    if(!device->capture) EXIT_FAIL("cvCreateCameraCapture");
+    //set capture properties
+    cvSetCaptureProperty(device->capture, CV_CAP_PROP_FRAME_WIDTH, source->width);
+    cvSetCaptureProperty(device->capture, CV_CAP_PROP_FRAME_HEIGHT, source->height);
+
+    //grab and retrieve a frame, to find the resolution the device delivers
+    first_frame = cvQueryFrame(device->capture);
+    if(!first_frame) EXIT_FAIL("Problem initializing the device");
+    assert(first_frame->nChannels == 3);
+
+    source->width = first_frame->width;
+    source->height = first_frame->height;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  device_read
+//
+//  Parameters:     source - opened device source
+//                  frame - frame to fill
+//
+//  Return:         SUCCESS, FRAME_SOURCE_NO_FRAME if no V4L2 buffer was filled within one query period (late frame),
+//                  or ERROR if openCV delivered no frame
+//
+//  Description:    V4L2: waits at most one query period for a filled buffer, and converts the newest one straight from
+//                  the kernel mapped buffer into the frame, along with the buffer sequence and time-stamp. openCV: grabs,
+//                  retrieves, and copies the frame
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int device_read(frame_source_t *source, frame_t *frame)
+{
+    device_source_t *device = (device_source_t *)source->state;
+    v4l2_frame_t v4l2_frame;
+    IplImage *retrieve_frame;
+    Mat frame_mat(frame->height, frame->width, CV_8UC3, frame->data, frame->step);
+
+    if(capture_io_method == IO_METHOD_MMAP)
+    {
+        //wait for the driver to fill a buffer, at most one query period. A late frame is taken in the next release
+        if(v4l2_dequeue_frame(&device->v4l2, &v4l2_frame, QUERY_FRAMES_INTERVAL_IN_MSEC)) return FRAME_SOURCE_NO_FRAME;
+        source->frames_skipped += v4l2_frame.skipped;
+
+        //convert straight from the kernel mapped buffer into the slot
+        convert_v4l2_frame(&device->v4l2, &v4l2_frame, frame_mat);
+
+        //driver sequence, and its time-stamp unless the driver uses another clock than CLOCK_MONOTONIC
+        frame->source_sequence = v4l2_frame.sequence;
+        if((v4l2_frame.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+        {
+            frame->exposure_time.tv_sec = v4l2_frame.timestamp.tv_sec;
+            frame->exposure_time.tv_nsec = v4l2_frame.timestamp.tv_usec * NSEC_PER_USEC;
+        }
+
+        //hand the buffer back to the driver
+        v4l2_enqueue_frame(&device->v4l2, &v4l2_frame);
+        return SUCCESS;
+    }
+
+    //grab a new frame. Returns a valid int on Success
+    if(!(cvGrabFrame(device->capture))) EXIT_FAIL("cvGrabFrame"); //grab new frame
+    retrieve_frame = cvRetrieveFrame(device->capture);
+    //no valid data
+    if(!retrieve_frame) return ERROR;
+
+    cvarrToMat(retrieve_frame).copyTo(frame_mat);
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  device_close
+//
+//  Parameters:     source - opened device source
+//
+//  Return:         None
+//
+//  Description:    Stops capturing and releases the device
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void device_close(frame_source_t *source)
+{
+    device_source_t *device = (device_source_t *)source->state;
+
+    if(capture_io_method == IO_METHOD_MMAP)
+    {
+        v4l2_stop_capturing(&device->v4l2);
+        v4l2_uninitialize_device(&device->v4l2);
+    }
+    else
+    {
+        cvReleaseCapture(&device->capture);
+    }
+
+    free(device);
+    source->state = NULL;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  device_index
+//
+//  Parameters:     device_path - /dev/videoX
+//
+//  Return:         X, 0 if the name has no trailing number
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int device_index(const char *device_path)
+{
+    const char *digits;
+
+    if(!device_path) return 0;
+
+    digits = device_path + strlen(device_path);
+    while((digits > device_path) && (digits[-1] >= '0') && (digits[-1] <= '9')) --digits;
+
+    return *digits ? atoi(digits) : 0;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  convert_v4l2_frame
+//
+//  Parameters:     v4l2 - streaming device
+//                  v4l2_frame - dequeued frame, pointing into the kernel mapped buffer
+//                  frame_mat - BGR destination, preallocated with the device resolution
+//
+//  Return:         None
+//
+//  Description:    Converts the device pixel format to BGR, straight from the mapped buffer into frame_mat.
+//                  YUYV and UYVY use the vector kernels of pixel_convert.c
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void convert_v4l2_frame(const v4l2_device_t *v4l2, const v4l2_frame_t *v4l2_frame, Mat &frame_mat)
+{
+    const struct v4l2_format *fmt = v4l2_get_format(v4l2);
+    void *data = (void *)v4l2_frame->data;
+
+    switch(fmt->fmt.pix.pixelformat)
+    {
+        case V4L2_PIX_FMT_YUYV:
+            pixel_convert(PIXEL_CONVERT_YUYV_TO_BGR, (const unsigned char *)data, fmt->fmt.pix.bytesperline, frame_mat.data,
+                          frame_mat.step, fmt->fmt.pix.width, fmt->fmt.pix.height);
+            break;
+
+        case V4L2_PIX_FMT_UYVY:
+            pixel_convert(PIXEL_CONVERT_UYVY_TO_BGR, (const unsigned char *)data, fmt->fmt.pix.bytesperline, frame_mat.data,
+                          frame_mat.step, fmt->fmt.pix.width, fmt->fmt.pix.height);
+            break;
+
+        case V4L2_PIX_FMT_RGB24:
+            cvtColor(Mat(fmt->fmt.pix.height, fmt->fmt.pix.width, CV_8UC3, data, fmt->fmt.pix.bytesperline), frame_mat, CV_RGB2BGR);
+            break;
+
+        case V4L2_PIX_FMT_BGR24:
+            Mat(fmt->fmt.pix.height, fmt->fmt.pix.width, CV_8UC3, data, fmt->fmt.pix.bytesperline).copyTo(frame_mat);
+            break;
+
+        default:
+            EXIT_FAIL("Unsupported V4L2 pixel format");
+    }
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,77 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_source.h
+//
+//  Description: Header file for frame_source.cpp, frame_source_pattern.c and frame_source_replay.cpp
+//
+
+#ifndef _FRAME_SOURCE_H
+#define _FRAME_SOURCE_H
+
+#include "frame_ring.h"
+#include "include.h"
+
+//frame sources, selected with -i
+#define FRAME_SOURCE_DEVICE         (0) //camera (-d), through openCV or V4L2 streaming i/o (-m)
+#define FRAME_SOURCE_TEST_PATTERN   (1) //deterministic generated frames, no device needed
+#define FRAME_SOURCE_REPLAY         (2) //directory of .ppm/.png frames, or a raw BGR24 file (-p)
+#define FRAME_SOURCES               (3)
+
+//frame rate of the test pattern and replay sources, the device is queried every QUERY_FRAMES_INTERVAL_IN_MSEC
+#define MIN_FRAME_SOURCE_FPS        (1)
+#define DEFAULT_FRAME_SOURCE_FPS    (MSEC_PER_SEC / QUERY_FRAMES_INTERVAL_IN_MSEC)
+#define MAX_FRAME_SOURCE_FPS        (100)
+
+//max resolution of the test pattern and raw replay sources (-g)
+#define MAX_FRAME_SOURCE_HRES       (4096)
+#define MAX_FRAME_SOURCE_VRES       (4096)
+
+//frame_source_read() return, besides SUCCESS and ERROR (no more frames): no frame within this release, try the next one
+#define FRAME_SOURCE_NO_FRAME       (1)
+
+typedef struct frame_source frame_source_t;
+
+//backend of a frame source
+typedef struct
+{
+    const char *name;
+    void (*open)(frame_source_t *source);                   //sets width and height to the delivered resolution
+    int (*read)(frame_source_t *source, frame_t *frame);    //fills frame->data (BGR), SUCCESS, FRAME_SOURCE_NO_FRAME,
+                                                            //or ERROR at end of data
+    void (*close)(frame_source_t *source);
+}frame_source_ops_t;
+
+//frame source, filled by frame_source_open()
+struct frame_source
+{
+    const frame_source_ops_t *ops;
+    int type;                       //FRAME_SOURCE_xxx
+    const char *path;               //device name, or replay directory/file
+    unsigned int width;             //requested, then delivered resolution
+    unsigned int height;
+    unsigned int fps;               //test pattern and replay sources
+    unsigned long long frames_read;
+    unsigned long long frames_missed;   //reads with no frame within the release (FRAME_SOURCE_NO_FRAME)
+    unsigned long long frames_skipped;  //older device frames handed back unread for a newer one
+    void *state;                    //backend private
+};
+
+//backends
+extern const frame_source_ops_t frame_source_device_ops;
+extern const frame_source_ops_t frame_source_pattern_ops;
+extern const frame_source_ops_t frame_source_replay_ops;
+
+//APIs
+void frame_source_open(frame_source_t *source, const int type, const char *path, const unsigned int width,
+                       const unsigned int height, const unsigned int fps);
+int frame_source_read(frame_source_t *source, frame_t *frame);
+void frame_source_close(frame_source_t *source);
+unsigned int frame_source_period_msec(const int type, const unsigned int fps);
+const char *frame_source_name(const frame_source_t *source);
+
+#endif //_FRAME_SOURCE_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,179 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_source_pattern.c
+//
+//  Description: Deterministic test pattern frame source. Frame N is the same on every run and every host: a fixed
+//               gradient background, a square moving across it, and N encoded as black/white blocks in the bottom row,
+//               so the pipeline can be benchmarked without a camera and stored frames can be matched to their number
+//
+
+#include "include.h"
+#include "frame_source.h"
+
+//moving square
+#define PATTERN_SQUARE_SIZE         (64)
+#define PATTERN_SQUARE_STEP         (8)     //pixels per frame
+
+//frame number, one block per bit, MSB first
+#define PATTERN_COUNTER_BITS        (32)
+
+//test pattern backend state
+typedef struct
+{
+    unsigned char *background;      //width*height*3, rendered once
+    unsigned int counter_block;     //width of a frame number block
+    unsigned long long frame_no;
+}pattern_source_t;
+
+//local functions
+static void pattern_open(frame_source_t *source);
+static int pattern_read(frame_source_t *source, frame_t *frame);
+static void pattern_close(frame_source_t *source);
+static void fill_rect(frame_t *frame, const unsigned int x, const unsigned int y, const unsigned int width,
+                      const unsigned int height, const unsigned char b, const unsigned char g, const unsigned char r);
+
+const frame_source_ops_t frame_source_pattern_ops =
+{
+    "test pattern",
+    pattern_open,
+    pattern_read,
+    pattern_close
+};
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  pattern_open
+//
+//  Parameters:     source - source being opened, delivers the requested resolution
+//
+//  Return:         None
+//
+//  Description:    Renders the background once, every frame starts as a copy of it
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void pattern_open(frame_source_t *source)
+{
+    unsigned int row, col;
+    unsigned char *pixel;
+    pattern_source_t *pattern;
+
+    if((source->width < PATTERN_SQUARE_SIZE) || (source->height < 2 * PATTERN_SQUARE_SIZE))
+    {
+        errno = EINVAL;
+        EXIT_FAIL("test pattern resolution");
+    }
+
+    pattern = (pattern_source_t *)calloc(1, sizeof(*pattern));
+    if(!pattern) EXIT_FAIL("calloc");
+
+    pattern->background = (unsigned char *)malloc((size_t)source->width * source->height * 3);
+    if(!pattern->background) EXIT_FAIL("malloc");
+    pattern->counter_block = source->width / PATTERN_COUNTER_BITS;
+
+    //blue left to right, green top to bottom, red constant
+    pixel = pattern->background;
+    for(row = 0; row < source->height; ++row)
+    {
+        for(col = 0; col < source->width; ++col, pixel += 3)
+        {
+            pixel[0] = (unsigned char)((col * 255) / (source->width - 1));
+            pixel[1] = (unsigned char)((row * 255) / (source->height - 1));
+            pixel[2] = 128;
+        }
+    }
+
+    source->state = pattern;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  pattern_read
+//
+//  Parameters:     source - opened test pattern source
+//                  frame - frame to fill
+//
+//  Return:         SUCCESS, the pattern never ends
+//
+//  Description:    Copies the background, draws the square at its position for this frame, and the frame number
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int pattern_read(frame_source_t *source, frame_t *frame)
+{
+    unsigned int row, bit, x, y, travel;
+    const size_t row_size = (size_t)frame->width * 3;
+    pattern_source_t *pattern = (pattern_source_t *)source->state;
+    unsigned char level;
+
+    for(row = 0; row < frame->height; ++row)
+    {
+        memcpy(frame->data + row * frame->step, pattern->background + row * row_size, row_size);
+    }
+
+    //square travels left to right on a diagonal, and starts over
+    travel = (unsigned int)((pattern->frame_no * PATTERN_SQUARE_STEP) % (frame->width - PATTERN_SQUARE_SIZE + 1));
+    x = travel;
+    y = (travel * (frame->height - 2 * PATTERN_SQUARE_SIZE)) / (frame->width - PATTERN_SQUARE_SIZE + 1);
+    fill_rect(frame, x, y, PATTERN_SQUARE_SIZE, PATTERN_SQUARE_SIZE, 255, 255, 255);
+
+    //frame number in the bottom band
+    for(bit = 0; bit < PATTERN_COUNTER_BITS; ++bit)
+    {
+        level = ((pattern->frame_no >> (PATTERN_COUNTER_BITS - 1 - bit)) & 1) ? 255 : 0;
+        fill_rect(frame, bit * pattern->counter_block, frame->height - PATTERN_SQUARE_SIZE / 2,
+                  pattern->counter_block, PATTERN_SQUARE_SIZE / 2, level, level, level);
+    }
+
+    ++pattern->frame_no;
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  pattern_close
+//
+//  Parameters:     source - opened test pattern source
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void pattern_close(frame_source_t *source)
+{
+    pattern_source_t *pattern = (pattern_source_t *)source->state;
+
+    free(pattern->background);
+    free(pattern);
+    source->state = NULL;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  fill_rect
+//
+//  Parameters:     frame - BGR frame
+//                  x, y, width, height - rectangle, inside the frame
+//                  b, g, r - color
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void fill_rect(frame_t *frame, const unsigned int x, const unsigned int y, const unsigned int width,
+                      const unsigned int height, const unsigned char b, const unsigned char g, const unsigned char r)
+{
+    unsigned int row, col;
+    unsigned char *pixel;
+
+    for(row = y; row < (y + height); ++row)
+    {
+        pixel = frame->data + row * frame->step + x * 3;
+        for(col = 0; col < width; ++col, pixel += 3)
+        {
+            pixel[0] = b;
+            pixel[1] = g;
+            pixel[2] = r;
+        }
+    }
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
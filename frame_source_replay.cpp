@@ -0,0 +1,380 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_source_replay.cpp
+//
+//  Description: Replay frame source. Plays back a directory of .ppm/.png frames (in file name order), or a raw file
+//               of BGR24 frames back to back, one frame per query release, and starts over at the end.
+//               .ppm and raw frames are read straight into the frame slot, .png frames are decoded with openCV
+//
+
+#include "capture.hpp"
+#include "frame_source.h"
+#include "include.h"
+#include "ppm_writer.h"
+#include <dirent.h>
+#include <limits.h>
+#include <strings.h>
+
+//cpp namespaces
+using namespace cv;
+
+//replayed file types
+#define REPLAY_RAW      (0)
+#define REPLAY_PPM      (1)
+#define REPLAY_PNG      (2)
+
+//replay backend state
+typedef struct
+{
+    int raw_fd;                     //raw file, -1 for a directory
+    struct dirent **files;          //directory entries, file name order
+    int no_of_files;
+    char file_name[PATH_MAX];
+    unsigned long long no_of_frames;
+    unsigned long long frame_no;
+}replay_source_t;
+
+//local functions
+static void replay_open(frame_source_t *source);
+static int replay_read(frame_source_t *source, frame_t *frame);
+static void replay_close(frame_source_t *source);
+static int replay_file_type(const char *file_name);
+static int replay_file_filter(const struct dirent *entry);
+static void read_ppm_frame(const char *file_name, frame_t *frame);
+static size_t read_ppm_header(const int fd, unsigned int *width, unsigned int *height);
+static void read_frame_rows(const int fd, frame_t *frame, const off_t offset);
+static void read_png_frame(const char *file_name, frame_t *frame);
+
+const frame_source_ops_t frame_source_replay_ops =
+{
+    "replay",
+    replay_open,
+    replay_read,
+    replay_close
+};
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  replay_open
+//
+//  Parameters:     source - source being opened, source->path is a directory or a raw file
+//
+//  Return:         None
+//
+//  Description:    Directory: lists the .ppm/.png files, the first one sets the resolution.
+//                  Raw file: source->width x source->height BGR24 frames, a trailing partial frame is ignored
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void replay_open(frame_source_t *source)
+{
+    int fd;
+    struct stat path_stats;
+    replay_source_t *replay;
+    Mat first_frame;
+
+    if(!source->path)
+    {
+        errno = EINVAL;
+        EXIT_FAIL("replay path (-p)");
+    }
+    if(stat(source->path, &path_stats))
+    {
+        fprintf(stderr, "Cannot identify '%s'\n", source->path);
+        EXIT_FAIL("stat");
+    }
+
+    replay = (replay_source_t *)calloc(1, sizeof(*replay));
+    if(!replay) EXIT_FAIL("calloc");
+    replay->raw_fd = -1;
+    source->state = replay;
+
+    if(S_ISREG(path_stats.st_mode))
+    {
+        replay->raw_fd = open(source->path, O_RDONLY);
+        if(replay->raw_fd == -1) EXIT_FAIL("open");
+
+        replay->no_of_frames = path_stats.st_size / ((off_t)source->width * source->height * 3);
+        if(!replay->no_of_frames)
+        {
+            fprintf(stderr, "'%s' is smaller than one %ux%u BGR24 frame\n", source->path, source->width, source->height);
+            errno = EINVAL;
+            EXIT_FAIL("replay_open");
+        }
+        return;
+    }
+
+    if(!S_ISDIR(path_stats.st_mode))
+    {
+        fprintf(stderr, "'%s' is no directory or regular file\n", source->path);
+        errno = EINVAL;
+        EXIT_FAIL("replay_open");
+    }
+
+    replay->no_of_files = scandir(source->path, &replay->files, replay_file_filter, alphasort);
+    if(replay->no_of_files < 0) EXIT_FAIL("scandir");
+    if(!replay->no_of_files)
+    {
+        fprintf(stderr, "No .ppm/.png frames in '%s'\n", source->path);
+        errno = ENOENT;
+        EXIT_FAIL("replay_open");
+    }
+    replay->no_of_frames = replay->no_of_files;
+
+    //first frame sets the resolution
+    snprintf(replay->file_name, sizeof(replay->file_name), "%s/%s", source->path, replay->files[0]->d_name);
+    if(replay_file_type(replay->file_name) == REPLAY_PPM)
+    {
+        fd = open(replay->file_name, O_RDONLY);
+        if(fd == -1) EXIT_FAIL("open");
+        if(!read_ppm_header(fd, &source->width, &source->height)) EXIT_FAIL(replay->file_name);
+        close(fd);
+    }
+    else
+    {
+        first_frame = imread(replay->file_name, CV_LOAD_IMAGE_COLOR);
+        if(first_frame.empty()) EXIT_FAIL(replay->file_name);
+        source->width = first_frame.cols;
+        source->height = first_frame.rows;
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  replay_read
+//
+//  Parameters:     source - opened replay source
+//                  frame - frame to fill
+//
+//  Return:         SUCCESS, replay starts over at the end
+//
+//  Description:    Reads the next frame into the slot. .png frames are decoded by openCV, which allocates, so .ppm or raw
+//                  replays are preferred for timing the store path
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int replay_read(frame_source_t *source, frame_t *frame)
+{
+    replay_source_t *replay = (replay_source_t *)source->state;
+    const unsigned long long idx = replay->frame_no % replay->no_of_frames;
+
+    if(replay->raw_fd != -1)
+    {
+        read_frame_rows(replay->raw_fd, frame, (off_t)(idx * frame->width * frame->height * 3));
+    }
+    else
+    {
+        snprintf(replay->file_name, sizeof(replay->file_name), "%s/%s", source->path, replay->files[idx]->d_name);
+
+        if(replay_file_type(replay->file_name) == REPLAY_PPM)
+        {
+            read_ppm_frame(replay->file_name, frame);
+        }
+        else
+        {
+            read_png_frame(replay->file_name, frame);
+        }
+    }
+
+    ++replay->frame_no;
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  replay_close
+//
+//  Parameters:     source - opened replay source
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void replay_close(frame_source_t *source)
+{
+    int i;
+    replay_source_t *replay = (replay_source_t *)source->state;
+
+    if(replay->raw_fd != -1) close(replay->raw_fd);
+
+    for(i = 0; i < replay->no_of_files; ++i)
+    {
+        free(replay->files[i]);
+    }
+    free(replay->files);
+
+    free(replay);
+    source->state = NULL;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  replay_file_type
+//
+//  Parameters:     file_name - file name
+//
+//  Return:         REPLAY_PPM, REPLAY_PNG, or ERROR for any other extension
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int replay_file_type(const char *file_name)
+{
+    const char *extension = strrchr(file_name, '.');
+
+    if(!extension) return ERROR;
+    if(!strcasecmp(extension, ".ppm")) return REPLAY_PPM;
+    if(!strcasecmp(extension, ".png")) return REPLAY_PNG;
+
+    return ERROR;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  replay_file_filter
+//
+//  Parameters:     entry - directory entry
+//
+//  Return:         Non-zero for .ppm/.png files
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int replay_file_filter(const struct dirent *entry)
+{
+    return replay_file_type(entry->d_name) != ERROR;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  read_ppm_frame
+//
+//  Parameters:     file_name - binary (P6) .ppm file, with the source resolution
+//                  frame - frame to fill
+//
+//  Return:         None
+//
+//  Description:    Reads the RGB rows straight into the slot, and swaps them to BGR in place
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void read_ppm_frame(const char *file_name, frame_t *frame)
+{
+    int fd;
+    size_t header_size;
+    unsigned int width, height, row, col;
+    unsigned char swap, *pixel;
+
+    fd = open(file_name, O_RDONLY);
+    if(fd == -1) EXIT_FAIL("open");
+
+    header_size = read_ppm_header(fd, &width, &height);
+    if(!header_size) EXIT_FAIL(file_name);
+    if((width != frame->width) || (height != frame->height))
+    {
+        fprintf(stderr, "'%s' is %ux%u, replaying %ux%u\n", file_name, width, height, frame->width, frame->height);
+        errno = EINVAL;
+        EXIT_FAIL("read_ppm_frame");
+    }
+
+    read_frame_rows(fd, frame, header_size);
+    close(fd);
+
+    for(row = 0; row < frame->height; ++row)
+    {
+        pixel = frame->data + row * frame->step;
+        for(col = 0; col < frame->width; ++col, pixel += 3)
+        {
+            swap = pixel[0];
+            pixel[0] = pixel[2];
+            pixel[2] = swap;
+        }
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  read_ppm_header
+//
+//  Parameters:     fd - .ppm file
+//                  width, height - set to the frame resolution
+//
+//  Return:         Header size in bytes (pixel data offset), 0 if the file is no binary 8 bit (P6) .ppm file
+//
+//  Description:    Reads the header, see ppm_parse_header()
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static size_t read_ppm_header(const int fd, unsigned int *width, unsigned int *height)
+{
+    char header[PPM_MAX_HEADER_SIZE];
+    ssize_t header_size;
+
+    header_size = pread(fd, header, sizeof(header), 0);
+    if(header_size < 0) return 0;
+
+    return ppm_parse_header(header, header_size, width, height);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  read_frame_rows
+//
+//  Parameters:     fd - file with width*3 bytes per row from offset
+//                  frame - frame to fill
+//                  offset - file offset of the first row
+//
+//  Return:         None
+//
+//  Description:    Reads the rows straight into the slot, in one read if the slot rows are not padded
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void read_frame_rows(const int fd, frame_t *frame, const off_t offset)
+{
+    unsigned int row;
+    size_t done;
+    ssize_t rc;
+    const size_t row_size = (size_t)frame->width * 3;
+    const unsigned int no_of_reads = (frame->step == row_size) ? 1 : frame->height;
+    const size_t read_size = (frame->step == row_size) ? row_size * frame->height : row_size;
+
+    for(row = 0; row < no_of_reads; ++row)
+    {
+        for(done = 0; done < read_size; done += rc)
+        {
+            rc = pread(fd, frame->data + row * frame->step + done, read_size - done, offset + row * read_size + done);
+            if((rc == -1) && (errno == EINTR))
+            {
+                rc = 0;
+                continue;
+            }
+            if(rc == -1) EXIT_FAIL("pread");
+            if(rc == 0)
+            {
+                errno = EIO;
+                EXIT_FAIL("replay file truncated");
+            }
+        }
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  read_png_frame
+//
+//  Parameters:     file_name - .png file, with the source resolution
+//                  frame - frame to fill
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void read_png_frame(const char *file_name, frame_t *frame)
+{
+    Mat frame_mat(frame->height, frame->width, CV_8UC3, frame->data, frame->step);
+    Mat png_frame = imread(file_name, CV_LOAD_IMAGE_COLOR);
+
+    if(png_frame.empty()) EXIT_FAIL(file_name);
+    if((png_frame.cols != (int)frame->width) || (png_frame.rows != (int)frame->height))
+    {
+        fprintf(stderr, "'%s' is %dx%d, replaying %ux%u\n", file_name, png_frame.cols, png_frame.rows, frame->width, frame->height);
+        errno = EINVAL;
+        EXIT_FAIL("read_png_frame");
+    }
+
+    png_frame.copyTo(frame_mat);
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
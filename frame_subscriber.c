@@ -0,0 +1,287 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_subscriber.c
+//
+//  Description: Consumer library of the shared memory frame ring (see frame_shm.h, frame_publisher.c). Frames are used
+//               in place, read-only, the publisher never waits for a consumer: a frame acquired with
+//               frame_subscriber_acquire() is checked by frame_subscriber_release(), which tells if the publisher
+//               overwrote it in the meantime (results computed from it must then be dropped). Waiting for frames is a
+//               futex wait, woken by the publisher only while a consumer waits.
+//               Standalone, builds without the rest of the tree
+//
+
+#include "frame_subscriber.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SUBSCRIBER_NAME_SIZE        (256)
+#define SUBSCRIBER_NSEC_PER_SEC     (1000000000LL)
+#define SUBSCRIBER_NSEC_PER_MSEC    (1000000LL)
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_subscriber_open
+//
+//  Parameters:     subscriber - subscriber to initialize
+//                  name - shared memory object name (-M), a '/' is prepended if missing
+//
+//  Return:         0, or -1 with errno set (ENOENT not published, EAGAIN not initialized yet, EPROTO not a frame ring)
+//
+//  Description:    Maps the object read-only, and its first page read-write for the waiters count. Frames published
+//                  from now on are acquired
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int frame_subscriber_open(frame_subscriber_t *subscriber, const char *name)
+{
+    int fd, error;
+    char shm_name[SUBSCRIBER_NAME_SIZE];
+    struct stat shm_stat;
+    const frame_shm_header_t *header;
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+
+    memset(subscriber, 0, sizeof(*subscriber));
+    snprintf(shm_name, sizeof(shm_name), "%s%s", (name[0] == '/') ? "" : "/", name);
+
+    fd = shm_open(shm_name, O_RDWR, 0);
+    if(fd == -1) return -1;
+
+    if(fstat(fd, &shm_stat) || ((size_t)shm_stat.st_size < page_size))
+    {
+        //sized by the publisher right after creating it
+        error = ((size_t)shm_stat.st_size < page_size) ? EAGAIN : errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+
+    subscriber->size = shm_stat.st_size;
+    subscriber->memory = (const unsigned char *)mmap(NULL, subscriber->size, PROT_READ, MAP_SHARED, fd, 0);
+    subscriber->control = (frame_shm_header_t *)mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    error = errno;
+    close(fd);
+    if((subscriber->memory == MAP_FAILED) || (subscriber->control == MAP_FAILED))
+    {
+        if(subscriber->memory != MAP_FAILED) munmap((void *)subscriber->memory, subscriber->size);
+        if(subscriber->control != MAP_FAILED) munmap(subscriber->control, page_size);
+        memset(subscriber, 0, sizeof(*subscriber));
+        errno = error;
+        return -1;
+    }
+
+    //magic is written last by the publisher
+    header = (const frame_shm_header_t *)subscriber->memory;
+    error = 0;
+    if(memcmp(header->magic, FRAME_SHM_MAGIC, sizeof(header->magic)))
+    {
+        error = EAGAIN;
+    }
+    else
+    {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if((header->no_of_slots < MIN_FRAME_SHM_SLOTS) || (header->no_of_slots > MAX_FRAME_SHM_SLOTS) ||
+           (subscriber->size < header->frames_offset + (header->no_of_slots * header->slot_size)) ||
+           (header->slot_size < header->step * header->height))
+        {
+            error = EPROTO;
+        }
+    }
+    if(error)
+    {
+        frame_subscriber_close(subscriber);
+        errno = error;
+        return -1;
+    }
+
+    subscriber->header = header;
+    subscriber->slots = (const frame_shm_slot_t *)(header + 1);
+    subscriber->last_sequence = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+
+    return 0;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_subscriber_close
+//
+//  Parameters:     subscriber - opened subscriber, acquired frames must not be used afterwards
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void frame_subscriber_close(frame_subscriber_t *subscriber)
+{
+    if(subscriber->memory) munmap((void *)subscriber->memory, subscriber->size);
+    if(subscriber->control) munmap(subscriber->control, sysconf(_SC_PAGESIZE));
+
+    subscriber->memory = NULL;
+    subscriber->control = NULL;
+    subscriber->header = NULL;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_subscriber_wait
+//
+//  Parameters:     subscriber - opened subscriber
+//                  timeout_msec - longest wait, negative waits until a frame is published or the ring is closed
+//
+//  Return:         0 if a frame not acquired yet is published, or -1 with errno set (ETIMEDOUT, EPIPE ring closed)
+//
+//  Description:    Counts itself in the waiters, then sleeps on the futex word until the publisher bumps it
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int frame_subscriber_wait(frame_subscriber_t *subscriber, const int timeout_msec)
+{
+    int rc = 0;
+    uint32_t notify;
+    long long deadline_nsec, remaining_nsec;
+    struct timespec now, timeout;
+
+    if(__atomic_load_n(&subscriber->header->head, __ATOMIC_ACQUIRE) > subscriber->last_sequence) return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    deadline_nsec = ((long long)now.tv_sec * SUBSCRIBER_NSEC_PER_SEC) + now.tv_nsec + ((long long)timeout_msec * SUBSCRIBER_NSEC_PER_MSEC);
+
+    //counted in before reading notify, see frame_publisher_offer()
+    __atomic_add_fetch(&subscriber->control->waiters, 1, __ATOMIC_SEQ_CST);
+
+    while(1)
+    {
+        notify = __atomic_load_n(&subscriber->control->notify, __ATOMIC_SEQ_CST);
+
+        if(__atomic_load_n(&subscriber->header->head, __ATOMIC_ACQUIRE) > subscriber->last_sequence) break;
+
+        if(__atomic_load_n(&subscriber->header->state, __ATOMIC_ACQUIRE) == FRAME_SHM_STATE_CLOSED)
+        {
+            errno = EPIPE;
+            rc = -1;
+            break;
+        }
+
+        if(timeout_msec < 0)
+        {
+            syscall(SYS_futex, &subscriber->control->notify, FUTEX_WAIT, notify, NULL, NULL, 0);
+            continue;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        remaining_nsec = deadline_nsec - (((long long)now.tv_sec * SUBSCRIBER_NSEC_PER_SEC) + now.tv_nsec);
+        if(remaining_nsec <= 0)
+        {
+            errno = ETIMEDOUT;
+            rc = -1;
+            break;
+        }
+        timeout.tv_sec = remaining_nsec / SUBSCRIBER_NSEC_PER_SEC;
+        timeout.tv_nsec = remaining_nsec % SUBSCRIBER_NSEC_PER_SEC;
+
+        //woken, changed before sleeping (EAGAIN), interrupted or timed out: checked again above
+        syscall(SYS_futex, &subscriber->control->notify, FUTEX_WAIT, notify, &timeout, NULL, 0);
+    }
+
+    __atomic_sub_fetch(&subscriber->control->waiters, 1, __ATOMIC_SEQ_CST);
+
+    return rc;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_subscriber_acquire
+//
+//  Parameters:     subscriber - opened subscriber
+//                  frame - set to the acquired frame
+//                  mode - FRAME_SUBSCRIBER_NEXT or FRAME_SUBSCRIBER_LATEST
+//
+//  Return:         0, or -1 with errno EAGAIN if no frame was published since the last one acquired
+//
+//  Description:    Picks the frame (NEXT: the one after the last acquired, or the oldest one which is not about to be
+//                  overwritten), and reads its descriptor inside the slot seqlock. The pixels are not read here,
+//                  use them in place, then call frame_subscriber_release()
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int frame_subscriber_acquire(frame_subscriber_t *subscriber, frame_subscriber_frame_t *frame, const int mode)
+{
+    const frame_shm_header_t *header = subscriber->header;
+    const uint64_t no_of_slots = header->no_of_slots;
+    const frame_shm_slot_t *slot;
+    uint64_t head, target, oldest, generation;
+
+    while(1)
+    {
+        head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+        if(head <= subscriber->last_sequence)
+        {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        //the slot of head + 1 may be being written
+        target = (mode == FRAME_SUBSCRIBER_LATEST) ? head : (subscriber->last_sequence + 1);
+        oldest = (head + 2 > no_of_slots) ? (head + 2 - no_of_slots) : 1;
+        if(target < oldest) target = oldest;
+
+        slot = &subscriber->slots[(target - 1) % no_of_slots];
+        generation = __atomic_load_n(&slot->generation, __ATOMIC_ACQUIRE);
+        if(generation & 1) continue;
+
+        frame->sequence = slot->sequence;
+        frame->frame_sequence = slot->frame_sequence;
+        frame->capture_nsec = slot->capture_nsec;
+        frame->publish_nsec = slot->publish_nsec;
+        frame->wall_sec = slot->wall_sec;
+        frame->wall_usec = slot->wall_usec;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if((__atomic_load_n(&slot->generation, __ATOMIC_RELAXED) != generation) || (frame->sequence != target)) continue;
+
+        frame->data = subscriber->memory + header->frames_offset + (((target - 1) % no_of_slots) * header->slot_size);
+        frame->width = header->width;
+        frame->height = header->height;
+        frame->channels = header->channels;
+        frame->step = header->step;
+        frame->slot = slot;
+        frame->generation = generation;
+
+        subscriber->missed += target - subscriber->last_sequence - 1;
+        subscriber->last_sequence = target;
+        ++subscriber->acquired;
+
+        return 0;
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  frame_subscriber_release
+//
+//  Parameters:     subscriber - opened subscriber
+//                  frame - frame acquired with frame_subscriber_acquire(), its pixels are no longer used
+//
+//  Return:         0 if the frame was intact while it was used, -1 with errno ESTALE if the publisher overwrote it
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int frame_subscriber_release(frame_subscriber_t *subscriber, const frame_subscriber_frame_t *frame)
+{
+    //every pixel read above happens before the generation check
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&frame->slot->generation, __ATOMIC_RELAXED) != frame->generation)
+    {
+        ++subscriber->torn;
+        errno = ESTALE;
+        return -1;
+    }
+
+    return 0;
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
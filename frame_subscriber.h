@@ -0,0 +1,72 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: frame_subscriber.h
+//
+//  Description: Header file for frame_subscriber.c, the consumer library of the shared memory frame ring (-M).
+//               Standalone (libframe_subscriber.a), usable from C and C++ analytics processes
+//
+
+#ifndef _FRAME_SUBSCRIBER_H
+#define _FRAME_SUBSCRIBER_H
+
+#include "frame_shm.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//frame_subscriber_acquire() modes
+#define FRAME_SUBSCRIBER_NEXT       (0) //oldest frame not seen yet, still in the ring
+#define FRAME_SUBSCRIBER_LATEST     (1) //newest frame, the ones in between are counted as missed
+
+//mapped frame ring of one camera
+typedef struct
+{
+    size_t size;
+    const unsigned char *memory;        //whole object, read-only
+    frame_shm_header_t *control;        //first page, read-write for the waiters count
+    const frame_shm_header_t *header;
+    const frame_shm_slot_t *slots;
+    uint64_t last_sequence;             //last acquired frame
+    uint64_t acquired;
+    uint64_t missed;                    //published frames never acquired (overwritten, or skipped by LATEST)
+    uint64_t torn;                      //acquired frames overwritten before their release
+}frame_subscriber_t;
+
+//acquired frame, the pixels stay in the shared memory object (no copy)
+typedef struct
+{
+    const unsigned char *data;          //BGR rows, step bytes apart
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint64_t step;
+    uint64_t sequence;                  //publish sequence
+    uint64_t frame_sequence;            //capture sequence
+    uint64_t capture_nsec;              //CLOCK_MONOTONIC
+    uint64_t publish_nsec;              //CLOCK_MONOTONIC
+    int64_t wall_sec;
+    int64_t wall_usec;
+    const frame_shm_slot_t *slot;
+    uint64_t generation;                //slot generation at acquire
+}frame_subscriber_frame_t;
+
+//APIs, 0 on success, -1 with errno set on failure
+int frame_subscriber_open(frame_subscriber_t *subscriber, const char *name);
+void frame_subscriber_close(frame_subscriber_t *subscriber);
+int frame_subscriber_wait(frame_subscriber_t *subscriber, const int timeout_msec);
+int frame_subscriber_acquire(frame_subscriber_t *subscriber, frame_subscriber_frame_t *frame, const int mode);
+int frame_subscriber_release(frame_subscriber_t *subscriber, const frame_subscriber_frame_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //_FRAME_SUBSCRIBER_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
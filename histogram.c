@@ -0,0 +1,186 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: histogram.c
+//
+//  Description: Fixed memory, log-linear (HDR style) histograms of nano second values, used for the latency
+//               distributions of the RT services. Recording is inline (see histogram.h), reading is done here
+//
+
+#include "include.h"
+#include "histogram.h"
+
+//local functions
+static unsigned long long bucket_highest_value(const unsigned int bucket);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  histogram_reset
+//
+//  Parameters:     histogram - histogram, not being recorded
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void histogram_reset(histogram_t *histogram)
+{
+    memset(histogram, 0, sizeof(*histogram));
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  histogram_merge
+//
+//  Parameters:     histogram - histogram, not being recorded
+//                  other - histogram added to it, e.g. the same stage of another camera
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void histogram_merge(histogram_t *histogram, const histogram_t *other)
+{
+    unsigned int bucket;
+    const unsigned long long max_value = histogram_max(other);
+
+    for(bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket)
+    {
+        histogram->counts[bucket] += __atomic_load_n(&other->counts[bucket], __ATOMIC_RELAXED);
+    }
+    histogram->total_value += __atomic_load_n(&other->total_value, __ATOMIC_RELAXED);
+    histogram->total_count += __atomic_load_n(&other->total_count, __ATOMIC_ACQUIRE);
+    if(max_value > histogram->max_value) histogram->max_value = max_value;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  histogram_percentile
+//
+//  Parameters:     histogram - histogram, may be recorded concurrently
+//                  percentile - 0 to 100
+//
+//  Return:         Highest value of the bucket holding the percentile (never above the max value), 0 if empty
+//
+//------------------------------------------------------------------------------------------------------------------------------
+unsigned long long histogram_percentile(const histogram_t *histogram, const double percentile)
+{
+    unsigned int bucket;
+    unsigned long long count = 0, target;
+    const unsigned long long total_count = __atomic_load_n(&histogram->total_count, __ATOMIC_ACQUIRE);
+    const unsigned long long max_value = histogram_max(histogram);
+
+    if(!total_count) return 0;
+
+    //rank of the percentile, at least the first value
+    target = (unsigned long long)(((percentile / 100.0) * total_count) + 0.5);
+    if(target < 1) target = 1;
+    if(target > total_count) target = total_count;
+
+    for(bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket)
+    {
+        count += __atomic_load_n(&histogram->counts[bucket], __ATOMIC_RELAXED);
+        if(count >= target) break;
+    }
+
+    if((bucket == HISTOGRAM_BUCKETS) || (bucket_highest_value(bucket) > max_value)) return max_value;
+
+    return bucket_highest_value(bucket);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  histogram_max
+//
+//  Parameters:     histogram - histogram, may be recorded concurrently
+//
+//  Return:         Max recorded value
+//
+//------------------------------------------------------------------------------------------------------------------------------
+unsigned long long histogram_max(const histogram_t *histogram)
+{
+    return __atomic_load_n(&histogram->max_value, __ATOMIC_RELAXED);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  histogram_count
+//
+//  Parameters:     histogram - histogram, may be recorded concurrently
+//
+//  Return:         No.of recorded values
+//
+//------------------------------------------------------------------------------------------------------------------------------
+unsigned long long histogram_count(const histogram_t *histogram)
+{
+    return __atomic_load_n(&histogram->total_count, __ATOMIC_ACQUIRE);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  histogram_mean
+//
+//  Parameters:     histogram - histogram, may be recorded concurrently
+//
+//  Return:         Average of the recorded values, 0 if empty
+//
+//------------------------------------------------------------------------------------------------------------------------------
+double histogram_mean(const histogram_t *histogram)
+{
+    const unsigned long long total_count = histogram_count(histogram);
+
+    if(!total_count) return 0;
+
+    return (double)__atomic_load_n(&histogram->total_value, __ATOMIC_RELAXED) / total_count;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  histogram_print
+//
+//  Parameters:     fp - output stream
+//                  histogram - histogram, may be recorded concurrently
+//                  name - printed along with the results
+//
+//  Return:         None
+//
+//  Description:    Prints one line: count, mean, p50, p99, p99.9 and max, in milli seconds.
+//                  Also logs it, syslog must be open
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void histogram_print(FILE *fp, const histogram_t *histogram, const char *name)
+{
+    const double p50 = (double)histogram_percentile(histogram, 50.0) / NSEC_PER_MSEC;
+    const double p99 = (double)histogram_percentile(histogram, 99.0) / NSEC_PER_MSEC;
+    const double p999 = (double)histogram_percentile(histogram, 99.9) / NSEC_PER_MSEC;
+    const double max = (double)histogram_max(histogram) / NSEC_PER_MSEC;
+    const double mean = histogram_mean(histogram) / NSEC_PER_MSEC;
+
+    fprintf(fp, "\n%-16s %8llu %10.3lf %10.3lf %10.3lf %10.3lf %10.3lf",
+            name, histogram_count(histogram), mean, p50, p99, p999, max);
+
+    syslog(LOG_WARNING, "   %s: count %llu, mean %.3lf, p50 %.3lf, p99 %.3lf, p99.9 %.3lf, max %.3lf ms",
+           name, histogram_count(histogram), mean, p50, p99, p999, max);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  bucket_highest_value
+//
+//  Parameters:     bucket - bucket index
+//
+//  Return:         Highest value recorded in the bucket
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static unsigned long long bucket_highest_value(const unsigned int bucket)
+{
+    unsigned int shift, sub_bucket;
+
+    if(bucket < (2 * HISTOGRAM_SUB_BUCKETS)) return bucket;
+
+    shift = ((bucket - (2 * HISTOGRAM_SUB_BUCKETS)) / HISTOGRAM_SUB_BUCKETS) + 1;
+    sub_bucket = (bucket - (2 * HISTOGRAM_SUB_BUCKETS)) % HISTOGRAM_SUB_BUCKETS;
+
+    return ((((unsigned long long)HISTOGRAM_SUB_BUCKETS + sub_bucket + 1) << shift) - 1);
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,91 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: histogram.h
+//
+//  Description: Header file for histogram.c
+//
+
+#ifndef _HISTOGRAM_H
+#define _HISTOGRAM_H
+
+#include "include.h"
+
+//log-linear buckets: values below 2^(HISTOGRAM_SUB_BUCKET_BITS + 1) are exact, above that every power of two is split
+//into 2^HISTOGRAM_SUB_BUCKET_BITS linear sub buckets (~3% precision)
+#define HISTOGRAM_SUB_BUCKET_BITS   (5)
+#define HISTOGRAM_SUB_BUCKETS       (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_MAX_VALUE_BITS    (36) //values are clamped to 2^36 - 1 ns (~68 sec)
+#define HISTOGRAM_BUCKETS           ((2 * HISTOGRAM_SUB_BUCKETS) + ((HISTOGRAM_MAX_VALUE_BITS - HISTOGRAM_SUB_BUCKET_BITS - 1) * HISTOGRAM_SUB_BUCKETS))
+
+//fixed memory histogram of nano second values, single writer
+//the writer uses plain atomic loads/stores (no read-modify-write), so recording is wait-free,
+//and readers on other threads see consistent (possibly slightly stale) counts
+typedef struct
+{
+    unsigned int counts[HISTOGRAM_BUCKETS];
+    unsigned long long total_count;
+    unsigned long long total_value;
+    unsigned long long max_value;
+}histogram_t;
+
+//APIs
+void histogram_reset(histogram_t *histogram);
+void histogram_merge(histogram_t *histogram, const histogram_t *other);
+unsigned long long histogram_percentile(const histogram_t *histogram, const double percentile);
+unsigned long long histogram_max(const histogram_t *histogram);
+unsigned long long histogram_count(const histogram_t *histogram);
+double histogram_mean(const histogram_t *histogram);
+void histogram_print(FILE *fp, const histogram_t *histogram, const char *name);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  histogram_bucket
+//
+//  Parameters:     value - value, less than 2^HISTOGRAM_MAX_VALUE_BITS
+//
+//  Return:         Bucket index of the value
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static inline unsigned int histogram_bucket(const unsigned long long value)
+{
+    unsigned int msb, shift;
+
+    if(value < (2 * HISTOGRAM_SUB_BUCKETS)) return (unsigned int)value;
+
+    msb = 63 - __builtin_clzll(value);
+    shift = msb - HISTOGRAM_SUB_BUCKET_BITS;
+
+    return (2 * HISTOGRAM_SUB_BUCKETS) + ((shift - 1) * HISTOGRAM_SUB_BUCKETS) +
+           (unsigned int)((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  histogram_record
+//
+//  Parameters:     histogram - histogram, recorded by the calling thread only
+//                  value - value in nano seconds
+//
+//  Return:         None
+//
+//  Description:    Wait-free, allocation free, a few tens of nano seconds
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static inline void histogram_record(histogram_t *histogram, unsigned long long value)
+{
+    unsigned int bucket;
+
+    if(value >= (1ULL << HISTOGRAM_MAX_VALUE_BITS)) value = (1ULL << HISTOGRAM_MAX_VALUE_BITS) - 1;
+    bucket = histogram_bucket(value);
+
+    __atomic_store_n(&histogram->counts[bucket], __atomic_load_n(&histogram->counts[bucket], __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->total_value, histogram->total_value + value, __ATOMIC_RELAXED);
+    if(value > histogram->max_value) __atomic_store_n(&histogram->max_value, value, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->total_count, histogram->total_count + 1, __ATOMIC_RELEASE);
+}
+
+#endif //_HISTOGRAM_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
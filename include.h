@@ -39,8 +39,7 @@
 #define SCHED_FIFO_MAX_PRIORITY         (0)   //used as (sched_get_priority_max(SCHED_FIFO) - (SCHED_FIFO_MAX_PRIORITY))
 #define RT_THREAD_DISPATCHER_PRIORITY   (SCHED_FIFO_MAX_PRIORITY)     //used as (sched_get_priority_max(SCHED_FIFO) - (SCHED_FIFO_MAX_PRIORITY))
 #define TIMER_THREAD_PRIORITY           (SCHED_FIFO_MAX_PRIORITY + 1) //used as (sched_get_priority_max(SCHED_FIFO) - (SCHED_FIFO_MAX_PRIORITY + 1))
-#define QUERY_FRAMES_THREAD_PRIORITY    (SCHED_FIFO_MAX_PRIORITY + 2) //used as (sched_get_priority_max(SCHED_FIFO) - (SCHED_FIFO_MAX_PRIORITY + 2))
-#define STORE_FRAMES_THREAD_PRIORITY    (SCHED_FIFO_MAX_PRIORITY + 3) //used as (sched_get_priority_max(SCHED_FIFO) - (SCHED_FIFO_MAX_PRIORITY + 3))
+#define SERVICE_THREADS_PRIORITY        (SCHED_FIFO_MAX_PRIORITY + 2) //highest sequencer service priority, RM priorities are assigned from here down
 
 //user defined thread indexes
 typedef struct
@@ -48,9 +47,16 @@ typedef struct
     unsigned int threadIdx;
 }threadParams_t;
 
-//Thread indexes
+//cameras (-N), each with its own frame source, frame ring, output and query and store services
+#define MAX_CAMERAS                 (4)
+#define SERVICES_PER_CAMERA         (2)
+#define SERVICE_NAME_SIZE           (32)
+
+//Thread indexes, also their sequencer service indexes (camera 0), threadParams_t threadIdx is the camera index
 #define QUERY_FRAMES_THREAD_IDX     (0)
 #define STORE_FRAMES_THREAD_IDX     (1)
+#define QUERY_FRAMES_SERVICE_IDX(camera)    (((camera) * SERVICES_PER_CAMERA) + QUERY_FRAMES_THREAD_IDX)
+#define STORE_FRAMES_SERVICE_IDX(camera)    (((camera) * SERVICES_PER_CAMERA) + STORE_FRAMES_THREAD_IDX)
 
 //macros for time functions
 #define MSEC_PER_SEC    (1000)              //milli seconds per second
@@ -67,6 +73,10 @@ typedef struct
 //1 Hz
 #define DEFAULT_STORE_FRAMES_INTERVAL_IN_MSEC   (MSEC_PER_SEC) //store frames
 
+//RT thread stacks, set explicitly in the thread attributes, and prefaulted at thread start
+#define RT_THREAD_STACK_SIZE            (2 * 1024 * 1024)
+#define RT_THREAD_STACK_PREFAULT_SIZE   (512 * 1024)
+
 //other utilities
 #define TRUE        (1)
 #define FALSE       (0)
@@ -78,14 +88,6 @@ typedef struct
 #define FRAME_HRES 640
 #define FRAME_VRES 480
 
-//as root do: "~./tegrastats" to find these CPU core numbers
-#define JETSON_TX2_ARM_CORE0    (0)
-#define JETSON_TX2_DENVER_CORE0 (1)
-#define JETSON_TX2_DENVER_CORE1 (2)
-#define JETSON_TX2_ARM_CORE1    (3)
-#define JETSON_TX2_ARM_CORE2    (4)
-#define JETSON_TX2_ARM_CORE3    (5)
-
 //macro for exit(-1) along with debug details
 #define EXIT_FAIL(fun_name) {\
     fprintf(stderr,\
@@ -0,0 +1,176 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: latest_frame.c
+//
+//  Description: Wait-free latest frame slot (triple buffer), a best-effort reader (the preview) gets the latest frame
+//               of an RT writer without ever making it wait. Every offered frame is copied in and replaces the latest
+//               one, taken or not, so the reader is at most one offer behind the writer.
+//
+
+#include "include.h"
+#include "latest_frame.h"
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  latest_frame_init
+//
+//  Parameters:     slot - slot to initialize
+//                  width, height, channels - frame resolution
+//                  pool - frame pool, LATEST_FRAME_BUFFERS buffers are borrowed from it
+//
+//  Return:         None
+//
+//  Description:    Sets up the frame buffers up front, nothing is allocated afterwards
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void latest_frame_init(latest_frame_t *slot, const unsigned int width, const unsigned int height, const unsigned int channels,
+                       frame_pool_t *pool)
+{
+    unsigned int i;
+    const size_t step = (size_t)width * channels;
+
+    assert(pool->buffer_size >= (step * height));
+
+    memset(slot, 0, sizeof(*slot));
+    slot->pool = pool;
+
+    for(i = 0; i < LATEST_FRAME_BUFFERS; ++i)
+    {
+        slot->frames[i].data = frame_pool_get(pool);
+        if(!slot->frames[i].data) EXIT_FAIL("frame_pool_get");
+        slot->frames[i].width = width;
+        slot->frames[i].height = height;
+        slot->frames[i].channels = channels;
+        slot->frames[i].step = step;
+    }
+
+    //writer starts with buffer 0, latest is buffer 1 (not fresh), reader holds buffer 2
+    slot->write_idx = 0;
+    slot->latest = 1;
+    slot->read_idx = 2;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  latest_frame_destroy
+//
+//  Parameters:     slot - initialized slot, no writer/reader must be using it
+//
+//  Return:         None
+//
+//  Description:    Returns the frame buffers to the frame pool
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void latest_frame_destroy(latest_frame_t *slot)
+{
+    unsigned int i;
+
+    for(i = 0; i < LATEST_FRAME_BUFFERS; ++i)
+    {
+        if(slot->frames[i].data) frame_pool_put(slot->pool, slot->frames[i].data);
+        slot->frames[i].data = NULL;
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  latest_frame_offer
+//
+//  Parameters:     slot - latest frame slot (writer only)
+//                  frame - frame with the slot resolution
+//
+//  Return:         None
+//
+//  Description:    Copies the frame into the writer buffer, and swaps it with the latest one in one atomic exchange.
+//                  A latest frame the reader did not take yet is overwritten (counted)
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void latest_frame_offer(latest_frame_t *slot, const frame_t *frame)
+{
+    frame_t *copy = &slot->frames[slot->write_idx];
+    unsigned int previous;
+    unsigned int row;
+
+    assert((frame->width == copy->width) && (frame->height == copy->height) && (frame->channels == copy->channels));
+
+    if(frame->step == copy->step)
+    {
+        memcpy(copy->data, frame->data, copy->step * copy->height);
+    }
+    else
+    {
+        for(row = 0; row < copy->height; ++row)
+        {
+            memcpy(copy->data + (row * copy->step), frame->data + (row * frame->step), copy->step);
+        }
+    }
+    copy->sequence = frame->sequence;
+    copy->capture_time = frame->capture_time;
+    copy->wall_time = frame->wall_time;
+    copy->source_sequence = frame->source_sequence;
+    copy->exposure_time = frame->exposure_time;
+
+    //release the copy, and take the buffer the reader left behind, or the untaken latest one
+    previous = __atomic_exchange_n(&slot->latest, slot->write_idx | LATEST_FRAME_FRESH, __ATOMIC_ACQ_REL);
+    slot->write_idx = previous & LATEST_FRAME_INDEX_MASK;
+    if(previous & LATEST_FRAME_FRESH) ++slot->overwritten;
+    ++slot->published;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  latest_frame_take
+//
+//  Parameters:     slot - latest frame slot (reader only)
+//
+//  Return:         Latest frame, valid until the next latest_frame_take(), or NULL if there is no new frame
+//
+//------------------------------------------------------------------------------------------------------------------------------
+const frame_t *latest_frame_take(latest_frame_t *slot)
+{
+    unsigned int previous;
+
+    if(!(__atomic_load_n(&slot->latest, __ATOMIC_ACQUIRE) & LATEST_FRAME_FRESH))
+    {
+        ++slot->empty_takes;
+        return NULL;
+    }
+
+    //hand the previous read buffer back, and take the latest one
+    previous = __atomic_exchange_n(&slot->latest, slot->read_idx, __ATOMIC_ACQ_REL);
+    slot->read_idx = previous & LATEST_FRAME_INDEX_MASK;
+    ++slot->taken;
+
+    return &slot->frames[slot->read_idx];
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  latest_frame_report
+//
+//  Parameters:     slot - latest frame slot, writer and reader must have exited
+//                  slot_name - printed along with the results
+//
+//  Return:         None
+//
+//  Description:    Prints and logs the slot counters
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void latest_frame_report(const latest_frame_t *slot, const char *slot_name)
+{
+    fprintf(stdout, "\n\n--------------------------------------"
+                     "\n%s latest frame results:"
+                     "\npublished frames: %llu,"
+                     "\noverwritten frames (not taken): %llu,"
+                     "\ntaken frames: %llu,"
+                     "\ntakes without a new frame: %llu"
+                     "\n--------------------------------------",
+                     slot_name, slot->published, slot->overwritten, slot->taken, slot->empty_takes);
+
+    syslog(LOG_WARNING," %s latest frame: published %llu, overwritten %llu, taken %llu, empty %llu",
+           slot_name, slot->published, slot->overwritten, slot->taken, slot->empty_takes);
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,53 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: latest_frame.h
+//
+//  Description: Header file for latest_frame.c
+//
+
+#ifndef _LATEST_FRAME_H
+#define _LATEST_FRAME_H
+
+#include "frame_pool.h"
+#include "frame_ring.h"
+#include "include.h"
+
+//frame buffers of a latest frame slot: one written, one latest, one read
+#define LATEST_FRAME_BUFFERS        (3)
+
+//latest buffer index, and this bit while it was not taken by the reader
+#define LATEST_FRAME_INDEX_MASK     (0x3)
+#define LATEST_FRAME_FRESH          (0x4)
+
+//wait-free single writer, single reader slot holding the latest frame only (triple buffer).
+//The writer never waits for the reader, the reader gets the latest frame or nothing, older frames are dropped
+typedef struct
+{
+    //writer side
+    unsigned int write_idx __attribute__((aligned(CACHE_LINE_SIZE)));
+    unsigned long long published;       //frames copied in
+    unsigned long long overwritten;     //published frames replaced by a newer one before the reader took them
+    //latest buffer index | LATEST_FRAME_FRESH, atomic
+    unsigned int latest __attribute__((aligned(CACHE_LINE_SIZE)));
+    //reader side
+    unsigned int read_idx __attribute__((aligned(CACHE_LINE_SIZE)));
+    unsigned long long taken;           //frames taken by the reader
+    unsigned long long empty_takes;     //takes without a new frame
+    frame_t frames[LATEST_FRAME_BUFFERS];
+    frame_pool_t *pool;
+}latest_frame_t;
+
+//APIs
+void latest_frame_init(latest_frame_t *slot, const unsigned int width, const unsigned int height, const unsigned int channels,
+                       frame_pool_t *pool);
+void latest_frame_destroy(latest_frame_t *slot);
+void latest_frame_offer(latest_frame_t *slot, const frame_t *frame);
+const frame_t *latest_frame_take(latest_frame_t *slot);
+void latest_frame_report(const latest_frame_t *slot, const char *slot_name);
+
+#endif //_LATEST_FRAME_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
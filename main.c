@@ -6,31 +6,74 @@
 //  Description: main() function, manages RT Threads
 //
 
+#include "bench_report.h"
 #include "capture.hpp"
+#include "change_detect.h"
+#include "encode_pool.h"
+#include "frame_archive.h"
+#include "frame_pool.h"
+#include "frame_publisher.h"
+#include "frame_ring.h"
+#include "frame_source.h"
 #include "include.h"
+#include "placement.h"
 #include "posix_timer.h"
+#include "quality_control.h"
+#include "rt_memory.h"
+#include "sequencer.h"
+#include "tile_delta.h"
+#include "trace.h"
 #include "utilities.h"
 #include "v4l2_capture.h"
 
 //function prototyping
 void *rt_thread_dispatcher_handler(void *args);
 static void usage(FILE *fp, int argc, char **argv);
+static unsigned int parse_list(char *list, char **items, const unsigned int max_items);
 
-// /dev/videoX name
-char *device_name="/dev/video0";
-
-//global time variable mutex to restrict access to it
-pthread_mutex_t app_timer_counter_mutex_lock;
-pthread_mutexattr_t app_timer_counter_mutex_lock_attr;
+// /dev/videoX names, one per camera
+char *device_names[MAX_CAMERAS] = {"/dev/video0", "/dev/video1", "/dev/video2", "/dev/video3"};
+unsigned int no_of_cameras = 0; //default: one camera per '-d'/'-p' entry
 
 //global variable //updated once, and used across the application for sync
-bool query_frames_thread_dispatched = false;
-bool store_frames_thread_dispatched = false;
-bool timer_started = false;
 unsigned int store_frames_frequency = 1; //default value 1
 bool live_camera_view = false;
+bool headless = false;
+unsigned int preview_width = DEFAULT_PREVIEW_WIDTH;
+unsigned int preview_height = DEFAULT_PREVIEW_HEIGHT;
+unsigned int preview_frequency = DEFAULT_PREVIEW_FREQUENCY;
+char *shm_name = NULL; //default: frames are not published to other processes
+unsigned int shm_publish_interval = MIN_FRAME_PUBLISH_INTERVAL;
 unsigned int compress_ratio = 0; //default: no compression
+unsigned int output_format = OUTPUT_FORMAT_PPM;
+char *bench_report_file = NULL;
 unsigned int max_no_of_frames_allowed = 100;
+unsigned int release_mode = RELEASE_MODE_ABSOLUTE; //default: tickless releases
+unsigned int capture_io_method = IO_METHOD_OPENCV; //default: openCV grab/retrieve
+unsigned int v4l2_buffer_count = DEFAULT_V4L2_BUFFER_COUNT;
+unsigned int frame_ring_slots = DEFAULT_FRAME_RING_SLOTS;
+int frame_pool_backing = FRAME_POOL_NORMAL_PAGES;
+unsigned int schedulability_warmup_sec = DEFAULT_SCHEDULABILITY_WARMUP_IN_SEC;
+unsigned int service_sched_policy = SCHED_POLICY_FIFO;
+unsigned int frame_source_type = FRAME_SOURCE_DEVICE;
+char *replay_paths[MAX_CAMERAS] = {NULL};
+unsigned int frame_source_width = FRAME_HRES;
+unsigned int frame_source_height = FRAME_VRES;
+unsigned int frame_source_fps = DEFAULT_FRAME_SOURCE_FPS;
+unsigned int encode_workers = DEFAULT_ENCODE_WORKERS;
+char *archive_name = NULL; //default: one file per frame
+unsigned int archive_segment_mb = DEFAULT_FRAME_ARCHIVE_SEGMENT_MB;
+unsigned int change_detect_threshold = DEFAULT_CHANGE_DETECT_THRESHOLD; //default: every frame is stored
+unsigned int change_detect_cells_percent = DEFAULT_CHANGE_DETECT_CELLS_PERCENT;
+unsigned int change_detect_max_skip_sec = DEFAULT_CHANGE_DETECT_MAX_SKIP_IN_SEC;
+unsigned int tile_delta_keyframe_interval = DEFAULT_TILE_DELTA_KEYFRAME_INTERVAL;
+unsigned int quality_miss_percent = DEFAULT_QUALITY_MISS_PERCENT; //default: store mode is never changed
+unsigned int quality_max_downscale = DEFAULT_QUALITY_DOWNSCALE;
+int quality_min_compress_ratio = -1; //default: the configured store mode (-o, -c) only
+int quality_max_compress_ratio = -1;
+cpu_topology_t cpu_topology;
+placement_t placement; //cores and priorities of the threads, -C/-R/-E, then the placement file (-L), then placement_auto()
+char *placement_file = NULL;
 
 
 //------------------------------------------------------------------------------
@@ -48,18 +91,67 @@ unsigned int max_no_of_frames_allowed = 100;
 int main( int argc, char** argv )
 {
 
+    int output_format_option = -1; //default: .png if compressed, else .ppm
+    int encode_workers_option = FALSE; //-e given, not reset for the quality control
+    unsigned int no_of_device_names = 0;
+    unsigned int no_of_replay_paths = 0;
+
+    //cores given with -C/-E are checked against the online ones
+    cpu_topology_read(&cpu_topology);
+    placement_init(&placement);
+
     //parse user options
     while(1)
     {
         int idx;
         int user_input_option;
 
-        user_input_option = getopt(argc, argv, "c:d:f:hl:n:");
+        user_input_option = getopt(argc, argv, "a:A:b:c:C:d:D:e:E:f:F:g:hH:i:I:j:k:K:l:L:m:M:n:N:o:p:P:Q:r:R:s:t:U:v:V:w:X:Y:");
 
         if (user_input_option == -1) break; //exit forever loop
 
         switch (user_input_option)
         {
+            case 'a':
+            archive_name = optarg;
+            //segment and index names are made from it
+            if(strlen(archive_name) >= FRAME_ARCHIVE_NAME_SIZE)
+            {
+                fprintf(stderr, "Frame archive name is too long (Max %d characters)!\n", FRAME_ARCHIVE_NAME_SIZE - 1);
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+            case 'A':
+            archive_segment_mb = atoi(optarg);
+            //boundary checks
+            if(archive_segment_mb < MIN_FRAME_ARCHIVE_SEGMENT_MB)
+            {
+                archive_segment_mb = MIN_FRAME_ARCHIVE_SEGMENT_MB;
+                fprintf(stdout, "Resetting frame archive segment size to %d MB (Min allowed)!\n", MIN_FRAME_ARCHIVE_SEGMENT_MB);
+            }
+            else if(archive_segment_mb > MAX_FRAME_ARCHIVE_SEGMENT_MB)
+            {
+                archive_segment_mb = MAX_FRAME_ARCHIVE_SEGMENT_MB;
+                fprintf(stdout, "Resetting frame archive segment size to %d MB (Max allowed)!\n", MAX_FRAME_ARCHIVE_SEGMENT_MB);
+            }
+            break;
+
+            case 'b':
+            v4l2_buffer_count = atoi(optarg);
+            //boundary checks
+            if(v4l2_buffer_count < MIN_V4L2_BUFFER_COUNT)
+            {
+                v4l2_buffer_count = MIN_V4L2_BUFFER_COUNT;
+                fprintf(stdout, "Resetting no.of V4L2 buffers to %d (Min allowed)!\n", MIN_V4L2_BUFFER_COUNT);
+            }
+            else if(v4l2_buffer_count > MAX_V4L2_BUFFER_COUNT)
+            {
+                v4l2_buffer_count = MAX_V4L2_BUFFER_COUNT;
+                fprintf(stdout, "Resetting no.of V4L2 buffers to %d (Max allowed)!\n", MAX_V4L2_BUFFER_COUNT);
+            }
+            break;
+
             case 'c':
             compress_ratio = atoi(optarg);
             //validate user input
@@ -76,8 +168,73 @@ int main( int argc, char** argv )
             //ignoring device name changes for now
             break;
 
+            case 'C':
+            {
+                //comma separated core numbers, query and store service of camera 0, then camera 1..
+                char *core_str;
+                int core;
+                unsigned int service = 0;
+
+                for(core_str = strtok(optarg, ","); core_str && (service < (MAX_CAMERAS * SERVICES_PER_CAMERA)); core_str = strtok(NULL, ","), ++service)
+                {
+                    core = atoi(core_str);
+                    if(!cpu_topology_core_online(&cpu_topology, core))
+                    {
+                        fprintf(stdout, "Ignoring service %u core %d (not available), placed automatically!\n", service, core);
+                        continue;
+                    }
+                    placement.service_cores[service] = core;
+                }
+            }
+            break;
+
             case 'd':
-            //ignoring device name changes for now
+            //comma separated, openCV opens /dev/videoX as camera index X
+            no_of_device_names = parse_list(optarg, device_names, MAX_CAMERAS);
+            break;
+
+            case 'D':
+            change_detect_threshold = atoi(optarg);
+            //boundary checks, 0 stores every frame
+            if(change_detect_threshold > MAX_CHANGE_DETECT_THRESHOLD)
+            {
+                change_detect_threshold = MAX_CHANGE_DETECT_THRESHOLD;
+                fprintf(stdout, "Resetting change detection threshold to %d (Max allowed)!\n", MAX_CHANGE_DETECT_THRESHOLD);
+            }
+            break;
+
+            case 'e':
+            encode_workers = atoi(optarg);
+            encode_workers_option = TRUE;
+            //boundary checks, 0 encodes in store_frames_thread
+            if(encode_workers > MAX_ENCODE_WORKERS)
+            {
+                encode_workers = MAX_ENCODE_WORKERS;
+                fprintf(stdout, "Resetting no.of encode workers to %d (Max allowed)!\n", MAX_ENCODE_WORKERS);
+            }
+            break;
+
+            case 'E':
+            {
+                //comma separated core numbers
+                char *core_str;
+                int core;
+
+                placement.no_of_encode_cores = 0;
+                for(core_str = strtok(optarg, ","); core_str && (placement.no_of_encode_cores < MAX_ENCODE_WORKERS); core_str = strtok(NULL, ","))
+                {
+                    core = atoi(core_str);
+                    if(!cpu_topology_core_online(&cpu_topology, core))
+                    {
+                        fprintf(stdout, "Ignoring encode worker core %d (not available)!\n", core);
+                        continue;
+                    }
+                    placement.encode_cores[placement.no_of_encode_cores++] = core;
+                }
+                //none left, placed automatically
+                placement.encode_cores_set = placement.no_of_encode_cores ? TRUE : FALSE;
+                if(!placement.encode_cores_set) fprintf(stdout, "Resetting encode worker cores, placed automatically!\n");
+            }
             break;
 
             case 'f':
@@ -88,10 +245,36 @@ int main( int argc, char** argv )
                 store_frames_frequency = 1; //reset to one
                 fprintf(stdout, "Resetting frequency to save the frames to 1 Hz (Min allowed)! \n");
             }
-            else if(store_frames_frequency > 10)
+            else if(store_frames_frequency > MAX_BENCH_STORE_FRAMES_FREQUENCY)
+            {
+                store_frames_frequency = MAX_BENCH_STORE_FRAMES_FREQUENCY; //more than 10 Hz for benchmarks only, checked below
+            }
+            break;
+
+            case 'F':
+            frame_source_fps = atoi(optarg);
+            //boundary checks
+            if(frame_source_fps < MIN_FRAME_SOURCE_FPS)
+            {
+                frame_source_fps = MIN_FRAME_SOURCE_FPS;
+                fprintf(stdout, "Resetting frame rate of the source to %d fps (Min allowed)!\n", MIN_FRAME_SOURCE_FPS);
+            }
+            else if(frame_source_fps > MAX_FRAME_SOURCE_FPS)
+            {
+                frame_source_fps = MAX_FRAME_SOURCE_FPS;
+                fprintf(stdout, "Resetting frame rate of the source to %d fps (Max allowed)!\n", MAX_FRAME_SOURCE_FPS);
+            }
+            break;
+
+            case 'g':
+            //WIDTHxHEIGHT
+            if((sscanf(optarg, "%ux%u", &frame_source_width, &frame_source_height) != 2) ||
+               (frame_source_width < 1) || (frame_source_width > MAX_FRAME_SOURCE_HRES) ||
+               (frame_source_height < 1) || (frame_source_height > MAX_FRAME_SOURCE_VRES))
             {
-                store_frames_frequency = 10; //not suppporting more than 10Hz
-                fprintf(stdout, "Resetting frequency to save the frames to 10 Hz (Max allowed)! \n");
+                frame_source_width = FRAME_HRES;
+                frame_source_height = FRAME_VRES;
+                fprintf(stdout, "Resetting resolution of the source to %dx%d (Default)!\n", FRAME_HRES, FRAME_VRES);
             }
             break;
 
@@ -99,10 +282,97 @@ int main( int argc, char** argv )
             usage(stdout, argc, argv);
             return(SUCCESS);
 
+            case 'H':
+            frame_pool_backing = atoi(optarg) ? FRAME_POOL_HUGE_PAGES : FRAME_POOL_NORMAL_PAGES;
+            break;
+
+            case 'i':
+            frame_source_type = atoi(optarg);
+            //validate user input
+            if(frame_source_type >= FRAME_SOURCES)
+            {
+                frame_source_type = FRAME_SOURCE_DEVICE;
+                fprintf(stdout, "Resetting frame source to the device (Default)! \n");
+            }
+            break;
+
+            case 'I':
+            shm_publish_interval = atoi(optarg);
+            //boundary checks
+            if(shm_publish_interval < MIN_FRAME_PUBLISH_INTERVAL)
+            {
+                shm_publish_interval = MIN_FRAME_PUBLISH_INTERVAL;
+                fprintf(stdout, "Resetting shared memory publish interval to %d frame (Min allowed)!\n", MIN_FRAME_PUBLISH_INTERVAL);
+            }
+            else if(shm_publish_interval > MAX_FRAME_PUBLISH_INTERVAL)
+            {
+                shm_publish_interval = MAX_FRAME_PUBLISH_INTERVAL;
+                fprintf(stdout, "Resetting shared memory publish interval to %d frames (Max allowed)!\n", MAX_FRAME_PUBLISH_INTERVAL);
+            }
+            break;
+
+            case 'j':
+            bench_report_file = optarg;
+            break;
+
+            case 'k':
+            change_detect_max_skip_sec = atoi(optarg);
+            //boundary checks
+            if(change_detect_max_skip_sec < MIN_CHANGE_DETECT_MAX_SKIP_IN_SEC)
+            {
+                change_detect_max_skip_sec = MIN_CHANGE_DETECT_MAX_SKIP_IN_SEC;
+                fprintf(stdout, "Resetting change detection max skip interval to %d sec (Min allowed)!\n", MIN_CHANGE_DETECT_MAX_SKIP_IN_SEC);
+            }
+            else if(change_detect_max_skip_sec > MAX_CHANGE_DETECT_MAX_SKIP_IN_SEC)
+            {
+                change_detect_max_skip_sec = MAX_CHANGE_DETECT_MAX_SKIP_IN_SEC;
+                fprintf(stdout, "Resetting change detection max skip interval to %d sec (Max allowed)!\n", MAX_CHANGE_DETECT_MAX_SKIP_IN_SEC);
+            }
+            break;
+
+            case 'K':
+            tile_delta_keyframe_interval = atoi(optarg);
+            //boundary checks
+            if(tile_delta_keyframe_interval < MIN_TILE_DELTA_KEYFRAME_INTERVAL)
+            {
+                tile_delta_keyframe_interval = MIN_TILE_DELTA_KEYFRAME_INTERVAL;
+                fprintf(stdout, "Resetting keyframe interval to %d frame (Min allowed)!\n", MIN_TILE_DELTA_KEYFRAME_INTERVAL);
+            }
+            else if(tile_delta_keyframe_interval > MAX_TILE_DELTA_KEYFRAME_INTERVAL)
+            {
+                tile_delta_keyframe_interval = MAX_TILE_DELTA_KEYFRAME_INTERVAL;
+                fprintf(stdout, "Resetting keyframe interval to %d frames (Max allowed)!\n", MAX_TILE_DELTA_KEYFRAME_INTERVAL);
+            }
+            break;
+
             case 'l':
             live_camera_view = (bool)atoi(optarg);
             break;
 
+            case 'L':
+            placement_file = optarg;
+            break;
+
+            case 'm':
+            capture_io_method = atoi(optarg);
+            //validate user input
+            if(capture_io_method > IO_METHOD_MMAP)
+            {
+                capture_io_method = IO_METHOD_OPENCV;
+                fprintf(stdout, "Resetting I/O method to openCV (Default)! \n");
+            }
+            break;
+
+            case 'M':
+            shm_name = optarg;
+            //camera suffix is added to it with more than one camera
+            if(strlen(shm_name) >= FRAME_PUBLISHER_NAME_SIZE - 16)
+            {
+                fprintf(stderr, "Shared memory name is too long (Max %d characters)!\n", FRAME_PUBLISHER_NAME_SIZE - 17);
+                exit(EXIT_FAILURE);
+            }
+            break;
+
             case 'n':
             max_no_of_frames_allowed = atoi(optarg);
             //boundary checks
@@ -118,6 +388,166 @@ int main( int argc, char** argv )
             }
             break;
 
+            case 'o':
+            output_format_option = atoi(optarg);
+            //validate user input
+            if((output_format_option < 0) || (output_format_option >= OUTPUT_FORMATS))
+            {
+                output_format_option = -1;
+                fprintf(stdout, "Resetting output format (Default)! \n");
+            }
+            break;
+
+            case 'N':
+            no_of_cameras = atoi(optarg);
+            //boundary checks
+            if(no_of_cameras < 1)
+            {
+                no_of_cameras = 1;
+                fprintf(stdout, "Resetting no.of cameras to 1 (Min allowed)!\n");
+            }
+            else if(no_of_cameras > MAX_CAMERAS)
+            {
+                no_of_cameras = MAX_CAMERAS;
+                fprintf(stdout, "Resetting no.of cameras to %d (Max allowed)!\n", MAX_CAMERAS);
+            }
+            break;
+
+            case 'p':
+            //comma separated, one per camera
+            no_of_replay_paths = parse_list(optarg, replay_paths, MAX_CAMERAS);
+            break;
+
+            case 'P':
+            change_detect_cells_percent = atoi(optarg);
+            //boundary checks, 0 stores on any changed cell
+            if(change_detect_cells_percent > MAX_CHANGE_DETECT_CELLS_PERCENT)
+            {
+                change_detect_cells_percent = MAX_CHANGE_DETECT_CELLS_PERCENT;
+                fprintf(stdout, "Resetting changed cells to store a frame to %d%% (Max allowed)!\n", MAX_CHANGE_DETECT_CELLS_PERCENT);
+            }
+            break;
+
+            case 'Q':
+            quality_miss_percent = atoi(optarg);
+            //boundary checks, 0 disables the quality control
+            if(quality_miss_percent > MAX_QUALITY_MISS_PERCENT)
+            {
+                quality_miss_percent = MAX_QUALITY_MISS_PERCENT;
+                fprintf(stdout, "Resetting store jobs allowed to miss their period to %d%% (Max allowed)!\n", MAX_QUALITY_MISS_PERCENT);
+            }
+            break;
+
+            case 'r':
+            frame_ring_slots = atoi(optarg);
+            //boundary checks
+            if(frame_ring_slots < MIN_FRAME_RING_SLOTS)
+            {
+                frame_ring_slots = MIN_FRAME_RING_SLOTS;
+                fprintf(stdout, "Resetting no.of frame ring slots to %d (Min allowed)!\n", MIN_FRAME_RING_SLOTS);
+            }
+            else if(frame_ring_slots > MAX_FRAME_RING_SLOTS)
+            {
+                frame_ring_slots = MAX_FRAME_RING_SLOTS;
+                fprintf(stdout, "Resetting no.of frame ring slots to %d (Max allowed)!\n", MAX_FRAME_RING_SLOTS);
+            }
+            break;
+
+            case 'R':
+            {
+                //comma separated relative priorities (see include.h), same order as '-C', -1 for a rate-monotonic priority
+                char *priority_str;
+                int priority;
+                unsigned int service = 0;
+
+                for(priority_str = strtok(optarg, ","); priority_str && (service < (MAX_CAMERAS * SERVICES_PER_CAMERA)); priority_str = strtok(NULL, ","), ++service)
+                {
+                    priority = atoi(priority_str);
+                    if((priority != SEQUENCER_RM_PRIORITY) && (priority < SERVICE_THREADS_PRIORITY))
+                    {
+                        fprintf(stdout, "Resetting service %u priority %d to %d (Max allowed)!\n", service, priority, SERVICE_THREADS_PRIORITY);
+                        priority = SERVICE_THREADS_PRIORITY;
+                    }
+                    placement.service_priorities[service] = priority;
+                }
+            }
+            break;
+
+            case 's':
+            service_sched_policy = atoi(optarg) ? SCHED_POLICY_DEADLINE : SCHED_POLICY_FIFO;
+            break;
+
+            case 't':
+            release_mode = atoi(optarg) ? RELEASE_MODE_TIMER_TICK : RELEASE_MODE_ABSOLUTE;
+            break;
+
+            case 'U':
+            preview_frequency = atoi(optarg);
+            //boundary checks
+            if(preview_frequency < 1)
+            {
+                preview_frequency = 1;
+                fprintf(stdout, "Resetting preview rate to 1 Hz (Min allowed)!\n");
+            }
+            else if(preview_frequency > MAX_PREVIEW_FREQUENCY)
+            {
+                preview_frequency = MAX_PREVIEW_FREQUENCY;
+                fprintf(stdout, "Resetting preview rate to %d Hz (Max allowed)!\n", MAX_PREVIEW_FREQUENCY);
+            }
+            break;
+
+            case 'v':
+            headless = !atoi(optarg);
+            break;
+
+            case 'V':
+            //WIDTHxHEIGHT
+            if((sscanf(optarg, "%ux%u", &preview_width, &preview_height) != 2) ||
+               (preview_width < MIN_PREVIEW_SIZE) || (preview_width > MAX_FRAME_SOURCE_HRES) ||
+               (preview_height < MIN_PREVIEW_SIZE) || (preview_height > MAX_FRAME_SOURCE_VRES))
+            {
+                preview_width = DEFAULT_PREVIEW_WIDTH;
+                preview_height = DEFAULT_PREVIEW_HEIGHT;
+                fprintf(stdout, "Resetting preview size to %dx%d (Default)!\n", DEFAULT_PREVIEW_WIDTH, DEFAULT_PREVIEW_HEIGHT);
+            }
+            break;
+
+            case 'w':
+            schedulability_warmup_sec = atoi(optarg);
+            //boundary checks, 0 disables the analysis after the warm-up
+            if(schedulability_warmup_sec > MAX_SCHEDULABILITY_WARMUP_IN_SEC)
+            {
+                schedulability_warmup_sec = MAX_SCHEDULABILITY_WARMUP_IN_SEC;
+                fprintf(stdout, "Resetting schedulability warm-up to %d sec (Max allowed)!\n", MAX_SCHEDULABILITY_WARMUP_IN_SEC);
+            }
+            break;
+
+            case 'X':
+            quality_max_downscale = atoi(optarg);
+            //boundary checks
+            if(quality_max_downscale < MIN_QUALITY_DOWNSCALE)
+            {
+                quality_max_downscale = MIN_QUALITY_DOWNSCALE;
+                fprintf(stdout, "Resetting quality control downscale factor to %d (Min allowed)!\n", MIN_QUALITY_DOWNSCALE);
+            }
+            else if(quality_max_downscale > MAX_QUALITY_DOWNSCALE)
+            {
+                quality_max_downscale = MAX_QUALITY_DOWNSCALE;
+                fprintf(stdout, "Resetting quality control downscale factor to %d (Max allowed)!\n", MAX_QUALITY_DOWNSCALE);
+            }
+            break;
+
+            case 'Y':
+            //MIN,MAX .png compression levels, 0 allows .ppm
+            if((sscanf(optarg, "%d,%d", &quality_min_compress_ratio, &quality_max_compress_ratio) != 2) ||
+               (quality_min_compress_ratio < 0) || (quality_max_compress_ratio > MAX_QUALITY_COMPRESS_RATIO) ||
+               (quality_min_compress_ratio > quality_max_compress_ratio))
+            {
+                quality_min_compress_ratio = quality_max_compress_ratio = -1;
+                fprintf(stdout, "Resetting quality control compression levels (Default)!\n");
+            }
+            break;
+
             default:
             usage(stderr, argc, argv);
             exit(EXIT_FAILURE);
@@ -125,16 +555,110 @@ int main( int argc, char** argv )
         }//end of switch(user_input_option)
     }//end of while(1)
 
+    //SCHED_DEADLINE reservations are sized from the WCETs measured during the warm-up
+    if((service_sched_policy == SCHED_POLICY_DEADLINE) && !schedulability_warmup_sec)
+    {
+        schedulability_warmup_sec = DEFAULT_SCHEDULABILITY_WARMUP_IN_SEC;
+        fprintf(stdout, "Resetting schedulability warm-up to %d sec, needed by SCHED_DEADLINE!\n", DEFAULT_SCHEDULABILITY_WARMUP_IN_SEC);
+    }
+
+    //not suppporting more than 10Hz, except for benchmark runs (-j)
+    if(!bench_report_file && (store_frames_frequency > 10))
+    {
+        store_frames_frequency = 10;
+        fprintf(stdout, "Resetting frequency to save the frames to 10 Hz (Max allowed)! \n");
+    }
+
+    //compressed frames are stored as .png, unless the format is selected
+    output_format = (output_format_option < 0) ? (compress_ratio ? OUTPUT_FORMAT_PNG : OUTPUT_FORMAT_PPM) : output_format_option;
+
+    //the quality control steps the store mode of store_frames_thread, not delta frames or .png frames of the encode workers
+    if(quality_miss_percent && (output_format == OUTPUT_FORMAT_DELTA))
+    {
+        fprintf(stderr, "Quality control (-Q) does not step delta frames (-o 2)!\n");
+        usage(stderr, argc, argv);
+        exit(EXIT_FAILURE);
+    }
+    if(quality_miss_percent && (output_format == OUTPUT_FORMAT_PNG) && encode_workers)
+    {
+        if(encode_workers_option)
+        {
+            fprintf(stderr, "Quality control (-Q) steps the .png frames encoded by the store thread, use '-e 0'!\n");
+            usage(stderr, argc, argv);
+            exit(EXIT_FAILURE);
+        }
+        encode_workers = 0;
+        fprintf(stdout, "Resetting no.of encode workers to 0, needed by the quality control (-Q)!\n");
+    }
+
+    //the quality control steps format and compression within the levels, the configured store mode is one of them
+    if(quality_min_compress_ratio < 0)
+    {
+        quality_min_compress_ratio = quality_max_compress_ratio = (output_format == OUTPUT_FORMAT_PNG) ? compress_ratio : 0;
+    }
+    else if((output_format == OUTPUT_FORMAT_PPM) && quality_min_compress_ratio)
+    {
+        quality_min_compress_ratio = 0;
+        fprintf(stdout, "Resetting quality control compression levels to %d,%d, to include .ppm (-o 0)!\n",
+                quality_min_compress_ratio, quality_max_compress_ratio);
+    }
+    else if((output_format == OUTPUT_FORMAT_PNG) &&
+            ((quality_min_compress_ratio > (int)compress_ratio) || (quality_max_compress_ratio < (int)compress_ratio)))
+    {
+        if(quality_min_compress_ratio > (int)compress_ratio) quality_min_compress_ratio = compress_ratio;
+        if(quality_max_compress_ratio < (int)compress_ratio) quality_max_compress_ratio = compress_ratio;
+        fprintf(stdout, "Resetting quality control compression levels to %d,%d, to include '-c %u'!\n",
+                quality_min_compress_ratio, quality_max_compress_ratio, compress_ratio);
+    }
+
+    //no window to show the frames in
+    if(headless) live_camera_view = false;
+
+    //one camera per listed device or replay source, unless the no.of cameras is given
+    if(!no_of_cameras)
+    {
+        if(frame_source_type == FRAME_SOURCE_DEVICE) no_of_cameras = no_of_device_names ? no_of_device_names : 1;
+        else if(frame_source_type == FRAME_SOURCE_REPLAY) no_of_cameras = no_of_replay_paths ? no_of_replay_paths : 1;
+        else no_of_cameras = 1;
+    }
+
+    //replay needs frames to play back, for every camera
+    if((frame_source_type == FRAME_SOURCE_REPLAY) && (no_of_replay_paths < no_of_cameras))
+    {
+        fprintf(stderr, "Replay frame source needs a directory or raw file per camera (-p), %u given for %u cameras!\n",
+                no_of_replay_paths, no_of_cameras);
+        usage(stderr, argc, argv);
+        exit(EXIT_FAILURE);
+    }
+
     int rc = 0;
 
     //syslogs
     initialize_syslogs();
 
+    //cores and priorities not given on the command line, from the placement file, then the topology
+    if(placement_file && placement_load(&placement, &cpu_topology, placement_file, no_of_cameras))
+    {
+        usage(stderr, argc, argv);
+        exit(EXIT_FAILURE);
+    }
+    placement_auto(&placement, &cpu_topology, no_of_cameras);
+    placement_report(&placement, &cpu_topology, no_of_cameras);
+
+    //lock memory before any RT thread is created
+    lock_process_memory();
+
+    //SEQUENCER_REPORT_SIGNAL is taken only by the sequencer stats thread, block it in every other thread
+    sigset_t report_signal_set;
+    sigemptyset(&report_signal_set);
+    sigaddset(&report_signal_set, SEQUENCER_REPORT_SIGNAL);
+    if(pthread_sigmask(SIG_BLOCK, &report_signal_set, NULL)) EXIT_FAIL("pthread_sigmask");
+
     pthread_t rt_thread_dispatcher;
     pthread_attr_t rt_thread_dispatcher_sched_attr;
     struct sched_param rt_thread_dispatcher_sched_param;
 
-    assign_RT_schedular_attr(&rt_thread_dispatcher_sched_attr, &rt_thread_dispatcher_sched_param, SCHED_FIFO, SCHED_FIFO_MAX_PRIORITY, JETSON_TX2_ARM_CORE2);
+    assign_RT_schedular_attr(&rt_thread_dispatcher_sched_attr, &rt_thread_dispatcher_sched_param, SCHED_FIFO, SCHED_FIFO_MAX_PRIORITY, placement.sequencer_core);
 
     syslog(LOG_WARNING, "RT dispatcher thread dispatching with priority ==> %d <==", rt_thread_dispatcher_sched_param.sched_priority);
     rc = pthread_create(&rt_thread_dispatcher, &rt_thread_dispatcher_sched_attr, rt_thread_dispatcher_handler, (void *)0 );
@@ -162,102 +686,70 @@ int main( int argc, char** argv )
 //
 //  Return:         None
 //
-//  Description:    Initialize and start POSIX timer
-//                  Dispatch RT thtreads to query and store frames
+//  Description:    Register the services in the sequencer table
+//                  Dispatch RT thtreads to query and store frames through the sequencer
 //
 //------------------------------------------------------------------------------
 void *rt_thread_dispatcher_handler(void *args)
 {
     int rc;
-    pthread_t query_frames_thread, store_frames_thread;
-    pthread_attr_t query_frames_thread_attr, store_frames_thread_attr;
-    threadParams_t query_frames_threadIdx, store_frames_threadIdx;
-    struct sched_param query_frames_thread_sched_param, store_frames_thread_sched_param;
-
-    //posix timer parameters
-    struct sigevent sigevent_param;
-    timer_t timer_id;
-    struct itimerspec timer_period;
-    pthread_attr_t timer_thread_attr;
-    struct sched_param timer_thread_sched_param;
-
-    //assign thread indexes to keep track
-    query_frames_threadIdx.threadIdx = QUERY_FRAMES_THREAD_IDX;
-    store_frames_threadIdx.threadIdx = STORE_FRAMES_THREAD_IDX;
-
-    //assign RT scheduler attributes
-    assign_RT_schedular_attr(&query_frames_thread_attr, &query_frames_thread_sched_param, SCHED_FIFO, QUERY_FRAMES_THREAD_PRIORITY, JETSON_TX2_ARM_CORE2);
-    assign_RT_schedular_attr(&store_frames_thread_attr, &store_frames_thread_sched_param, SCHED_FIFO, STORE_FRAMES_THREAD_PRIORITY, JETSON_TX2_ARM_CORE2);
+    unsigned int camera;
+    struct rusage page_faults_baseline;
+    threadParams_t camera_threadIdx[MAX_CAMERAS];
+    //the sequencer keeps the name pointers
+    static char service_names[MAX_CAMERAS * SERVICES_PER_CAMERA][SERVICE_NAME_SIZE];
+
+    prefault_thread_stack(&page_faults_baseline);
+
+    //service table, cores and priorities from the placement, RM priorities are assigned by the sequencer
+    //two services per camera, see QUERY/STORE_FRAMES_SERVICE_IDX (store_frames_thread periods are changed at run time)
+    //every camera is released at the same offset, so the cameras capture and store at the same instants
+    for(camera = 0; camera < no_of_cameras; ++camera)
+    {
+        camera_threadIdx[camera].threadIdx = camera;
+
+        snprintf(service_names[QUERY_FRAMES_SERVICE_IDX(camera)], SERVICE_NAME_SIZE, (no_of_cameras > 1) ? "query_frames_thread_%u" : "query_frames_thread", camera);
+        rc = sequencer_register_service(service_names[QUERY_FRAMES_SERVICE_IDX(camera)], frame_source_period_msec(frame_source_type, frame_source_fps), 0,
+                                        placement.service_priorities[QUERY_FRAMES_SERVICE_IDX(camera)], placement.service_cores[QUERY_FRAMES_SERVICE_IDX(camera)],
+                                        query_frames, (void *)&camera_threadIdx[camera]);
+        assert(rc == (int)QUERY_FRAMES_SERVICE_IDX(camera));
+
+        snprintf(service_names[STORE_FRAMES_SERVICE_IDX(camera)], SERVICE_NAME_SIZE, (no_of_cameras > 1) ? "store_frames_thread_%u" : "store_frames_thread", camera);
+        rc = sequencer_register_service(service_names[STORE_FRAMES_SERVICE_IDX(camera)], DEFAULT_STORE_FRAMES_INTERVAL_IN_MSEC/store_frames_frequency, 0,
+                                        placement.service_priorities[STORE_FRAMES_SERVICE_IDX(camera)], placement.service_cores[STORE_FRAMES_SERVICE_IDX(camera)],
+                                        store_frames, (void *)&camera_threadIdx[camera]);
+        assert(rc == (int)STORE_FRAMES_SERVICE_IDX(camera));
+    }
 
     #ifdef DEBUG_MODE_ON
     syslog_scheduler();
     #endif //DEBUG_MODE_ON
 
-    //initialize timer thread attributes
-    assign_RT_schedular_attr(&timer_thread_attr, &timer_thread_sched_param, SCHED_FIFO, SCHED_FIFO_MAX_PRIORITY, JETSON_TX2_ARM_CORE2);
-
-    //assign sigevent paramaters for the timer
-    sigevent_param.sigev_notify = SIGEV_THREAD;
-    sigevent_param.sigev_value.sival_ptr = &timer_id;
-    sigevent_param.sigev_notify_function = &timer_handler;
-    sigevent_param.sigev_notify_attributes = &timer_thread_attr;
-
-    //initialize timer period values
-    timer_period.it_interval.tv_sec = (APP_TIMER_INTERVAL_IN_MSEC / MSEC_PER_SEC);
-    timer_period.it_interval.tv_nsec = (APP_TIMER_INTERVAL_IN_MSEC * NSEC_PER_MSEC);
-    timer_period.it_value.tv_sec = timer_period.it_interval.tv_sec; //start time
-    timer_period.it_value.tv_nsec = timer_period.it_interval.tv_nsec;
-
-    //create timer
-    if(timer_create(CLOCK_REALTIME, &sigevent_param, &timer_id)) EXIT_FAIL("timer_create");
-
-    //initialize app_timer_counter variable mutex attributes
-    if(pthread_mutexattr_init(&app_timer_counter_mutex_lock_attr)) EXIT_FAIL("pthread_mutexattr_init");
-    //set mutex type to PTHREAD_MUTEX_ERRORCHECK
-    if(pthread_mutexattr_settype(&app_timer_counter_mutex_lock_attr, PTHREAD_MUTEX_ERRORCHECK)) EXIT_FAIL("pthread_mutexattr_settype");
-    //initilize mutex to protect app_timer_counter variable
-    if(pthread_mutex_init(&app_timer_counter_mutex_lock, &app_timer_counter_mutex_lock_attr)) EXIT_FAIL("pthread_mutex_init");
-
-    //start timer
-    syslog(LOG_WARNING,"\n Timer starting with timer_thread_attr priority ==> %d <==", timer_thread_sched_param.sched_priority);
-    if(timer_settime(timer_id, 0, &timer_period, 0)) EXIT_FAIL("timer_settime");
-    timer_started = true;
-
-    //using openCV APIs to qccquire individual frames from the camera
-    //initialize, start querying frames, and save a sample frame, to make sure device is working..!
-    initialize_device_use_openCV();
-
-    //create query_frames_thread
-    syslog(LOG_WARNING,"\n query_frames_thread dispatching with priority ==> %d <==", query_frames_thread_sched_param.sched_priority);
-    query_frames_thread_dispatched = true;
-    rc = pthread_create(&query_frames_thread, &query_frames_thread_attr, query_frames, (void *)&query_frames_threadIdx);
-    if(rc)
-    {
-        EXIT_FAIL("pthread_create");
-    }
+    //cameras (openCV or V4L2), test patterns or replayed frames
+    //initialize, and show a first frame of each, to make sure the sources are working..!
+    initialize_capture();
 
-    //create store_frames_thread
-    syslog(LOG_WARNING,"\n store_frames_thread dispatching with priority ==> %d <==", store_frames_thread_sched_param.sched_priority);
-    store_frames_thread_dispatched = true;
-    rc = pthread_create(&store_frames_thread, &store_frames_thread_attr, store_frames, (void *)&store_frames_threadIdx);
-    if(rc)
-    {
-        EXIT_FAIL("pthread_create");
-    }
+    //release, grab, encode and write timeline, see trace_export
+    #ifdef DEBUG_MODE_ON
+    trace_start(TRACE_FILE_NAME);
+    #endif //DEBUG_MODE_ON
+
+    //dispatch the services, and release them until all of them exit
+    sequencer_start(placement.sequencer_core);
+    sequencer_join();
 
-    //wait fot query_frames_thread to exit
-    pthread_join(query_frames_thread, NULL);
-    //wait for store_frames_thread to exit
-    pthread_join(store_frames_thread, NULL);
+    #ifdef DEBUG_MODE_ON
+    trace_stop();
+    #endif //DEBUG_MODE_ON
 
-    //stop timer
-    timer_period.it_interval.tv_sec = 0;
-    timer_period.it_interval.tv_nsec = 0;
-    if(timer_settime(timer_id, 0, &timer_period, 0)) EXIT_FAIL("timer_settime");
-    timer_started = false;
+    //benchmark results, see pipeline_bench.sh
+    if(bench_report_file) bench_report_write(bench_report_file);
+
+    //frame ring and pool counters, used for sizing them
+    release_frame_buffers();
+
+    report_thread_page_faults("rt_thread_dispatcher", &page_faults_baseline);
 
-    //destroy mutex lock
-    pthread_mutex_destroy(&app_timer_counter_mutex_lock);
     //add a log
     syslog(LOG_WARNING," rt_thread_dispatcher exiting...");
     //exit thread
@@ -265,6 +757,32 @@ void *rt_thread_dispatcher_handler(void *args)
 } //end of "rt_thread_dispatcher_handler()""
 
 
+//------------------------------------------------------------------------------
+//  Function Name:  parse_list
+//
+//  Parameters:     list - comma separated, split in place
+//                  items - set to the entries
+//                  max_items - size of items, extra entries are ignored
+//
+//  Return:         No.of entries set
+//
+//------------------------------------------------------------------------------
+static unsigned int parse_list(char *list, char **items, const unsigned int max_items)
+{
+    char *item;
+    unsigned int no_of_items = 0;
+
+    for(item = strtok(list, ","); item && (no_of_items < max_items); item = strtok(NULL, ","))
+    {
+        items[no_of_items++] = item;
+    }
+
+    if(item) fprintf(stdout, "Ignoring '%s'.. (Max %u allowed)!\n", item, max_items);
+
+    return no_of_items;
+}
+
+
 //------------------------------------------------------------------------------
 //  Function Name:  rt_thread_dispatcher_handler
 //
@@ -281,12 +799,47 @@ static void usage(FILE *fp, int argc, char **argv)
     fprintf(fp,
              "\nUsage: %s [options]\n\n"
              "Options:\n"
+             "\t-a    Store the frames in this frame archive (<name>_000.seg..., <name>.idx), see archive_extract \n\t\t[default: one file per frame]\n\n"
+             "\t-A    Frame archive segment size in MB, used with '-a' \n\t\t[Min: 16, Max: 4096, Default: 256]\n\n"
+             "\t-b    No.of V4L2 buffers, used with '-m 1' \n\t\t[Min: 2, Max: 32, Default: 4]\n\n"
              "\t-c    Compression ratio \n\t\t[Min: 0, Max: 9, Default :0]\n\n"
-             "\t-d    Video device name \n\t\t[default: '/dev/video0']\n\n"
+             "\t-C    Cores of the services, comma separated, query and store of camera 0, then camera 1.. \n\t\t[Default: placement file (-L), else automatic]\n\n"
+             "\t-d    Video device names, comma separated, one per camera, used with '-i 0' \n\t\t[default: '/dev/video0,/dev/video1,..']\n\n"
+             "\t-D    Change detection, a 16x16 pixel cell changed if its mean moved by more than this \n\t\t[0: store every frame, Max: 254, Default: 0]\n\n"
+             "\t-e    No.of .png encode worker threads \n\t\t[0: encode in the store thread, Max: 8, Default: 2]\n\n"
+             "\t-E    Cores of the encode workers, comma separated \n\t\t[Default: placement file (-L), else automatic]\n\n"
              "\t-f    Select frequency to save frames \n\t\t[Min: 1 Hz, Max: 10 Hz, Default: 1 Hz]\n\n"
+             "\t-F    Frame rate of the test pattern and replay sources \n\t\t[Min: 1 fps, Max: 100 fps, Default: 20 fps]\n\n"
+             "\t-g    Resolution of the test pattern and raw replay sources, WIDTHxHEIGHT \n\t\t[Default: 640x480]\n\n"
              "\t-h    Print this message\n\n"
-			 "\t-l    Live camera view \n\t\t[default: false]\n\n"
-             "\t-n    Number of frames to collect \n\t\t[Min: 1, Max: 6000, Default: 100]\n\n",
+             "\t-H    Back the frame buffers with huge pages \n\t\t[default: 0]\n\n"
+             "\t-i    Frame source \n\t\t[0: device, 1: test pattern, 2: replay (-p), Default: 0]\n\n"
+             "\t-I    Publish every n-th captured frame to the shared memory frame ring, used with '-M' \n\t\t[Min: 1, Max: 1000, Default: 1]\n\n"
+             "\t-j    Write the benchmark results (JSON) to this file, allows '-f' up to 50 Hz \n\n"
+             "\t-k    Change detection, store a frame at least this often, changed or not \n\t\t[Min: 1 sec, Max: 3600 sec, Default: 60 sec]\n\n"
+             "\t-K    Delta frames, a keyframe every n frames, changed 32x32 tiles in between, used with '-o 2' \n\t\t[Min: 1, Max: 1000, Default: 30]\n\n"
+			 "\t-l    Live camera view, preview the latest captured frames instead of the stored ones \n\t\t[default: false]\n\n"
+             "\t-L    Placement file, '<role> <core>[,<core>..] [<priority>]' lines, roles: sequencer, query[_<n>], store[_<n>], encode \n\t\t[default: isolated cores (isolcpus) for the services, else the smaller big.LITTLE cores, the rest encode]\n\n"
+             "\t-m    I/O method \n\t\t[0: openCV, 1: V4L2 streaming (mmap), Default: 0]\n\n"
+             "\t-M    Publish the captured frames to this POSIX shared memory frame ring (<name>_camera_<n> with more than one camera), see frame_subscriber.h \n\t\t[default: not published]\n\n"
+             "\t-n    Number of frames to collect \n\t\t[Min: 1, Max: 6000, Default: 100]\n\n"
+             "\t-N    No.of cameras, each stores to camera_<n>/ (archives <name>_camera_<n>) if more than one \n\t\t[Min: 1, Max: 4, Default: no.of '-d'/'-p' entries]\n\n"
+             "\t-o    Output format \n\t\t[0: .ppm, 1: .png, 2: .rtd delta frames (see '-K'), Default: .png if '-c' is not 0, else .ppm]\n\n"
+             "\t-p    Replay directories of .ppm/.png frames, or raw BGR24 files (-g resolution), comma separated, one per camera, used with '-i 2' \n\n"
+             "\t-P    Change detection, changed cells to store a frame, percent of the cells \n\t\t[0: any cell, Max: 100, Default: 1]\n\n"
+             "\t-Q    Quality control, store jobs allowed to miss their period in percent, the store mode (.ppm/.png, compression, resolution) is stepped to hold it, not with delta frames, .png frames are encoded by the store thread ('-e 0') \n\t\t[0: off, Max: 50, Default: 0]\n\n"
+             "\t-r    No.of frame ring slots between query and store threads \n\t\t[Min: 3, Max: 16, Default: 4]\n\n"
+             "\t-R    Priorities of the services, comma separated, same order as '-C', relative to the max (see include.h) \n\t\t[Min: 2, -1: rate-monotonic, Default: placement file (-L), else -1]\n\n"
+             "\t-s    Scheduling policy of the services \n\t\t[0: SCHED_FIFO, 1: SCHED_DEADLINE after the warm-up, Default: 0]\n\n"
+             "\t-t    Sequencer release mode \n\t\t[0: tickless (clock_nanosleep), 1: 1 ms timer tick, Default: 0]\n\n"
+             "\t-U    Preview rate, frames are shown by a best-effort thread, dropped if it falls behind \n\t\t[Min: 1 Hz, Max: 30 Hz, Default: 10 Hz]\n\n"
+             "\t-v    Frame view window \n\t\t[0: headless, no window and keys, Default: 1]\n\n"
+             "\t-V    Preview size, frames are box downscaled by an integer factor to fit WIDTHxHEIGHT \n\t\t[Min: 16x16, Default: 320x240]\n\n"
+             "\t-w    Warm-up before the schedulability analysis, in seconds \n\t\t[0: no analysis, Max: 60, Default: 5]\n\n"
+             "\t-X    Quality control, stored frames are box downscaled by at most this factor, used with '-Q' \n\t\t[Min: 1, Max: 4, Default: 2]\n\n"
+             "\t-Y    Quality control, .png compression levels the store mode may step through, MIN,MAX, 0 allows .ppm, used with '-Q' \n\t\t[Min: 0, Max: 9, Default: the '-o'/'-c' store mode only]\n\n"
+             "\tKeys: '+'/'-' raise/lower the frequency to save frames, 'q'/'Esc' exit\n\n"
+             "\tkill -USR1 <pid> prints the service latency reports while running\n\n",
              argv[0]);
 }
 
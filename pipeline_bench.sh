@@ -0,0 +1,79 @@
+#!/bin/sh
+#
+#  Author: Nagarjuna Pamidi
+#
+#  File name: pipeline_bench.sh
+#
+#  Description: Headless capture -> store pipeline benchmark on the test pattern source (no camera needed).
+#               Sweeps resolution, store frequency, compression ratio and output format, one ./main run per
+#               configuration, and collects the per run results (see bench_report.c) into one JSON file.
+#               Compares them against a baseline with bench_compare, if one is given. Run as root (SCHED_FIFO, mlockall)
+#
+#               Usage: ./pipeline_bench.sh [results file, default bench_results.json] [baseline file]
+#
+#               Sweep, overridden from the environment:
+#               BENCH_RESOLUTIONS   frame source resolutions            [default: "320x240 640x480 1280x720"]
+#               BENCH_STORE_HZ      store frequencies, up to 50 Hz      [default: "1 5 10 20"]
+#               BENCH_COMPRESS      .png compression ratios             [default: "0 1 2 3 4 5 6 7 8 9"]
+#               BENCH_SECONDS       stored time per run                 [default: 5]
+#               BENCH_THRESHOLD     regression threshold, in percent    [default: 10]
+#
+
+RESULTS=${1:-bench_results.json}
+BASELINE=$2
+
+BENCH_RESOLUTIONS=${BENCH_RESOLUTIONS:-"320x240 640x480 1280x720"}
+BENCH_STORE_HZ=${BENCH_STORE_HZ:-"1 5 10 20"}
+BENCH_COMPRESS=${BENCH_COMPRESS:-"0 1 2 3 4 5 6 7 8 9"}
+BENCH_SECONDS=${BENCH_SECONDS:-5}
+BENCH_THRESHOLD=${BENCH_THRESHOLD:-10}
+
+MAIN=$(pwd)/main
+COMPARE=$(pwd)/bench_compare
+
+#frames are stored in a scratch directory, removed after every run
+SCRATCH=$(mktemp -d bench.XXXXXX) || exit 1
+trap 'rm -rf "$SCRATCH"' EXIT
+
+#run <resolution> <store Hz> <compression ratio> <output format>
+run()
+{
+    frames=$(($2 * BENCH_SECONDS))
+    [ "$frames" -lt 5 ] && frames=5
+    #the source delivers at least one frame per store release
+    fps=20
+    [ "$2" -gt "$fps" ] && fps=$2
+
+    echo "  $1 at $2 Hz, compression $3, format $4 ($frames frames)"
+    (cd "$SCRATCH" && "$MAIN" -i 1 -v 0 -w 0 -g "$1" -F "$fps" -f "$2" -c "$3" -o "$4" -n "$frames" -j run.json > run.txt 2>&1)
+    if [ $? -ne 0 ] || [ ! -s "$SCRATCH/run.json" ]; then
+        echo "  run failed, see below"
+        tail -20 "$SCRATCH/run.txt"
+        exit 1
+    fi
+
+    [ -n "$first_run" ] || echo "," >> "$RESULTS"
+    first_run=
+    tr -d '\n' < "$SCRATCH/run.json" >> "$RESULTS"
+    rm -f "$SCRATCH"/*
+}
+
+echo "pipeline benchmark, results in $RESULTS"
+echo '{"runs": [' > "$RESULTS"
+first_run=1
+
+for resolution in $BENCH_RESOLUTIONS; do
+    for store_hz in $BENCH_STORE_HZ; do
+        run "$resolution" "$store_hz" 0 0
+        for compress in $BENCH_COMPRESS; do
+            run "$resolution" "$store_hz" "$compress" 1
+        done
+    done
+done
+
+printf '\n]}\n' >> "$RESULTS"
+
+if [ -n "$BASELINE" ]; then
+    echo "comparing against $BASELINE"
+    "$COMPARE" "$BASELINE" "$RESULTS" "$BENCH_THRESHOLD"
+fi
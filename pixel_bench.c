@@ -0,0 +1,504 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: pixel_bench.c
+//
+//  Description: Verifies and benchmarks the pixel conversion kernels (see pixel_convert.c) of every instruction set
+//               the CPU supports. Verification: every vector kernel against the scalar one (bit exact, odd tails,
+//               padded rows, no writes past the row), and the scalar fixed point against floating point BT.601 over
+//               every Y, U, V (bounded error), the box downscale against the box means. Benchmark: megapixels per
+//               second at the usual camera resolutions, the box downscale to the default preview size.
+//               Exits with EXIT_FAILURE if a kernel fails verification
+//
+//               Usage: ./pixel_bench [seconds per kernel, default 0.5]
+//
+
+#include "include.h"
+#include "pixel_convert.h"
+#include <math.h>
+
+#define DEFAULT_BENCH_SECONDS       (0.5)
+
+//max difference from floating point BT.601, per channel
+#define MAX_REFERENCE_ERROR         (2)
+
+//bytes after every destination row, must be left untouched
+#define ROW_GUARD_SIZE              (64)
+#define ROW_GUARD_BYTE              (0xA5)
+
+//verified row widths, around every vector step (8, 16, 32 pixels)
+static const unsigned int verify_widths[] = {2, 4, 6, 8, 10, 14, 16, 18, 30, 32, 34, 46, 48, 62, 64, 66, 98, 640, 642};
+#define NO_OF_VERIFY_WIDTHS     (sizeof(verify_widths) / sizeof(verify_widths[0]))
+#define VERIFY_HEIGHT           (3)
+
+//benchmarked resolutions
+static const unsigned int bench_resolutions[][2] = {{640, 480}, {1280, 720}, {1920, 1080}};
+#define NO_OF_BENCH_RESOLUTIONS (sizeof(bench_resolutions) / sizeof(bench_resolutions[0]))
+
+//box downscale: verified BGR frames (source widths around every vector step) and factors, benchmarked preview size
+static const unsigned int verify_box_widths[] = {1, 5, 6, 11, 16, 17, 33, 64, 65, 640};
+#define NO_OF_VERIFY_BOX_WIDTHS (sizeof(verify_box_widths) / sizeof(verify_box_widths[0]))
+#define VERIFY_BOX_HEIGHT       (2 * MAX_PIXEL_BOX_FACTOR + 1)
+#define BENCH_BOX_WIDTH         (320)
+#define BENCH_BOX_HEIGHT        (240)
+
+//conversion names, indexed by PIXEL_CONVERT_xxx
+static const char *conversion_names[PIXEL_CONVERSIONS] =
+{
+    "yuyv->bgr",
+    "uyvy->bgr",
+    "yuyv->gray"
+};
+
+//destination bytes per pixel, indexed by PIXEL_CONVERT_xxx
+static const unsigned int dst_channels[PIXEL_CONVERSIONS] = {3, 3, 1};
+
+//local functions
+static int verify_kernels(const int isa);
+static int verify_reference(void);
+static int verify_box_downscale(const int isa);
+static double bench_kernel(const int conversion, const unsigned int width, const unsigned int height, const double seconds);
+static double bench_box_downscale(const unsigned int width, const unsigned int height, const double seconds);
+static void fill_random(unsigned char *data, const size_t size);
+static double elapsed_sec(const struct timespec *start_time);
+static void print_usage(void);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  main
+//
+//  Parameters:     argc, argv - optional seconds per benchmarked kernel
+//
+//  Return:         EXIT_SUCCESS, or EXIT_FAILURE if a kernel fails verification
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    int isa, conversion, failures = 0;
+    unsigned int r;
+    double seconds = DEFAULT_BENCH_SECONDS;
+    double mpix_per_sec, scalar_mpix_per_sec[PIXEL_CONVERSIONS], scalar_box_mpix_per_sec = 0;
+
+    if(argc > 2)
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+    if(argc == 2) seconds = atof(argv[1]);
+    if(seconds <= 0)
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    pixel_convert_init();
+    fprintf(stdout, "selected kernels: %s\n\n", pixel_convert_isa_name(pixel_convert_selected_isa()));
+
+    failures += verify_reference();
+    failures += verify_box_downscale(PIXEL_ISA_SCALAR);
+    for(isa = PIXEL_ISA_SCALAR + 1; isa < PIXEL_ISAS; ++isa)
+    {
+        if(!pixel_convert_isa_supported(isa))
+        {
+            fprintf(stdout, "%-8s not supported\n", pixel_convert_isa_name(isa));
+            continue;
+        }
+        failures += verify_kernels(isa);
+        failures += verify_box_downscale(isa);
+    }
+
+    fprintf(stdout, "\n%-10s %-8s %-11s %12s %9s\n", "resolution", "kernels", "conversion", "Mpixels/sec", "speedup");
+
+    for(r = 0; r < NO_OF_BENCH_RESOLUTIONS; ++r)
+    {
+        for(isa = PIXEL_ISA_SCALAR; isa < PIXEL_ISAS; ++isa)
+        {
+            if(pixel_convert_select_isa(isa)) continue;
+
+            for(conversion = 0; conversion < PIXEL_CONVERSIONS; ++conversion)
+            {
+                mpix_per_sec = bench_kernel(conversion, bench_resolutions[r][0], bench_resolutions[r][1], seconds);
+                if(isa == PIXEL_ISA_SCALAR) scalar_mpix_per_sec[conversion] = mpix_per_sec;
+
+                fprintf(stdout, "%4ux%-5u %-8s %-11s %12.1lf %8.2lfx\n", bench_resolutions[r][0], bench_resolutions[r][1],
+                        pixel_convert_isa_name(isa), conversion_names[conversion], mpix_per_sec,
+                        mpix_per_sec / scalar_mpix_per_sec[conversion]);
+            }
+
+            //source megapixels, downscaled to fit the preview
+            mpix_per_sec = bench_box_downscale(bench_resolutions[r][0], bench_resolutions[r][1], seconds);
+            if(isa == PIXEL_ISA_SCALAR) scalar_box_mpix_per_sec = mpix_per_sec;
+
+            fprintf(stdout, "%4ux%-5u %-8s bgr box/%-3u %12.1lf %8.2lfx\n", bench_resolutions[r][0], bench_resolutions[r][1],
+                    pixel_convert_isa_name(isa), pixel_box_factor(bench_resolutions[r][0], bench_resolutions[r][1], BENCH_BOX_WIDTH, BENCH_BOX_HEIGHT),
+                    mpix_per_sec, mpix_per_sec / scalar_box_mpix_per_sec);
+        }
+    }
+
+    fprintf(stdout, "\n%d verification failures\n", failures);
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  verify_kernels
+//
+//  Parameters:     isa - PIXEL_ISA_xxx, supported by the CPU
+//
+//  Return:         No.of failed checks
+//
+//  Description:    Converts random frames of every verified width with the scalar and the isa kernels. Source rows are
+//                  padded, destination rows are followed by guard bytes. Outputs must match byte for byte, and the
+//                  guard bytes must be untouched
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int verify_kernels(const int isa)
+{
+    int conversion, failures = 0;
+    unsigned int w, width, row;
+    size_t src_step, dst_step, dst_row_size;
+    unsigned char *src, *expected, *actual;
+    const unsigned char *guard;
+
+    for(conversion = 0; conversion < PIXEL_CONVERSIONS; ++conversion)
+    {
+        for(w = 0; w < NO_OF_VERIFY_WIDTHS; ++w)
+        {
+            width = verify_widths[w];
+            src_step = (width * 2) + 6;
+            dst_row_size = width * dst_channels[conversion];
+            dst_step = dst_row_size + ROW_GUARD_SIZE;
+
+            src = (unsigned char *)malloc(src_step * VERIFY_HEIGHT);
+            expected = (unsigned char *)malloc(dst_step * VERIFY_HEIGHT);
+            actual = (unsigned char *)malloc(dst_step * VERIFY_HEIGHT);
+            if(!src || !expected || !actual) EXIT_FAIL("malloc");
+
+            fill_random(src, src_step * VERIFY_HEIGHT);
+            memset(expected, ROW_GUARD_BYTE, dst_step * VERIFY_HEIGHT);
+            memset(actual, ROW_GUARD_BYTE, dst_step * VERIFY_HEIGHT);
+
+            if(pixel_convert_select_isa(PIXEL_ISA_SCALAR)) EXIT_FAIL("pixel_convert_select_isa");
+            pixel_convert(conversion, src, src_step, expected, dst_step, width, VERIFY_HEIGHT);
+            if(pixel_convert_select_isa(isa)) EXIT_FAIL("pixel_convert_select_isa");
+            pixel_convert(conversion, src, src_step, actual, dst_step, width, VERIFY_HEIGHT);
+
+            for(row = 0; row < VERIFY_HEIGHT; ++row)
+            {
+                if(memcmp(expected + (row * dst_step), actual + (row * dst_step), dst_row_size))
+                {
+                    fprintf(stdout, "%-8s %-11s width %u, row %u differs from scalar\n",
+                            pixel_convert_isa_name(isa), conversion_names[conversion], width, row);
+                    ++failures;
+                    break;
+                }
+
+                for(guard = actual + (row * dst_step) + dst_row_size; guard < actual + ((row + 1) * dst_step); ++guard)
+                {
+                    if(*guard != ROW_GUARD_BYTE) break;
+                }
+                if(guard != actual + ((row + 1) * dst_step))
+                {
+                    fprintf(stdout, "%-8s %-11s width %u, row %u written past the row\n",
+                            pixel_convert_isa_name(isa), conversion_names[conversion], width, row);
+                    ++failures;
+                    break;
+                }
+            }
+
+            free(src);
+            free(expected);
+            free(actual);
+        }
+    }
+
+    fprintf(stdout, "%-8s %s\n", pixel_convert_isa_name(isa), failures ? "FAILED" : "bit exact with scalar");
+    return failures;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  verify_reference
+//
+//  Parameters:     None
+//
+//  Return:         No.of failed checks (0 or 1)
+//
+//  Description:    Scalar YUYV -> BGR of every Y, U, V against rounded floating point BT.601 (limited range),
+//                  and YUYV -> gray against Y. The largest per channel difference must be MAX_REFERENCE_ERROR or less
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int verify_reference(void)
+{
+    int y, u, v, i, diff, max_error = 0;
+    unsigned char yuyv[4], bgr[6], gray[2];
+    double c, d, e, expected[3];
+
+    if(pixel_convert_select_isa(PIXEL_ISA_SCALAR)) EXIT_FAIL("pixel_convert_select_isa");
+
+    for(y = 0; y < 256; ++y)
+    {
+        for(u = 0; u < 256; ++u)
+        {
+            for(v = 0; v < 256; ++v)
+            {
+                yuyv[0] = y;
+                yuyv[1] = u;
+                yuyv[2] = y;
+                yuyv[3] = v;
+                pixel_convert(PIXEL_CONVERT_YUYV_TO_BGR, yuyv, sizeof(yuyv), bgr, sizeof(bgr), 2, 1);
+
+                c = 1.164 * (y - 16);
+                d = u - 128;
+                e = v - 128;
+                expected[0] = c + (2.018 * d);
+                expected[1] = c - (0.391 * d) - (0.813 * e);
+                expected[2] = c + (1.596 * e);
+
+                for(i = 0; i < 3; ++i)
+                {
+                    expected[i] = (expected[i] < 0) ? 0 : ((expected[i] > 255) ? 255 : floor(expected[i] + 0.5));
+                    diff = abs(bgr[i] - (int)expected[i]);
+                    if(diff > max_error) max_error = diff;
+                }
+            }
+        }
+
+        pixel_convert(PIXEL_CONVERT_YUYV_TO_GRAY, yuyv, sizeof(yuyv), gray, sizeof(gray), 2, 1);
+        if((gray[0] != y) || (gray[1] != y)) max_error = 256;
+    }
+
+    fprintf(stdout, "%-8s max error %d from floating point BT.601 (limit %d)\n", "scalar", max_error, MAX_REFERENCE_ERROR);
+
+    return (max_error > MAX_REFERENCE_ERROR) ? 1 : 0;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  verify_box_downscale
+//
+//  Parameters:     isa - PIXEL_ISA_xxx, supported by the CPU
+//
+//  Return:         No.of failed checks
+//
+//  Description:    Downscales random BGR frames of every verified width by every factor, with padded source rows and
+//                  destination rows followed by guard bytes. Every destination byte must be the rounded mean of its
+//                  box, and the guard bytes must be untouched
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int verify_box_downscale(const int isa)
+{
+    int failures = 0;
+    unsigned int w, width, factor, row, x, y, i, sum;
+    size_t src_step, dst_step, dst_row_size;
+    unsigned char *src, *dst;
+    unsigned short *column_sums;
+    const unsigned char *guard;
+
+    if(pixel_convert_select_isa(isa)) EXIT_FAIL("pixel_convert_select_isa");
+
+    for(w = 0; (w < NO_OF_VERIFY_BOX_WIDTHS) && !failures; ++w)
+    {
+        width = verify_box_widths[w];
+
+        for(factor = 1; (factor <= MAX_PIXEL_BOX_FACTOR) && (factor <= width) && !failures; ++factor)
+        {
+            src_step = (width * 3) + 5;
+            dst_row_size = (width / factor) * 3;
+            dst_step = dst_row_size + ROW_GUARD_SIZE;
+
+            src = (unsigned char *)malloc(src_step * VERIFY_BOX_HEIGHT);
+            dst = (unsigned char *)malloc(dst_step * (VERIFY_BOX_HEIGHT / factor));
+            column_sums = (unsigned short *)malloc(width * 3 * sizeof(*column_sums));
+            if(!src || !dst || !column_sums) EXIT_FAIL("malloc");
+
+            fill_random(src, src_step * VERIFY_BOX_HEIGHT);
+            memset(dst, ROW_GUARD_BYTE, dst_step * (VERIFY_BOX_HEIGHT / factor));
+
+            pixel_box_downscale(src, src_step, width, VERIFY_BOX_HEIGHT, 3, factor, dst, dst_step, column_sums);
+
+            for(row = 0; (row < VERIFY_BOX_HEIGHT / factor) && !failures; ++row)
+            {
+                for(i = 0; i < dst_row_size; ++i)
+                {
+                    sum = 0;
+                    for(y = 0; y < factor; ++y)
+                    {
+                        for(x = 0; x < factor; ++x)
+                        {
+                            sum += src[((row * factor + y) * src_step) + ((((i / 3) * factor) + x) * 3) + (i % 3)];
+                        }
+                    }
+
+                    if(dst[(row * dst_step) + i] != ((sum + ((factor * factor) / 2)) / (factor * factor)))
+                    {
+                        fprintf(stdout, "%-8s bgr box/%u width %u, row %u differs from the box mean\n",
+                                pixel_convert_isa_name(isa), factor, width, row);
+                        ++failures;
+                        break;
+                    }
+                }
+
+                for(guard = dst + (row * dst_step) + dst_row_size; guard < dst + ((row + 1) * dst_step); ++guard)
+                {
+                    if(*guard != ROW_GUARD_BYTE) break;
+                }
+                if(guard != dst + ((row + 1) * dst_step))
+                {
+                    fprintf(stdout, "%-8s bgr box/%u width %u, row %u written past the row\n",
+                            pixel_convert_isa_name(isa), factor, width, row);
+                    ++failures;
+                }
+            }
+
+            free(src);
+            free(dst);
+            free(column_sums);
+        }
+    }
+
+    fprintf(stdout, "%-8s box downscale %s\n", pixel_convert_isa_name(isa), failures ? "FAILED" : "exact box means");
+    return failures;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  bench_kernel
+//
+//  Parameters:     conversion - PIXEL_CONVERT_xxx
+//                  width, height - frame resolution
+//                  seconds - minimum run time
+//
+//  Return:         Megapixels converted per second, with the selected kernels
+//
+//  Description:    Converts the same frame back to back, once untimed to fault the buffers in
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static double bench_kernel(const int conversion, const unsigned int width, const unsigned int height, const double seconds)
+{
+    unsigned char *src, *dst;
+    unsigned long long frames = 0;
+    double elapsed;
+    struct timespec start_time;
+    const size_t src_step = width * 2;
+    const size_t dst_step = width * dst_channels[conversion];
+
+    src = (unsigned char *)malloc(src_step * height);
+    dst = (unsigned char *)malloc(dst_step * height);
+    if(!src || !dst) EXIT_FAIL("malloc");
+    fill_random(src, src_step * height);
+
+    pixel_convert(conversion, src, src_step, dst, dst_step, width, height);
+
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    do
+    {
+        pixel_convert(conversion, src, src_step, dst, dst_step, width, height);
+        ++frames;
+        elapsed = elapsed_sec(&start_time);
+    }while(elapsed < seconds);
+
+    free(src);
+    free(dst);
+
+    return ((double)frames * width * height) / (elapsed * 1e6);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  bench_box_downscale
+//
+//  Parameters:     width, height - BGR frame resolution
+//                  seconds - minimum run time
+//
+//  Return:         Source megapixels downscaled per second to fit BENCH_BOX_WIDTH x BENCH_BOX_HEIGHT, with the
+//                  selected kernels
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static double bench_box_downscale(const unsigned int width, const unsigned int height, const double seconds)
+{
+    unsigned char *src, *dst;
+    unsigned short *column_sums;
+    unsigned long long frames = 0;
+    double elapsed;
+    struct timespec start_time;
+    const unsigned int factor = pixel_box_factor(width, height, BENCH_BOX_WIDTH, BENCH_BOX_HEIGHT);
+    const size_t src_step = width * 3;
+    const size_t dst_step = (width / factor) * 3;
+
+    src = (unsigned char *)malloc(src_step * height);
+    dst = (unsigned char *)malloc(dst_step * (height / factor));
+    column_sums = (unsigned short *)malloc(src_step * sizeof(*column_sums));
+    if(!src || !dst || !column_sums) EXIT_FAIL("malloc");
+    fill_random(src, src_step * height);
+
+    pixel_box_downscale(src, src_step, width, height, 3, factor, dst, dst_step, column_sums);
+
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    do
+    {
+        pixel_box_downscale(src, src_step, width, height, 3, factor, dst, dst_step, column_sums);
+        ++frames;
+        elapsed = elapsed_sec(&start_time);
+    }while(elapsed < seconds);
+
+    free(src);
+    free(dst);
+    free(column_sums);
+
+    return ((double)frames * width * height) / (elapsed * 1e6);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  fill_random
+//
+//  Parameters:     data, size - buffer to fill
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void fill_random(unsigned char *data, const size_t size)
+{
+    size_t i;
+
+    for(i = 0; i < size; ++i)
+    {
+        data[i] = rand() & 0xFF;
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  elapsed_sec
+//
+//  Parameters:     start_time - CLOCK_MONOTONIC
+//
+//  Return:         Seconds since start_time
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static double elapsed_sec(const struct timespec *start_time)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start_time->tv_sec) + ((now.tv_nsec - start_time->tv_nsec) / 1e9);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  print_usage
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void print_usage(void)
+{
+    fprintf(stderr, "\nUsage: ./pixel_bench [seconds per kernel, default %.1lf]\n\n", DEFAULT_BENCH_SECONDS);
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
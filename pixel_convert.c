@@ -0,0 +1,858 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: pixel_convert.c
+//
+//  Description: YUV 4:2:2 (V4L2_PIX_FMT_YUYV / UYVY) to BGR24 and gray conversion kernels, and the box downscale of
+//               the preview frames. A scalar reference, SSE2 and AVX2 kernels on x86, NEON kernels on ARM. The kernels
+//               are picked at run time from the CPU features, every vector kernel produces the same bytes as the
+//               scalar one (see pixel_bench.c)
+//
+
+#include "include.h"
+#include "pixel_convert.h"
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIXEL_CONVERT_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PIXEL_CONVERT_NEON
+#include <arm_neon.h>
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+//converts one row of width pixels
+typedef void (*pixel_row_fn_t)(const unsigned char *src, unsigned char *dst, const unsigned int width);
+
+//adds size bytes of one row to their 16 bit column sums
+typedef void (*pixel_accumulate_fn_t)(const unsigned char *src, unsigned short *sums, const unsigned int size);
+
+//kernels of one instruction set, rows indexed by PIXEL_CONVERT_xxx
+typedef struct
+{
+    const char *name;
+    pixel_row_fn_t rows[PIXEL_CONVERSIONS];
+    pixel_accumulate_fn_t accumulate;
+}pixel_isa_kernels_t;
+
+//local functions
+static void yuyv_to_bgr_row_scalar(const unsigned char *src, unsigned char *dst, const unsigned int width);
+static void uyvy_to_bgr_row_scalar(const unsigned char *src, unsigned char *dst, const unsigned int width);
+static void yuyv_to_gray_row_scalar(const unsigned char *src, unsigned char *dst, const unsigned int width);
+static void accumulate_row_scalar(const unsigned char *src, unsigned short *sums, const unsigned int size);
+#ifdef PIXEL_CONVERT_X86
+static void yuyv_to_bgr_row_sse2(const unsigned char *src, unsigned char *dst, const unsigned int width);
+static void uyvy_to_bgr_row_sse2(const unsigned char *src, unsigned char *dst, const unsigned int width);
+static void yuyv_to_gray_row_sse2(const unsigned char *src, unsigned char *dst, const unsigned int width);
+static void yuyv_to_bgr_row_avx2(const unsigned char *src, unsigned char *dst, const unsigned int width);
+static void uyvy_to_bgr_row_avx2(const unsigned char *src, unsigned char *dst, const unsigned int width);
+static void yuyv_to_gray_row_avx2(const unsigned char *src, unsigned char *dst, const unsigned int width);
+static void accumulate_row_sse2(const unsigned char *src, unsigned short *sums, const unsigned int size);
+static void accumulate_row_avx2(const unsigned char *src, unsigned short *sums, const unsigned int size);
+#endif //PIXEL_CONVERT_X86
+#ifdef PIXEL_CONVERT_NEON
+static void yuyv_to_bgr_row_neon(const unsigned char *src, unsigned char *dst, const unsigned int width);
+static void uyvy_to_bgr_row_neon(const unsigned char *src, unsigned char *dst, const unsigned int width);
+static void yuyv_to_gray_row_neon(const unsigned char *src, unsigned char *dst, const unsigned int width);
+static void accumulate_row_neon(const unsigned char *src, unsigned short *sums, const unsigned int size);
+#endif //PIXEL_CONVERT_NEON
+
+//kernel table, indexed by PIXEL_ISA_xxx. Instruction sets not built for this host have no kernels
+static const pixel_isa_kernels_t isa_kernels[PIXEL_ISAS] =
+{
+    {"scalar",  {yuyv_to_bgr_row_scalar, uyvy_to_bgr_row_scalar, yuyv_to_gray_row_scalar}, accumulate_row_scalar},
+#ifdef PIXEL_CONVERT_X86
+    {"sse2",    {yuyv_to_bgr_row_sse2, uyvy_to_bgr_row_sse2, yuyv_to_gray_row_sse2}, accumulate_row_sse2},
+    {"avx2",    {yuyv_to_bgr_row_avx2, uyvy_to_bgr_row_avx2, yuyv_to_gray_row_avx2}, accumulate_row_avx2},
+#else
+    {"sse2",    {NULL, NULL, NULL}, NULL},
+    {"avx2",    {NULL, NULL, NULL}, NULL},
+#endif //PIXEL_CONVERT_X86
+#ifdef PIXEL_CONVERT_NEON
+    {"neon",    {yuyv_to_bgr_row_neon, uyvy_to_bgr_row_neon, yuyv_to_gray_row_neon}, accumulate_row_neon},
+#else
+    {"neon",    {NULL, NULL, NULL}, NULL},
+#endif //PIXEL_CONVERT_NEON
+};
+
+//kernels used by pixel_convert(), scalar until pixel_convert_init()
+static int selected_isa = PIXEL_ISA_SCALAR;
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  pixel_convert_init
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//  Description:    Selects the widest instruction set the CPU supports: AVX2, SSE2, NEON, scalar
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void pixel_convert_init(void)
+{
+    int isa;
+
+    for(isa = PIXEL_ISAS - 1; isa > PIXEL_ISA_SCALAR; --isa)
+    {
+        if(pixel_convert_isa_supported(isa)) break;
+    }
+    selected_isa = isa;
+
+    syslog(LOG_WARNING, " pixel convert: %s kernels", isa_kernels[selected_isa].name);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  pixel_convert_select_isa
+//
+//  Parameters:     isa - PIXEL_ISA_xxx
+//
+//  Return:         SUCCESS, or ERROR if the CPU does not support the instruction set
+//
+//  Description:    Forces the kernels of an instruction set, for benchmarks and verification
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int pixel_convert_select_isa(const int isa)
+{
+    if(!pixel_convert_isa_supported(isa)) return ERROR;
+
+    selected_isa = isa;
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  pixel_convert_selected_isa
+//
+//  Parameters:     None
+//
+//  Return:         PIXEL_ISA_xxx used by pixel_convert()
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int pixel_convert_selected_isa(void)
+{
+    return selected_isa;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  pixel_convert_isa_supported
+//
+//  Parameters:     isa - PIXEL_ISA_xxx
+//
+//  Return:         TRUE if the kernels are built in and the CPU supports them, FALSE otherwise
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int pixel_convert_isa_supported(const int isa)
+{
+    if((isa < 0) || (isa >= PIXEL_ISAS) || !isa_kernels[isa].rows[0]) return FALSE;
+
+    switch(isa)
+    {
+#ifdef PIXEL_CONVERT_X86
+        case PIXEL_ISA_SSE2:
+            return __builtin_cpu_supports("sse2") ? TRUE : FALSE;
+
+        case PIXEL_ISA_AVX2:
+            return __builtin_cpu_supports("avx2") ? TRUE : FALSE;
+#endif //PIXEL_CONVERT_X86
+
+#ifdef PIXEL_CONVERT_NEON
+        case PIXEL_ISA_NEON:
+#if defined(__aarch64__)
+            //advanced SIMD is mandatory on ARMv8
+            return TRUE;
+#else
+            return (getauxval(AT_HWCAP) & HWCAP_NEON) ? TRUE : FALSE;
+#endif
+#endif //PIXEL_CONVERT_NEON
+
+        default:
+            return TRUE;
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  pixel_convert_isa_name
+//
+//  Parameters:     isa - PIXEL_ISA_xxx
+//
+//  Return:         Instruction set name
+//
+//------------------------------------------------------------------------------------------------------------------------------
+const char *pixel_convert_isa_name(const int isa)
+{
+    if((isa < 0) || (isa >= PIXEL_ISAS)) return "unknown";
+
+    return isa_kernels[isa].name;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  pixel_convert
+//
+//  Parameters:     conversion - PIXEL_CONVERT_xxx
+//                  src, src_step - YUV 4:2:2 frame, and its row size in bytes (bytesperline)
+//                  dst, dst_step - BGR24 or gray frame, and its row size in bytes
+//                  width, height - resolution, width is even
+//
+//  Return:         None
+//
+//  Description:    Converts the frame row by row with the selected kernels
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void pixel_convert(const int conversion, const unsigned char *src, const size_t src_step, unsigned char *dst,
+                   const size_t dst_step, const unsigned int width, const unsigned int height)
+{
+    unsigned int row;
+    const pixel_row_fn_t convert_row = isa_kernels[selected_isa].rows[conversion];
+
+    assert((conversion >= 0) && (conversion < PIXEL_CONVERSIONS));
+    assert(!(width & 1));
+
+    for(row = 0; row < height; ++row)
+    {
+        convert_row(src + (row * src_step), dst + (row * dst_step), width);
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  pixel_box_factor
+//
+//  Parameters:     width, height - source resolution
+//                  max_width, max_height - largest downscaled resolution
+//
+//  Return:         Smallest downscale factor which fits the frame in max_width x max_height, 1 to MAX_PIXEL_BOX_FACTOR
+//
+//------------------------------------------------------------------------------------------------------------------------------
+unsigned int pixel_box_factor(const unsigned int width, const unsigned int height, const unsigned int max_width,
+                              const unsigned int max_height)
+{
+    const unsigned int x_factor = (width + max_width - 1) / max_width;
+    const unsigned int y_factor = (height + max_height - 1) / max_height;
+    const unsigned int factor = (x_factor > y_factor) ? x_factor : y_factor;
+
+    return (factor < 1) ? 1 : ((factor > MAX_PIXEL_BOX_FACTOR) ? MAX_PIXEL_BOX_FACTOR : factor);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  pixel_box_downscale
+//
+//  Parameters:     src, src_step - frame, and its row size in bytes
+//                  width, height, channels - source resolution, and bytes per pixel
+//                  factor - 1 to MAX_PIXEL_BOX_FACTOR
+//                  dst, dst_step - (width / factor) x (height / factor) frame, and its row size in bytes
+//                  column_sums - width x channels scratch sums
+//
+//  Return:         None
+//
+//  Description:    Every destination pixel is the rounded mean of a factor x factor box, the last source columns and
+//                  rows which do not fill a box are left out. The factor rows of a box are added into the column sums
+//                  with the selected kernels, then every factor columns are added up and divided
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void pixel_box_downscale(const unsigned char *src, const size_t src_step, const unsigned int width, const unsigned int height,
+                         const unsigned int channels, const unsigned int factor, unsigned char *dst, const size_t dst_step,
+                         unsigned short *column_sums)
+{
+    unsigned int row, i, x, c, sum;
+    const unsigned int dst_width = width / factor;
+    const unsigned int dst_height = height / factor;
+    const unsigned int area = factor * factor;
+    const unsigned int row_size = dst_width * factor * channels;
+    const pixel_accumulate_fn_t accumulate_row = isa_kernels[selected_isa].accumulate;
+    const unsigned short *sums;
+    unsigned char *out;
+
+    assert((factor >= 1) && (factor <= MAX_PIXEL_BOX_FACTOR));
+
+    for(row = 0; row < dst_height; ++row, src += factor * src_step, dst += dst_step)
+    {
+        memset(column_sums, 0, row_size * sizeof(*column_sums));
+        for(i = 0; i < factor; ++i)
+        {
+            accumulate_row(src + (i * src_step), column_sums, row_size);
+        }
+
+        sums = column_sums;
+        out = dst;
+        for(x = 0; x < dst_width; ++x, sums += factor * channels, out += channels)
+        {
+            for(c = 0; c < channels; ++c)
+            {
+                sum = area / 2;
+                for(i = 0; i < factor; ++i)
+                {
+                    sum += sums[(i * channels) + c];
+                }
+                out[c] = sum / area;
+            }
+        }
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  yuv_to_bgr
+//
+//  Parameters:     y, u, v - one pixel
+//                  bgr - 3 bytes out
+//
+//  Return:         None
+//
+//  Description:    Reference arithmetic, the vector kernels do the same 16 bit saturating adds in the same order
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static inline int saturate_16(const int value)
+{
+    return (value > INT16_MAX) ? INT16_MAX : ((value < INT16_MIN) ? INT16_MIN : value);
+}
+
+static inline unsigned char saturate_8(const int value)
+{
+    return (value > UINT8_MAX) ? UINT8_MAX : ((value < 0) ? 0 : value);
+}
+
+static inline void yuv_to_bgr(const int y, const int u, const int v, unsigned char *bgr)
+{
+    const int c = (PIXEL_YUV_CY * (y - 16)) + (1 << (PIXEL_YUV_SHIFT - 1));
+    const int d = u - 128;
+    const int e = v - 128;
+
+    bgr[0] = saturate_8(saturate_16(c + (PIXEL_YUV_CUB * d)) >> PIXEL_YUV_SHIFT);
+    bgr[1] = saturate_8(saturate_16(c + ((PIXEL_YUV_CUG * d) + (PIXEL_YUV_CVG * e))) >> PIXEL_YUV_SHIFT);
+    bgr[2] = saturate_8(saturate_16(c + (PIXEL_YUV_CVR * e)) >> PIXEL_YUV_SHIFT);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  yuyv_to_bgr_row_scalar, uyvy_to_bgr_row_scalar, yuyv_to_gray_row_scalar
+//
+//  Parameters:     src - YUV 4:2:2 row
+//                  dst - BGR24 or gray row
+//                  width - pixels, even
+//
+//  Return:         None
+//
+//  Description:    Reference kernels, and the tail of the vector kernels
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void yuyv_to_bgr_row_scalar(const unsigned char *src, unsigned char *dst, const unsigned int width)
+{
+    unsigned int x;
+
+    //Y0 U Y1 V, two pixels
+    for(x = 0; x < width; x += 2, src += 4, dst += 6)
+    {
+        yuv_to_bgr(src[0], src[1], src[3], dst);
+        yuv_to_bgr(src[2], src[1], src[3], dst + 3);
+    }
+}
+
+static void uyvy_to_bgr_row_scalar(const unsigned char *src, unsigned char *dst, const unsigned int width)
+{
+    unsigned int x;
+
+    //U Y0 V Y1, two pixels
+    for(x = 0; x < width; x += 2, src += 4, dst += 6)
+    {
+        yuv_to_bgr(src[1], src[0], src[2], dst);
+        yuv_to_bgr(src[3], src[0], src[2], dst + 3);
+    }
+}
+
+static void yuyv_to_gray_row_scalar(const unsigned char *src, unsigned char *dst, const unsigned int width)
+{
+    unsigned int x;
+
+    for(x = 0; x < width; ++x)
+    {
+        dst[x] = src[2 * x];
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  accumulate_row_scalar
+//
+//  Parameters:     src - row
+//                  sums - column sums, one per byte
+//                  size - bytes
+//
+//  Return:         None
+//
+//  Description:    Reference kernel, and the tail of the vector kernels
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void accumulate_row_scalar(const unsigned char *src, unsigned short *sums, const unsigned int size)
+{
+    unsigned int x;
+
+    for(x = 0; x < size; ++x)
+    {
+        sums[x] += src[x];
+    }
+}
+
+#ifdef PIXEL_CONVERT_X86
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  yuv_to_bgr_sse2
+//
+//  Parameters:     y - 8 luma values, 16 bit
+//                  uv - U0 V0 U1 V1 U2 V2 U3 V3, 16 bit
+//                  b, g, r - 8 results, 16 bit, not yet saturated to 8 bit
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+__attribute__((target("sse2")))
+static inline void yuv_to_bgr_sse2(const __m128i y, const __m128i uv, __m128i *b, __m128i *g, __m128i *r)
+{
+    //both pixels of a pair use the pair's chroma
+    __m128i u = _mm_and_si128(uv, _mm_set1_epi32(0x0000FFFF));
+    __m128i v = _mm_srli_epi32(uv, 16);
+    const __m128i c = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(y, _mm_set1_epi16(16)), _mm_set1_epi16(PIXEL_YUV_CY)),
+                                    _mm_set1_epi16(1 << (PIXEL_YUV_SHIFT - 1)));
+
+    u = _mm_sub_epi16(_mm_or_si128(u, _mm_slli_epi32(u, 16)), _mm_set1_epi16(128));
+    v = _mm_sub_epi16(_mm_or_si128(v, _mm_slli_epi32(v, 16)), _mm_set1_epi16(128));
+
+    *b = _mm_srai_epi16(_mm_adds_epi16(c, _mm_mullo_epi16(u, _mm_set1_epi16(PIXEL_YUV_CUB))), PIXEL_YUV_SHIFT);
+    *g = _mm_srai_epi16(_mm_adds_epi16(c, _mm_add_epi16(_mm_mullo_epi16(u, _mm_set1_epi16(PIXEL_YUV_CUG)),
+                                                        _mm_mullo_epi16(v, _mm_set1_epi16(PIXEL_YUV_CVG)))), PIXEL_YUV_SHIFT);
+    *r = _mm_srai_epi16(_mm_adds_epi16(c, _mm_mullo_epi16(v, _mm_set1_epi16(PIXEL_YUV_CVR))), PIXEL_YUV_SHIFT);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  yuv422_to_bgr_row_sse2
+//
+//  Parameters:     src, dst, width - see yuyv_to_bgr_row_scalar
+//                  uyvy - TRUE for U Y0 V Y1 byte order, FALSE for Y0 U Y1 V
+//
+//  Return:         None
+//
+//  Description:    8 pixels per step. SSE2 has no byte shuffle, so the BGRX results are stored 3 bytes a pixel
+//
+//------------------------------------------------------------------------------------------------------------------------------
+__attribute__((target("sse2")))
+static inline void yuv422_to_bgr_row_sse2(const unsigned char *src, unsigned char *dst, const unsigned int width, const int uyvy)
+{
+    unsigned int x, i;
+    __m128i in, y, uv, b, g, r, bg, rx;
+    uint32_t bgrx[8];
+    const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+
+    for(x = 0; x + 8 <= width; x += 8, src += 16, dst += 24)
+    {
+        in = _mm_loadu_si128((const __m128i *)src);
+        y = uyvy ? _mm_srli_epi16(in, 8) : _mm_and_si128(in, low_bytes);
+        uv = uyvy ? _mm_and_si128(in, low_bytes) : _mm_srli_epi16(in, 8);
+
+        yuv_to_bgr_sse2(y, uv, &b, &g, &r);
+
+        b = _mm_packus_epi16(b, b);
+        g = _mm_packus_epi16(g, g);
+        r = _mm_packus_epi16(r, r);
+        bg = _mm_unpacklo_epi8(b, g);
+        rx = _mm_unpacklo_epi8(r, _mm_setzero_si128());
+        _mm_storeu_si128((__m128i *)&bgrx[0], _mm_unpacklo_epi16(bg, rx));
+        _mm_storeu_si128((__m128i *)&bgrx[4], _mm_unpackhi_epi16(bg, rx));
+
+        for(i = 0; i < 8; ++i)
+        {
+            memcpy(dst + (3 * i), &bgrx[i], 3);
+        }
+    }
+
+    if(x < width)
+    {
+        if(uyvy) uyvy_to_bgr_row_scalar(src, dst, width - x);
+        else yuyv_to_bgr_row_scalar(src, dst, width - x);
+    }
+}
+
+__attribute__((target("sse2")))
+static void yuyv_to_bgr_row_sse2(const unsigned char *src, unsigned char *dst, const unsigned int width)
+{
+    yuv422_to_bgr_row_sse2(src, dst, width, FALSE);
+}
+
+__attribute__((target("sse2")))
+static void uyvy_to_bgr_row_sse2(const unsigned char *src, unsigned char *dst, const unsigned int width)
+{
+    yuv422_to_bgr_row_sse2(src, dst, width, TRUE);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  yuyv_to_gray_row_sse2
+//
+//  Parameters:     src, dst, width - see yuyv_to_gray_row_scalar
+//
+//  Return:         None
+//
+//  Description:    16 pixels per step
+//
+//------------------------------------------------------------------------------------------------------------------------------
+__attribute__((target("sse2")))
+static void yuyv_to_gray_row_sse2(const unsigned char *src, unsigned char *dst, const unsigned int width)
+{
+    unsigned int x;
+    __m128i y0, y1;
+    const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+
+    for(x = 0; x + 16 <= width; x += 16, src += 32, dst += 16)
+    {
+        y0 = _mm_and_si128(_mm_loadu_si128((const __m128i *)src), low_bytes);
+        y1 = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + 16)), low_bytes);
+        _mm_storeu_si128((__m128i *)dst, _mm_packus_epi16(y0, y1));
+    }
+
+    if(x < width) yuyv_to_gray_row_scalar(src, dst, width - x);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  accumulate_row_sse2
+//
+//  Parameters:     src, sums, size - see accumulate_row_scalar
+//
+//  Return:         None
+//
+//  Description:    16 bytes per step, widened to 16 bits
+//
+//------------------------------------------------------------------------------------------------------------------------------
+__attribute__((target("sse2")))
+static void accumulate_row_sse2(const unsigned char *src, unsigned short *sums, const unsigned int size)
+{
+    unsigned int x;
+    __m128i in;
+    const __m128i zero = _mm_setzero_si128();
+
+    for(x = 0; x + 16 <= size; x += 16)
+    {
+        in = _mm_loadu_si128((const __m128i *)(src + x));
+        _mm_storeu_si128((__m128i *)(sums + x), _mm_add_epi16(_mm_loadu_si128((const __m128i *)(sums + x)), _mm_unpacklo_epi8(in, zero)));
+        _mm_storeu_si128((__m128i *)(sums + x + 8), _mm_add_epi16(_mm_loadu_si128((const __m128i *)(sums + x + 8)), _mm_unpackhi_epi8(in, zero)));
+    }
+
+    if(x < size) accumulate_row_scalar(src + x, sums + x, size - x);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  yuv_to_bgr_avx2
+//
+//  Parameters:     see yuv_to_bgr_sse2, 16 pixels (8 per 128 bit lane)
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+__attribute__((target("avx2")))
+static inline void yuv_to_bgr_avx2(const __m256i y, const __m256i uv, __m256i *b, __m256i *g, __m256i *r)
+{
+    __m256i u = _mm256_and_si256(uv, _mm256_set1_epi32(0x0000FFFF));
+    __m256i v = _mm256_srli_epi32(uv, 16);
+    const __m256i c = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(y, _mm256_set1_epi16(16)), _mm256_set1_epi16(PIXEL_YUV_CY)),
+                                       _mm256_set1_epi16(1 << (PIXEL_YUV_SHIFT - 1)));
+
+    u = _mm256_sub_epi16(_mm256_or_si256(u, _mm256_slli_epi32(u, 16)), _mm256_set1_epi16(128));
+    v = _mm256_sub_epi16(_mm256_or_si256(v, _mm256_slli_epi32(v, 16)), _mm256_set1_epi16(128));
+
+    *b = _mm256_srai_epi16(_mm256_adds_epi16(c, _mm256_mullo_epi16(u, _mm256_set1_epi16(PIXEL_YUV_CUB))), PIXEL_YUV_SHIFT);
+    *g = _mm256_srai_epi16(_mm256_adds_epi16(c, _mm256_add_epi16(_mm256_mullo_epi16(u, _mm256_set1_epi16(PIXEL_YUV_CUG)),
+                                                                 _mm256_mullo_epi16(v, _mm256_set1_epi16(PIXEL_YUV_CVG)))), PIXEL_YUV_SHIFT);
+    *r = _mm256_srai_epi16(_mm256_adds_epi16(c, _mm256_mullo_epi16(v, _mm256_set1_epi16(PIXEL_YUV_CVR))), PIXEL_YUV_SHIFT);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  store_bgr12
+//
+//  Parameters:     dst - 12 bytes out
+//                  bgr - 4 packed BGR pixels in the low 12 bytes
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+__attribute__((target("avx2")))
+static inline void store_bgr12(unsigned char *dst, const __m128i bgr)
+{
+    uint32_t last;
+
+    _mm_storel_epi64((__m128i *)dst, bgr);
+    last = _mm_cvtsi128_si32(_mm_srli_si128(bgr, 8));
+    memcpy(dst + 8, &last, 4);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  yuv422_to_bgr_row_avx2
+//
+//  Parameters:     see yuv422_to_bgr_row_sse2
+//
+//  Return:         None
+//
+//  Description:    16 pixels per step, pixels 0-7 in the low lane and 8-15 in the high lane. BGRX is packed to BGR
+//                  with a byte shuffle per lane
+//
+//------------------------------------------------------------------------------------------------------------------------------
+__attribute__((target("avx2")))
+static inline void yuv422_to_bgr_row_avx2(const unsigned char *src, unsigned char *dst, const unsigned int width, const int uyvy)
+{
+    unsigned int x;
+    __m256i in, y, uv, b, g, r, bg, rx, lo, hi;
+    const __m256i low_bytes = _mm256_set1_epi16(0x00FF);
+    const __m256i drop_x = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    for(x = 0; x + 16 <= width; x += 16, src += 32, dst += 48)
+    {
+        in = _mm256_loadu_si256((const __m256i *)src);
+        y = uyvy ? _mm256_srli_epi16(in, 8) : _mm256_and_si256(in, low_bytes);
+        uv = uyvy ? _mm256_and_si256(in, low_bytes) : _mm256_srli_epi16(in, 8);
+
+        yuv_to_bgr_avx2(y, uv, &b, &g, &r);
+
+        b = _mm256_packus_epi16(b, b);
+        g = _mm256_packus_epi16(g, g);
+        r = _mm256_packus_epi16(r, r);
+        bg = _mm256_unpacklo_epi8(b, g);
+        rx = _mm256_unpacklo_epi8(r, _mm256_setzero_si256());
+        //pixels 0-3 | 8-11, and 4-7 | 12-15
+        lo = _mm256_shuffle_epi8(_mm256_unpacklo_epi16(bg, rx), drop_x);
+        hi = _mm256_shuffle_epi8(_mm256_unpackhi_epi16(bg, rx), drop_x);
+
+        store_bgr12(dst, _mm256_castsi256_si128(lo));
+        store_bgr12(dst + 12, _mm256_castsi256_si128(hi));
+        store_bgr12(dst + 24, _mm256_extracti128_si256(lo, 1));
+        store_bgr12(dst + 36, _mm256_extracti128_si256(hi, 1));
+    }
+
+    if(x < width)
+    {
+        if(uyvy) uyvy_to_bgr_row_scalar(src, dst, width - x);
+        else yuyv_to_bgr_row_scalar(src, dst, width - x);
+    }
+}
+
+__attribute__((target("avx2")))
+static void yuyv_to_bgr_row_avx2(const unsigned char *src, unsigned char *dst, const unsigned int width)
+{
+    yuv422_to_bgr_row_avx2(src, dst, width, FALSE);
+}
+
+__attribute__((target("avx2")))
+static void uyvy_to_bgr_row_avx2(const unsigned char *src, unsigned char *dst, const unsigned int width)
+{
+    yuv422_to_bgr_row_avx2(src, dst, width, TRUE);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  yuyv_to_gray_row_avx2
+//
+//  Parameters:     src, dst, width - see yuyv_to_gray_row_scalar
+//
+//  Return:         None
+//
+//  Description:    32 pixels per step, the lane interleaving of the pack is undone with a 64 bit permute
+//
+//------------------------------------------------------------------------------------------------------------------------------
+__attribute__((target("avx2")))
+static void yuyv_to_gray_row_avx2(const unsigned char *src, unsigned char *dst, const unsigned int width)
+{
+    unsigned int x;
+    __m256i y0, y1;
+    const __m256i low_bytes = _mm256_set1_epi16(0x00FF);
+
+    for(x = 0; x + 32 <= width; x += 32, src += 64, dst += 32)
+    {
+        y0 = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)src), low_bytes);
+        y1 = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(src + 32)), low_bytes);
+        _mm256_storeu_si256((__m256i *)dst, _mm256_permute4x64_epi64(_mm256_packus_epi16(y0, y1), 0xD8));
+    }
+
+    if(x < width) yuyv_to_gray_row_scalar(src, dst, width - x);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  accumulate_row_avx2
+//
+//  Parameters:     src, sums, size - see accumulate_row_scalar
+//
+//  Return:         None
+//
+//  Description:    32 bytes per step, widened to 16 bits
+//
+//------------------------------------------------------------------------------------------------------------------------------
+__attribute__((target("avx2")))
+static void accumulate_row_avx2(const unsigned char *src, unsigned short *sums, const unsigned int size)
+{
+    unsigned int x;
+
+    for(x = 0; x + 32 <= size; x += 32)
+    {
+        _mm256_storeu_si256((__m256i *)(sums + x), _mm256_add_epi16(_mm256_loadu_si256((const __m256i *)(sums + x)),
+                                                                    _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src + x)))));
+        _mm256_storeu_si256((__m256i *)(sums + x + 16), _mm256_add_epi16(_mm256_loadu_si256((const __m256i *)(sums + x + 16)),
+                                                                         _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src + x + 16)))));
+    }
+
+    if(x < size) accumulate_row_scalar(src + x, sums + x, size - x);
+}
+
+#endif //PIXEL_CONVERT_X86
+
+#ifdef PIXEL_CONVERT_NEON
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  yuv_to_bgr_neon
+//
+//  Parameters:     y - 8 luma values (every other pixel)
+//                  u, v - their chroma, 16 bit, minus 128
+//
+//  Return:         B, G, R of the 8 pixels
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static inline uint8x8x3_t yuv_to_bgr_neon(const uint8x8_t y, const int16x8_t u, const int16x8_t v)
+{
+    uint8x8x3_t bgr;
+    const int16x8_t c = vaddq_s16(vmulq_n_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(y)), vdupq_n_s16(16)), PIXEL_YUV_CY),
+                                  vdupq_n_s16(1 << (PIXEL_YUV_SHIFT - 1)));
+
+    bgr.val[0] = vqmovun_s16(vshrq_n_s16(vqaddq_s16(c, vmulq_n_s16(u, PIXEL_YUV_CUB)), PIXEL_YUV_SHIFT));
+    bgr.val[1] = vqmovun_s16(vshrq_n_s16(vqaddq_s16(c, vaddq_s16(vmulq_n_s16(u, PIXEL_YUV_CUG),
+                                                                 vmulq_n_s16(v, PIXEL_YUV_CVG))), PIXEL_YUV_SHIFT));
+    bgr.val[2] = vqmovun_s16(vshrq_n_s16(vqaddq_s16(c, vmulq_n_s16(v, PIXEL_YUV_CVR)), PIXEL_YUV_SHIFT));
+
+    return bgr;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  yuv422_to_bgr_row_neon
+//
+//  Parameters:     see yuv422_to_bgr_row_sse2
+//
+//  Return:         None
+//
+//  Description:    16 pixels per step, the de-interleaving load splits even and odd pixels, zipped back on the store
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static inline void yuv422_to_bgr_row_neon(const unsigned char *src, unsigned char *dst, const unsigned int width, const int uyvy)
+{
+    unsigned int x, i;
+    uint8x8x4_t in;
+    uint8x8x3_t even, odd, out;
+    uint8x8x2_t zipped[3];
+    int16x8_t u, v;
+
+    for(x = 0; x + 16 <= width; x += 16, src += 32, dst += 48)
+    {
+        in = vld4_u8(src);
+        //Y0 U Y1 V, or U Y0 V Y1
+        u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(in.val[uyvy ? 0 : 1])), vdupq_n_s16(128));
+        v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(in.val[uyvy ? 2 : 3])), vdupq_n_s16(128));
+
+        even = yuv_to_bgr_neon(in.val[uyvy ? 1 : 0], u, v);
+        odd = yuv_to_bgr_neon(in.val[uyvy ? 3 : 2], u, v);
+
+        for(i = 0; i < 3; ++i)
+        {
+            zipped[i] = vzip_u8(even.val[i], odd.val[i]);
+        }
+
+        out.val[0] = zipped[0].val[0];
+        out.val[1] = zipped[1].val[0];
+        out.val[2] = zipped[2].val[0];
+        vst3_u8(dst, out);
+        out.val[0] = zipped[0].val[1];
+        out.val[1] = zipped[1].val[1];
+        out.val[2] = zipped[2].val[1];
+        vst3_u8(dst + 24, out);
+    }
+
+    if(x < width)
+    {
+        if(uyvy) uyvy_to_bgr_row_scalar(src, dst, width - x);
+        else yuyv_to_bgr_row_scalar(src, dst, width - x);
+    }
+}
+
+static void yuyv_to_bgr_row_neon(const unsigned char *src, unsigned char *dst, const unsigned int width)
+{
+    yuv422_to_bgr_row_neon(src, dst, width, FALSE);
+}
+
+static void uyvy_to_bgr_row_neon(const unsigned char *src, unsigned char *dst, const unsigned int width)
+{
+    yuv422_to_bgr_row_neon(src, dst, width, TRUE);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  yuyv_to_gray_row_neon
+//
+//  Parameters:     src, dst, width - see yuyv_to_gray_row_scalar
+//
+//  Return:         None
+//
+//  Description:    16 pixels per step
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void yuyv_to_gray_row_neon(const unsigned char *src, unsigned char *dst, const unsigned int width)
+{
+    unsigned int x;
+
+    for(x = 0; x + 16 <= width; x += 16, src += 32, dst += 16)
+    {
+        vst1q_u8(dst, vld2q_u8(src).val[0]);
+    }
+
+    if(x < width) yuyv_to_gray_row_scalar(src, dst, width - x);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  accumulate_row_neon
+//
+//  Parameters:     src, sums, size - see accumulate_row_scalar
+//
+//  Return:         None
+//
+//  Description:    16 bytes per step, widening adds
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void accumulate_row_neon(const unsigned char *src, unsigned short *sums, const unsigned int size)
+{
+    unsigned int x;
+    uint8x16_t in;
+
+    for(x = 0; x + 16 <= size; x += 16)
+    {
+        in = vld1q_u8(src + x);
+        vst1q_u16(sums + x, vaddw_u8(vld1q_u16(sums + x), vget_low_u8(in)));
+        vst1q_u16(sums + x + 8, vaddw_u8(vld1q_u16(sums + x + 8), vget_high_u8(in)));
+    }
+
+    if(x < size) accumulate_row_scalar(src + x, sums + x, size - x);
+}
+
+#endif //PIXEL_CONVERT_NEON
+
+//==============================================================================
+//    End of file!
+//==============================================================================
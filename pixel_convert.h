@@ -0,0 +1,59 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: pixel_convert.h
+//
+//  Description: Header file for pixel_convert.c
+//
+
+#ifndef _PIXEL_CONVERT_H
+#define _PIXEL_CONVERT_H
+
+#include "include.h"
+#include <stddef.h>
+
+//conversions, source rows are YUV 4:2:2 (2 bytes per pixel, even width)
+#define PIXEL_CONVERT_YUYV_TO_BGR   (0) //V4L2_PIX_FMT_YUYV to BGR24
+#define PIXEL_CONVERT_UYVY_TO_BGR   (1) //V4L2_PIX_FMT_UYVY to BGR24
+#define PIXEL_CONVERT_YUYV_TO_GRAY  (2) //V4L2_PIX_FMT_YUYV to 8 bit gray (luma)
+#define PIXEL_CONVERSIONS           (3)
+
+//kernel instruction sets, selected at run time by pixel_convert_init()
+#define PIXEL_ISA_SCALAR            (0) //reference, every host
+#define PIXEL_ISA_SSE2              (1) //x86
+#define PIXEL_ISA_AVX2              (2) //x86
+#define PIXEL_ISA_NEON              (3) //ARM (Jetson)
+#define PIXEL_ISAS                  (4)
+
+//BT.601 limited range YUV to RGB, 6 bit fixed point, 16 bit saturating arithmetic in every kernel:
+//c = 74*(Y-16) + 32, R = (c + 102*(V-128)) >> 6, G = (c - 25*(U-128) - 52*(V-128)) >> 6, B = (c + 129*(U-128)) >> 6
+#define PIXEL_YUV_SHIFT             (6)
+#define PIXEL_YUV_CY                (74)
+#define PIXEL_YUV_CVR               (102)
+#define PIXEL_YUV_CUG               (-25)
+#define PIXEL_YUV_CVG               (-52)
+#define PIXEL_YUV_CUB               (129)
+
+//box downscale by an integer factor, every source pixel of a factor x factor box has the same weight
+//column sums of factor rows are 16 bit, and the box sums (factor^2 x 255) must fit in 16 bits too
+#define MAX_PIXEL_BOX_FACTOR        (15)
+
+//APIs
+void pixel_convert_init(void);
+int pixel_convert_select_isa(const int isa);
+int pixel_convert_selected_isa(void);
+int pixel_convert_isa_supported(const int isa);
+const char *pixel_convert_isa_name(const int isa);
+void pixel_convert(const int conversion, const unsigned char *src, const size_t src_step, unsigned char *dst,
+                   const size_t dst_step, const unsigned int width, const unsigned int height);
+unsigned int pixel_box_factor(const unsigned int width, const unsigned int height, const unsigned int max_width,
+                              const unsigned int max_height);
+void pixel_box_downscale(const unsigned char *src, const size_t src_step, const unsigned int width, const unsigned int height,
+                         const unsigned int channels, const unsigned int factor, unsigned char *dst, const size_t dst_step,
+                         unsigned short *column_sums);
+
+#endif //_PIXEL_CONVERT_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,548 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: placement.c
+//
+//  Description: Reads the CPU topology from sysfs (online CPUs, big.LITTLE capacities, isolcpus= and nohz_full=
+//               masks), and places the sequencer, the query and store services of every camera and the encode
+//               workers on cores. Cores and priorities come from the command line (-C, -R, -E), then the placement
+//               file (-L), and the rest from the automatic policy (see placement_auto())
+//
+
+#include "include.h"
+#include "placement.h"
+#include "sequencer.h"
+
+#define SYSFS_CPU_DIR       "/sys/devices/system/cpu/"
+
+//local functions
+static int read_cpu_list(const char *path, int *cpus);
+static int read_sysfs_value(const char *path, unsigned int *value);
+static int parse_core_list(const cpu_topology_t *topology, char *list, int *cores, const unsigned int max_cores);
+static void set_service(placement_t *placement, const unsigned int service, const int core, const int priority);
+static unsigned int sort_by_capacity(const cpu_topology_t *topology, int *cores, const unsigned int no_of_cores);
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  cpu_topology_read
+//
+//  Parameters:     topology - filled from sysfs
+//
+//  Return:         None
+//
+//  Description:    Online CPUs, capacity (cpu_capacity, else scaled from cpuinfo_max_freq, else CPU_CAPACITY_SCALE),
+//                  cluster, and the isolated and nohz_full masks. Falls back to sysconf() CPU counts without sysfs
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void cpu_topology_read(cpu_topology_t *topology)
+{
+    int cpus[MAX_TOPOLOGY_CPUS];
+    char path[128];
+    unsigned int i, value, max_freq_khz = 0;
+    int have_capacity = FALSE;
+    cpu_info_t *cpu;
+
+    memset(topology, 0, sizeof(*topology));
+
+    //online CPUs
+    if(read_cpu_list(SYSFS_CPU_DIR "online", cpus))
+    {
+        memset(cpus, 0, sizeof(cpus));
+        for(i = 0; (i < (unsigned int)sysconf(_SC_NPROCESSORS_ONLN)) && (i < MAX_TOPOLOGY_CPUS); ++i) cpus[i] = TRUE;
+    }
+
+    for(i = 0; i < MAX_TOPOLOGY_CPUS; ++i)
+    {
+        if(!cpus[i]) continue;
+
+        cpu = &topology->cpus[i];
+        cpu->online = TRUE;
+        topology->no_of_cpus = i + 1;
+        ++topology->no_of_online;
+
+        //big.LITTLE, the biggest core is CPU_CAPACITY_SCALE
+        snprintf(path, sizeof(path), SYSFS_CPU_DIR "cpu%u/cpu_capacity", i);
+        if(!read_sysfs_value(path, &value))
+        {
+            cpu->capacity = value;
+            have_capacity = TRUE;
+        }
+
+        snprintf(path, sizeof(path), SYSFS_CPU_DIR "cpu%u/cpufreq/cpuinfo_max_freq", i);
+        if(!read_sysfs_value(path, &value))
+        {
+            cpu->max_freq_khz = value;
+            if(value > max_freq_khz) max_freq_khz = value;
+        }
+
+        snprintf(path, sizeof(path), SYSFS_CPU_DIR "cpu%u/topology/cluster_id", i);
+        if(read_sysfs_value(path, &value))
+        {
+            snprintf(path, sizeof(path), SYSFS_CPU_DIR "cpu%u/topology/physical_package_id", i);
+            if(read_sysfs_value(path, &value)) value = 0;
+        }
+        cpu->cluster = (int)value;
+    }
+
+    //no capacities from the kernel (x86, older ARM kernels), scaled from the max frequencies if they differ
+    for(i = 0; (i < topology->no_of_cpus) && !have_capacity; ++i)
+    {
+        cpu = &topology->cpus[i];
+        if(!cpu->online) continue;
+        cpu->capacity = (max_freq_khz && cpu->max_freq_khz) ?
+                        (unsigned int)(((unsigned long long)cpu->max_freq_khz * CPU_CAPACITY_SCALE) / max_freq_khz) : CPU_CAPACITY_SCALE;
+    }
+
+    //empty or missing masks, no core is isolated
+    if(!read_cpu_list(SYSFS_CPU_DIR "isolated", cpus))
+    {
+        for(i = 0; i < topology->no_of_cpus; ++i)
+        {
+            if(!cpus[i] || !topology->cpus[i].online) continue;
+            topology->cpus[i].isolated = TRUE;
+            ++topology->no_of_isolated;
+        }
+    }
+
+    if(!read_cpu_list(SYSFS_CPU_DIR "nohz_full", cpus))
+    {
+        for(i = 0; i < topology->no_of_cpus; ++i) topology->cpus[i].nohz_full = cpus[i] && topology->cpus[i].online;
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  cpu_topology_core_online
+//
+//  Parameters:     topology - read with cpu_topology_read()
+//                  core - CPU number
+//
+//  Return:         TRUE if the core is online, else FALSE
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int cpu_topology_core_online(const cpu_topology_t *topology, const int core)
+{
+    return (core >= 0) && (core < (int)topology->no_of_cpus) && topology->cpus[core].online;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  placement_init
+//
+//  Parameters:     placement - every core and priority set to PLACEMENT_AUTO
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void placement_init(placement_t *placement)
+{
+    unsigned int i;
+
+    memset(placement, 0, sizeof(*placement));
+    placement->sequencer_core = PLACEMENT_AUTO;
+    for(i = 0; i < (MAX_CAMERAS * SERVICES_PER_CAMERA); ++i)
+    {
+        placement->service_cores[i] = PLACEMENT_AUTO;
+        placement->service_priorities[i] = PLACEMENT_AUTO;
+    }
+    placement->encode_cores_set = FALSE;
+    placement->source = "auto";
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  placement_load
+//
+//  Parameters:     placement - cores and priorities still PLACEMENT_AUTO are set from the file
+//                  topology - read with cpu_topology_read(), cores must be online
+//                  file_name - placement file, see MAX_PLACEMENT_LINE_SIZE in placement.h for the format
+//                  no_of_cameras - query_<n>/store_<n> lines of other cameras are ignored
+//
+//  Return:         SUCCESS, or ERROR if the file cannot be read
+//
+//  Description:    Bad lines, offline cores and priorities above SERVICE_THREADS_PRIORITY are reported and ignored,
+//                  so the command line (already set) and the automatic policy (for the rest) still apply
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int placement_load(placement_t *placement, const cpu_topology_t *topology, const char *file_name, const unsigned int no_of_cameras)
+{
+    FILE *fp;
+    char line[MAX_PLACEMENT_LINE_SIZE], role[32], cores[MAX_PLACEMENT_LINE_SIZE];
+    char *comment;
+    unsigned int line_no = 0, camera, service_idx;
+    int core, priority, fields, no_of_cores;
+    int encode_cores[MAX_ENCODE_WORKERS];
+
+    fp = fopen(file_name, "r");
+    if(!fp)
+    {
+        fprintf(stderr, "\nCannot open %s: %s\n", file_name, strerror(errno));
+        return ERROR;
+    }
+
+    while(fgets(line, sizeof(line), fp))
+    {
+        ++line_no;
+        comment = strchr(line, '#');
+        if(comment) *comment = '\0';
+
+        priority = PLACEMENT_AUTO;
+        fields = sscanf(line, "%31s %255s %d", role, cores, &priority);
+        if(fields <= 0) continue;
+        if(fields < 2)
+        {
+            fprintf(stdout, "%s:%u: ignoring '%s', no core!\n", file_name, line_no, role);
+            continue;
+        }
+
+        if(!strcmp(role, "encode"))
+        {
+            no_of_cores = parse_core_list(topology, cores, encode_cores, MAX_ENCODE_WORKERS);
+            if(!no_of_cores || placement->encode_cores_set) continue;
+            memcpy(placement->encode_cores, encode_cores, no_of_cores * sizeof(encode_cores[0]));
+            placement->no_of_encode_cores = no_of_cores;
+            placement->encode_cores_set = TRUE;
+            continue;
+        }
+
+        core = atoi(cores);
+        if(!cpu_topology_core_online(topology, core))
+        {
+            fprintf(stdout, "%s:%u: ignoring %s core %d (not available)!\n", file_name, line_no, role, core);
+            continue;
+        }
+
+        if((priority != PLACEMENT_AUTO) && (priority != SEQUENCER_RM_PRIORITY) && (priority < SERVICE_THREADS_PRIORITY))
+        {
+            fprintf(stdout, "%s:%u: ignoring %s priority %d (Max allowed %d)!\n", file_name, line_no, role, priority, SERVICE_THREADS_PRIORITY);
+            priority = PLACEMENT_AUTO;
+        }
+
+        if(!strcmp(role, "sequencer"))
+        {
+            if(placement->sequencer_core == PLACEMENT_AUTO) placement->sequencer_core = core;
+        }
+        else if(!strcmp(role, "query") || !strcmp(role, "store"))
+        {
+            for(camera = 0; camera < no_of_cameras; ++camera)
+            {
+                service_idx = (role[0] == 'q') ? QUERY_FRAMES_SERVICE_IDX(camera) : STORE_FRAMES_SERVICE_IDX(camera);
+                set_service(placement, service_idx, core, priority);
+            }
+        }
+        else if((sscanf(role, "query_%u", &camera) == 1) || (sscanf(role, "store_%u", &camera) == 1))
+        {
+            if(camera >= no_of_cameras) continue;
+            service_idx = (role[0] == 'q') ? QUERY_FRAMES_SERVICE_IDX(camera) : STORE_FRAMES_SERVICE_IDX(camera);
+            set_service(placement, service_idx, core, priority);
+        }
+        else
+        {
+            fprintf(stdout, "%s:%u: ignoring unknown role '%s'!\n", file_name, line_no, role);
+        }
+    }
+
+    fclose(fp);
+    placement->source = file_name;
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  placement_auto
+//
+//  Parameters:     placement - cores and priorities still PLACEMENT_AUTO are set
+//                  topology - read with cpu_topology_read()
+//                  no_of_cameras - cameras with a query and a store service
+//
+//  Return:         None
+//
+//  Description:    CPU 0 is left for the housekeeping (interrupts, kernel threads) if there is another core.
+//                  RT cores, for the sequencer and the query and store services:
+//                    - the isolated cores (isolcpus=), if any,
+//                    - else the lower capacity cores with big.LITTLE, the biggest ones are left for encoding,
+//                    - else one core per camera (nohz_full cores first), up to half of the cores.
+//                  Encode workers get the other cores, biggest first, and stay unpinned if there is none.
+//                  A camera has its own core if there are enough, both services of a camera share one otherwise,
+//                  and one core per service if there are two per camera. Priorities are rate-monotonic
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void placement_auto(placement_t *placement, const cpu_topology_t *topology, const unsigned int no_of_cameras)
+{
+    int pool[MAX_TOPOLOGY_CPUS], rt_cores[MAX_TOPOLOGY_CPUS], encode_cores[MAX_TOPOLOGY_CPUS];
+    unsigned int no_of_pool = 0, no_of_rt = 0, no_of_encode = 0;
+    unsigned int i, camera, service, min_capacity = ~0U, max_capacity = 0;
+    const cpu_info_t *cpu;
+
+    //every online core but the housekeeping one
+    for(i = 0; i < topology->no_of_cpus; ++i)
+    {
+        cpu = &topology->cpus[i];
+        if(!cpu->online || (!i && (topology->no_of_online > 1))) continue;
+
+        pool[no_of_pool++] = i;
+        if(cpu->capacity < min_capacity) min_capacity = cpu->capacity;
+        if(cpu->capacity > max_capacity) max_capacity = cpu->capacity;
+    }
+    if(!no_of_pool) pool[no_of_pool++] = 0;
+
+    if(topology->no_of_isolated)
+    {
+        for(i = 0; i < topology->no_of_cpus; ++i)
+        {
+            if(topology->cpus[i].isolated) rt_cores[no_of_rt++] = i;
+        }
+        for(i = 0; i < no_of_pool; ++i)
+        {
+            if(!topology->cpus[pool[i]].isolated) encode_cores[no_of_encode++] = pool[i];
+        }
+    }
+    else if(min_capacity < max_capacity)
+    {
+        for(i = 0; i < no_of_pool; ++i)
+        {
+            if(topology->cpus[pool[i]].capacity == max_capacity) encode_cores[no_of_encode++] = pool[i];
+            else rt_cores[no_of_rt++] = pool[i];
+        }
+    }
+    else
+    {
+        //nohz_full cores first
+        for(i = 0; i < no_of_pool; ++i)
+        {
+            if(topology->cpus[pool[i]].nohz_full) rt_cores[no_of_rt++] = pool[i];
+        }
+        for(i = 0; i < no_of_pool; ++i)
+        {
+            if(!topology->cpus[pool[i]].nohz_full) rt_cores[no_of_rt++] = pool[i];
+        }
+
+        //the rest of the cores encode
+        if(no_of_rt > 1)
+        {
+            no_of_encode = no_of_rt - ((no_of_cameras < (no_of_rt / 2)) ? no_of_cameras : (no_of_rt / 2));
+            no_of_rt -= no_of_encode;
+            memcpy(encode_cores, &rt_cores[no_of_rt], no_of_encode * sizeof(encode_cores[0]));
+        }
+    }
+
+    no_of_encode = sort_by_capacity(topology, encode_cores, no_of_encode);
+
+    if(placement->sequencer_core == PLACEMENT_AUTO) placement->sequencer_core = rt_cores[0];
+
+    for(camera = 0; camera < no_of_cameras; ++camera)
+    {
+        for(service = QUERY_FRAMES_SERVICE_IDX(camera); service <= STORE_FRAMES_SERVICE_IDX(camera); ++service)
+        {
+            set_service(placement, service, rt_cores[(no_of_rt >= (no_of_cameras * SERVICES_PER_CAMERA)) ? service : (camera % no_of_rt)],
+                        SEQUENCER_RM_PRIORITY);
+        }
+    }
+
+    if(!placement->encode_cores_set)
+    {
+        placement->no_of_encode_cores = (no_of_encode < MAX_ENCODE_WORKERS) ? no_of_encode : MAX_ENCODE_WORKERS;
+        memcpy(placement->encode_cores, encode_cores, placement->no_of_encode_cores * sizeof(encode_cores[0]));
+        placement->encode_cores_set = TRUE;
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  placement_report
+//
+//  Parameters:     placement - placed, see placement_auto()
+//                  topology - read with cpu_topology_read()
+//                  no_of_cameras - cameras with a query and a store service
+//
+//  Return:         None
+//
+//  Description:    Prints the online CPUs and the core and priority of every thread, and logs the placement
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void placement_report(const placement_t *placement, const cpu_topology_t *topology, const unsigned int no_of_cameras)
+{
+    unsigned int i, camera, service;
+    const cpu_info_t *cpu;
+    char cores[MAX_PLACEMENT_LINE_SIZE] = "unpinned";
+    int length = 0;
+
+    fprintf(stdout, "\n--------------------------------------"
+                    "\nCPU topology (%u online, %u isolated):"
+                    "\ncpu  capacity  max MHz  cluster  isolated  nohz_full", topology->no_of_online, topology->no_of_isolated);
+    for(i = 0; i < topology->no_of_cpus; ++i)
+    {
+        cpu = &topology->cpus[i];
+        if(!cpu->online) continue;
+        fprintf(stdout, "\n%3u  %8u  %7u  %7d  %8s  %9s", i, cpu->capacity, cpu->max_freq_khz / 1000, cpu->cluster,
+                cpu->isolated ? "yes" : "no", cpu->nohz_full ? "yes" : "no");
+    }
+
+    for(i = 0; i < placement->no_of_encode_cores; ++i)
+    {
+        length += snprintf(cores + length, sizeof(cores) - length, i ? ",%d" : "%d", placement->encode_cores[i]);
+    }
+
+    fprintf(stdout, "\n--------------------------------------"
+                    "\nthread placement (%s):"
+                    "\nsequencer: core %d", placement->source, placement->sequencer_core);
+    for(camera = 0; camera < no_of_cameras; ++camera)
+    {
+        for(service = QUERY_FRAMES_SERVICE_IDX(camera); service <= STORE_FRAMES_SERVICE_IDX(camera); ++service)
+        {
+            fprintf(stdout, "\ncamera %u %s: core %d%s, ", camera, (service == QUERY_FRAMES_SERVICE_IDX(camera)) ? "query" : "store",
+                    placement->service_cores[service], topology->cpus[placement->service_cores[service]].isolated ? " (isolated)" : "");
+            if(placement->service_priorities[service] == SEQUENCER_RM_PRIORITY) fprintf(stdout, "rate-monotonic priority");
+            else fprintf(stdout, "priority %d", placement->service_priorities[service]);
+        }
+    }
+    fprintf(stdout, "\nencode workers: %s%s"
+                    "\n--------------------------------------\n", placement->no_of_encode_cores ? "cores " : "", cores);
+
+    syslog(LOG_WARNING, " placement (%s): %u online, %u isolated cores, sequencer core %d, camera 0 query core %d, store core %d, encode %s",
+           placement->source, topology->no_of_online, topology->no_of_isolated, placement->sequencer_core,
+           placement->service_cores[QUERY_FRAMES_SERVICE_IDX(0)], placement->service_cores[STORE_FRAMES_SERVICE_IDX(0)], cores);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  read_cpu_list
+//
+//  Parameters:     path - sysfs CPU list, "0-3,5"
+//                  cpus - MAX_TOPOLOGY_CPUS flags, TRUE for every listed CPU
+//
+//  Return:         SUCCESS, or ERROR if the file is missing or holds no CPU ("" or "(null)")
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int read_cpu_list(const char *path, int *cpus)
+{
+    FILE *fp;
+    char list[MAX_PLACEMENT_LINE_SIZE];
+    char *range;
+    unsigned int first, last, cpu;
+    int listed = FALSE;
+
+    memset(cpus, 0, MAX_TOPOLOGY_CPUS * sizeof(cpus[0]));
+
+    fp = fopen(path, "r");
+    if(!fp) return ERROR;
+    if(!fgets(list, sizeof(list), fp)) list[0] = '\0';
+    fclose(fp);
+
+    for(range = strtok(list, ",\n"); range; range = strtok(NULL, ",\n"))
+    {
+        if(sscanf(range, "%u-%u", &first, &last) != 2)
+        {
+            if(sscanf(range, "%u", &first) != 1) continue;
+            last = first;
+        }
+        for(cpu = first; (cpu <= last) && (cpu < MAX_TOPOLOGY_CPUS); ++cpu)
+        {
+            cpus[cpu] = TRUE;
+            listed = TRUE;
+        }
+    }
+
+    return listed ? SUCCESS : ERROR;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  read_sysfs_value
+//
+//  Parameters:     path - sysfs attribute
+//                  value - set to the number it holds
+//
+//  Return:         SUCCESS, or ERROR if the attribute is missing
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int read_sysfs_value(const char *path, unsigned int *value)
+{
+    FILE *fp;
+    int rc;
+
+    fp = fopen(path, "r");
+    if(!fp) return ERROR;
+    rc = (fscanf(fp, "%u", value) == 1) ? SUCCESS : ERROR;
+    fclose(fp);
+
+    return rc;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  parse_core_list
+//
+//  Parameters:     topology - read with cpu_topology_read()
+//                  list - comma separated core numbers, split in place
+//                  cores - set to the online ones
+//                  max_cores - size of cores
+//
+//  Return:         No.of cores set
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int parse_core_list(const cpu_topology_t *topology, char *list, int *cores, const unsigned int max_cores)
+{
+    char *core_str;
+    unsigned int no_of_cores = 0;
+
+    for(core_str = strtok(list, ","); core_str && (no_of_cores < max_cores); core_str = strtok(NULL, ","))
+    {
+        if(!cpu_topology_core_online(topology, atoi(core_str)))
+        {
+            fprintf(stdout, "Ignoring core %d (not available)!\n", atoi(core_str));
+            continue;
+        }
+        cores[no_of_cores++] = atoi(core_str);
+    }
+
+    return no_of_cores;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  set_service
+//
+//  Parameters:     placement - placement being built
+//                  service - QUERY/STORE_FRAMES_SERVICE_IDX(camera)
+//                  core, priority - set if still PLACEMENT_AUTO, PLACEMENT_AUTO leaves it as is
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void set_service(placement_t *placement, const unsigned int service, const int core, const int priority)
+{
+    if(placement->service_cores[service] == PLACEMENT_AUTO) placement->service_cores[service] = core;
+    if(placement->service_priorities[service] == PLACEMENT_AUTO) placement->service_priorities[service] = priority;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  sort_by_capacity
+//
+//  Parameters:     topology - read with cpu_topology_read()
+//                  cores - sorted in place, biggest capacity first, lower core number first among equals
+//                  no_of_cores - no.of cores
+//
+//  Return:         no_of_cores
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static unsigned int sort_by_capacity(const cpu_topology_t *topology, int *cores, const unsigned int no_of_cores)
+{
+    unsigned int i, j;
+    int core;
+
+    //a handful of cores, insertion sort
+    for(i = 1; i < no_of_cores; ++i)
+    {
+        core = cores[i];
+        for(j = i; (j > 0) && (topology->cpus[cores[j - 1]].capacity < topology->cpus[core].capacity); --j) cores[j] = cores[j - 1];
+        cores[j] = core;
+    }
+
+    return no_of_cores;
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
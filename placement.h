@@ -0,0 +1,74 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: placement.h
+//
+//  Description: Header file for placement.c, CPU topology (sysfs) and the cores and priorities of the threads
+//
+
+#ifndef _PLACEMENT_H
+#define _PLACEMENT_H
+
+#include "include.h"
+#include "encode_pool.h"
+
+//CPUs read from sysfs, CPU numbers from 0 to MAX_TOPOLOGY_CPUS - 1
+#define MAX_TOPOLOGY_CPUS           (64)
+
+//sysfs cpu_capacity of the biggest core, the scale used if the kernel does not report capacities
+#define CPU_CAPACITY_SCALE          (1024)
+
+//core or priority not set (-C/-R/-E or the placement file), chosen by placement_auto()
+#define PLACEMENT_AUTO              (-2)
+
+//placement file (-L), one thread role per line, '#' starts a comment
+//  sequencer <core>                        sequencer (timer) and dispatcher threads
+//  query <core> [<priority>]               query_frames_thread of every camera, query_<n> for camera n only
+//  store <core> [<priority>]               store_frames_thread of every camera, store_<n> for camera n only
+//  encode <core>[,<core>..]                .png encode workers
+#define MAX_PLACEMENT_LINE_SIZE     (256)
+
+//one CPU
+typedef struct
+{
+    int online;
+    unsigned int capacity;          //relative to CPU_CAPACITY_SCALE (big.LITTLE), from cpu_capacity or the max frequency
+    unsigned int max_freq_khz;      //0 if cpufreq is not available
+    int cluster;                    //cluster_id, else physical_package_id
+    int isolated;                   //isolcpus=, no load balancing onto it
+    int nohz_full;                  //nohz_full=, no scheduler tick while one task runs
+}cpu_info_t;
+
+typedef struct
+{
+    unsigned int no_of_cpus;        //highest CPU number + 1
+    unsigned int no_of_online;
+    unsigned int no_of_isolated;    //online ones
+    cpu_info_t cpus[MAX_TOPOLOGY_CPUS];
+}cpu_topology_t;
+
+//cores and relative priorities (see include.h) of the threads, PLACEMENT_AUTO until placed
+typedef struct
+{
+    int sequencer_core;
+    int service_cores[MAX_CAMERAS * SERVICES_PER_CAMERA];           //QUERY/STORE_FRAMES_SERVICE_IDX(camera)
+    int service_priorities[MAX_CAMERAS * SERVICES_PER_CAMERA];      //SEQUENCER_RM_PRIORITY for a rate-monotonic one
+    int encode_cores[MAX_ENCODE_WORKERS];
+    unsigned int no_of_encode_cores;                                //0 leaves the workers unpinned
+    int encode_cores_set;
+    const char *source;                                             //file name, else "auto", for the report
+}placement_t;
+
+//APIs
+void cpu_topology_read(cpu_topology_t *topology);
+int cpu_topology_core_online(const cpu_topology_t *topology, const int core);
+void placement_init(placement_t *placement);
+int placement_load(placement_t *placement, const cpu_topology_t *topology, const char *file_name, const unsigned int no_of_cameras);
+void placement_auto(placement_t *placement, const cpu_topology_t *topology, const unsigned int no_of_cameras);
+void placement_report(const placement_t *placement, const cpu_topology_t *topology, const unsigned int no_of_cameras);
+
+#endif //_PLACEMENT_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
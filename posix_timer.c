@@ -3,26 +3,24 @@
 //
 //  File name: posix_timer.c
 //
-//  Description: Timer functionalities
+//  Description: Timer functionalities, 1 ms tick releasing the sequencer services (RELEASE_MODE_TIMER_TICK)
 //
 
 #include "include.h"
 #include "posix_timer.h"
+#include "sequencer.h"
 
 //global timer variable
 unsigned long long app_timer_counter=1;
 
 //global time variable mutex to restrict access to it
-extern pthread_mutex_t app_timer_counter_mutex_lock;
+pthread_mutex_t app_timer_counter_mutex_lock;
+static pthread_mutexattr_t app_timer_counter_mutex_lock_attr;
 
-//cond wait/signal for synchronization
-pthread_cond_t cond_query_frames_thread;
-pthread_cond_t cond_store_frames_thread;
-
-//global variable //updated by only once, and used across the application for sync
-extern bool query_frames_thread_dispatched;
-extern bool store_frames_thread_dispatched;
-extern unsigned int store_frames_frequency; //default value 1
+//timer, and its handler thread attributes
+static timer_t timer_id;
+static pthread_attr_t timer_thread_attr;
+static struct sched_param timer_thread_sched_param;
 
 //------------------------------------------------------------------------------------------------------------------------------
 //  Function Name:  timer_handler.c
@@ -31,8 +29,7 @@ extern unsigned int store_frames_frequency; //default value 1
 //
 //  Return:         None
 //
-//  Description:    Initialize and start POSIX timer
-//                  Dispatch RT thtreads to query and store frames
+//  Description:    Advances the application timer, and releases the sequencer services due at this tick
 //
 //---------------------------------------------------------------------------------------------------------------------------
 void timer_handler(union sigval arg)
@@ -51,19 +48,8 @@ void timer_handler(union sigval arg)
     //update timer counter
     app_timer_counter += APP_TIMER_INTERVAL_IN_MSEC;
 
-    //run at 25 Hz
-    if((query_frames_thread_dispatched) && ((app_timer_counter % QUERY_FRAMES_INTERVAL_IN_MSEC) == 0))
-    {
-        //signal  query_frames_thread
-        if(pthread_cond_signal(&cond_query_frames_thread)) EXIT_FAIL("pthread_cond_signal");
-    }
-
-    //run at variable frequency from 1 Hz to 10 Hz
-    if((store_frames_thread_dispatched) && ((app_timer_counter % (DEFAULT_STORE_FRAMES_INTERVAL_IN_MSEC/store_frames_frequency)) == 0))
-    {
-        //signal store_frames_thread
-        if(pthread_cond_signal(&cond_store_frames_thread)) EXIT_FAIL("pthread_cond_signal");
-    }
+    //release the services due at this tick
+    sequencer_release_on_tick(app_timer_counter);
 
     //relinquish mutex lock on timer counter variable
     if(pthread_mutex_unlock(&app_timer_counter_mutex_lock)) EXIT_FAIL("pthread_mutex_unlock");
@@ -77,6 +63,76 @@ void timer_handler(union sigval arg)
     #endif
 } //end of "timer_handler()"
 
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  start_app_timer
+//
+//  Parameters:     core - core of the timer_handler() thread
+//
+//  Return:         None
+//
+//  Description:    Creates and starts the APP_TIMER_INTERVAL_IN_MSEC timer, timer_handler() runs on its own RT thread
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void start_app_timer(const int core)
+{
+    struct sigevent sigevent_param;
+    struct itimerspec timer_period;
+
+    //initialize timer thread attributes
+    assign_RT_schedular_attr(&timer_thread_attr, &timer_thread_sched_param, SCHED_FIFO, TIMER_THREAD_PRIORITY, core);
+
+    //assign sigevent paramaters for the timer
+    sigevent_param.sigev_notify = SIGEV_THREAD;
+    sigevent_param.sigev_value.sival_ptr = &timer_id;
+    sigevent_param.sigev_notify_function = &timer_handler;
+    sigevent_param.sigev_notify_attributes = &timer_thread_attr;
+
+    //initialize timer period values
+    timer_period.it_interval.tv_sec = (APP_TIMER_INTERVAL_IN_MSEC / MSEC_PER_SEC);
+    timer_period.it_interval.tv_nsec = (APP_TIMER_INTERVAL_IN_MSEC * NSEC_PER_MSEC);
+    timer_period.it_value.tv_sec = timer_period.it_interval.tv_sec; //start time
+    timer_period.it_value.tv_nsec = timer_period.it_interval.tv_nsec;
+
+    //create timer
+    if(timer_create(CLOCK_REALTIME, &sigevent_param, &timer_id)) EXIT_FAIL("timer_create");
+
+    //initialize app_timer_counter variable mutex attributes
+    if(pthread_mutexattr_init(&app_timer_counter_mutex_lock_attr)) EXIT_FAIL("pthread_mutexattr_init");
+    //set mutex type to PTHREAD_MUTEX_ERRORCHECK
+    if(pthread_mutexattr_settype(&app_timer_counter_mutex_lock_attr, PTHREAD_MUTEX_ERRORCHECK)) EXIT_FAIL("pthread_mutexattr_settype");
+    //initilize mutex to protect app_timer_counter variable
+    if(pthread_mutex_init(&app_timer_counter_mutex_lock, &app_timer_counter_mutex_lock_attr)) EXIT_FAIL("pthread_mutex_init");
+
+    //start timer
+    syslog(LOG_WARNING,"\n Timer starting with timer_thread_attr priority ==> %d <==", timer_thread_sched_param.sched_priority);
+    if(timer_settime(timer_id, 0, &timer_period, 0)) EXIT_FAIL("timer_settime");
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  stop_app_timer
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//  Description:    Stops and deletes the timer started by start_app_timer()
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void stop_app_timer(void)
+{
+    if(timer_delete(timer_id)) EXIT_FAIL("timer_delete");
+
+    //a handler may still be running, wait for it
+    if(pthread_mutex_lock(&app_timer_counter_mutex_lock)) EXIT_FAIL("pthread_mutex_lock");
+    if(pthread_mutex_unlock(&app_timer_counter_mutex_lock)) EXIT_FAIL("pthread_mutex_unlock");
+
+    //destroy mutex lock
+    pthread_mutex_destroy(&app_timer_counter_mutex_lock);
+    pthread_mutexattr_destroy(&app_timer_counter_mutex_lock_attr);
+}
+
 //==============================================================================
 //    End of file!
 //==============================================================================
@@ -14,5 +14,11 @@
 
 //APIs
 void timer_handler(union sigval arg);
+void start_app_timer(const int core);
+void stop_app_timer(void);
 
 #endif //_POSIX_TIMER_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,274 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: ppm_writer.c
+//
+//  Description: Writes frames as binary .ppm (P6) / .pgm (P5) files in a single pass.
+//               Header is built in memory, and header plus pixel rows are written with writev().
+//               The header parser is shared by the replay source and the frame reader
+//
+
+#include "include.h"
+#include <limits.h>
+#include <sys/uio.h>
+#include "ppm_writer.h"
+
+//local functions
+static int writev_all(int fd, struct iovec *iov, int iov_count);
+static int build_header(char *header, const size_t header_size, const unsigned int width, const unsigned int height,
+                        const unsigned int channels, const char *comments);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  ppm_write_frame
+//
+//  Parameters:     file_name - .ppm file to create (truncated if exists)
+//                  pixels, width, height, channels, step, pixel_order, comments, scratch - see ppm_write_frame_fd()
+//
+//  Return:         SUCCESS/ERROR (errno is set)
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int ppm_write_frame(const char *file_name, const unsigned char *pixels, const unsigned int width, const unsigned int height,
+                    const unsigned int channels, const size_t step, const int pixel_order, const char *comments,
+                    unsigned char *scratch)
+{
+    int rc, fd;
+
+    fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 00666);
+    if(fd == -1) return ERROR;
+
+    rc = ppm_write_frame_fd(fd, pixels, width, height, channels, step, pixel_order, comments, scratch);
+
+    if(close(fd)) rc = ERROR;
+
+    return rc;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  ppm_write_frame_fd
+//
+//  Parameters:     fd - file to write to, at its current offset (a new file, or a frame archive record)
+//                  pixels - first pixel of the frame
+//                  width, height - frame resolution
+//                  channels - 3 (P6) or 1 (P5)
+//                  step - distance in bytes between two adjacent rows
+//                  pixel_order - PPM_PIXEL_ORDER_RGB or PPM_PIXEL_ORDER_BGR
+//                  comments - header comment lines, each starting with '#' (NULL for none)
+//                  scratch - width*height*channels bytes, used only to swap BGR to RGB (may be NULL for RGB)
+//
+//  Return:         SUCCESS/ERROR (errno is set)
+//
+//  Description:    Builds the header in memory, and writes header plus pixel data with one writev() call.
+//                  RGB rows are written straight from the frame memory, no intermediate file or copy.
+//                  Writes exactly ppm_frame_size() bytes
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int ppm_write_frame_fd(const int fd, const unsigned char *pixels, const unsigned int width, const unsigned int height,
+                       const unsigned int channels, const size_t step, const int pixel_order, const char *comments,
+                       unsigned char *scratch)
+{
+    int rc, header_size;
+    unsigned int row, col;
+    char header[PPM_MAX_HEADER_SIZE];
+    struct iovec iov[IOV_MAX];
+    int iov_count;
+    const size_t row_size = (size_t)width * channels;
+
+    if(((channels != 3) && (channels != 1)) || ((channels == 3) && (pixel_order == PPM_PIXEL_ORDER_BGR) && !scratch))
+    {
+        errno = EINVAL;
+        return ERROR;
+    }
+
+    header_size = build_header(header, sizeof(header), width, height, channels, comments);
+    if((header_size < 0) || (header_size >= (int)sizeof(header)))
+    {
+        errno = EOVERFLOW;
+        return ERROR;
+    }
+
+    iov[0].iov_base = header;
+    iov[0].iov_len = header_size;
+
+    if((channels == 3) && (pixel_order == PPM_PIXEL_ORDER_BGR))
+    {
+        //.ppm pixels are RGB, swap while packing the rows into scratch
+        for(row = 0; row < height; ++row)
+        {
+            const unsigned char *src = pixels + row * step;
+            unsigned char *dst = scratch + row * row_size;
+
+            for(col = 0; col < width; ++col, src += 3, dst += 3)
+            {
+                dst[0] = src[2];
+                dst[1] = src[1];
+                dst[2] = src[0];
+            }
+        }
+
+        iov[1].iov_base = scratch;
+        iov[1].iov_len = row_size * height;
+        rc = writev_all(fd, iov, 2);
+    }
+    else if(step == row_size)
+    {
+        //continuous frame, header plus whole frame
+        iov[1].iov_base = (void *)pixels;
+        iov[1].iov_len = row_size * height;
+        rc = writev_all(fd, iov, 2);
+    }
+    else
+    {
+        //padded rows, one iovec per row, IOV_MAX at a time
+        rc = SUCCESS;
+        iov_count = 1;
+        for(row = 0; (row < height) && !rc; ++row)
+        {
+            iov[iov_count].iov_base = (void *)(pixels + row * step);
+            iov[iov_count].iov_len = row_size;
+
+            if((++iov_count == IOV_MAX) || (row == (height - 1)))
+            {
+                rc = writev_all(fd, iov, iov_count);
+                iov_count = 0;
+            }
+        }
+    }
+
+    return rc;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  ppm_frame_size
+//
+//  Parameters:     width, height - frame resolution
+//                  channels - 3 (P6) or 1 (P5)
+//                  comments - header comment lines, as passed to ppm_write_frame() (NULL for none)
+//
+//  Return:         Size of the file written by ppm_write_frame(), in bytes
+//
+//------------------------------------------------------------------------------------------------------------------------------
+size_t ppm_frame_size(const unsigned int width, const unsigned int height, const unsigned int channels, const char *comments)
+{
+    return (size_t)build_header(NULL, 0, width, height, channels, comments) + ((size_t)width * height * channels);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  ppm_parse_header
+//
+//  Parameters:     data, size - start of a .ppm file (in memory), at least the header
+//                  width, height - set to the frame resolution
+//
+//  Return:         Header size in bytes (pixel data offset), 0 if the data is no binary 8 bit (P6) .ppm file
+//
+//  Description:    Parses the magic, comment lines, resolution and maxval, as written by ppm_write_frame()
+//
+//------------------------------------------------------------------------------------------------------------------------------
+size_t ppm_parse_header(const void *data, const size_t size, unsigned int *width, unsigned int *height)
+{
+    char header[PPM_MAX_HEADER_SIZE + 1];
+    const size_t header_size = (size < PPM_MAX_HEADER_SIZE) ? size : PPM_MAX_HEADER_SIZE;
+    unsigned int values[3];
+    unsigned int no_of_values = 0;
+    char *next, *end;
+
+    if(header_size < 2) return 0;
+    memcpy(header, data, header_size);
+    if((header[0] != 'P') || (header[1] != '6')) return 0;
+    header[header_size] = '\0';
+
+    //width, height and maxval, separated by white space and comment lines
+    next = header + 2;
+    while(no_of_values < 3)
+    {
+        while((*next == ' ') || (*next == '\t') || (*next == '\r') || (*next == '\n')) ++next;
+        if(*next == '#')
+        {
+            next = strchr(next, '\n');
+            if(!next) return 0;
+            continue;
+        }
+
+        values[no_of_values] = (unsigned int)strtoul(next, &end, 10);
+        if(end == next) return 0;
+        next = end;
+        ++no_of_values;
+    }
+
+    //single white space before the pixels
+    if((values[2] != 255) || !*next) return 0;
+
+    *width = values[0];
+    *height = values[1];
+    return (size_t)(next + 1 - header);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  build_header
+//
+//  Parameters:     header - header buffer (NULL with header_size 0 to get the length only)
+//                  header_size - size of the header buffer
+//                  width, height, channels, comments - see ppm_write_frame()
+//
+//  Return:         Header length, as returned by snprintf()
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int build_header(char *header, const size_t header_size, const unsigned int width, const unsigned int height,
+                        const unsigned int channels, const char *comments)
+{
+    //P6 for color, P5 for gray scale
+    return snprintf(header, header_size, "P%c\n%s%s%u %u\n255\n",
+                    (channels == 3) ? '6' : '5', comments ? comments : "", comments ? "\n" : "", width, height);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  writev_all
+//
+//  Parameters:     fd - file descriptor
+//                  iov - buffers to write, modified on partial writes
+//                  iov_count - no.of buffers
+//
+//  Return:         SUCCESS/ERROR
+//
+//  Description:    writev() until every buffer is completely written
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int writev_all(int fd, struct iovec *iov, int iov_count)
+{
+    ssize_t written;
+
+    while(iov_count)
+    {
+        written = writev(fd, iov, iov_count);
+        if(written == -1)
+        {
+            if(errno == EINTR) continue;
+            return ERROR;
+        }
+
+        //skip fully written buffers
+        while(iov_count && (written >= (ssize_t)iov->iov_len))
+        {
+            written -= iov->iov_len;
+            ++iov;
+            --iov_count;
+        }
+
+        //partially written buffer
+        if(iov_count)
+        {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    return SUCCESS;
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
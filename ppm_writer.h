@@ -0,0 +1,36 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: ppm_writer.h
+//
+//  Description: Header file for ppm_writer.c
+//
+
+#ifndef _PPM_WRITER_H
+#define _PPM_WRITER_H
+
+#include "include.h"
+#include <stddef.h>
+
+//max length of the in-memory .ppm header (magic, comments, size, maxval)
+#define PPM_MAX_HEADER_SIZE     (512)
+
+//pixel order of the source data
+#define PPM_PIXEL_ORDER_RGB     (0)
+#define PPM_PIXEL_ORDER_BGR     (1) //openCV default, swapped to RGB while writing
+
+//APIs
+int ppm_write_frame(const char *file_name, const unsigned char *pixels, const unsigned int width, const unsigned int height,
+                    const unsigned int channels, const size_t step, const int pixel_order, const char *comments,
+                    unsigned char *scratch);
+int ppm_write_frame_fd(const int fd, const unsigned char *pixels, const unsigned int width, const unsigned int height,
+                       const unsigned int channels, const size_t step, const int pixel_order, const char *comments,
+                       unsigned char *scratch);
+size_t ppm_frame_size(const unsigned int width, const unsigned int height, const unsigned int channels, const char *comments);
+size_t ppm_parse_header(const void *data, const size_t size, unsigned int *width, unsigned int *height);
+
+#endif //_PPM_WRITER_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
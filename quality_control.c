@@ -0,0 +1,283 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: quality_control.c
+//
+//  Description: Store mode feedback control of a camera (-Q). The response time of every store job is compared with
+//               the store period, and once per window of jobs the mode is stepped down if too many jobs missed it:
+//               a write bound window gets smaller files (.ppm to .png, then more compression), an encode bound window
+//               less compression, then both a lower resolution. Format and compression stay within the configured
+//               levels (-Y). Steps are undone in reverse once the jobs are well within their period again. Every mode
+//               change is logged with its reason
+//
+
+#include "include.h"
+#include "quality_control.h"
+
+//local functions
+static int cheaper_mode(const quality_control_t *control, const int write_bound, quality_mode_t *mode, const char **reason);
+static void log_mode_change(const quality_control_t *control, const quality_mode_t *mode, const char *reason,
+                            const unsigned long long period_nsec);
+static const char *format_name(const unsigned int format);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  quality_control_init
+//
+//  Parameters:     control - quality control of a camera
+//                  camera - camera number, for the log
+//                  format, compress_ratio - configured store mode (-o, -c), the mode stepped from
+//                  min_compress_ratio, max_compress_ratio - compression levels the mode may step through (-Y), 0 allows
+//                                                           .ppm, the configured mode is within them
+//                  miss_percent - store jobs allowed to miss their period, percent, 1 to MAX_QUALITY_MISS_PERCENT
+//                  max_downscale - MIN_QUALITY_DOWNSCALE to MAX_QUALITY_DOWNSCALE
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void quality_control_init(quality_control_t *control, const unsigned int camera, const unsigned int format,
+                          const unsigned int compress_ratio, const unsigned int min_compress_ratio,
+                          const unsigned int max_compress_ratio, const unsigned int miss_percent, const unsigned int max_downscale)
+{
+    assert((format == OUTPUT_FORMAT_PPM) || (format == OUTPUT_FORMAT_PNG));
+    assert((min_compress_ratio <= max_compress_ratio) && (max_compress_ratio <= MAX_QUALITY_COMPRESS_RATIO));
+    assert((format == OUTPUT_FORMAT_PPM) ? !min_compress_ratio :
+           ((compress_ratio >= min_compress_ratio) && (compress_ratio <= max_compress_ratio)));
+    assert((miss_percent > 0) && (miss_percent <= MAX_QUALITY_MISS_PERCENT));
+    assert((max_downscale >= MIN_QUALITY_DOWNSCALE) && (max_downscale <= MAX_QUALITY_DOWNSCALE));
+
+    memset(control, 0, sizeof(*control));
+    control->camera = camera;
+    control->miss_percent = miss_percent;
+    control->max_downscale = max_downscale;
+    control->min_compress_ratio = min_compress_ratio;
+    control->max_compress_ratio = max_compress_ratio;
+    control->mode.format = format;
+    control->mode.compress_ratio = compress_ratio;
+    control->mode.downscale = 1;
+
+    syslog(LOG_WARNING, " camera %u quality control: at most %u%% store jobs missing their period, %s level %u, levels %u to %u, down to 1/%u resolution",
+           camera, miss_percent, format_name(format), compress_ratio, min_compress_ratio, max_compress_ratio, max_downscale);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  quality_control_job
+//
+//  Parameters:     control - quality control of the camera (store_frames_thread only)
+//                  response_nsec - store release to job end
+//                  period_nsec - store period, DEFAULT_STORE_FRAMES_INTERVAL_IN_MSEC / store_frames_frequency
+//                  encode_nsec, write_nsec - encode (and downscale) and file write time of the job, 0 if not done
+//
+//  Return:         TRUE if the store mode changed, applied from the next job on
+//
+//  Description:    Adds the job to the window. A full window with more misses than the target steps the mode down,
+//                  bound by the stage which took longer; QUALITY_RESTORE_WINDOWS clean windows in a row undo the last
+//                  step down
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int quality_control_job(quality_control_t *control, const unsigned long long response_nsec, const unsigned long long period_nsec,
+                        const unsigned long long encode_nsec, const unsigned long long write_nsec)
+{
+    quality_mode_t mode;
+    const char *reason;
+    int changed = FALSE;
+
+    ++control->jobs;
+    ++control->window_jobs;
+    if(response_nsec > period_nsec)
+    {
+        ++control->misses;
+        ++control->window_misses;
+    }
+    control->window_encode_nsec += encode_nsec;
+    control->window_write_nsec += write_nsec;
+    if(response_nsec > control->window_max_response_nsec) control->window_max_response_nsec = response_nsec;
+
+    if(control->window_jobs < QUALITY_CONTROL_WINDOW) return FALSE;
+
+    if((control->window_misses * 100) > (control->miss_percent * control->window_jobs))
+    {
+        control->clean_windows = 0;
+        if((control->steps < MAX_QUALITY_STEPS) &&
+           cheaper_mode(control, control->window_write_nsec >= control->window_encode_nsec, &mode, &reason))
+        {
+            log_mode_change(control, &mode, reason, period_nsec);
+            control->history[control->steps++] = control->mode;
+            control->mode = mode;
+            ++control->steps_down;
+            changed = TRUE;
+        }
+        else
+        {
+            ++control->windows_at_limit;
+        }
+    }
+    else if(!control->window_misses && ((control->window_max_response_nsec * 100) <= (period_nsec * QUALITY_RESTORE_HEADROOM_PERCENT)))
+    {
+        if((++control->clean_windows >= QUALITY_RESTORE_WINDOWS) && control->steps)
+        {
+            log_mode_change(control, &control->history[control->steps - 1], "restored, jobs well within their period", period_nsec);
+            control->mode = control->history[--control->steps];
+            control->clean_windows = 0;
+            ++control->steps_up;
+            changed = TRUE;
+        }
+    }
+    else
+    {
+        control->clean_windows = 0;
+    }
+
+    control->window_jobs = 0;
+    control->window_misses = 0;
+    control->window_encode_nsec = 0;
+    control->window_write_nsec = 0;
+    control->window_max_response_nsec = 0;
+
+    return changed;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  quality_control_report
+//
+//  Parameters:     control - quality control, store_frames_thread has exited
+//
+//  Return:         None
+//
+//  Description:    Prints and logs the misses, the mode changes and the final mode
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void quality_control_report(const quality_control_t *control)
+{
+    fprintf(stdout, "\n\n--------------------------------------"
+                     "\ncamera %u quality control results:"
+                     "\nstore jobs: %llu, missed their period: %llu (%.1f%%, target %u%%),"
+                     "\nsteps down: %llu, steps up: %llu, windows with no cheaper mode left: %llu,"
+                     "\nfinal mode: %s level %u, 1/%u resolution"
+                     "\n--------------------------------------",
+                     control->camera, control->jobs, control->misses,
+                     control->jobs ? ((100.0 * control->misses) / control->jobs) : 0.0, control->miss_percent,
+                     control->steps_down, control->steps_up, control->windows_at_limit,
+                     format_name(control->mode.format), control->mode.compress_ratio, control->mode.downscale);
+
+    syslog(LOG_WARNING, " camera %u quality control: jobs %llu, missed %llu, steps down %llu, up %llu, at limit %llu, final %s level %u 1/%u",
+           control->camera, control->jobs, control->misses, control->steps_down, control->steps_up, control->windows_at_limit,
+           format_name(control->mode.format), control->mode.compress_ratio, control->mode.downscale);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  cheaper_mode
+//
+//  Parameters:     control - quality control
+//                  write_bound - TRUE if the window spent more time writing than encoding
+//                  mode - set to the next cheaper mode
+//                  reason - set to the reason logged
+//
+//  Return:         TRUE, or FALSE if there is no cheaper mode within the bounds
+//
+//  Description:    Write bound: .ppm to .png at the fastest level allowed, then more compression, up to the max level.
+//                  Encode bound: less compression, down to the min level (and level 1). Then a lower resolution, and at
+//                  the lowest one an encode bound .png goes back to .ppm if the min level is 0. Modes stepped down from
+//                  are not tried again until they are restored, so a write bound and an encode bound window do not undo
+//                  each other's step
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int cheaper_mode(const quality_control_t *control, const int write_bound, quality_mode_t *mode, const char **reason)
+{
+    quality_mode_t candidates[QUALITY_CANDIDATES];
+    const char *reasons[QUALITY_CANDIDATES];
+    unsigned int no_of_candidates = 0, i, step;
+    //fastest .png level allowed
+    const unsigned int min_png_compress_ratio = (control->min_compress_ratio > MIN_QUALITY_COMPRESS_RATIO) ?
+                                                control->min_compress_ratio : MIN_QUALITY_COMPRESS_RATIO;
+
+    if(write_bound && (control->mode.format == OUTPUT_FORMAT_PPM) && (control->max_compress_ratio >= MIN_QUALITY_COMPRESS_RATIO))
+    {
+        candidates[no_of_candidates] = control->mode;
+        candidates[no_of_candidates].format = OUTPUT_FORMAT_PNG;
+        candidates[no_of_candidates].compress_ratio = min_png_compress_ratio;
+        reasons[no_of_candidates++] = "write bound, .ppm to .png";
+    }
+    if(write_bound && (control->mode.format == OUTPUT_FORMAT_PNG) && (control->mode.compress_ratio < control->max_compress_ratio))
+    {
+        candidates[no_of_candidates] = control->mode;
+        ++candidates[no_of_candidates].compress_ratio;
+        reasons[no_of_candidates++] = "write bound, compression up";
+    }
+    if(!write_bound && (control->mode.format == OUTPUT_FORMAT_PNG) && (control->mode.compress_ratio > min_png_compress_ratio))
+    {
+        candidates[no_of_candidates] = control->mode;
+        --candidates[no_of_candidates].compress_ratio;
+        reasons[no_of_candidates++] = "encode bound, compression down";
+    }
+    if(control->mode.downscale < control->max_downscale)
+    {
+        candidates[no_of_candidates] = control->mode;
+        ++candidates[no_of_candidates].downscale;
+        reasons[no_of_candidates++] = write_bound ? "write bound, resolution down" : "encode bound, resolution down";
+    }
+    if(!write_bound && (control->mode.format == OUTPUT_FORMAT_PNG) && !control->min_compress_ratio)
+    {
+        candidates[no_of_candidates] = control->mode;
+        candidates[no_of_candidates].format = OUTPUT_FORMAT_PPM;
+        reasons[no_of_candidates++] = "encode bound, .png to .ppm";
+    }
+
+    for(i = 0; i < no_of_candidates; ++i)
+    {
+        for(step = 0; step < control->steps; ++step)
+        {
+            if(!memcmp(&candidates[i], &control->history[step], sizeof(candidates[i]))) break;
+        }
+        if(step < control->steps) continue;
+
+        *mode = candidates[i];
+        *reason = reasons[i];
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  log_mode_change
+//
+//  Parameters:     control - quality control, with the window the decision is made on
+//                  mode - new mode
+//                  reason - why it changes
+//                  period_nsec - store period
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void log_mode_change(const quality_control_t *control, const quality_mode_t *mode, const char *reason,
+                            const unsigned long long period_nsec)
+{
+    syslog(LOG_WARNING, " camera %u store mode %s level %u 1/%u -> %s level %u 1/%u: %s, %u of %u jobs missed the %llu ms period, "
+                        "max response %llu us, encode %llu us, write %llu us per job",
+           control->camera, format_name(control->mode.format), control->mode.compress_ratio, control->mode.downscale,
+           format_name(mode->format), mode->compress_ratio, mode->downscale, reason, control->window_misses, control->window_jobs,
+           period_nsec / NSEC_PER_MSEC, control->window_max_response_nsec / NSEC_PER_USEC,
+           control->window_encode_nsec / control->window_jobs / NSEC_PER_USEC, control->window_write_nsec / control->window_jobs / NSEC_PER_USEC);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  format_name
+//
+//  Parameters:     format - OUTPUT_FORMAT_xxx
+//
+//  Return:         File extension of the format
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static const char *format_name(const unsigned int format)
+{
+    return (format == OUTPUT_FORMAT_PNG) ? ".png" : ".ppm";
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,85 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: quality_control.h
+//
+//  Description: Header file for quality_control.c
+//
+
+#ifndef _QUALITY_CONTROL_H
+#define _QUALITY_CONTROL_H
+
+#include "include.h"
+
+//store jobs allowed to miss their period, percent of the jobs of a window, 0 disables the quality control (-Q)
+#define DEFAULT_QUALITY_MISS_PERCENT        (0)
+#define MAX_QUALITY_MISS_PERCENT            (50)
+
+//stored frames are box downscaled by at most this factor (-X), 1 keeps the resolution
+#define MIN_QUALITY_DOWNSCALE               (1)
+#define DEFAULT_QUALITY_DOWNSCALE           (2)
+#define MAX_QUALITY_DOWNSCALE               (4)
+
+//.png compression levels the quality control may step through (-Y), level 0 allows .ppm, .png is stored from level 1
+#define MIN_QUALITY_COMPRESS_RATIO          (1)
+#define MAX_QUALITY_COMPRESS_RATIO          (9)
+
+//store jobs per decision, and clean windows (no miss, every job within the headroom) before a step is undone
+#define QUALITY_CONTROL_WINDOW              (10)
+#define QUALITY_RESTORE_WINDOWS             (3)
+#define QUALITY_RESTORE_HEADROOM_PERCENT    (50)
+
+//steps down kept to be undone in reverse, no further step once full
+#define MAX_QUALITY_STEPS                   (16)
+
+//cheaper modes looked at for a step down
+#define QUALITY_CANDIDATES                  (4)
+
+//how a camera stores its frames
+typedef struct
+{
+    unsigned int format;                    //OUTPUT_FORMAT_PPM or OUTPUT_FORMAT_PNG
+    unsigned int compress_ratio;            //.png compression level
+    unsigned int downscale;                 //box downscale factor, 1 is the source resolution
+}quality_mode_t;
+
+//store mode of a camera, stepped by its store_frames_thread only
+typedef struct
+{
+    unsigned int camera;
+    unsigned int miss_percent;              //target
+    unsigned int max_downscale;
+    unsigned int min_compress_ratio;        //bounds of the steps (-Y), the configured mode is within them
+    unsigned int max_compress_ratio;
+    quality_mode_t mode;
+    quality_mode_t history[MAX_QUALITY_STEPS];  //modes before every step down
+    unsigned int steps;
+
+    //current window
+    unsigned int window_jobs;
+    unsigned int window_misses;
+    unsigned long long window_encode_nsec;
+    unsigned long long window_write_nsec;
+    unsigned long long window_max_response_nsec;
+    unsigned int clean_windows;
+
+    unsigned long long jobs;
+    unsigned long long misses;
+    unsigned long long steps_down;
+    unsigned long long steps_up;
+    unsigned long long windows_at_limit;    //too many misses, no cheaper mode left
+}quality_control_t;
+
+//APIs
+void quality_control_init(quality_control_t *control, const unsigned int camera, const unsigned int format,
+                          const unsigned int compress_ratio, const unsigned int min_compress_ratio,
+                          const unsigned int max_compress_ratio, const unsigned int miss_percent, const unsigned int max_downscale);
+int quality_control_job(quality_control_t *control, const unsigned long long response_nsec, const unsigned long long period_nsec,
+                        const unsigned long long encode_nsec, const unsigned long long write_nsec);
+void quality_control_report(const quality_control_t *control);
+
+#endif //_QUALITY_CONTROL_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
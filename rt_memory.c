@@ -0,0 +1,117 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: rt_memory.c
+//
+//  Description: Real-time memory hardening. Locks the process memory, keeps malloc from returning memory to the
+//               kernel, and prefaults the RT thread stacks, so the RT loops do not take page faults
+//
+
+#include "include.h"
+#include <malloc.h>
+#include <sys/mman.h>
+#include "rt_memory.h"
+
+//local functions
+static void touch_stack(void) __attribute__((noinline));
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  lock_process_memory
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//  Description:    Call once at startup, before creating the RT threads.
+//                  Turns off malloc trimming and mmap'ed allocations, so freed heap memory stays mapped (and locked),
+//                  and locks all current and future mappings (heap, thread stacks, frame buffers) in memory
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void lock_process_memory(void)
+{
+    //never give heap memory back to the kernel
+    if(!mallopt(M_TRIM_THRESHOLD, -1)) EXIT_FAIL("mallopt M_TRIM_THRESHOLD");
+    //serve every allocation from the (locked) heap, no per-allocation mmap/munmap
+    if(!mallopt(M_MMAP_MAX, 0)) EXIT_FAIL("mallopt M_MMAP_MAX");
+
+    if(mlockall(MCL_CURRENT | MCL_FUTURE)) EXIT_FAIL("mlockall");
+
+    syslog(LOG_WARNING, " Process memory locked, malloc trimming and mmap threshold turned off");
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  prefault_thread_stack
+//
+//  Parameters:     baseline - page fault counters of the calling thread, once the stack is prefaulted
+//
+//  Return:         None
+//
+//  Description:    Call at the start of every RT thread. Touches RT_THREAD_STACK_PREFAULT_SIZE bytes of the stack
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void prefault_thread_stack(struct rusage *baseline)
+{
+    touch_stack();
+
+    if(getrusage(RUSAGE_THREAD, baseline)) EXIT_FAIL("getrusage");
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  report_thread_page_faults
+//
+//  Parameters:     thread_name - printed along with the results
+//                  baseline - counters returned by prefault_thread_stack() in the same thread
+//
+//  Return:         None
+//
+//  Description:    Call at the end of every RT thread. Prints and logs the minor/major page faults of the calling thread,
+//                  in total and after the stack was prefaulted
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void report_thread_page_faults(const char *thread_name, const struct rusage *baseline)
+{
+    struct rusage usage;
+
+    if(getrusage(RUSAGE_THREAD, &usage)) EXIT_FAIL("getrusage");
+
+    fprintf(stdout, "\n\n======================================"
+                     "\n%s page faults:"
+                     "\nminor: %ld (%ld after prefault),"
+                     "\nmajor: %ld (%ld after prefault)"
+                     "\n======================================",
+                     thread_name, usage.ru_minflt, usage.ru_minflt - baseline->ru_minflt,
+                     usage.ru_majflt, usage.ru_majflt - baseline->ru_majflt);
+
+    syslog(LOG_WARNING, " %s page faults: minor %ld (%ld after prefault), major %ld (%ld after prefault)",
+           thread_name, usage.ru_minflt, usage.ru_minflt - baseline->ru_minflt,
+           usage.ru_majflt, usage.ru_majflt - baseline->ru_majflt);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  touch_stack
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//  Description:    Writes to every page of a RT_THREAD_STACK_PREFAULT_SIZE stack frame below the caller
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void touch_stack(void)
+{
+    unsigned int i;
+    volatile unsigned char stack_area[RT_THREAD_STACK_PREFAULT_SIZE];
+    const long page_size = sysconf(_SC_PAGESIZE);
+
+    for(i = 0; i < sizeof(stack_area); i += page_size)
+    {
+        stack_area[i] = 0;
+    }
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
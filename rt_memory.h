@@ -0,0 +1,24 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: rt_memory.h
+//
+//  Description: Header file for rt_memory.c
+//
+
+#ifndef _RT_MEMORY_H
+#define _RT_MEMORY_H
+
+#include "include.h"
+#include <sys/resource.h>
+
+//APIs
+void lock_process_memory(void);
+void prefault_thread_stack(struct rusage *baseline);
+void report_thread_page_faults(const char *thread_name, const struct rusage *baseline);
+
+#endif //_RT_MEMORY_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
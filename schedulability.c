@@ -0,0 +1,151 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: schedulability.c
+//
+//  Description: Feasibility tests of a set of periodic tasks (implicit deadlines), on every core separately:
+//               Liu & Layland utilization bound (sufficient, RM), response-time analysis (exact, fixed priority),
+//               and EDF utilization test (exact, for comparison)
+//
+
+#include "include.h"
+#include <math.h>
+#include "schedulability.h"
+
+//response-time analysis gives up after this many iterations
+#define MAX_RTA_ITERATIONS  (1000)
+
+//local functions
+static double response_time(const sched_task_t *tasks, const unsigned int no_of_tasks, const unsigned int task_idx);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  schedulability_analysis
+//
+//  Parameters:     tasks - task set, response_time_msec of every task is updated
+//                  no_of_tasks - no.of tasks
+//                  log_results - TRUE to log utilization, headroom and test results of every core
+//
+//  Return:         TRUE if every core passes the response-time analysis (tasks run with fixed priorities), else FALSE
+//
+//  Description:    Groups the tasks by core, and runs the Liu & Layland bound, response-time analysis and the
+//                  EDF utilization test on each core
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int schedulability_analysis(sched_task_t *tasks, const unsigned int no_of_tasks, const int log_results)
+{
+    unsigned int i, core_tasks;
+    int core, core_rta_schedulable, schedulable = TRUE;
+    double utilization, bound;
+    sched_task_t core_task_set[MAX_SCHEDULABILITY_TASKS];
+    unsigned int core_task_idx[MAX_SCHEDULABILITY_TASKS];
+
+    assert(no_of_tasks <= MAX_SCHEDULABILITY_TASKS);
+    for(i = 0; i < no_of_tasks; ++i)
+    {
+        assert((tasks[i].core >= 0) && (tasks[i].core < MAX_SCHEDULABILITY_CORES) && (tasks[i].period_msec > 0));
+    }
+
+    for(core = 0; core < MAX_SCHEDULABILITY_CORES; ++core)
+    {
+        //tasks on this core
+        core_tasks = 0;
+        utilization = 0;
+        for(i = 0; i < no_of_tasks; ++i)
+        {
+            if(tasks[i].core != core) continue;
+
+            core_task_idx[core_tasks] = i;
+            core_task_set[core_tasks++] = tasks[i];
+            utilization += tasks[i].wcet_msec / tasks[i].period_msec;
+        }
+        if(!core_tasks) continue;
+
+        //response-time analysis, every task must complete before its deadline
+        core_rta_schedulable = TRUE;
+        for(i = 0; i < core_tasks; ++i)
+        {
+            tasks[core_task_idx[i]].response_time_msec = response_time(core_task_set, core_tasks, i);
+            if(tasks[core_task_idx[i]].response_time_msec > core_task_set[i].period_msec) core_rta_schedulable = FALSE;
+        }
+        if(!core_rta_schedulable) schedulable = FALSE;
+
+        if(log_results)
+        {
+            bound = liu_layland_bound(core_tasks);
+            syslog(core_rta_schedulable ? LOG_WARNING : LOG_ERR,
+                   " schedulability core %d: %u tasks, U %.4f, headroom %.1f%%, LL bound %.4f (%s), RTA %s, EDF %s",
+                   core, core_tasks, utilization, (1.0 - utilization) * 100, bound,
+                   (utilization <= bound) ? "pass" : "inconclusive",
+                   core_rta_schedulable ? "pass" : "FAIL", (utilization <= 1.0) ? "pass" : "FAIL");
+
+            for(i = 0; i < core_tasks; ++i)
+            {
+                syslog(LOG_WARNING, "   %s: C %.3f ms, T %.0f ms, priority %d, R %.3f ms",
+                       core_task_set[i].name, core_task_set[i].wcet_msec, core_task_set[i].period_msec,
+                       core_task_set[i].priority, tasks[core_task_idx[i]].response_time_msec);
+            }
+        }
+    }
+
+    return schedulable;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  liu_layland_bound
+//
+//  Parameters:     no_of_tasks - no.of tasks on the core
+//
+//  Return:         n(2^(1/n) - 1), RM utilization bound
+//
+//------------------------------------------------------------------------------------------------------------------------------
+double liu_layland_bound(const unsigned int no_of_tasks)
+{
+    if(!no_of_tasks) return 1.0;
+
+    return no_of_tasks * (pow(2.0, 1.0 / no_of_tasks) - 1.0);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  response_time
+//
+//  Parameters:     tasks - tasks on one core
+//                  no_of_tasks - no.of tasks
+//                  task_idx - task to analyze
+//
+//  Return:         Worst case response time, R = C + sum(ceil(R/Tj) * Cj) over the higher priority tasks.
+//                  Greater than the period if the task can miss its deadline
+//
+//  Description:    Tasks with equal priority are counted as interfering (SCHED_FIFO runs them in release order)
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static double response_time(const sched_task_t *tasks, const unsigned int no_of_tasks, const unsigned int task_idx)
+{
+    unsigned int i, iteration;
+    double response, interference;
+    const sched_task_t *task = &tasks[task_idx];
+
+    response = task->wcet_msec;
+    for(iteration = 0; iteration < MAX_RTA_ITERATIONS; ++iteration)
+    {
+        interference = 0;
+        for(i = 0; i < no_of_tasks; ++i)
+        {
+            if((i == task_idx) || (tasks[i].priority > task->priority)) continue;
+
+            interference += ceil(response / tasks[i].period_msec) * tasks[i].wcet_msec;
+        }
+
+        //converged, or already past the deadline
+        if((task->wcet_msec + interference) == response) return response;
+        response = task->wcet_msec + interference;
+        if(response > task->period_msec) return response;
+    }
+
+    return response;
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,37 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: schedulability.h
+//
+//  Description: Header file for schedulability.c
+//
+
+#ifndef _SCHEDULABILITY_H
+#define _SCHEDULABILITY_H
+
+#include "include.h"
+
+//no.of cores and tasks analyzed
+#define MAX_SCHEDULABILITY_CORES    (64) //MAX_TOPOLOGY_CPUS
+#define MAX_SCHEDULABILITY_TASKS    (32)
+
+//periodic task, deadline equals period
+typedef struct
+{
+    const char *name;
+    double wcet_msec;           //C, measured
+    double period_msec;         //T (= D)
+    int priority;               //relative (see include.h), lower value is higher priority
+    int core;
+    double response_time_msec;  //set by schedulability_analysis(), worst case R from response-time analysis
+}sched_task_t;
+
+//APIs
+int schedulability_analysis(sched_task_t *tasks, const unsigned int no_of_tasks, const int log_results);
+double liu_layland_bound(const unsigned int no_of_tasks);
+
+#endif //_SCHEDULABILITY_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,893 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: sequencer.c
+//
+//  Description: Rate-monotonic sequencer. Periodic services are registered in a table (period, offset, priority, core,
+//               entry function), get rate-monotonic priorities, and run on their own RT threads. Every release is
+//               handed to a service by posting its semaphore, either from the tickless sequencer thread (default) or
+//               from the 1 ms timer_handler() tick.
+//
+
+#include "include.h"
+#include "posix_timer.h"
+#include "schedulability.h"
+#include "sequencer.h"
+#include "trace.h"
+
+extern unsigned int release_mode;
+extern unsigned int schedulability_warmup_sec;
+extern unsigned int service_sched_policy;
+
+//service table
+static sequencer_service_t services[MAX_SEQUENCER_SERVICES];
+static unsigned int no_of_services = 0;
+static unsigned int hyperperiod_msec = 0;
+
+//tickless sequencer thread
+static pthread_t sequencer_thread;
+static pthread_attr_t sequencer_thread_attr;
+static struct sched_param sequencer_thread_sched_param;
+static int stop_sequencer = FALSE;
+
+//prints the reports on SEQUENCER_REPORT_SIGNAL
+static pthread_t stats_thread;
+static int stop_stats_thread = FALSE;
+
+//posted by every service thread on exit
+static sem_t service_exited_sem;
+
+//serializes the schedulability checks and period changes
+static pthread_mutex_t schedulability_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//service of the calling thread
+static __thread sequencer_service_t *this_service = NULL;
+
+//local functions
+static void *sequencer_thread_handler(void *args);
+static void *service_thread_handler(void *args);
+static void release_service(sequencer_service_t *service, const unsigned long long release_nsec);
+static void complete_job(sequencer_service_t *service);
+static int analyze_services(const int service_idx, const unsigned int period_msec, const int log_results);
+static int apply_sched_deadline(sequencer_service_t *service, const unsigned int period_msec);
+static void assign_rm_priorities(void);
+static void report_service(const sequencer_service_t *service);
+static void *stats_thread_handler(void *args);
+static unsigned int gcd(unsigned int a, unsigned int b);
+static unsigned long long monotonic_time_in_nsec(void);
+static void nsec_to_timespec(const unsigned long long nsec, struct timespec *time);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  sequencer_register_service
+//
+//  Parameters:     name - service name, used in the logs and reports
+//                  period_msec - release period
+//                  offset_msec - release phase, relative to the common first release (less than period_msec)
+//                  priority - relative priority (see include.h), or SEQUENCER_RM_PRIORITY
+//                  core - core to run the service thread on
+//                  entry - service thread handler, waits for its releases with sequencer_wait_for_release()
+//                  entry_args - passed to entry
+//
+//  Return:         Index of the service in the service table
+//
+//  Description:    Adds a periodic service to the service table. Call before sequencer_start()
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int sequencer_register_service(const char *name, const unsigned int period_msec, const unsigned int offset_msec,
+                               const int priority, const int core, service_entry_t entry, void *entry_args)
+{
+    sequencer_service_t *service;
+
+    if(no_of_services == MAX_SEQUENCER_SERVICES) EXIT_FAIL("sequencer_register_service: service table full");
+    assert((period_msec > 0) && (offset_msec < period_msec) && entry);
+
+    service = &services[no_of_services];
+    memset(service, 0, sizeof(*service));
+    service->name = name;
+    service->period_msec = period_msec;
+    service->offset_msec = offset_msec;
+    service->priority = priority;
+    service->core = core;
+    service->entry = entry;
+    service->entry_args = entry_args;
+
+    return no_of_services++;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  sequencer_start
+//
+//  Parameters:     core - core of the sequencer thread (or timer_handler() thread)
+//
+//  Return:         None
+//
+//  Description:    Computes the hyperperiod, assigns the RM priorities, creates the service threads, and starts
+//                  releasing them. All services share the first release, FIRST_RELEASE_DELAY_IN_MSEC from now
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void sequencer_start(const int core)
+{
+    unsigned int i;
+    unsigned long long first_release_nsec;
+    sequencer_service_t *service;
+    pthread_attr_t stats_thread_attr;
+
+    if(!no_of_services) EXIT_FAIL("sequencer_start: no services registered");
+
+    //hyperperiod, LCM of the service periods
+    hyperperiod_msec = services[0].period_msec;
+    for(i = 1; i < no_of_services; ++i)
+    {
+        hyperperiod_msec = (hyperperiod_msec / gcd(hyperperiod_msec, services[i].period_msec)) * services[i].period_msec;
+    }
+
+    assign_rm_priorities();
+
+    //leave time for the threads to start, aligned to the millisecond
+    first_release_nsec = ((monotonic_time_in_nsec() / NSEC_PER_MSEC) + FIRST_RELEASE_DELAY_IN_MSEC) * NSEC_PER_MSEC;
+
+    syslog(LOG_WARNING, " sequencer: %u services, hyperperiod %u ms, %s releases",
+           no_of_services, hyperperiod_msec, (release_mode == RELEASE_MODE_TIMER_TICK) ? "timer tick" : "tickless");
+
+    if(sem_init(&service_exited_sem, 0, 0)) EXIT_FAIL("sem_init");
+
+    for(i = 0; i < no_of_services; ++i)
+    {
+        service = &services[i];
+
+        if(sem_init(&service->release_sem, 0, 0)) EXIT_FAIL("sem_init");
+        service->policy = SCHED_FIFO;
+        service->next_release_nsec = first_release_nsec + ((unsigned long long)service->offset_msec * NSEC_PER_MSEC);
+
+        assign_RT_schedular_attr(&service->thread_attr, &service->sched_param, SCHED_FIFO, service->priority, service->core);
+
+        syslog(LOG_WARNING," %s dispatching with priority ==> %d <==, period %u ms, offset %u ms, core %d",
+               service->name, service->sched_param.sched_priority, service->period_msec, service->offset_msec, service->core);
+        if(pthread_create(&service->thread, &service->thread_attr, service_thread_handler, (void *)service)) EXIT_FAIL("pthread_create");
+    }
+
+    //reports on demand, normal (non RT) thread, not the policy and core of the calling dispatcher
+    assign_normal_schedular_attr(&stats_thread_attr, ALL_CORES);
+    if(pthread_create(&stats_thread, &stats_thread_attr, stats_thread_handler, NULL)) EXIT_FAIL("pthread_create");
+    pthread_attr_destroy(&stats_thread_attr);
+
+    //start releasing
+    if(release_mode == RELEASE_MODE_TIMER_TICK)
+    {
+        start_app_timer(core);
+    }
+    else
+    {
+        assign_RT_schedular_attr(&sequencer_thread_attr, &sequencer_thread_sched_param, SCHED_FIFO, TIMER_THREAD_PRIORITY, core);
+
+        syslog(LOG_WARNING," sequencer_thread dispatching with priority ==> %d <==", sequencer_thread_sched_param.sched_priority);
+        if(pthread_create(&sequencer_thread, &sequencer_thread_attr, sequencer_thread_handler, NULL)) EXIT_FAIL("pthread_create");
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  sequencer_join
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//  Description:    Waits for all the service threads to exit, stops the releases, and reports the services
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void sequencer_join(void)
+{
+    int rc;
+    unsigned int i, exited = 0;
+    struct timespec warmup_end;
+
+    //schedulability analysis on the measured execution times, unless every service exits during the warm-up
+    if(schedulability_warmup_sec)
+    {
+        if(clock_gettime(CLOCK_REALTIME, &warmup_end)) EXIT_FAIL("clock_gettime");
+        warmup_end.tv_sec += schedulability_warmup_sec;
+        warmup_end.tv_nsec += FIRST_RELEASE_DELAY_IN_MSEC * NSEC_PER_MSEC;
+        if(warmup_end.tv_nsec >= NSEC_PER_SEC)
+        {
+            warmup_end.tv_sec += warmup_end.tv_nsec / NSEC_PER_SEC;
+            warmup_end.tv_nsec %= NSEC_PER_SEC;
+        }
+
+        while(exited < no_of_services)
+        {
+            rc = sem_timedwait(&service_exited_sem, &warmup_end);
+            if(!rc)
+            {
+                ++exited;
+                continue;
+            }
+
+            if(errno == EINTR) continue;
+            if(errno != ETIMEDOUT) EXIT_FAIL("sem_timedwait");
+
+            if(!sequencer_check_schedulability(TRUE))
+            {
+                syslog(LOG_ERR, " sequencer: service set is not schedulable after the warm-up, expect missed deadlines");
+                fprintf(stderr, "\nWarning: service set is not schedulable with the measured execution times, see syslog\n");
+            }
+
+            //reservations sized from the measured WCETs, a service stays on SCHED_FIFO if refused
+            if(service_sched_policy == SCHED_POLICY_DEADLINE)
+            {
+                if(pthread_mutex_lock(&schedulability_mutex)) EXIT_FAIL("pthread_mutex_lock");
+                for(i = 0; i < no_of_services; ++i)
+                {
+                    apply_sched_deadline(&services[i], __atomic_load_n(&services[i].period_msec, __ATOMIC_RELAXED));
+                }
+                if(pthread_mutex_unlock(&schedulability_mutex)) EXIT_FAIL("pthread_mutex_unlock");
+            }
+            break;
+        }
+    }
+
+    //services keep being released until all of them exit
+    for(i = 0; i < no_of_services; ++i)
+    {
+        pthread_join(services[i].thread, NULL);
+    }
+
+    if(release_mode == RELEASE_MODE_TIMER_TICK)
+    {
+        stop_app_timer();
+    }
+    else
+    {
+        __atomic_store_n(&stop_sequencer, TRUE, __ATOMIC_RELEASE);
+        pthread_join(sequencer_thread, NULL);
+    }
+
+    //stop the stats thread
+    __atomic_store_n(&stop_stats_thread, TRUE, __ATOMIC_RELEASE);
+    if(pthread_kill(stats_thread, SEQUENCER_REPORT_SIGNAL)) EXIT_FAIL("pthread_kill");
+    pthread_join(stats_thread, NULL);
+
+    sequencer_report();
+    for(i = 0; i < no_of_services; ++i)
+    {
+        sem_destroy(&services[i].release_sem);
+    }
+    sem_destroy(&service_exited_sem);
+
+    //final analysis with the execution times of the whole run
+    sequencer_check_schedulability(TRUE);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  sequencer_wait_for_release
+//
+//  Parameters:     release_time - set to the release time (CLOCK_MONOTONIC)
+//
+//  Return:         None
+//
+//  Description:    Blocks the calling service until its next release.
+//                  Release latency (wake-up - release) and start jitter (|wake-up interval - period|) are recorded
+//                  on every release, execution and response time of the previous job before waiting.
+//                  Call from a service thread only
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void sequencer_wait_for_release(struct timespec *release_time)
+{
+    struct timespec wake_time;
+    unsigned long long wake_nsec, interval_nsec, period_nsec;
+    sequencer_service_t *service = this_service;
+
+    assert(service);
+
+    if(service->releases)
+    {
+        TRACE_EVENT(TRACE_EVENT_JOB, TRACE_END, service->releases);
+        complete_job(service);
+    }
+
+    while(sem_wait(&service->release_sem))
+    {
+        if(errno != EINTR) EXIT_FAIL("sem_wait");
+    }
+
+    if(clock_gettime(CLOCK_MONOTONIC, &wake_time)) EXIT_FAIL("clock_gettime");
+    service->job_release_nsec = __atomic_load_n(&service->release_nsec, __ATOMIC_ACQUIRE);
+    nsec_to_timespec(service->job_release_nsec, release_time);
+
+    //release latency
+    wake_nsec = ((unsigned long long)wake_time.tv_sec * NSEC_PER_SEC) + wake_time.tv_nsec;
+    histogram_record(&service->release_latency, (wake_nsec > service->job_release_nsec) ? (wake_nsec - service->job_release_nsec) : 0);
+
+    //start jitter
+    if(service->releases)
+    {
+        interval_nsec = wake_nsec - (((unsigned long long)service->last_wake_time.tv_sec * NSEC_PER_SEC) + service->last_wake_time.tv_nsec);
+        period_nsec = (unsigned long long)__atomic_load_n(&service->period_msec, __ATOMIC_RELAXED) * NSEC_PER_MSEC;
+        histogram_record(&service->start_jitter, (interval_nsec > period_nsec) ? (interval_nsec - period_nsec) : (period_nsec - interval_nsec));
+    }
+
+    service->last_wake_time = wake_time;
+    __atomic_store_n(&service->releases, service->releases + 1, __ATOMIC_RELAXED);
+
+    if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &service->job_cpu_start_time)) EXIT_FAIL("clock_gettime");
+
+    TRACE_EVENT(TRACE_EVENT_JOB, TRACE_BEGIN, service->releases);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  sequencer_release_on_tick
+//
+//  Parameters:     timer_counter_msec - application timer, in milli seconds
+//
+//  Return:         None
+//
+//  Description:    Releases the services due at this tick, called by timer_handler() in RELEASE_MODE_TIMER_TICK
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void sequencer_release_on_tick(const unsigned long long timer_counter_msec)
+{
+    unsigned int i;
+    unsigned long long now_nsec = 0;
+
+    for(i = 0; i < no_of_services; ++i)
+    {
+        if((timer_counter_msec % __atomic_load_n(&services[i].period_msec, __ATOMIC_RELAXED)) != services[i].offset_msec) continue;
+
+        if(!now_nsec) now_nsec = monotonic_time_in_nsec();
+        release_service(&services[i], now_nsec);
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  sequencer_hyperperiod_msec
+//
+//  Parameters:     None
+//
+//  Return:         LCM of the service periods, computed by sequencer_start()
+//
+//------------------------------------------------------------------------------------------------------------------------------
+unsigned int sequencer_hyperperiod_msec(void)
+{
+    return hyperperiod_msec;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  sequencer_check_schedulability
+//
+//  Parameters:     log_results - TRUE to log utilization, headroom and test results of every core
+//
+//  Return:         TRUE if the service set is schedulable with the measured WCETs, else FALSE
+//
+//  Description:    Liu & Layland bound, response-time analysis and EDF test on every core (see schedulability.c).
+//                  C is the max CPU time of a job measured so far, T the current period
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int sequencer_check_schedulability(const int log_results)
+{
+    int schedulable;
+
+    if(pthread_mutex_lock(&schedulability_mutex)) EXIT_FAIL("pthread_mutex_lock");
+    schedulable = analyze_services(-1, 0, log_results);
+    if(pthread_mutex_unlock(&schedulability_mutex)) EXIT_FAIL("pthread_mutex_unlock");
+
+    return schedulable;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  sequencer_set_service_period
+//
+//  Parameters:     service_idx - index returned by sequencer_register_service()
+//                  period_msec - new release period, greater than the service offset
+//
+//  Return:         SUCCESS, or ERROR if the service set would not be schedulable with the new period
+//
+//  Description:    Checks the service set with the new period first (measured WCETs), and refuses the change if
+//                  the response-time analysis fails on any core. A longer period is always accepted.
+//                  A SCHED_DEADLINE service gets a new reservation instead, refused by the kernel admission control
+//                  if it does not fit. Takes effect from the next release, priorities are not reassigned
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int sequencer_set_service_period(const int service_idx, const unsigned int period_msec)
+{
+    int rc = SUCCESS;
+    sequencer_service_t *service;
+
+    assert((service_idx >= 0) && ((unsigned int)service_idx < no_of_services));
+    service = &services[service_idx];
+    if(period_msec <= service->offset_msec)
+    {
+        errno = EINVAL;
+        return ERROR;
+    }
+
+    if(pthread_mutex_lock(&schedulability_mutex)) EXIT_FAIL("pthread_mutex_lock");
+
+    if(service->policy == SCHED_DEADLINE)
+    {
+        //kernel admission control decides
+        if(apply_sched_deadline(service, period_msec))
+        {
+            syslog(LOG_WARNING, " sequencer: %s period %u ms refused by SCHED_DEADLINE admission control", service->name, period_msec);
+            rc = ERROR;
+        }
+        else
+        {
+            __atomic_store_n(&service->period_msec, period_msec, __ATOMIC_RELAXED);
+            syslog(LOG_WARNING, " sequencer: %s period changed to %u ms", service->name, period_msec);
+        }
+    }
+    else if((period_msec < service->period_msec) && !analyze_services(service_idx, period_msec, FALSE))
+    {
+        syslog(LOG_WARNING, " sequencer: %s period %u ms refused, service set would not be schedulable", service->name, period_msec);
+        rc = ERROR;
+    }
+    else
+    {
+        __atomic_store_n(&service->period_msec, period_msec, __ATOMIC_RELAXED);
+        syslog(LOG_WARNING, " sequencer: %s period changed to %u ms", service->name, period_msec);
+        analyze_services(-1, 0, TRUE);
+    }
+
+    if(pthread_mutex_unlock(&schedulability_mutex)) EXIT_FAIL("pthread_mutex_unlock");
+
+    return rc;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  sequencer_get_service
+//
+//  Parameters:     service_idx - index returned by sequencer_register_service()
+//
+//  Return:         Service table entry, counters and distributions are final once the service has exited
+//
+//------------------------------------------------------------------------------------------------------------------------------
+const sequencer_service_t *sequencer_get_service(const int service_idx)
+{
+    assert((service_idx >= 0) && ((unsigned int)service_idx < no_of_services));
+
+    return &services[service_idx];
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  sequencer_report
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//  Description:    Prints and logs the release counters and latency distributions of every service.
+//                  Safe while the services are running (see histogram.h), not from a signal handler
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void sequencer_report(void)
+{
+    unsigned int i;
+
+    for(i = 0; i < no_of_services; ++i)
+    {
+        report_service(&services[i]);
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  sequencer_thread_handler
+//
+//  Parameters:     args - not used
+//
+//  Return:         None
+//
+//  Description:    Tickless releases. Sleeps until the earliest next release of any service with
+//                  clock_nanosleep(TIMER_ABSTIME), immune to wall clock (NTP) changes, then releases the services due.
+//                  Releases already more than a period late are skipped (counted), to avoid a burst of releases
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void *sequencer_thread_handler(void *args)
+{
+    int rc;
+    unsigned int i;
+    unsigned long long next_release_nsec, now_nsec, period_nsec;
+    struct timespec next_release;
+
+    trace_thread_register("sequencer_thread");
+
+    while(!__atomic_load_n(&stop_sequencer, __ATOMIC_ACQUIRE))
+    {
+        next_release_nsec = services[0].next_release_nsec;
+        for(i = 1; i < no_of_services; ++i)
+        {
+            if(services[i].next_release_nsec < next_release_nsec) next_release_nsec = services[i].next_release_nsec;
+        }
+
+        //sleep until the absolute release time
+        nsec_to_timespec(next_release_nsec, &next_release);
+        do
+        {
+            rc = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_release, NULL);
+        } while(rc == EINTR);
+        if(rc) EXIT_FAIL("clock_nanosleep");
+
+        now_nsec = monotonic_time_in_nsec();
+        for(i = 0; i < no_of_services; ++i)
+        {
+            if(services[i].next_release_nsec > now_nsec) continue;
+
+            release_service(&services[i], services[i].next_release_nsec);
+
+            //overran by more than a period, skip to the next release in the future
+            period_nsec = (unsigned long long)__atomic_load_n(&services[i].period_msec, __ATOMIC_RELAXED) * NSEC_PER_MSEC;
+            services[i].next_release_nsec += period_nsec;
+            while(services[i].next_release_nsec <= now_nsec)
+            {
+                services[i].next_release_nsec += period_nsec;
+                ++services[i].skipped_releases;
+            }
+        }
+    }
+
+    pthread_exit(NULL);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  stats_thread_handler
+//
+//  Parameters:     args - not used
+//
+//  Return:         None
+//
+//  Description:    Prints the service reports on every SEQUENCER_REPORT_SIGNAL (kill -USR1 <pid>).
+//                  The signal is blocked in every other thread (see main())
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void *stats_thread_handler(void *args)
+{
+    int signal_number;
+    sigset_t report_signal_set;
+
+    sigemptyset(&report_signal_set);
+    sigaddset(&report_signal_set, SEQUENCER_REPORT_SIGNAL);
+
+    while(1)
+    {
+        if(sigwait(&report_signal_set, &signal_number)) EXIT_FAIL("sigwait");
+        if(__atomic_load_n(&stop_stats_thread, __ATOMIC_ACQUIRE)) break;
+
+        sequencer_report();
+    }
+
+    pthread_exit(NULL);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  service_thread_handler
+//
+//  Parameters:     args - service of this thread
+//
+//  Return:         Return value of the service entry function
+//
+//  Description:    Binds the thread to its service, so sequencer_wait_for_release() finds it, and runs the service.
+//                  Lets sequencer_join() know once the service exits
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void *service_thread_handler(void *args)
+{
+    void *rc;
+
+    this_service = (sequencer_service_t *)args;
+    __atomic_store_n(&this_service->tid, get_thread_id(), __ATOMIC_RELEASE);
+    trace_thread_register(this_service->name);
+    rc = this_service->entry(this_service->entry_args);
+
+    __atomic_store_n(&this_service->exited, TRUE, __ATOMIC_RELEASE);
+    if(sem_post(&service_exited_sem)) EXIT_FAIL("sem_post");
+
+    return rc;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  release_service
+//
+//  Parameters:     service - service to release
+//                  release_nsec - CLOCK_MONOTONIC release time
+//
+//  Return:         None
+//
+//  Description:    Posts the service semaphore. A service which has not yet taken its previous release has overrun,
+//                  the release is skipped (counted) rather than queued
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void release_service(sequencer_service_t *service, const unsigned long long release_nsec)
+{
+    int pending;
+
+    if(sem_getvalue(&service->release_sem, &pending)) EXIT_FAIL("sem_getvalue");
+    if(pending > 0)
+    {
+        ++service->skipped_releases;
+        return;
+    }
+
+    __atomic_store_n(&service->release_nsec, release_nsec, __ATOMIC_RELEASE);
+    if(sem_post(&service->release_sem)) EXIT_FAIL("sem_post");
+
+    TRACE_EVENT(TRACE_EVENT_RELEASE, TRACE_INSTANT, service - services);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  complete_job
+//
+//  Parameters:     service - service of the calling thread
+//
+//  Return:         None
+//
+//  Description:    Accounts the job started at the last release: CPU time (C), response time, and a deadline miss if
+//                  the response time is greater than the period
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void complete_job(sequencer_service_t *service)
+{
+    struct timespec cpu_time;
+    unsigned long long exec_nsec, response_nsec;
+
+    if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time)) EXIT_FAIL("clock_gettime");
+    exec_nsec = ((unsigned long long)(cpu_time.tv_sec - service->job_cpu_start_time.tv_sec) * NSEC_PER_SEC) +
+                cpu_time.tv_nsec - service->job_cpu_start_time.tv_nsec;
+    response_nsec = monotonic_time_in_nsec() - service->job_release_nsec;
+
+    histogram_record(&service->execution_time, exec_nsec);
+    histogram_record(&service->response_time, response_nsec);
+    if(response_nsec > ((unsigned long long)__atomic_load_n(&service->period_msec, __ATOMIC_RELAXED) * NSEC_PER_MSEC))
+    {
+        __atomic_store_n(&service->missed_deadlines, service->missed_deadlines + 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  analyze_services
+//
+//  Parameters:     service_idx - service to analyze with a different period, -1 for none
+//                  period_msec - period of service_idx
+//                  log_results - TRUE to log the results
+//
+//  Return:         TRUE if schedulable, else FALSE
+//
+//  Description:    Builds the task set from the service table and the measured WCETs, and analyzes it.
+//                  Caller holds schedulability_mutex
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int analyze_services(const int service_idx, const unsigned int period_msec, const int log_results)
+{
+    unsigned int i;
+    sched_task_t tasks[MAX_SEQUENCER_SERVICES];
+
+    for(i = 0; i < no_of_services; ++i)
+    {
+        tasks[i].name = services[i].name;
+        tasks[i].wcet_msec = (double)histogram_max(&services[i].execution_time) / NSEC_PER_MSEC;
+        tasks[i].period_msec = ((int)i == service_idx) ? period_msec : __atomic_load_n(&services[i].period_msec, __ATOMIC_RELAXED);
+        tasks[i].priority = services[i].priority;
+        tasks[i].core = services[i].core;
+        tasks[i].response_time_msec = 0;
+    }
+
+    return schedulability_analysis(tasks, no_of_services, log_results);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  apply_sched_deadline
+//
+//  Parameters:     service - running service
+//                  period_msec - reservation period (= deadline)
+//
+//  Return:         SUCCESS, or ERROR if the kernel refused the reservation (errno is set)
+//
+//  Description:    Moves the service thread to SCHED_DEADLINE, runtime is the measured WCET plus
+//                  SCHED_DEADLINE_RUNTIME_MARGIN_PERCENT. A job overrunning its runtime (e.g. store_frames_thread on a
+//                  slow disk) is throttled by the kernel, instead of starving the other RT threads on the core.
+//                  The kernel accepts SCHED_DEADLINE only with an affinity spanning the whole root domain, so the
+//                  thread is unpinned first, and pinned back to its core if refused. Caller holds schedulability_mutex
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int apply_sched_deadline(sequencer_service_t *service, const unsigned int period_msec)
+{
+    int rc;
+    const pid_t tid = __atomic_load_n(&service->tid, __ATOMIC_ACQUIRE);
+    const unsigned long long period_nsec = (unsigned long long)period_msec * NSEC_PER_MSEC;
+    unsigned long long runtime_nsec;
+
+    runtime_nsec = histogram_max(&service->execution_time);
+    runtime_nsec += (runtime_nsec * SCHED_DEADLINE_RUNTIME_MARGIN_PERCENT) / 100;
+    if(runtime_nsec < ((unsigned long long)SCHED_DEADLINE_MIN_RUNTIME_IN_USEC * NSEC_PER_USEC))
+    {
+        runtime_nsec = (unsigned long long)SCHED_DEADLINE_MIN_RUNTIME_IN_USEC * NSEC_PER_USEC;
+    }
+    if(runtime_nsec > period_nsec) runtime_nsec = period_nsec;
+
+    //exited already
+    if(!tid || __atomic_load_n(&service->exited, __ATOMIC_ACQUIRE)) return ERROR;
+
+    if(service->policy != SCHED_DEADLINE) set_thread_cpu_affinity(tid, ALL_CORES);
+
+    rc = set_thread_sched_deadline(tid, runtime_nsec, period_nsec, period_nsec);
+    if(rc)
+    {
+        syslog(LOG_WARNING, " sequencer: %s SCHED_DEADLINE runtime %llu us, period %u ms refused (%s), staying on %s",
+               service->name, runtime_nsec / NSEC_PER_USEC, period_msec, strerror(errno),
+               (service->policy == SCHED_DEADLINE) ? "the current reservation" : "SCHED_FIFO");
+        if(service->policy != SCHED_DEADLINE) set_thread_cpu_affinity(tid, service->core);
+        return ERROR;
+    }
+
+    service->policy = SCHED_DEADLINE;
+    service->dl_runtime_nsec = runtime_nsec;
+    syslog(LOG_WARNING, " sequencer: %s on SCHED_DEADLINE, runtime %llu us, deadline = period %u ms",
+           service->name, runtime_nsec / NSEC_PER_USEC, period_msec);
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  assign_rm_priorities
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//  Description:    Services registered with SEQUENCER_RM_PRIORITY get rate-monotonic priorities, from
+//                  SERVICE_THREADS_PRIORITY down: shorter period, higher priority. Equal periods keep the registration order
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void assign_rm_priorities(void)
+{
+    unsigned int i, j;
+    int rm_priority[MAX_SEQUENCER_SERVICES];
+
+    for(i = 0; i < no_of_services; ++i)
+    {
+        rm_priority[i] = services[i].priority;
+        if(services[i].priority != SEQUENCER_RM_PRIORITY) continue;
+
+        rm_priority[i] = SERVICE_THREADS_PRIORITY;
+        for(j = 0; j < no_of_services; ++j)
+        {
+            if((services[j].priority == SEQUENCER_RM_PRIORITY) &&
+               ((services[j].period_msec < services[i].period_msec) ||
+                ((services[j].period_msec == services[i].period_msec) && (j < i))))
+            {
+                ++rm_priority[i];
+            }
+        }
+    }
+
+    for(i = 0; i < no_of_services; ++i)
+    {
+        services[i].priority = rm_priority[i];
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  report_service
+//
+//  Parameters:     service - service, may be running
+//
+//  Return:         None
+//
+//  Description:    Prints and logs the release counters, and the release latency, start jitter, execution time and
+//                  response time distributions
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void report_service(const sequencer_service_t *service)
+{
+    char policy[64];
+
+    if(service->policy == SCHED_DEADLINE)
+    {
+        snprintf(policy, sizeof(policy), "SCHED_DEADLINE runtime %.3lf ms", (double)service->dl_runtime_nsec / NSEC_PER_MSEC);
+    }
+    else
+    {
+        snprintf(policy, sizeof(policy), "SCHED_FIFO priority %d", service->sched_param.sched_priority);
+    }
+
+    fprintf(stdout, "\n\n++++++++++++++++++++++++++++++++++++++"
+                     "\n%s releases (%s, period %u ms, %s):"
+                     "\nreleases: %llu,"
+                     "\nskipped releases: %llu,"
+                     "\nmissed deadlines: %llu"
+                     "\n\n(ms)                count       mean        p50        p99      p99.9        max",
+                     service->name, (release_mode == RELEASE_MODE_TIMER_TICK) ? "timer tick" : "tickless",
+                     __atomic_load_n(&service->period_msec, __ATOMIC_RELAXED), policy,
+                     __atomic_load_n(&service->releases, __ATOMIC_RELAXED),
+                     __atomic_load_n(&service->skipped_releases, __ATOMIC_RELAXED),
+                     __atomic_load_n(&service->missed_deadlines, __ATOMIC_RELAXED));
+
+    syslog(LOG_WARNING, " %s (%s): releases %llu, skipped %llu, missed deadlines %llu",
+           service->name, policy, __atomic_load_n(&service->releases, __ATOMIC_RELAXED),
+           __atomic_load_n(&service->skipped_releases, __ATOMIC_RELAXED),
+           __atomic_load_n(&service->missed_deadlines, __ATOMIC_RELAXED));
+
+    histogram_print(stdout, &service->release_latency, "release latency");
+    histogram_print(stdout, &service->start_jitter, "start jitter");
+    histogram_print(stdout, &service->execution_time, "execution (CPU)");
+    histogram_print(stdout, &service->response_time, "response time");
+
+    fprintf(stdout, "\n++++++++++++++++++++++++++++++++++++++");
+    fflush(stdout);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  gcd
+//
+//  Parameters:     a, b - non zero values
+//
+//  Return:         greatest common divisor of a and b
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static unsigned int gcd(unsigned int a, unsigned int b)
+{
+    unsigned int remainder;
+
+    while(b)
+    {
+        remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+
+    return a;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  monotonic_time_in_nsec
+//
+//  Parameters:     None
+//
+//  Return:         CLOCK_MONOTONIC time in nano seconds
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static unsigned long long monotonic_time_in_nsec(void)
+{
+    struct timespec time;
+
+    if(clock_gettime(CLOCK_MONOTONIC, &time)) EXIT_FAIL("clock_gettime");
+
+    return ((unsigned long long)time.tv_sec * NSEC_PER_SEC) + time.tv_nsec;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  nsec_to_timespec
+//
+//  Parameters:     nsec - time in nano seconds
+//                  time - converted time
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void nsec_to_timespec(const unsigned long long nsec, struct timespec *time)
+{
+    time->tv_sec = nsec / NSEC_PER_SEC;
+    time->tv_nsec = nsec % NSEC_PER_SEC;
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
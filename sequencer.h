@@ -0,0 +1,108 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: sequencer.h
+//
+//  Description: Header file for sequencer.c
+//
+
+#ifndef _SEQUENCER_H
+#define _SEQUENCER_H
+
+#include "include.h"
+#include "histogram.h"
+#include <semaphore.h>
+#include <time.h>
+
+//release modes of the sequencer
+#define RELEASE_MODE_ABSOLUTE       (0) //tickless, sequencer thread sleeps with clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME)
+#define RELEASE_MODE_TIMER_TICK     (1) //APP_TIMER_INTERVAL_IN_MSEC timer_handler() tick releases the services
+
+//prints the service reports on demand
+#define SEQUENCER_REPORT_SIGNAL     (SIGUSR1)
+
+//max no.of registered services
+#define MAX_SEQUENCER_SERVICES      (8)
+
+//register with this priority to get a rate-monotonic priority assigned (shorter period, higher priority)
+#define SEQUENCER_RM_PRIORITY       (-1)
+
+//delay from sequencer_start() to the first release
+#define FIRST_RELEASE_DELAY_IN_MSEC (100)
+
+//scheduling policy of the services
+#define SCHED_POLICY_FIFO           (0) //SCHED_FIFO, RM priorities
+#define SCHED_POLICY_DEADLINE       (1) //SCHED_FIFO during the warm-up, then SCHED_DEADLINE from the measured WCET
+
+//SCHED_DEADLINE runtime, WCET plus margin, at least the min runtime, at most the period
+#define SCHED_DEADLINE_RUNTIME_MARGIN_PERCENT   (50)
+#define SCHED_DEADLINE_MIN_RUNTIME_IN_USEC      (500)
+
+//schedulability analysis of the measured service set, once the warm-up is over
+#define DEFAULT_SCHEDULABILITY_WARMUP_IN_SEC    (5)
+#define MAX_SCHEDULABILITY_WARMUP_IN_SEC        (60)
+
+//service thread handler
+typedef void *(*service_entry_t)(void *);
+
+//periodic service, registered with sequencer_register_service()
+typedef struct
+{
+    //registered
+    const char *name;
+    unsigned int period_msec;           //atomic, can be changed with sequencer_set_service_period()
+    unsigned int offset_msec;           //release phase, relative to the common first release
+    int priority;                       //relative (see include.h), or SEQUENCER_RM_PRIORITY
+    int core;
+    service_entry_t entry;
+    void *entry_args;
+
+    //set up by sequencer_start()
+    pthread_t thread;
+    pid_t tid;                          //kernel thread id, atomic
+    int exited;                         //TRUE once the service returned, atomic
+    int policy;                         //SCHED_FIFO or SCHED_DEADLINE
+    unsigned long long dl_runtime_nsec; //SCHED_DEADLINE runtime
+    pthread_attr_t thread_attr;
+    struct sched_param sched_param;
+    sem_t release_sem;                  //posted once per release
+    unsigned long long next_release_nsec; //CLOCK_MONOTONIC, used by the tickless sequencer thread only
+    unsigned long long release_nsec;    //CLOCK_MONOTONIC release handed to the service, atomic
+
+    //release side (sequencer thread or timer_handler)
+    unsigned long long skipped_releases; //service still had a pending release
+
+    //service side
+    struct timespec last_wake_time;
+    unsigned long long releases;
+
+    //jobs, a job runs from a release until the next sequencer_wait_for_release() call
+    unsigned long long job_release_nsec; //release of the running job
+    struct timespec job_cpu_start_time; //CLOCK_THREAD_CPUTIME_ID at the release
+    unsigned long long missed_deadlines; //response time greater than the period
+
+    //distributions, recorded by the service thread
+    histogram_t release_latency;        //wake-up time - release time
+    histogram_t start_jitter;           //|wake-up interval - period|
+    histogram_t execution_time;         //CPU time of a job, max is the WCET (C)
+    histogram_t response_time;          //job completion - release time
+}sequencer_service_t;
+
+//APIs
+int sequencer_register_service(const char *name, const unsigned int period_msec, const unsigned int offset_msec,
+                               const int priority, const int core, service_entry_t entry, void *entry_args);
+void sequencer_start(const int core);
+void sequencer_join(void);
+void sequencer_wait_for_release(struct timespec *release_time);
+void sequencer_release_on_tick(const unsigned long long timer_counter_msec);
+unsigned int sequencer_hyperperiod_msec(void);
+int sequencer_check_schedulability(const int log_results);
+int sequencer_set_service_period(const int service_idx, const unsigned int period_msec);
+const sequencer_service_t *sequencer_get_service(const int service_idx);
+void sequencer_report(void);
+
+#endif //_SEQUENCER_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,454 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: tile_delta.c
+//
+//  Description: Temporal delta frames (-o 2). Frames are split into 32x32 pixel tiles. A keyframe stores every tile,
+//               the frames in between store only the tiles that differ from the frame stored before, as the byte
+//               difference to it, so small changes inside a tile deflate to almost nothing. Lossless: a reader
+//               rebuilds any frame from the keyframe before it, applying the delta frames in order (frame_reader.c).
+//               The encoder keeps the previous frame the way a reader rebuilds it, and the zlib stream is reset
+//               for every frame instead of allocated
+//
+
+#include "include.h"
+#include "tile_delta.h"
+
+//local functions
+static void encode_keyframe(tile_delta_t *delta, const frame_t *frame);
+static size_t encode_changed_tiles(tile_delta_t *delta, const frame_t *frame, unsigned char *bitmap, unsigned int *changed_tiles);
+static int decode_keyframe(const tile_delta_header_t *header, const unsigned char *payload, unsigned char *pixels);
+static int decode_changed_tiles(const tile_delta_header_t *header, const unsigned char *bitmap, const unsigned char *payload,
+                                unsigned char *pixels);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  tile_delta_init
+//
+//  Parameters:     delta - encoder to initialize
+//                  width, height - frame resolution
+//                  keyframe_interval - a keyframe every n frames, MIN/MAX_TILE_DELTA_KEYFRAME_INTERVAL
+//                  level - deflate level, 1 to 9
+//
+//  Return:         None
+//
+//  Description:    Allocates the previous frame, payload and output buffers, and the deflate state (outside the RT
+//                  loops, locked by mlockall). Exits the application on failure
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void tile_delta_init(tile_delta_t *delta, const unsigned int width, const unsigned int height, const unsigned int keyframe_interval,
+                     const int level)
+{
+    const size_t frame_size = (size_t)width * height * 3;
+
+    memset(delta, 0, sizeof(*delta));
+    if(!frame_size)
+    {
+        errno = EINVAL;
+        EXIT_FAIL("tile_delta_init");
+    }
+
+    delta->width = width;
+    delta->height = height;
+    delta->cols = (width + TILE_DELTA_TILE_SIZE - 1) / TILE_DELTA_TILE_SIZE;
+    delta->rows = (height + TILE_DELTA_TILE_SIZE - 1) / TILE_DELTA_TILE_SIZE;
+    delta->no_of_tiles = delta->cols * delta->rows;
+    delta->keyframe_interval = keyframe_interval;
+
+    if(deflateInit(&delta->stream, level) != Z_OK)
+    {
+        errno = ENOMEM;
+        EXIT_FAIL("deflateInit");
+    }
+
+    //worst case: every tile changed, and the payload does not deflate
+    delta->output_capacity = sizeof(tile_delta_header_t) + ((delta->no_of_tiles + 7) / 8) + deflateBound(&delta->stream, frame_size);
+    delta->reference = (unsigned char *)malloc(frame_size);
+    delta->payload = (unsigned char *)malloc(frame_size);
+    delta->output = (unsigned char *)malloc(delta->output_capacity);
+    if(!delta->reference || !delta->payload || !delta->output) EXIT_FAIL("malloc");
+
+    syslog(LOG_WARNING, " delta frames: %ux%u tiles of %u pixels, keyframe every %u frames, deflate level %d",
+           delta->cols, delta->rows, TILE_DELTA_TILE_SIZE, keyframe_interval, level);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  tile_delta_encode
+//
+//  Parameters:     delta - initialized encoder
+//                  frame - BGR frame to store, resolution given to tile_delta_init()
+//                  frame_no - store frame counter, frames are numbered in store order
+//
+//  Return:         Size of the delta frame in delta->output, 0 on a deflate error
+//
+//  Description:    Keyframe for the first frame and every keyframe_interval frames, else the changed tiles. The
+//                  frame becomes the previous frame of the next one, so every encoded frame must be stored
+//
+//------------------------------------------------------------------------------------------------------------------------------
+size_t tile_delta_encode(tile_delta_t *delta, const frame_t *frame, const unsigned int frame_no)
+{
+    tile_delta_header_t *header = (tile_delta_header_t *)delta->output;
+    unsigned char *bitmap = delta->output + sizeof(*header);
+    unsigned char *stream_data;
+    unsigned int changed_tiles;
+    size_t payload_size;
+
+    memset(header, 0, sizeof(*header));
+    header->magic = TILE_DELTA_MAGIC;
+    header->tile_size = TILE_DELTA_TILE_SIZE;
+    header->width = delta->width;
+    header->height = delta->height;
+    header->frame_no = frame_no;
+    header->wall_usec = ((uint64_t)frame->wall_time.tv_sec * USEC_PER_SEC) + frame->wall_time.tv_usec;
+
+    if(!delta->have_reference || (delta->frames_since_keyframe >= delta->keyframe_interval))
+    {
+        encode_keyframe(delta, frame);
+        payload_size = (size_t)delta->width * delta->height * 3;
+        changed_tiles = delta->no_of_tiles;
+        header->type = TILE_DELTA_KEYFRAME;
+        header->reference_no = frame_no;
+        delta->keyframe_no = frame_no;
+        delta->frames_since_keyframe = 0;
+        delta->have_reference = TRUE;
+        stream_data = bitmap;
+        ++delta->keyframes;
+    }
+    else
+    {
+        memset(bitmap, 0, (delta->no_of_tiles + 7) / 8);
+        payload_size = encode_changed_tiles(delta, frame, bitmap, &changed_tiles);
+        header->type = TILE_DELTA_DELTA;
+        header->reference_no = delta->reference_no;
+        stream_data = bitmap + ((delta->no_of_tiles + 7) / 8);
+        delta->tiles_changed += changed_tiles;
+        ++delta->delta_frames;
+    }
+
+    header->keyframe_no = delta->keyframe_no;
+    header->changed_tiles = changed_tiles;
+    header->payload_size = payload_size;
+    delta->reference_no = frame_no;
+    ++delta->frames_since_keyframe;
+
+    //unchanged frame, header and bitmap only
+    if(payload_size)
+    {
+        if(deflateReset(&delta->stream) != Z_OK) return 0;
+        delta->stream.next_in = delta->payload;
+        delta->stream.avail_in = payload_size;
+        delta->stream.next_out = stream_data;
+        delta->stream.avail_out = delta->output_capacity - (stream_data - delta->output);
+        if(deflate(&delta->stream, Z_FINISH) != Z_STREAM_END) return 0;
+        header->compressed_size = delta->stream.total_out;
+    }
+
+    delta->bytes_in += (size_t)delta->width * delta->height * 3;
+    delta->bytes_out += (stream_data - delta->output) + header->compressed_size;
+
+    return (stream_data - delta->output) + header->compressed_size;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  tile_delta_report
+//
+//  Parameters:     delta - encoder
+//
+//  Return:         None
+//
+//  Description:    Prints and logs the frame counters and the compression ratio
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void tile_delta_report(const tile_delta_t *delta)
+{
+    fprintf(stdout, "\n\n--------------------------------------"
+                     "\ndelta frame results:"
+                     "\nkeyframes: %llu,"
+                     "\ndelta frames: %llu, %.1f of %u tiles changed on average,"
+                     "\nraw: %llu bytes, stored: %llu bytes (%.1f:1)"
+                     "\n--------------------------------------",
+                     delta->keyframes, delta->delta_frames,
+                     delta->delta_frames ? ((double)delta->tiles_changed / delta->delta_frames) : 0.0, delta->no_of_tiles,
+                     delta->bytes_in, delta->bytes_out, delta->bytes_out ? ((double)delta->bytes_in / delta->bytes_out) : 0.0);
+
+    syslog(LOG_WARNING, " delta frames: keyframes %llu, delta frames %llu, tiles changed %llu, raw %llu bytes, stored %llu bytes",
+           delta->keyframes, delta->delta_frames, delta->tiles_changed, delta->bytes_in, delta->bytes_out);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  tile_delta_destroy
+//
+//  Parameters:     delta - encoder
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void tile_delta_destroy(tile_delta_t *delta)
+{
+    deflateEnd(&delta->stream);
+    free(delta->reference);
+    free(delta->payload);
+    free(delta->output);
+    delta->reference = NULL;
+    delta->payload = NULL;
+    delta->output = NULL;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  tile_delta_read_header
+//
+//  Parameters:     data, size - delta frame
+//                  header - set to the frame header
+//
+//  Return:         SUCCESS, or ERROR if data is no delta frame, or is cut short
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int tile_delta_read_header(const void *data, const size_t size, tile_delta_header_t *header)
+{
+    size_t bitmap_size;
+
+    if(size < sizeof(*header)) return ERROR;
+    memcpy(header, data, sizeof(*header));
+
+    if((header->magic != TILE_DELTA_MAGIC) || !header->width || !header->height || !header->tile_size ||
+       (header->type > TILE_DELTA_DELTA) || (header->payload_size > ((size_t)header->width * header->height * 3)))
+    {
+        return ERROR;
+    }
+
+    bitmap_size = 0;
+    if(header->type == TILE_DELTA_DELTA)
+    {
+        bitmap_size = ((((size_t)header->width + header->tile_size - 1) / header->tile_size) *
+                       ((header->height + header->tile_size - 1) / header->tile_size) + 7) / 8;
+    }
+
+    return (sizeof(*header) + bitmap_size + header->compressed_size > size) ? ERROR : SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  tile_delta_decode
+//
+//  Parameters:     data, size - delta frame
+//                  pixels - BGR frame, width * 3 step. Keyframes overwrite it, delta frames are applied to it, so
+//                           it must hold the frame reference_no
+//                  payload - width * height * 3 bytes, inflated payload
+//
+//  Return:         SUCCESS, or ERROR on a damaged frame
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int tile_delta_decode(const void *data, const size_t size, unsigned char *pixels, unsigned char *payload)
+{
+    const unsigned char *bitmap = (const unsigned char *)data + sizeof(tile_delta_header_t);
+    const unsigned char *stream_data = bitmap;
+    tile_delta_header_t header;
+    uLongf payload_size;
+
+    if(tile_delta_read_header(data, size, &header)) return ERROR;
+
+    if(header.type == TILE_DELTA_DELTA)
+    {
+        stream_data += ((((size_t)header.width + header.tile_size - 1) / header.tile_size) *
+                        ((header.height + header.tile_size - 1) / header.tile_size) + 7) / 8;
+    }
+
+    if(header.payload_size)
+    {
+        payload_size = header.payload_size;
+        if((uncompress(payload, &payload_size, stream_data, header.compressed_size) != Z_OK) || (payload_size != header.payload_size))
+        {
+            return ERROR;
+        }
+    }
+
+    return (header.type == TILE_DELTA_KEYFRAME) ? decode_keyframe(&header, payload, pixels) :
+                                                  decode_changed_tiles(&header, bitmap, payload, pixels);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  encode_keyframe
+//
+//  Parameters:     delta - encoder
+//                  frame - BGR frame
+//
+//  Return:         None
+//
+//  Description:    Left neighbour filtered rows to the payload, and the frame to the previous frame buffer
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void encode_keyframe(tile_delta_t *delta, const frame_t *frame)
+{
+    const size_t row_bytes = (size_t)delta->width * 3;
+    const unsigned char *pixels;
+    unsigned char *payload = delta->payload;
+    unsigned int row;
+    size_t i;
+
+    for(row = 0; row < delta->height; ++row, payload += row_bytes)
+    {
+        pixels = frame->data + ((size_t)row * frame->step);
+        memcpy(delta->reference + (row * row_bytes), pixels, row_bytes);
+
+        payload[0] = pixels[0];
+        payload[1] = pixels[1];
+        payload[2] = pixels[2];
+        for(i = 3; i < row_bytes; ++i)
+        {
+            payload[i] = pixels[i] - pixels[i - 3];
+        }
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  encode_changed_tiles
+//
+//  Parameters:     delta - encoder, reference holds the previous frame
+//                  frame - BGR frame
+//                  bitmap - zeroed, bits of the changed tiles are set
+//                  changed_tiles - set to the no.of changed tiles
+//
+//  Return:         Payload size
+//
+//  Description:    A tile changed if any of its rows differs from the previous frame. Rows of the changed tiles go to
+//                  the payload as the byte difference, and are copied to the previous frame buffer
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static size_t encode_changed_tiles(tile_delta_t *delta, const frame_t *frame, unsigned char *bitmap, unsigned int *changed_tiles)
+{
+    const size_t row_bytes = (size_t)delta->width * 3;
+    unsigned char *payload = delta->payload;
+    const unsigned char *pixels;
+    unsigned char *reference;
+    unsigned int tile_row, tile_col, tile = 0, row, first_row, tile_height;
+    size_t x, tile_bytes, i;
+
+    *changed_tiles = 0;
+
+    for(tile_row = 0; tile_row < delta->rows; ++tile_row)
+    {
+        first_row = tile_row * TILE_DELTA_TILE_SIZE;
+        tile_height = ((delta->height - first_row) < TILE_DELTA_TILE_SIZE) ? (delta->height - first_row) : TILE_DELTA_TILE_SIZE;
+
+        for(tile_col = 0; tile_col < delta->cols; ++tile_col, ++tile)
+        {
+            x = (size_t)tile_col * TILE_DELTA_TILE_SIZE * 3;
+            tile_bytes = ((row_bytes - x) < (TILE_DELTA_TILE_SIZE * 3)) ? (row_bytes - x) : (TILE_DELTA_TILE_SIZE * 3);
+
+            for(row = first_row; row < (first_row + tile_height); ++row)
+            {
+                if(memcmp(frame->data + ((size_t)row * frame->step) + x, delta->reference + (row * row_bytes) + x, tile_bytes)) break;
+            }
+            if(row == (first_row + tile_height)) continue;
+
+            bitmap[tile / 8] |= (1 << (tile % 8));
+            ++*changed_tiles;
+
+            for(row = first_row; row < (first_row + tile_height); ++row, payload += tile_bytes)
+            {
+                pixels = frame->data + ((size_t)row * frame->step) + x;
+                reference = delta->reference + (row * row_bytes) + x;
+                for(i = 0; i < tile_bytes; ++i)
+                {
+                    payload[i] = pixels[i] - reference[i];
+                    reference[i] = pixels[i];
+                }
+            }
+        }
+    }
+
+    return payload - delta->payload;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  decode_keyframe
+//
+//  Parameters:     header - keyframe header
+//                  payload - inflated payload
+//                  pixels - BGR frame, width * 3 step
+//
+//  Return:         SUCCESS/ERROR
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int decode_keyframe(const tile_delta_header_t *header, const unsigned char *payload, unsigned char *pixels)
+{
+    const size_t row_bytes = (size_t)header->width * 3;
+    unsigned int row;
+    size_t i;
+
+    if(header->payload_size != (row_bytes * header->height)) return ERROR;
+
+    for(row = 0; row < header->height; ++row, payload += row_bytes, pixels += row_bytes)
+    {
+        pixels[0] = payload[0];
+        pixels[1] = payload[1];
+        pixels[2] = payload[2];
+        for(i = 3; i < row_bytes; ++i)
+        {
+            pixels[i] = payload[i] + pixels[i - 3];
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  decode_changed_tiles
+//
+//  Parameters:     header - delta frame header
+//                  bitmap - changed tiles
+//                  payload - inflated payload
+//                  pixels - BGR frame reference_no, width * 3 step, updated to this frame
+//
+//  Return:         SUCCESS, or ERROR if the payload does not match the bitmap
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int decode_changed_tiles(const tile_delta_header_t *header, const unsigned char *bitmap, const unsigned char *payload,
+                                unsigned char *pixels)
+{
+    const size_t row_bytes = (size_t)header->width * 3;
+    const unsigned int tile_size = header->tile_size;
+    const unsigned int cols = (header->width + tile_size - 1) / tile_size;
+    const unsigned int rows = (header->height + tile_size - 1) / tile_size;
+    const unsigned char *payload_end = payload + header->payload_size;
+    unsigned char *reference;
+    unsigned int tile_row, tile_col, tile = 0, row, first_row, tile_height;
+    size_t x, tile_bytes, i;
+
+    for(tile_row = 0; tile_row < rows; ++tile_row)
+    {
+        first_row = tile_row * tile_size;
+        tile_height = ((header->height - first_row) < tile_size) ? (header->height - first_row) : tile_size;
+
+        for(tile_col = 0; tile_col < cols; ++tile_col, ++tile)
+        {
+            if(!(bitmap[tile / 8] & (1 << (tile % 8)))) continue;
+
+            x = (size_t)tile_col * tile_size * 3;
+            tile_bytes = ((row_bytes - x) < ((size_t)tile_size * 3)) ? (row_bytes - x) : ((size_t)tile_size * 3);
+            if((size_t)(payload_end - payload) < (tile_bytes * tile_height)) return ERROR;
+
+            for(row = first_row; row < (first_row + tile_height); ++row, payload += tile_bytes)
+            {
+                reference = pixels + (row * row_bytes) + x;
+                for(i = 0; i < tile_bytes; ++i)
+                {
+                    reference[i] += payload[i];
+                }
+            }
+        }
+    }
+
+    return (payload == payload_end) ? SUCCESS : ERROR;
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,91 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: tile_delta.h
+//
+//  Description: Header file for tile_delta.c, and the delta frame format (.rtd)
+//
+
+#ifndef _TILE_DELTA_H
+#define _TILE_DELTA_H
+
+#include "include.h"
+#include "frame_ring.h"
+#include <stdint.h>
+#include <zlib.h>
+
+//frames are compared in tiles of TILE_SIZE x TILE_SIZE pixels, partial tiles at the right and bottom edges
+#define TILE_DELTA_TILE_SIZE                    (32)
+
+#define TILE_DELTA_MAGIC                        (0x31544C44) //"DLT1"
+
+//a keyframe (every tile) is stored every n frames (-K), the frames in between store their changed tiles only
+#define DEFAULT_TILE_DELTA_KEYFRAME_INTERVAL    (30)
+#define MIN_TILE_DELTA_KEYFRAME_INTERVAL        (1)
+#define MAX_TILE_DELTA_KEYFRAME_INTERVAL        (1000)
+
+//tile_delta_header_t types
+#define TILE_DELTA_KEYFRAME                     (0)
+#define TILE_DELTA_DELTA                        (1)
+
+//first bytes of a delta frame, 48 bytes. Followed by
+//  delta frames: changed tile bitmap, one bit per tile in raster order, (no_of_tiles + 7) / 8 bytes
+//  deflate (zlib) stream of the payload, compressed_size bytes, none if the payload is empty
+//payload
+//  keyframes: BGR rows, every byte less the byte one pixel to the left (left neighbour filter)
+//  delta frames: rows of the changed tiles in raster order, every byte less the byte of the previous frame
+typedef struct
+{
+    uint32_t magic;                 //TILE_DELTA_MAGIC
+    uint16_t type;                  //TILE_DELTA_KEYFRAME or TILE_DELTA_DELTA
+    uint16_t tile_size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frame_no;
+    uint32_t reference_no;          //delta frames: frame the tiles are applied to, the one stored before
+    uint32_t keyframe_no;           //keyframe the frame is rebuilt from, its own frame_no for a keyframe
+    uint32_t changed_tiles;
+    uint32_t payload_size;          //before deflate
+    uint32_t compressed_size;
+    uint64_t wall_usec;             //capture time, wall clock, micro seconds since the epoch
+}tile_delta_header_t;
+
+//encoder, the previous frame as rebuilt by a reader and the buffers of one delta frame
+typedef struct
+{
+    unsigned int width;
+    unsigned int height;
+    unsigned int cols;                      //tiles
+    unsigned int rows;
+    unsigned int no_of_tiles;
+    unsigned int keyframe_interval;
+    unsigned char *reference;               //previous frame, BGR, width * 3 step
+    unsigned char *payload;                 //before deflate, frame sized
+    unsigned char *output;                  //delta frame: header, bitmap and deflate stream
+    size_t output_capacity;
+    z_stream stream;                        //reset for every frame, nothing is allocated per frame
+    int have_reference;
+    unsigned int reference_no;
+    unsigned int keyframe_no;
+    unsigned int frames_since_keyframe;
+    unsigned long long keyframes;
+    unsigned long long delta_frames;
+    unsigned long long tiles_changed;       //delta frames
+    unsigned long long bytes_in;            //raw BGR
+    unsigned long long bytes_out;
+}tile_delta_t;
+
+//APIs
+void tile_delta_init(tile_delta_t *delta, const unsigned int width, const unsigned int height, const unsigned int keyframe_interval,
+                     const int level);
+size_t tile_delta_encode(tile_delta_t *delta, const frame_t *frame, const unsigned int frame_no);
+void tile_delta_report(const tile_delta_t *delta);
+void tile_delta_destroy(tile_delta_t *delta);
+int tile_delta_read_header(const void *data, const size_t size, tile_delta_header_t *header);
+int tile_delta_decode(const void *data, const size_t size, unsigned char *pixels, unsigned char *payload);
+
+#endif //_TILE_DELTA_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
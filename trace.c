@@ -0,0 +1,250 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: trace.c
+//
+//  Description: Low overhead event tracing. Every traced thread records begin/end/instant events in its own lock-free
+//               ring (see trace_event() in trace.h), a normal priority drain thread writes them to a binary trace file.
+//               trace_export converts the file to Chrome trace / Perfetto JSON (chrome://tracing, ui.perfetto.dev)
+//
+
+#include "include.h"
+#include "trace.h"
+
+//event names, indexed by the TRACE_EVENT_xxx ids
+static const char *trace_event_names[TRACE_EVENTS] =
+{
+    "release",
+    "job",
+    "grab",
+    "publish",
+    "display",
+    "claim",
+    "no frame",
+    "encode",
+    "write",
+    "snapshot",
+    "detect",
+    "unchanged",
+    "shm publish",
+    "frame gap",
+    "stored"
+};
+
+//rings, preallocated (locked by mlockall), handed out by trace_thread_register()
+static trace_ring_t trace_rings[MAX_TRACE_THREADS];
+static int trace_ring_registered[MAX_TRACE_THREADS];
+static unsigned int no_of_trace_rings = 0;
+
+__thread trace_ring_t *this_trace_ring = NULL;
+int trace_enabled = FALSE;
+
+//drain thread
+static pthread_t trace_drain_thread;
+static int stop_trace_drain = FALSE;
+static FILE *trace_file = NULL;
+
+//local functions
+static void *trace_drain_thread_handler(void *args);
+static unsigned long long drain_rings(int *thread_record_written);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  trace_thread_register
+//
+//  Parameters:     name - thread name, shown on the timeline
+//
+//  Return:         None
+//
+//  Description:    Gives the calling thread its own event ring. Unregistered threads record nothing.
+//                  Threads beyond MAX_TRACE_THREADS are not traced
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void trace_thread_register(const char *name)
+{
+    unsigned int idx;
+    trace_ring_t *ring;
+
+    if(this_trace_ring) return;
+
+    idx = __atomic_fetch_add(&no_of_trace_rings, 1, __ATOMIC_RELAXED);
+    if(idx >= MAX_TRACE_THREADS)
+    {
+        syslog(LOG_WARNING, " trace: no ring left for %s, not traced", name);
+        return;
+    }
+
+    ring = &trace_rings[idx];
+    ring->tid = (uint32_t)get_thread_id();
+    strncpy(ring->name, name, TRACE_NAME_SIZE - 1);
+    this_trace_ring = ring;
+
+    //drain thread picks it up from here
+    __atomic_store_n(&trace_ring_registered[idx], TRUE, __ATOMIC_RELEASE);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  trace_start
+//
+//  Parameters:     file_name - binary trace file, overwritten
+//
+//  Return:         None
+//
+//  Description:    Writes the trace file header and the event names, starts the drain thread, and enables recording
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void trace_start(const char *file_name)
+{
+    unsigned int i;
+    trace_file_header_t header;
+    char name[TRACE_NAME_SIZE];
+    pthread_attr_t trace_drain_thread_attr;
+
+    trace_file = fopen(file_name, "wb");
+    if(!trace_file) EXIT_FAIL("fopen");
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+    header.no_of_event_names = TRACE_EVENTS;
+    header.name_size = TRACE_NAME_SIZE;
+    if(fwrite(&header, sizeof(header), 1, trace_file) != 1) EXIT_FAIL("fwrite");
+
+    for(i = 0; i < TRACE_EVENTS; ++i)
+    {
+        memset(name, 0, sizeof(name));
+        strncpy(name, trace_event_names[i], TRACE_NAME_SIZE - 1);
+        if(fwrite(name, sizeof(name), 1, trace_file) != 1) EXIT_FAIL("fwrite");
+    }
+
+    //normal (non RT) thread, drains in the slack of the RT threads. Called from the dispatcher, so the policy and core
+    //are set explicitly instead of inherited
+    assign_normal_schedular_attr(&trace_drain_thread_attr, ALL_CORES);
+    if(pthread_create(&trace_drain_thread, &trace_drain_thread_attr, trace_drain_thread_handler, NULL)) EXIT_FAIL("pthread_create");
+    pthread_attr_destroy(&trace_drain_thread_attr);
+
+    __atomic_store_n(&trace_enabled, TRUE, __ATOMIC_RELEASE);
+    syslog(LOG_WARNING, " trace: recording to %s", file_name);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  trace_stop
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//  Description:    Disables recording, drains the rings one last time, closes the trace file, and logs the dropped events
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void trace_stop(void)
+{
+    unsigned int i, no_of_rings;
+    unsigned long long dropped;
+
+    if(!trace_file) return;
+
+    __atomic_store_n(&trace_enabled, FALSE, __ATOMIC_RELEASE);
+    __atomic_store_n(&stop_trace_drain, TRUE, __ATOMIC_RELEASE);
+    pthread_join(trace_drain_thread, NULL);
+
+    if(fclose(trace_file)) EXIT_FAIL("fclose");
+    trace_file = NULL;
+
+    no_of_rings = __atomic_load_n(&no_of_trace_rings, __ATOMIC_RELAXED);
+    if(no_of_rings > MAX_TRACE_THREADS) no_of_rings = MAX_TRACE_THREADS;
+    for(i = 0; i < no_of_rings; ++i)
+    {
+        dropped = __atomic_load_n(&trace_rings[i].dropped, __ATOMIC_RELAXED);
+        if(dropped) syslog(LOG_WARNING, " trace: %s dropped %llu events, ring full", trace_rings[i].name, dropped);
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  trace_drain_thread_handler
+//
+//  Parameters:     args - not used
+//
+//  Return:         None
+//
+//  Description:    Writes the recorded events to the trace file every TRACE_DRAIN_INTERVAL_IN_MSEC, until trace_stop()
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void *trace_drain_thread_handler(void *args)
+{
+    int stop;
+    int thread_record_written[MAX_TRACE_THREADS] = {FALSE};
+    unsigned long long no_of_events = 0;
+    struct timespec interval;
+
+    interval.tv_sec = TRACE_DRAIN_INTERVAL_IN_MSEC / MSEC_PER_SEC;
+    interval.tv_nsec = (TRACE_DRAIN_INTERVAL_IN_MSEC % MSEC_PER_SEC) * NSEC_PER_MSEC;
+
+    do
+    {
+        stop = __atomic_load_n(&stop_trace_drain, __ATOMIC_ACQUIRE);
+        no_of_events += drain_rings(thread_record_written);
+        if(!stop) nanosleep(&interval, NULL);
+    } while(!stop);
+
+    syslog(LOG_WARNING, " trace: %llu events written", no_of_events);
+
+    pthread_exit(NULL);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  drain_rings
+//
+//  Parameters:     thread_record_written - per ring, TRUE once its thread record is in the file
+//
+//  Return:         No.of events written
+//
+//  Description:    Moves the events of every registered ring to the trace file, a thread record ahead of the first
+//                  events of every thread. Only consumer of the rings
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static unsigned long long drain_rings(int *thread_record_written)
+{
+    unsigned int i, no_of_rings;
+    unsigned long long head, tail, written = 0;
+    trace_ring_t *ring;
+    trace_thread_record_t thread_record;
+
+    no_of_rings = __atomic_load_n(&no_of_trace_rings, __ATOMIC_RELAXED);
+    if(no_of_rings > MAX_TRACE_THREADS) no_of_rings = MAX_TRACE_THREADS;
+
+    for(i = 0; i < no_of_rings; ++i)
+    {
+        if(!__atomic_load_n(&trace_ring_registered[i], __ATOMIC_ACQUIRE)) continue;
+        ring = &trace_rings[i];
+
+        if(!thread_record_written[i])
+        {
+            memset(&thread_record, 0, sizeof(thread_record));
+            thread_record.record_type = TRACE_RECORD_THREAD;
+            thread_record.tid = ring->tid;
+            memcpy(thread_record.name, ring->name, TRACE_NAME_SIZE);
+            if(fwrite(&thread_record, sizeof(thread_record), 1, trace_file) != 1) EXIT_FAIL("fwrite");
+            thread_record_written[i] = TRUE;
+        }
+
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        tail = ring->tail;
+        for(; tail != head; ++tail)
+        {
+            if(fwrite(&ring->events[tail & (TRACE_RING_EVENTS - 1)], sizeof(trace_event_t), 1, trace_file) != 1) EXIT_FAIL("fwrite");
+            ++written;
+        }
+
+        //slots free for the producer again
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+
+    return written;
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
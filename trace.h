@@ -0,0 +1,153 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: trace.h
+//
+//  Description: Header file for trace.c
+//
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "include.h"
+#include <stdint.h>
+
+//default trace file, convert with "./trace_export rt_trace.bin rt_trace.json"
+#define TRACE_FILE_NAME             "rt_trace.bin"
+#define TRACE_FILE_MAGIC            "RTTRACE1"
+
+//per thread ring, power of 2
+#define TRACE_RING_EVENTS           (4096)
+#define MAX_TRACE_THREADS           (16)
+#define TRACE_NAME_SIZE             (32)
+
+//drain thread period
+#define TRACE_DRAIN_INTERVAL_IN_MSEC    (100)
+
+//event phases, as in the Chrome trace event format
+#define TRACE_BEGIN                 ('B')
+#define TRACE_END                   ('E')
+#define TRACE_INSTANT               ('i')
+
+//event ids, names in trace_event_names[] (trace.c)
+#define TRACE_EVENT_RELEASE         (0) //sequencer released a service, arg: service index
+#define TRACE_EVENT_JOB             (1) //service job, release to next wait, arg: release no.
+#define TRACE_EVENT_GRAB            (2) //frame grab/dequeue and conversion, arg: frame no.
+#define TRACE_EVENT_PUBLISH         (3) //frame published to the ring, arg: ring sequence
+#define TRACE_EVENT_DISPLAY         (4) //preview downscale and cvShowImage, arg: ring sequence
+#define TRACE_EVENT_CLAIM           (5) //frame claimed from the ring, arg: ring sequence
+#define TRACE_EVENT_NO_FRAME        (6) //release without a new frame, arg: frame no.
+#define TRACE_EVENT_ENCODE          (7) //.png encode, arg: frame no.
+#define TRACE_EVENT_WRITE           (8) //file write, arg: frame no.
+#define TRACE_EVENT_SNAPSHOT        (9) //frame copied into an encode job, arg: frame no.
+#define TRACE_EVENT_DETECT          (10) //change detection, arg: ring sequence
+#define TRACE_EVENT_UNCHANGED       (11) //frame not stored, scene unchanged, arg: ring sequence
+#define TRACE_EVENT_SHM_PUBLISH     (12) //frame copied into the shared memory ring (-M), arg: ring sequence
+#define TRACE_EVENT_FRAME_GAP       (13) //driver sequence gap before a captured frame, arg: frames lost
+#define TRACE_EVENT_STORED          (14) //frame written, arg: capture to disk latency in micro seconds
+#define TRACE_EVENTS                (15)
+
+//trace file records
+#define TRACE_RECORD_THREAD         (1)
+#define TRACE_RECORD_EVENT          (2)
+
+//trace event, 24 bytes
+typedef struct
+{
+    uint8_t record_type;        //TRACE_RECORD_EVENT, first byte of every record in the file
+    uint8_t phase;              //TRACE_BEGIN/END/INSTANT
+    uint16_t id;                //TRACE_EVENT_xxx
+    uint32_t tid;
+    uint64_t timestamp_nsec;    //CLOCK_MONOTONIC
+    uint64_t arg;
+}trace_event_t;
+
+//trace file: header, event names, then thread and event records in time order per thread
+typedef struct
+{
+    char magic[8];              //TRACE_FILE_MAGIC
+    uint32_t no_of_event_names;
+    uint32_t name_size;         //TRACE_NAME_SIZE
+}trace_file_header_t;
+
+typedef struct
+{
+    uint8_t record_type;        //TRACE_RECORD_THREAD
+    uint8_t reserved[3];
+    uint32_t tid;
+    char name[TRACE_NAME_SIZE];
+}trace_thread_record_t;
+
+//single producer (traced thread), single consumer (drain thread) event ring
+typedef struct
+{
+    uint64_t head __attribute__((aligned(64)));     //next event to write, atomic
+    uint64_t dropped;                               //events lost to a full ring
+    uint64_t tail __attribute__((aligned(64)));     //next event to drain, atomic
+    uint32_t tid;
+    char name[TRACE_NAME_SIZE];
+    trace_event_t events[TRACE_RING_EVENTS] __attribute__((aligned(64)));
+}trace_ring_t;
+
+//ring of the calling thread, NULL if not registered
+extern __thread trace_ring_t *this_trace_ring;
+extern int trace_enabled;
+
+//APIs
+void trace_start(const char *file_name);
+void trace_stop(void);
+void trace_thread_register(const char *name);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  trace_event
+//
+//  Parameters:     id - TRACE_EVENT_xxx
+//                  phase - TRACE_BEGIN, TRACE_END or TRACE_INSTANT
+//                  arg - event argument
+//
+//  Return:         None
+//
+//  Description:    Records an event in the ring of the calling thread, lock-free and wait-free (tens of nano seconds).
+//                  No-op if tracing is not started or the thread is not registered. Full ring drops the event (counted)
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static inline void trace_event(const uint16_t id, const uint8_t phase, const uint64_t arg)
+{
+    struct timespec now;
+    trace_event_t *event;
+    trace_ring_t *ring = this_trace_ring;
+    uint64_t head;
+
+    if(!ring || !__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED)) return;
+
+    head = ring->head; //written only by this thread
+    if((head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) >= TRACE_RING_EVENTS)
+    {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    event = &ring->events[head & (TRACE_RING_EVENTS - 1)];
+    event->record_type = TRACE_RECORD_EVENT;
+    event->phase = phase;
+    event->id = id;
+    event->tid = ring->tid;
+    event->timestamp_nsec = ((uint64_t)now.tv_sec * NSEC_PER_SEC) + now.tv_nsec;
+    event->arg = arg;
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+//hot path tracing, compiled in with DEBUG_MODE_ON only
+#ifdef DEBUG_MODE_ON
+#define TRACE_EVENT(id, phase, arg)     trace_event((id), (phase), (arg))
+#else
+#define TRACE_EVENT(id, phase, arg)     do {} while(0)
+#endif //DEBUG_MODE_ON
+
+#endif //_TRACE_H
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -0,0 +1,167 @@
+//
+//  Author: Nagarjuna Pamidi
+//
+//  File name: trace_export.c
+//
+//  Description: Converts a binary trace file (see trace.c) to the Chrome trace event JSON format,
+//               open the output in chrome://tracing or https://ui.perfetto.dev
+//
+//               Usage: ./trace_export rt_trace.bin rt_trace.json
+//
+
+#include "include.h"
+#include "trace.h"
+
+//local functions
+static int read_record(FILE *fp, trace_event_t *event, trace_thread_record_t *thread_record);
+static void print_usage(void);
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  main
+//
+//  Parameters:     argc, argv - binary trace file, JSON output file
+//
+//  Return:         EXIT_SUCCESS, or EXIT_FAILURE on a bad or truncated trace file
+//
+//  Description:    Two passes over the trace file: the first finds the earliest event (time zero of the timeline),
+//                  the second writes a thread name per traced thread, and a JSON event per trace event.
+//                  Timestamps are in micro seconds, as the format requires
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    FILE *in, *out;
+    int record_type, first = TRUE;
+    unsigned int i;
+    unsigned long long no_of_events = 0, start_nsec = 0;
+    trace_file_header_t header;
+    trace_event_t event;
+    trace_thread_record_t thread_record;
+    char (*event_names)[TRACE_NAME_SIZE];
+    long events_offset;
+
+    if(argc != 3)
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    in = fopen(argv[1], "rb");
+    if(!in) EXIT_FAIL("fopen");
+
+    if((fread(&header, sizeof(header), 1, in) != 1) || memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) ||
+       (header.name_size != TRACE_NAME_SIZE))
+    {
+        fprintf(stderr, "\n%s is not a trace file\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    event_names = (char (*)[TRACE_NAME_SIZE])calloc(header.no_of_event_names, TRACE_NAME_SIZE);
+    if(!event_names) EXIT_FAIL("calloc");
+    if(fread(event_names, TRACE_NAME_SIZE, header.no_of_event_names, in) != header.no_of_event_names)
+    {
+        fprintf(stderr, "\n%s: truncated event names\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    for(i = 0; i < header.no_of_event_names; ++i)
+    {
+        event_names[i][TRACE_NAME_SIZE - 1] = '\0';
+    }
+    events_offset = ftell(in);
+
+    //time zero
+    while((record_type = read_record(in, &event, &thread_record)) > 0)
+    {
+        if(record_type != TRACE_RECORD_EVENT) continue;
+        if(first || (event.timestamp_nsec < start_nsec)) start_nsec = event.timestamp_nsec;
+        first = FALSE;
+    }
+    if(record_type < 0) return EXIT_FAILURE;
+
+    out = fopen(argv[2], "w");
+    if(!out) EXIT_FAIL("fopen");
+    if(fseek(in, events_offset, SEEK_SET)) EXIT_FAIL("fseek");
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                 "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"RTthreads\"}}");
+
+    while((record_type = read_record(in, &event, &thread_record)) > 0)
+    {
+        if(record_type == TRACE_RECORD_THREAD)
+        {
+            thread_record.name[TRACE_NAME_SIZE - 1] = '\0';
+            fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    thread_record.tid, thread_record.name);
+            continue;
+        }
+
+        fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"rt\",\"ph\":\"%c\",%s\"ts\":%.3lf,\"pid\":1,\"tid\":%u,\"args\":{\"arg\":%llu}}",
+                (event.id < header.no_of_event_names) ? event_names[event.id] : "unknown", event.phase,
+                (event.phase == TRACE_INSTANT) ? "\"s\":\"t\"," : "",
+                (double)(event.timestamp_nsec - start_nsec) / NSEC_PER_USEC, event.tid, (unsigned long long)event.arg);
+        ++no_of_events;
+    }
+
+    fprintf(out, "\n]}\n");
+    if(fclose(out)) EXIT_FAIL("fclose");
+    fclose(in);
+    free(event_names);
+
+    if(record_type < 0) return EXIT_FAILURE;
+
+    fprintf(stdout, "%llu events written to %s\n", no_of_events, argv[2]);
+
+    return EXIT_SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  read_record
+//
+//  Parameters:     fp - trace file, at a record
+//                  event - set if an event record is read
+//                  thread_record - set if a thread record is read
+//
+//  Return:         TRACE_RECORD_EVENT or TRACE_RECORD_THREAD, 0 at the end of the file, -1 on a bad or truncated record
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static int read_record(FILE *fp, trace_event_t *event, trace_thread_record_t *thread_record)
+{
+    int record_type = fgetc(fp);
+
+    if(record_type == EOF) return 0;
+    if(ungetc(record_type, fp) == EOF) EXIT_FAIL("ungetc");
+
+    if(record_type == TRACE_RECORD_EVENT)
+    {
+        if(fread(event, sizeof(*event), 1, fp) == 1) return TRACE_RECORD_EVENT;
+    }
+    else if(record_type == TRACE_RECORD_THREAD)
+    {
+        if(fread(thread_record, sizeof(*thread_record), 1, fp) == 1) return TRACE_RECORD_THREAD;
+    }
+
+    fprintf(stderr, "\nbad or truncated trace record at offset %ld\n", ftell(fp));
+
+    return -1;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  print_usage
+//
+//  Parameters:     None
+//
+//  Return:         None
+//
+//------------------------------------------------------------------------------------------------------------------------------
+static void print_usage(void)
+{
+    fprintf(stdout, "\nUsage: ./trace_export <trace file> <json file>"
+                    "\n\nConverts a trace recorded by main (%s, DEBUG_MODE_ON builds) to Chrome trace JSON,"
+                    "\nopen it in chrome://tracing or https://ui.perfetto.dev\n", TRACE_FILE_NAME);
+}
+
+//==============================================================================
+//    End of file!
+//==============================================================================
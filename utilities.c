@@ -7,6 +7,7 @@
 //
 
 #include "include.h"
+#include <sys/syscall.h>
 #include "utilities.h"
 
 //------------------------------------------------------------------------------------------------------------------------------
@@ -16,16 +17,18 @@
 //                  sched_param - parameter to assign to the scheduler
 //                  rt_sched_policy - Type of real time scheduling policy (SCHED_FIFO)
 //                  thread_priority - Assign priority based on this priority level (Assigned as (RT_MAX - threadpriority))
-//                  core - One of available cores on Jetson TX2 board
+//                  core - online core, see placement.c
 //
 //  Return:         None
 //
-//  Description:    Used for assigning the pthread attributes with the provided real-time scheduling scheme and priority.
+//  Description:    Used for assigning the pthread attributes with the provided real-time scheduling scheme, priority
+//                  and core. Only the attributes are set, policy and affinity apply to the thread created with them.
 //
 //------------------------------------------------------------------------------------------------------------------------------
 void assign_RT_schedular_attr(pthread_attr_t *thread_attr, struct sched_param *sched_param, const int rt_sched_policy, const int thread_priority, const int core)
 {
     int rc = 0;
+    cpu_set_t thread_cpu_set;
 
     //initialize the thread attributes to default values
     //and, check if the assignment is successful or not
@@ -57,21 +60,90 @@ void assign_RT_schedular_attr(pthread_attr_t *thread_attr, struct sched_param *s
     assert((sched_param->sched_priority >= sched_get_priority_min(rt_sched_policy)) &&
            (sched_param->sched_priority <= sched_get_priority_max(rt_sched_policy)));
 
-    //set schedular with SCHED_FIFO scheme
-    rc = sched_setscheduler(THIS_THREAD, rt_sched_policy, sched_param);
+    //pin the new thread to the core, the calling thread is left as is
+    CPU_ZERO(&thread_cpu_set);
+    CPU_SET(core, &thread_cpu_set);
+    rc = pthread_attr_setaffinity_np(thread_attr, sizeof(cpu_set_t), &thread_cpu_set);
     if(rc)
     {
-        EXIT_FAIL("sched_setscheduler");
+        EXIT_FAIL("pthread_attr_setaffinity_np");
     }
 
-    set_thread_cpu_affinity(THIS_THREAD, core);
-
     //set scheduling paramater to the thread
     rc = pthread_attr_setschedparam(thread_attr, sched_param);
     if(rc)
     {
         EXIT_FAIL("pthread_attr_setschedparam");
     }
+
+    //explicit stack size, instead of the default (ulimit -s) size
+    rc = pthread_attr_setstacksize(thread_attr, RT_THREAD_STACK_SIZE);
+    if(rc)
+    {
+        EXIT_FAIL("pthread_attr_setstacksize");
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  assign_normal_schedular_attr
+//
+//  Parameters:     thread_attr - pthread attribute structure, used while creating a pthread
+//                  core - online core, or ALL_CORES for every core the process may run on
+//
+//  Return:         None
+//
+//  Description:    Used for assigning the pthread attributes of a normal (SCHED_OTHER) thread. Threads created by an
+//                  RT thread otherwise inherit its policy, priority and core, so helper threads created from the
+//                  dispatcher would run at the max RT priority on the sequencer core
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void assign_normal_schedular_attr(pthread_attr_t *thread_attr, const int core)
+{
+    int rc = 0;
+    struct sched_param sched_param;
+    cpu_set_t thread_cpu_set;
+
+    rc = pthread_attr_init(thread_attr);
+    if(rc)
+    {
+        EXIT_FAIL("pthread_attr_init");
+    }
+
+    rc = pthread_attr_setinheritsched(thread_attr, PTHREAD_EXPLICIT_SCHED);
+    if(rc)
+    {
+        EXIT_FAIL("pthread_attr_setinheritsched");
+    }
+
+    rc = pthread_attr_setschedpolicy(thread_attr, SCHED_OTHER);
+    if(rc)
+    {
+        EXIT_FAIL("pthread_attr_setschedpolicy");
+    }
+
+    sched_param.sched_priority = 0;
+    rc = pthread_attr_setschedparam(thread_attr, &sched_param);
+    if(rc)
+    {
+        EXIT_FAIL("pthread_attr_setschedparam");
+    }
+
+    //the affinity is inherited too, whatever the policy
+    CPU_ZERO(&thread_cpu_set);
+    if(core == ALL_CORES)
+    {
+        //main thread id is the process id, see set_thread_cpu_affinity()
+        if(sched_getaffinity(getpid(), sizeof(cpu_set_t), &thread_cpu_set)) EXIT_FAIL("sched_getaffinity");
+    }
+    else
+    {
+        CPU_SET(core, &thread_cpu_set);
+    }
+    rc = pthread_attr_setaffinity_np(thread_attr, sizeof(cpu_set_t), &thread_cpu_set);
+    if(rc)
+    {
+        EXIT_FAIL("pthread_attr_setaffinity_np");
+    }
 }
 
 //------------------------------------------------------------------------------------------------------------------------------
@@ -249,15 +321,17 @@ struct timespec max_time(const struct timespec *time1, const struct timespec *ti
 //------------------------------------------------------------------------------------------------------------------------------
 //  Function Name:  set_thread_cpu_affinity
 //
-//  Parameters:     thread - calling thread
-//                  core - available core numebr
+//  Parameters:     thread - kernel thread id (see get_thread_id()), THIS_THREAD for the calling thread
+//                  core - available core numebr, ALL_CORES for every core the process may run on
 //
 //  Return:         None
 //
-//  Description:    Used for assigning the pthread cpu affinity of the calling thread, to run on the given core number
+//  Description:    Used for assigning the cpu affinity of the given thread, to run on the given core number.
+//                  ALL_CORES is the affinity of the main thread (never pinned, waits for the dispatcher), so only
+//                  online cores, which need not be numbered contiguously, and the cores allowed by taskset
 //
 //------------------------------------------------------------------------------------------------------------------------------
-void set_thread_cpu_affinity(pthread_t thread, const int core)
+void set_thread_cpu_affinity(const pid_t thread, const int core)
 {
 
     int rc;
@@ -266,15 +340,72 @@ void set_thread_cpu_affinity(pthread_t thread, const int core)
     //Note: make sure "#define _GNU_SOURCE" is included in the header
 
     CPU_ZERO(&jetson_cpu_set); //Initialize jetson_cpu_set to all to 0, i.e. no CPUs selected.
-    CPU_SET(core, &jetson_cpu_set); //set the bit that represents core
+    if(core == ALL_CORES)
+    {
+        //main thread id is the process id
+        if(sched_getaffinity(getpid(), sizeof(cpu_set_t), &jetson_cpu_set)) EXIT_FAIL("sched_getaffinity");
+    }
+    else
+    {
+        CPU_SET(core, &jetson_cpu_set); //set the bit that represents core
+    }
 
-    rc = sched_setaffinity(thread, sizeof(cpu_set_t), &jetson_cpu_set); //Set affinity of current thread to the defined jetson_cpu_set mask
+    rc = sched_setaffinity(thread, sizeof(cpu_set_t), &jetson_cpu_set); //Set affinity of the thread to the defined jetson_cpu_set mask
     if(rc)
     {
         EXIT_FAIL("sched_setaffinity");
     }
 }
 
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  set_thread_sched_deadline
+//
+//  Parameters:     thread - kernel thread id (see get_thread_id()), THIS_THREAD for the calling thread
+//                  runtime_nsec - CPU time budget per period
+//                  deadline_nsec - relative deadline
+//                  period_nsec - reservation period
+//
+//  Return:         SUCCESS, or ERROR with errno set (EBUSY: refused by the kernel admission control,
+//                  EPERM: no privileges, or the thread affinity does not span the root domain)
+//
+//  Description:    Moves the thread to SCHED_DEADLINE with sched_setattr(), runtime <= deadline <= period.
+//                  The kernel throttles the thread once it has used up its runtime (CBS), until the next period
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int set_thread_sched_deadline(const pid_t thread, const unsigned long long runtime_nsec,
+                              const unsigned long long deadline_nsec, const unsigned long long period_nsec)
+{
+    sched_deadline_attr_t attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_DEADLINE;
+    attr.sched_runtime = runtime_nsec;
+    attr.sched_deadline = deadline_nsec;
+    attr.sched_period = period_nsec;
+
+    //no glibc wrapper
+    if(syscall(SYS_sched_setattr, thread, &attr, 0)) return ERROR;
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  get_thread_id
+//
+//  Parameters:     None
+//
+//  Return:         Kernel thread id of the calling thread
+//
+//------------------------------------------------------------------------------------------------------------------------------
+pid_t get_thread_id(void)
+{
+    return (pid_t)syscall(SYS_gettid);
+}
+
+
 //------------------------------------------------------------------------------------------------------------------------------
 //  Function Name:  syslog_scheduler
 //
@@ -307,6 +438,10 @@ void syslog_scheduler()
             syslog(LOG_INFO, " Pthread Policy is SCHED_RR\n");
             break;
 
+        case SCHED_DEADLINE:
+            syslog(LOG_INFO, " Pthread Policy is SCHED_DEADLINE\n");
+            break;
+
         default:
             syslog(LOG_ERR, " Pthread Policy is UNKNOWN\n");
     }
@@ -331,6 +466,45 @@ void syslog_time(unsigned int thread_id, const struct timespec *time)
     syslog(LOG_INFO, "Thread: %d, syslog timestamp %ld:%ld",thread_id, time->tv_sec, time->tv_nsec);
 }
 
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  write_buffer_to_file
+//
+//  Parameters:     file_name - file to create (truncated if exists)
+//                  data - data to write
+//                  size - no.of bytes to write
+//
+//  Return:         SUCCESS/ERROR (errno is set)
+//
+//  Description:    Writes the whole buffer to the file, retrying partial writes
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int write_buffer_to_file(const char *file_name, const void *data, const size_t size)
+{
+    int fd, rc = SUCCESS;
+    ssize_t written;
+    size_t offset = 0;
+
+    fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 00666);
+    if(fd == -1) return ERROR;
+
+    while(offset < size)
+    {
+        written = write(fd, (const char *)data + offset, size - offset);
+        if(written == -1)
+        {
+            if(errno == EINTR) continue;
+            rc = ERROR;
+            break;
+        }
+        offset += written;
+    }
+
+    if(close(fd)) rc = ERROR;
+
+    return rc;
+}
+
 //==============================================================================
 //    End of file!
 //==============================================================================
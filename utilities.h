@@ -10,17 +10,44 @@
 #define _UTILITIES_H
 
 #include "include.h"
+#include <stdint.h>
+
+//set_thread_cpu_affinity() core, every online core
+#define ALL_CORES       (-1)
+
+//not defined by older glibc
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE  (6)
+#endif
+
+//sched_setattr() parameters, see "man 7 sched"
+typedef struct
+{
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;     //nano seconds
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+}sched_deadline_attr_t;
 
 //APIs
 void assign_RT_schedular_attr(pthread_attr_t *thread_attr, struct sched_param *sched_param, const int rt_sched_policy, const int thread_priority, const int core);
+void assign_normal_schedular_attr(pthread_attr_t *thread_attr, const int core);
 double delta_time_in_msec(const struct timespec *end_time, const struct timespec *start_time);
 double elapsed_time_in_msec(const struct timespec *past_time);
 void initialize_syslogs();
 struct timespec min_time(const struct timespec *time1, const struct timespec *time2);
 struct timespec max_time(const struct timespec *time1, const struct timespec *time2);
-void set_thread_cpu_affinity(pthread_t thread, const int core);
+void set_thread_cpu_affinity(const pid_t thread, const int core);
+int set_thread_sched_deadline(const pid_t thread, const unsigned long long runtime_nsec,
+                              const unsigned long long deadline_nsec, const unsigned long long period_nsec);
+pid_t get_thread_id(void);
 void syslog_scheduler();
 void syslog_time(unsigned int thread_id, const struct timespec *time);
+int write_buffer_to_file(const char *file_name, const void *data, const size_t size);
 
 #endif //_UTILITIES_H
 
@@ -3,23 +3,254 @@
 //
 //  File name: v4l2_capture.c
 //
-//  Description: Queries and stores frames periodically
+//  Description: V4L2 streaming (memory mapped) capture engine
 //
 // Note:Parts of this file implementation is referenced from..
 // ..source: http://ecee.colorado.edu/~ecen5623/ecen/ex/Linux/computer-vision/simple-capture/capture.c
 
 #include "include.h"
+#include <poll.h>
+#include <sys/mman.h>
 #include "utilities.h"
 #include "v4l2_capture.h"
 
-// /dev/videoX name
-extern char *device_name; //extern from main.c
+//local functions
+static void init_device(v4l2_device_t *device, const unsigned int buffer_count);
+static void init_mmap(v4l2_device_t *device, const unsigned int buffer_count);
+static void open_device(v4l2_device_t *device);
+static void fill_frame(const v4l2_device_t *device, const struct v4l2_buffer *buf, v4l2_frame_t *frame);
+static int xioctl(int file_descriptor, int request, void *arg);
 
-static struct v4l2_format fmt;
 
-static int device_file_descriptor = -1;
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  v4l2_initialize_device
+//
+//  Parameters:     device - set up
+//                  name - /dev/videoX, kept by the device
+//                  buffer_count - no.of kernel buffers to request for streaming i/o
+//
+//  Return:         None
+//
+//  Description:    Opens the device, negotiates the frame format, and maps the streaming buffers
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void v4l2_initialize_device(v4l2_device_t *device, const char *name, const unsigned int buffer_count)
+{
+    device->name = name;
+    device->file_descriptor = -1;
+    device->mmap_buffers = NULL;
+    device->no_of_mmap_buffers = 0;
+
+    open_device(device);
+    init_device(device, buffer_count);
+
+    syslog(LOG_WARNING, " %s streaming %ux%u, %u bytes per frame, %u buffers",
+           device->name, device->fmt.fmt.pix.width, device->fmt.fmt.pix.height, device->fmt.fmt.pix.sizeimage,
+           device->no_of_mmap_buffers);
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  v4l2_start_capturing
+//
+//  Parameters:     device - initialized device
+//
+//  Return:         None
+//
+//  Description:    Queues all the mapped buffers, and turns the stream on
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void v4l2_start_capturing(v4l2_device_t *device)
+{
+    unsigned int i;
+    enum v4l2_buf_type type;
+    struct v4l2_buffer buf;
+
+    for(i = 0; i < device->no_of_mmap_buffers; ++i)
+    {
+        CLEAR_MEMORY(buf);
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+
+        if(-1 == xioctl(device->file_descriptor, VIDIOC_QBUF, &buf)) EXIT_FAIL("VIDIOC_QBUF");
+    }
+
+    type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if(-1 == xioctl(device->file_descriptor, VIDIOC_STREAMON, &type)) EXIT_FAIL("VIDIOC_STREAMON");
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  v4l2_dequeue_frame
+//
+//  Parameters:     device - capturing device
+//                  frame - filled with the dequeued buffer details
+//                  timeout_msec - max time to wait for the driver to fill a buffer
+//
+//  Return:         SUCCESS if a frame is dequeued, ERROR if no frame is ready within timeout_msec
+//
+//  Description:    Waits (poll) for a filled buffer and dequeues it, then keeps dequeuing without waiting while the
+//                  driver has more filled buffers, handing the older ones straight back. The newest frame is returned,
+//                  so a camera faster than the caller does not leave it up to no_of_mmap_buffers - 1 frames behind.
+//                  frame->skipped is the no.of older frames handed back unread. frame->data points directly into the
+//                  kernel mapped buffer, no copy is made. Hand the buffer back with v4l2_enqueue_frame().
+//                  A poll or ioctl failure other than a timeout exits the application
+//
+//------------------------------------------------------------------------------------------------------------------------------
+int v4l2_dequeue_frame(v4l2_device_t *device, v4l2_frame_t *frame, const int timeout_msec)
+{
+    int rc;
+    struct pollfd device_poll_fd;
+    struct v4l2_buffer buf;
+
+    device_poll_fd.fd = device->file_descriptor;
+    device_poll_fd.events = POLLIN;
+    device_poll_fd.revents = 0;
+
+    do
+    {
+        rc = poll(&device_poll_fd, 1, timeout_msec);
+    } while(-1 == rc && EINTR == errno);
+
+    if(-1 == rc) EXIT_FAIL("poll");
+
+    //timeout
+    if(0 == rc) return ERROR;
+
+    CLEAR_MEMORY(buf);
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+
+    if(-1 == xioctl(device->file_descriptor, VIDIOC_DQBUF, &buf))
+    {
+        //device is opened with O_NONBLOCK, no buffer is ready yet
+        if(EAGAIN == errno) return ERROR;
+
+        EXIT_FAIL("VIDIOC_DQBUF");
+    }
+
+    frame->skipped = 0;
+    fill_frame(device, &buf, frame);
+
+    //newer filled buffers, the older frame goes back to the driver
+    while(1)
+    {
+        CLEAR_MEMORY(buf);
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+
+        if(-1 == xioctl(device->file_descriptor, VIDIOC_DQBUF, &buf))
+        {
+            if(EAGAIN == errno) break;
+
+            EXIT_FAIL("VIDIOC_DQBUF");
+        }
+
+        v4l2_enqueue_frame(device, frame);
+        ++frame->skipped;
+        fill_frame(device, &buf, frame);
+    }
+
+    return SUCCESS;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  v4l2_enqueue_frame
+//
+//  Parameters:     device - capturing device
+//                  frame - previously dequeued frame
+//
+//  Return:         None
+//
+//  Description:    Hands the buffer back to the driver. frame->data must not be used after this call
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void v4l2_enqueue_frame(v4l2_device_t *device, const v4l2_frame_t *frame)
+{
+    struct v4l2_buffer buf;
+
+    CLEAR_MEMORY(buf);
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = frame->index;
 
-static void init_device(void)
+    if(-1 == xioctl(device->file_descriptor, VIDIOC_QBUF, &buf)) EXIT_FAIL("VIDIOC_QBUF");
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  v4l2_stop_capturing
+//
+//  Parameters:     device - initialized device
+//
+//  Return:         None
+//
+//  Description:    Turns the stream off. All the buffers are implicitly dequeued by the driver
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void v4l2_stop_capturing(v4l2_device_t *device)
+{
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    if(-1 == xioctl(device->file_descriptor, VIDIOC_STREAMOFF, &type)) EXIT_FAIL("VIDIOC_STREAMOFF");
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  v4l2_uninitialize_device
+//
+//  Parameters:     device - initialized device
+//
+//  Return:         None
+//
+//  Description:    Unmaps and releases the streaming buffers, and closes the device
+//
+//------------------------------------------------------------------------------------------------------------------------------
+void v4l2_uninitialize_device(v4l2_device_t *device)
+{
+    unsigned int i;
+    struct v4l2_requestbuffers req;
+
+    for(i = 0; i < device->no_of_mmap_buffers; ++i)
+    {
+        if(-1 == munmap(device->mmap_buffers[i].start, device->mmap_buffers[i].length)) EXIT_FAIL("munmap");
+    }
+
+    free(device->mmap_buffers);
+    device->mmap_buffers = NULL;
+    device->no_of_mmap_buffers = 0;
+
+    //release the kernel buffers
+    CLEAR_MEMORY(req);
+    req.count = 0;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    xioctl(device->file_descriptor, VIDIOC_REQBUFS, &req); //errors ignored
+
+    if(-1 == close(device->file_descriptor)) EXIT_FAIL("close");
+    device->file_descriptor = -1;
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------
+//  Function Name:  v4l2_get_format
+//
+//  Parameters:     device - initialized device
+//
+//  Return:         Negotiated frame format
+//
+//  Description:    Width, height, bytesperline and pixelformat of the frames being streamed
+//
+//------------------------------------------------------------------------------------------------------------------------------
+const struct v4l2_format *v4l2_get_format(const v4l2_device_t *device)
+{
+    return &device->fmt;
+}
+
+
+static void init_device(v4l2_device_t *device, const unsigned int buffer_count)
 {
     int rc;
     //
@@ -30,12 +261,12 @@ static void init_device(void)
 
     //https://www.linuxtv.org/downloads/v4l-dvb-apis-old/vidioc-querycap.html
     //query device capabilities
-    rc == xioctl(device_file_descriptor, VIDIOC_QUERYCAP, &device_v4l2_capability);
+    rc = xioctl(device->file_descriptor, VIDIOC_QUERYCAP, &device_v4l2_capability);
     if(rc)
     {
         if (EINVAL == errno)
     {
-        fprintf(stderr, "%s is no V4L2 device\n", device_name);
+        fprintf(stderr, "%s is no V4L2 device\n", device->name);
     }
         EXIT_FAIL("VIDIOC_QUERYCAP");
     }
@@ -43,21 +274,14 @@ static void init_device(void)
     //check if the '/dev/videoX' is video capable or not
     if (!(device_v4l2_capability.capabilities & V4L2_CAP_VIDEO_CAPTURE))
     {
-        fprintf(stderr, "%s is no video capture device\n", device_name);
+        fprintf(stderr, "%s is no video capture device\n", device->name);
         EXIT_FAIL("V4L2_CAP_VIDEO_CAPTURE");
     }
 
-    //check if '/dev/videoX' support I/O read/write capability or not
-    if (!(device_v4l2_capability.capabilities & V4L2_CAP_READWRITE))
-    {
-        fprintf(stderr, "%s does not support read i/o\n", device_name);
-        EXIT_FAIL("V4L2_CAP_READWRITE");
-    }
-
     //check if '/dev/videoX' support streaming capability or not
     if (!(device_v4l2_capability.capabilities & V4L2_CAP_STREAMING))
     {
-        fprintf(stderr, "%s does not support streaming i/o\n", device_name);
+        fprintf(stderr, "%s does not support streaming i/o\n", device->name);
         EXIT_FAIL("V4L2_CAP_STREAMING");
     }
 
@@ -69,20 +293,20 @@ static void init_device(void)
 
     //https://www.linuxtv.org/downloads/legacy/video4linux/API/V4L2_API/spec/rn01re22.html
     //set v4l2 buffer type to capture type
-    if (0 == xioctl(device_file_descriptor, VIDIOC_CROPCAP, &device_v4l2_cropcap))
+    if (0 == xioctl(device->file_descriptor, VIDIOC_CROPCAP, &device_v4l2_cropcap))
     {
         device_v4l2_crop.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         device_v4l2_crop.c = device_v4l2_cropcap.defrect; //reset to default
 
     //use default crop scaling
-        rc == xioctl(device_file_descriptor, VIDIOC_S_CROP, &device_v4l2_crop);
+        rc = xioctl(device->file_descriptor, VIDIOC_S_CROP, &device_v4l2_crop);
         if(rc)
         {
             switch (errno)
             {
                 case EINVAL:
                     // Cropping not supported
-                    fprintf(stdout, "%s cropping not supported\n", device_name);
+                    fprintf(stdout, "%s cropping not supported\n", device->name);
                     break;
 
                 default:
@@ -98,97 +322,141 @@ static void init_device(void)
     }
 
 
-    CLEAR_MEMORY(fmt);
+    CLEAR_MEMORY(device->fmt);
 
-    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    device->fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
-    /*
-    //set capture fram height and width
-    //fmt.fmt.pix.width       = 640;
-    //fmt.fmt.pix.height      = 480;
+    //set capture frame height and width
+    device->fmt.fmt.pix.width       = FRAME_HRES;
+    device->fmt.fmt.pix.height      = FRAME_VRES;
 
     //specify pixel format
-    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
-    //fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_UYVY;
-    //fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_VYUY;
+    device->fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+    //device->fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_UYVY;
+    //device->fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_VYUY;
     // Would be nice if camera supported
-    //fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_GREY;
-    //fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_RGB24;
+    //device->fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_GREY;
+    //device->fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_RGB24;
 
-    //fmt.fmt.pix.field       = V4L2_FIELD_INTERLACED;
-    //fmt.fmt.pix.field       = V4L2_FIELD_NONE;
+    //device->fmt.fmt.pix.field       = V4L2_FIELD_INTERLACED;
+    device->fmt.fmt.pix.field       = V4L2_FIELD_NONE;
 
-    /*if (-1 == xioctl(device_file_descriptor, VIDIOC_S_FMT, &fmt))
+    //drivers adjust the unsupported values, the result is read back below
+    if (-1 == xioctl(device->file_descriptor, VIDIOC_S_FMT, &device->fmt))
     {
-        EXIT_FAIL("VIDIOC_S_FMT");
-    } //*/
+        fprintf(stdout, "%s VIDIOC_S_FMT failed, using current format\n", device->name);
+    }
 
     /* Preserve original settings as set by v4l2-ctl for example */
-    if (-1 == xioctl(device_file_descriptor, VIDIOC_G_FMT, &fmt))
+    if (-1 == xioctl(device->file_descriptor, VIDIOC_G_FMT, &device->fmt))
     {
     EXIT_FAIL("VIDIOC_G_FMT");
     }
 
     //leaving the reference code as is...
     /* Buggy driver paranoia. */
-    min = fmt.fmt.pix.width * 2;
-    if (fmt.fmt.pix.bytesperline < min)
+    min = device->fmt.fmt.pix.width * 2;
+    if (device->fmt.fmt.pix.bytesperline < min)
     {
-        fmt.fmt.pix.bytesperline = min; //Distance in bytes between the leftmost pixels in two adjacent lines.
+        device->fmt.fmt.pix.bytesperline = min; //Distance in bytes between the leftmost pixels in two adjacent lines.
     }
 
-    min = fmt.fmt.pix.bytesperline * fmt.fmt.pix.height;
-    if (fmt.fmt.pix.sizeimage < min)
+    min = device->fmt.fmt.pix.bytesperline * device->fmt.fmt.pix.height;
+    if (device->fmt.fmt.pix.sizeimage < min)
     {
-        fmt.fmt.pix.sizeimage = min;
+        device->fmt.fmt.pix.sizeimage = min;
     }
 
-/*
-    switch (io)
+    init_mmap(device, buffer_count);
+}
+
+static void init_mmap(v4l2_device_t *device, const unsigned int buffer_count)
+{
+    struct v4l2_requestbuffers req;
+    struct v4l2_buffer buf;
+
+    CLEAR_MEMORY(req);
+    req.count = buffer_count;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+
+    if (-1 == xioctl(device->file_descriptor, VIDIOC_REQBUFS, &req))
     {
-        case IO_METHOD_READ:
-            init_read(fmt.fmt.pix.sizeimage); /*
-            break;
+        if (EINVAL == errno)
+        {
+            fprintf(stderr, "%s does not support memory mapping\n", device->name);
+        }
+        EXIT_FAIL("VIDIOC_REQBUFS");
+    }
+
+    //driver may grant fewer buffers than requested
+    if (req.count < MIN_V4L2_BUFFER_COUNT)
+    {
+        fprintf(stderr, "Insufficient buffer memory on %s\n", device->name);
+        EXIT_FAIL("VIDIOC_REQBUFS");
+    }
+
+    device->mmap_buffers = (v4l2_mmap_buffer_t *)calloc(req.count, sizeof(*device->mmap_buffers));
+    if (!device->mmap_buffers) EXIT_FAIL("calloc");
+
+    for (device->no_of_mmap_buffers = 0; device->no_of_mmap_buffers < req.count; ++device->no_of_mmap_buffers)
+    {
+        CLEAR_MEMORY(buf);
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = device->no_of_mmap_buffers;
+
+        if (-1 == xioctl(device->file_descriptor, VIDIOC_QUERYBUF, &buf)) EXIT_FAIL("VIDIOC_QUERYBUF");
 
-        case IO_METHOD_MMAP:
-            init_mmap();
-            break;
+        device->mmap_buffers[device->no_of_mmap_buffers].length = buf.length;
+        device->mmap_buffers[device->no_of_mmap_buffers].start = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                                      device->file_descriptor, buf.m.offset);
 
-        case IO_METHOD_USERPTR:
-            init_userp(fmt.fmt.pix.sizeimage);
-            break;
-    } */
+        if (MAP_FAILED == device->mmap_buffers[device->no_of_mmap_buffers].start) EXIT_FAIL("mmap");
+    }
 }
 
-static void open_device(void)
+static void open_device(v4l2_device_t *device)
 {
     int rc;
     struct stat device_stats;
 
     //retrive informaiton about the /dev/videoX file
-    rc = stat(device_name, &device_stats);
+    rc = stat(device->name, &device_stats);
     if(rc)
     {
-        fprintf(stderr, "Cannot identify '%s'\n", device_name);
+        fprintf(stderr, "Cannot identify '%s'\n", device->name);
         EXIT_FAIL("stat");
     }
 
     //test for device_stats.st_mode directory
     if (!S_ISCHR(device_stats.st_mode))
     {
-        fprintf(stderr, "%s is no device\n", device_name);
+        fprintf(stderr, "%s is no device\n", device->name);
         EXIT_FAIL("S_ISCHR");
     }
 
     //open /dev/videoX file with read/write capabiliteis, and with non-blocking option.
-    device_file_descriptor = open(device_name, O_RDWR | O_NONBLOCK, 0);
-    if (device_file_descriptor == -1)
+    device->file_descriptor = open(device->name, O_RDWR | O_NONBLOCK, 0);
+    if (device->file_descriptor == -1)
     {
-        fprintf(stderr, "Cannot open '%s'\n",device_name);
+        fprintf(stderr, "Cannot open '%s'\n",device->name);
         EXIT_FAIL("open");
     }
 }
 
+static void fill_frame(const v4l2_device_t *device, const struct v4l2_buffer *buf, v4l2_frame_t *frame)
+{
+    assert(buf->index < device->no_of_mmap_buffers);
+
+    frame->index = buf->index;
+    frame->data = (const unsigned char *)device->mmap_buffers[buf->index].start;
+    frame->bytesused = buf->bytesused;
+    frame->timestamp = buf->timestamp;
+    frame->sequence = buf->sequence;
+    frame->flags = buf->flags;
+}
+
 
 static int xioctl(int file_descriptor, int request, void *arg)
 {
@@ -204,3 +472,7 @@ static int xioctl(int file_descriptor, int request, void *arg)
 
     return rc;
 }
+
+//==============================================================================
+//    End of file!
+//==============================================================================
@@ -10,9 +10,56 @@
 #define _V4L2_CAPTURE_HPP_
 
 #include "include.h"
+#include <linux/videodev2.h>
+#include <stddef.h>
+#include <sys/time.h>
 
-static void init_device(void);
-static void open_device(void);
-static int xioctl(int file_descriptor, int request, void *arg);
+//I/O methods used to query frames from the device
+#define IO_METHOD_OPENCV    (0) //cvGrabFrame/cvRetrieveFrame
+#define IO_METHOD_MMAP      (1) //V4L2 streaming i/o, kernel mapped buffers
+
+//no.of kernel buffers requested with VIDIOC_REQBUFS
+#define MIN_V4L2_BUFFER_COUNT       (2)
+#define DEFAULT_V4L2_BUFFER_COUNT   (4)
+#define MAX_V4L2_BUFFER_COUNT       (32)
+
+//mapped kernel buffer
+typedef struct
+{
+    void *start;
+    size_t length;
+}v4l2_mmap_buffer_t;
+
+//streaming device, one per camera
+typedef struct
+{
+    const char *name;                   // /dev/videoX
+    int file_descriptor;
+    struct v4l2_format fmt;
+    v4l2_mmap_buffer_t *mmap_buffers;   //kernel buffers mapped into user space
+    unsigned int no_of_mmap_buffers;
+}v4l2_device_t;
+
+//dequeued frame, points into the kernel mapped buffer
+//valid only until it is handed back with v4l2_enqueue_frame()
+typedef struct
+{
+    unsigned int index;         //kernel buffer index
+    const unsigned char *data;  //start of the mapped buffer
+    size_t bytesused;           //no.of valid bytes in the buffer
+    struct timeval timestamp;   //driver timestamp, clock given by flags
+    unsigned int sequence;      //driver frame sequence number, gaps are frames the driver dropped
+    unsigned int flags;         //V4L2_BUF_FLAG_xxx, V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC for a CLOCK_MONOTONIC timestamp
+    unsigned int skipped;       //older filled buffers handed back unread to return this one, see v4l2_dequeue_frame()
+}v4l2_frame_t;
+
+//APIs
+void v4l2_initialize_device(v4l2_device_t *device, const char *name, const unsigned int buffer_count);
+void v4l2_start_capturing(v4l2_device_t *device);
+int v4l2_dequeue_frame(v4l2_device_t *device, v4l2_frame_t *frame, const int timeout_msec);
+void v4l2_enqueue_frame(v4l2_device_t *device, const v4l2_frame_t *frame);
+void v4l2_stop_capturing(v4l2_device_t *device);
+void v4l2_uninitialize_device(v4l2_device_t *device);
+const struct v4l2_format *v4l2_get_format(const v4l2_device_t *device);
 
 #endif //_V4L2_CAPTURE_HPP_